@@ -319,11 +319,9 @@ static void OptimizeRGB(_Out_ HDRColorA *pX, _Out_ HDRColorA *pY,
 
 
 //-------------------------------------------------------------------------------------
-inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
+// Computes the 4 colors of a BC1 color block
+inline static void DecodeBC1Colors( _Out_writes_(4) XMVECTOR *pClr, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
 {
-    assert( pColor && pBC );
-    static_assert( sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes" );
-
     static XMVECTORF32 s_Scale = { 1.f/31.f, 1.f/63.f, 1.f/31.f, 1.f };
 
     XMVECTOR clr0 = XMLoadU565( reinterpret_cast<const XMU565*>(&pBC->rgb[0]) );
@@ -338,31 +336,34 @@ inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColo
     clr0 = XMVectorSelect( g_XMIdentityR3, clr0, g_XMSelect1110 );
     clr1 = XMVectorSelect( g_XMIdentityR3, clr1, g_XMSelect1110 );
 
-    XMVECTOR clr2, clr3;
+    pClr[0] = clr0;
+    pClr[1] = clr1;
+
     if ( isbc1 && (pBC->rgb[0] <= pBC->rgb[1]) )
     {
-        clr2 = XMVectorLerp( clr0, clr1, 0.5f );
-        clr3 = XMVectorZero();  // Alpha of 0
+        pClr[2] = XMVectorLerp( clr0, clr1, 0.5f );
+        pClr[3] = XMVectorZero();  // Alpha of 0
     }
     else
     {
-        clr2 = XMVectorLerp( clr0, clr1, 1.f/3.f );
-        clr3 = XMVectorLerp( clr0, clr1, 2.f/3.f );
+        pClr[2] = XMVectorLerp( clr0, clr1, 1.f/3.f );
+        pClr[3] = XMVectorLerp( clr0, clr1, 2.f/3.f );
     }
+}
+
+inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
+{
+    assert( pColor && pBC );
+    static_assert( sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes" );
+
+    XMVECTOR clr[4];
+    DecodeBC1Colors( clr, pBC, isbc1 );
 
     uint32_t dw = pBC->bitmap;
 
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
     {
-        switch(dw & 3)
-        {
-        case 0: pColor[i] = clr0; break;
-        case 1: pColor[i] = clr1; break;
-        case 2: pColor[i] = clr2; break;
-
-        case 3:
-        default: pColor[i] = clr3; break;
-        }
+        pColor[i] = clr[dw & 3];
     }
 }
 
@@ -711,147 +712,451 @@ static void EncodeSolidBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK)
 #endif // COLOR_WEIGHTS
 
 
-//=====================================================================================
-// Entry points
-//=====================================================================================
-
 //-------------------------------------------------------------------------------------
-// BC1 Compression
+// Encodes BC_BATCH_BLOCKS blocks at once with one block per vector lane. This mirrors
+// EncodeBC1 and OptimizeRGB operation for operation for the 4-color, non-dithered case
+// so the results are identical to the scalar encoder.
 //-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-void D3DXDecodeBC1(XMVECTOR *pColor, const uint8_t *pBC)
+#ifndef COLOR_WEIGHTS
+inline static XMVECTOR SelectStep(FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, CXMVECTOR V3,
+                                  CXMVECTOR Eq1, CXMVECTOR Eq2, CXMVECTOR Eq3)
 {
-    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
-    DecodeBC1( pColor, pBC1, true );
+    return XMVectorSelect( XMVectorSelect( XMVectorSelect( V0, V1, Eq1 ), V2, Eq2 ), V3, Eq3 );
 }
 
-_Use_decl_annotations_
-void D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float alphaRef, DWORD flags)
+static void EncodeBC1Batch(_Out_writes_(BC_BATCH_BLOCKS) D3DX_BC1 *const *pBC,
+                           _In_reads_(BC_BATCH_BLOCKS) const XMVECTOR *const *pColor, _In_ DWORD flags)
 {
     assert( pBC && pColor );
+    static_assert( sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes" );
+    static_assert( BC_BATCH_BLOCKS == 4, "EncodeBC1Batch assumes one block per XMVECTOR lane" );
 
-    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+    static const float fEpsilon = (0.25f / 64.0f) * (0.25f / 64.0f);
+    static const float pC4[] = { 3.0f/3.0f, 2.0f/3.0f, 1.0f/3.0f, 0.0f/3.0f };
+    static const float pD4[] = { 0.0f/3.0f, 1.0f/3.0f, 2.0f/3.0f, 3.0f/3.0f };
+    static const size_t pSteps4[] = { 0, 2, 3, 1 };
 
-    if (flags & BC_FLAGS_DITHER_A)
+    static const XMVECTORF32 s_31       = { 31.0f, 31.0f, 31.0f, 31.0f };
+    static const XMVECTORF32 s_63       = { 63.0f, 63.0f, 63.0f, 63.0f };
+    static const XMVECTORF32 s_Inv31    = { 1.0f / 31.0f, 1.0f / 31.0f, 1.0f / 31.0f, 1.0f / 31.0f };
+    static const XMVECTORF32 s_Inv63    = { 1.0f / 63.0f, 1.0f / 63.0f, 1.0f / 63.0f, 1.0f / 63.0f };
+    static const XMVECTORF32 s_Steps    = { 3.0f, 3.0f, 3.0f, 3.0f };
+    static const XMVECTORF32 s_Two      = { 2.0f, 2.0f, 2.0f, 2.0f };
+    static const XMVECTORF32 s_Eighth   = { 1.0f / 8.0f, 1.0f / 8.0f, 1.0f / 8.0f, 1.0f / 8.0f };
+    static const XMVECTORF32 s_FltMin   = { FLT_MIN, FLT_MIN, FLT_MIN, FLT_MIN };
+    static const XMVECTORF32 s_MinLen   = { 1.0f / 4096.0f, 1.0f / 4096.0f, 1.0f / 4096.0f, 1.0f / 4096.0f };
+
+    const bool bUniform = (flags & BC_FLAGS_UNIFORM) != 0;
+
+    const XMVECTOR lumR = bUniform ? g_XMOne.v : XMVectorReplicate( g_Luminance.r );
+    const XMVECTOR lumG = bUniform ? g_XMOne.v : XMVectorReplicate( g_Luminance.g );
+    const XMVECTOR lumB = bUniform ? g_XMOne.v : XMVectorReplicate( g_Luminance.b );
+
+    const XMVECTOR zero = XMVectorZero();
+    const XMVECTOR vEpsilon = XMVectorReplicate( fEpsilon );
+
+    // Transpose to structure-of-arrays, quantizing to R5G6B5 as EncodeBC1 does
+    XMVECTOR R[NUM_PIXELS_PER_BLOCK], G[NUM_PIXELS_PER_BLOCK], B[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR QR[NUM_PIXELS_PER_BLOCK], QG[NUM_PIXELS_PER_BLOCK], QB[NUM_PIXELS_PER_BLOCK];
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
-        float fError[NUM_PIXELS_PER_BLOCK];
-        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+        XMMATRIX M( pColor[0][i], pColor[1][i], pColor[2][i], pColor[3][i] );
+        M = XMMatrixTranspose( M );
+
+        XMVECTOR q;
+        q = XMVectorMultiply( XMVectorTruncate( XMVectorAdd( XMVectorMultiply( M.r[0], s_31 ), g_XMOneHalf ) ), s_Inv31 );
+        QR[i] = bUniform ? q : XMVectorMultiply( q, lumR );
+
+        q = XMVectorMultiply( XMVectorTruncate( XMVectorAdd( XMVectorMultiply( M.r[1], s_63 ), g_XMOneHalf ) ), s_Inv63 );
+        QG[i] = bUniform ? q : XMVectorMultiply( q, lumG );
+
+        q = XMVectorMultiply( XMVectorTruncate( XMVectorAdd( XMVectorMultiply( M.r[2], s_31 ), g_XMOneHalf ) ), s_Inv31 );
+        QB[i] = bUniform ? q : XMVectorMultiply( q, lumB );
+
+        R[i] = bUniform ? M.r[0] : XMVectorMultiply( M.r[0], lumR );
+        G[i] = bUniform ? M.r[1] : XMVectorMultiply( M.r[1], lumG );
+        B[i] = bUniform ? M.r[2] : XMVectorMultiply( M.r[2], lumB );
+    }
+
+    // OptimizeRGB: find Min and Max points, as starting point
+    XMVECTOR Xr = lumR, Xg = lumG, Xb = lumB;
+    XMVECTOR Yr = zero, Yg = zero, Yb = zero;
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        Xr = XMVectorMin( QR[i], Xr );
+        Xg = XMVectorMin( QG[i], Xg );
+        Xb = XMVectorMin( QB[i], Xb );
+
+        Yr = XMVectorMax( QR[i], Yr );
+        Yg = XMVectorMax( QG[i], Yg );
+        Yb = XMVectorMax( QB[i], Yb );
+    }
+
+    // Diagonal axis
+    XMVECTOR ABr = XMVectorSubtract( Yr, Xr );
+    XMVECTOR ABg = XMVectorSubtract( Yg, Xg );
+    XMVECTOR ABb = XMVectorSubtract( Yb, Xb );
+
+    XMVECTOR fAB = XMVectorAdd( XMVectorAdd( XMVectorMultiply( ABr, ABr ), XMVectorMultiply( ABg, ABg ) ), XMVectorMultiply( ABb, ABb ) );
+
+    // Single color lanes are finished
+    XMVECTOR solid = XMVectorLess( fAB, s_FltMin );
+
+    // Try all four axis directions, to determine which diagonal best fits data
+    XMVECTOR fABInv = XMVectorDivide( g_XMOne, fAB );
+
+    XMVECTOR Dirr = XMVectorMultiply( ABr, fABInv );
+    XMVECTOR Dirg = XMVectorMultiply( ABg, fABInv );
+    XMVECTOR Dirb = XMVectorMultiply( ABb, fABInv );
+
+    XMVECTOR Midr = XMVectorMultiply( XMVectorAdd( Xr, Yr ), g_XMOneHalf );
+    XMVECTOR Midg = XMVectorMultiply( XMVectorAdd( Xg, Yg ), g_XMOneHalf );
+    XMVECTOR Midb = XMVectorMultiply( XMVectorAdd( Xb, Yb ), g_XMOneHalf );
+
+    XMVECTOR fDir0 = zero, fDir1 = zero, fDir2 = zero, fDir3 = zero;
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMVECTOR Ptr = XMVectorMultiply( XMVectorSubtract( QR[i], Midr ), Dirr );
+        XMVECTOR Ptg = XMVectorMultiply( XMVectorSubtract( QG[i], Midg ), Dirg );
+        XMVECTOR Ptb = XMVectorMultiply( XMVectorSubtract( QB[i], Midb ), Dirb );
+
+        XMVECTOR sum = XMVectorAdd( Ptr, Ptg );
+        XMVECTOR dif = XMVectorSubtract( Ptr, Ptg );
+
+        XMVECTOR f = XMVectorAdd( sum, Ptb );
+        fDir0 = XMVectorAdd( fDir0, XMVectorMultiply( f, f ) );
+
+        f = XMVectorSubtract( sum, Ptb );
+        fDir1 = XMVectorAdd( fDir1, XMVectorMultiply( f, f ) );
+
+        f = XMVectorAdd( dif, Ptb );
+        fDir2 = XMVectorAdd( fDir2, XMVectorMultiply( f, f ) );
+
+        f = XMVectorSubtract( dif, Ptb );
+        fDir3 = XMVectorAdd( fDir3, XMVectorMultiply( f, f ) );
+    }
+
+    // Pick the best direction; bit 1 of its index swaps green, bit 0 swaps blue
+    XMVECTOR fDirMax = fDir0;
+    XMVECTOR swapG = XMVectorFalseInt();
+    XMVECTOR swapB = XMVectorFalseInt();
+
+    XMVECTOR gt = XMVectorGreater( fDir1, fDirMax );
+    fDirMax = XMVectorSelect( fDirMax, fDir1, gt );
+    swapB = XMVectorOrInt( swapB, gt );
+
+    gt = XMVectorGreater( fDir2, fDirMax );
+    fDirMax = XMVectorSelect( fDirMax, fDir2, gt );
+    swapG = XMVectorOrInt( swapG, gt );
+    swapB = XMVectorAndCInt( swapB, gt );
+
+    gt = XMVectorGreater( fDir3, fDirMax );
+    swapG = XMVectorOrInt( swapG, gt );
+    swapB = XMVectorOrInt( swapB, gt );
+
+    swapG = XMVectorAndCInt( swapG, solid );
+    swapB = XMVectorAndCInt( swapB, solid );
+
+    XMVECTOR t = Xg;
+    Xg = XMVectorSelect( Xg, Yg, swapG );
+    Yg = XMVectorSelect( Yg, t, swapG );
+
+    t = Xb;
+    Xb = XMVectorSelect( Xb, Yb, swapB );
+    Yb = XMVectorSelect( Yb, t, swapB );
+
+    // Two color lanes are finished too; use Newton's Method on the rest
+    XMVECTOR active = XMVectorXorInt( XMVectorLess( fAB, s_MinLen ), XMVectorTrueInt() );
+
+    const XMVECTOR C0 = XMVectorReplicate( pC4[0] ), C1 = XMVectorReplicate( pC4[1] ), C2 = XMVectorReplicate( pC4[2] ), C3 = XMVectorReplicate( pC4[3] );
+    const XMVECTOR D0 = XMVectorReplicate( pD4[0] ), D1 = XMVectorReplicate( pD4[1] ), D2 = XMVectorReplicate( pD4[2] ), D3 = XMVectorReplicate( pD4[3] );
+
+    for(size_t iIteration = 0; iIteration < 8; iIteration++)
+    {
+        if ( XMVector4EqualInt( active, XMVectorFalseInt() ) )
+            break;
+
+        // Calculate new steps
+        XMVECTOR S0r = XMVectorAdd( XMVectorMultiply( Xr, C0 ), XMVectorMultiply( Yr, D0 ) );
+        XMVECTOR S0g = XMVectorAdd( XMVectorMultiply( Xg, C0 ), XMVectorMultiply( Yg, D0 ) );
+        XMVECTOR S0b = XMVectorAdd( XMVectorMultiply( Xb, C0 ), XMVectorMultiply( Yb, D0 ) );
+        XMVECTOR S1r = XMVectorAdd( XMVectorMultiply( Xr, C1 ), XMVectorMultiply( Yr, D1 ) );
+        XMVECTOR S1g = XMVectorAdd( XMVectorMultiply( Xg, C1 ), XMVectorMultiply( Yg, D1 ) );
+        XMVECTOR S1b = XMVectorAdd( XMVectorMultiply( Xb, C1 ), XMVectorMultiply( Yb, D1 ) );
+        XMVECTOR S2r = XMVectorAdd( XMVectorMultiply( Xr, C2 ), XMVectorMultiply( Yr, D2 ) );
+        XMVECTOR S2g = XMVectorAdd( XMVectorMultiply( Xg, C2 ), XMVectorMultiply( Yg, D2 ) );
+        XMVECTOR S2b = XMVectorAdd( XMVectorMultiply( Xb, C2 ), XMVectorMultiply( Yb, D2 ) );
+        XMVECTOR S3r = XMVectorAdd( XMVectorMultiply( Xr, C3 ), XMVectorMultiply( Yr, D3 ) );
+        XMVECTOR S3g = XMVectorAdd( XMVectorMultiply( Xg, C3 ), XMVectorMultiply( Yg, D3 ) );
+        XMVECTOR S3b = XMVectorAdd( XMVectorMultiply( Xb, C3 ), XMVectorMultiply( Yb, D3 ) );
+
+        // Calculate color direction
+        Dirr = XMVectorSubtract( Yr, Xr );
+        Dirg = XMVectorSubtract( Yg, Xg );
+        Dirb = XMVectorSubtract( Yb, Xb );
+
+        XMVECTOR fLen = XMVectorAdd( XMVectorAdd( XMVectorMultiply( Dirr, Dirr ), XMVectorMultiply( Dirg, Dirg ) ), XMVectorMultiply( Dirb, Dirb ) );
+
+        active = XMVectorAndCInt( active, XMVectorLess( fLen, s_MinLen ) );
+        if ( XMVector4EqualInt( active, XMVectorFalseInt() ) )
+            break;
+
+        XMVECTOR fScale = XMVectorDivide( s_Steps, fLen );
+
+        Dirr = XMVectorMultiply( Dirr, fScale );
+        Dirg = XMVectorMultiply( Dirg, fScale );
+        Dirb = XMVectorMultiply( Dirb, fScale );
+
+        // Evaluate function, and derivatives
+        XMVECTOR d2X = zero, dXr = zero, dXg = zero, dXb = zero;
+        XMVECTOR d2Y = zero, dYr = zero, dYg = zero, dYb = zero;
 
         for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
         {
-            HDRColorA clr;
-            XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &clr ), pColor[i] );
+            XMVECTOR fDot = XMVectorAdd( XMVectorAdd( XMVectorMultiply( XMVectorSubtract( QR[i], Xr ), Dirr ),
+                                                      XMVectorMultiply( XMVectorSubtract( QG[i], Xg ), Dirg ) ),
+                                                      XMVectorMultiply( XMVectorSubtract( QB[i], Xb ), Dirb ) );
 
-            float fAlph = clr.a + fError[i];
+            XMVECTOR iStep = XMVectorTruncate( XMVectorAdd( fDot, g_XMOneHalf ) );
+            iStep = XMVectorSelect( iStep, zero, XMVectorLessOrEqual( fDot, zero ) );
+            iStep = XMVectorSelect( iStep, s_Steps, XMVectorGreaterOrEqual( fDot, s_Steps ) );
 
-            Color[i].r = clr.r;
-            Color[i].g = clr.g;
-            Color[i].b = clr.b;
-            Color[i].a = (float) static_cast<int32_t>(clr.a + fError[i] + 0.5f);
+            XMVECTOR eq1 = XMVectorEqual( iStep, g_XMOne );
+            XMVECTOR eq2 = XMVectorEqual( iStep, s_Two );
+            XMVECTOR eq3 = XMVectorEqual( iStep, s_Steps );
 
-            float fDiff = fAlph - Color[i].a;
+            XMVECTOR Diffr = XMVectorSubtract( SelectStep( S0r, S1r, S2r, S3r, eq1, eq2, eq3 ), QR[i] );
+            XMVECTOR Diffg = XMVectorSubtract( SelectStep( S0g, S1g, S2g, S3g, eq1, eq2, eq3 ), QG[i] );
+            XMVECTOR Diffb = XMVectorSubtract( SelectStep( S0b, S1b, S2b, S3b, eq1, eq2, eq3 ), QB[i] );
 
-            if(3 != (i & 3))
-            {
-                assert( i < 15 );
-                _Analysis_assume_( i < 15 );
-                fError[i + 1] += fDiff * (7.0f / 16.0f);
-            }
+            XMVECTOR vC = SelectStep( C0, C1, C2, C3, eq1, eq2, eq3 );
+            XMVECTOR vD = SelectStep( D0, D1, D2, D3, eq1, eq2, eq3 );
 
-            if(i < 12)
-            {
-                if(i & 3)
-                    fError[i + 3] += fDiff * (3.0f / 16.0f);
+            XMVECTOR fC = XMVectorMultiply( vC, s_Eighth );
+            XMVECTOR fD = XMVectorMultiply( vD, s_Eighth );
 
-                fError[i + 4] += fDiff * (5.0f / 16.0f);
+            d2X = XMVectorAdd( d2X, XMVectorMultiply( fC, vC ) );
+            dXr = XMVectorAdd( dXr, XMVectorMultiply( fC, Diffr ) );
+            dXg = XMVectorAdd( dXg, XMVectorMultiply( fC, Diffg ) );
+            dXb = XMVectorAdd( dXb, XMVectorMultiply( fC, Diffb ) );
 
-                if(3 != (i & 3))
-                {
-                    assert( i < 11 );
-                    _Analysis_assume_( i < 11 );
-                    fError[i + 5] += fDiff * (1.0f / 16.0f);
-                }
-            }
+            d2Y = XMVectorAdd( d2Y, XMVectorMultiply( fD, vD ) );
+            dYr = XMVectorAdd( dYr, XMVectorMultiply( fD, Diffr ) );
+            dYg = XMVectorAdd( dYg, XMVectorMultiply( fD, Diffg ) );
+            dYb = XMVectorAdd( dYb, XMVectorMultiply( fD, Diffb ) );
         }
+
+        // Move endpoints
+        XMVECTOR mask = XMVectorAndInt( active, XMVectorGreater( d2X, zero ) );
+        XMVECTOR f = XMVectorDivide( g_XMNegativeOne, d2X );
+
+        Xr = XMVectorSelect( Xr, XMVectorAdd( Xr, XMVectorMultiply( dXr, f ) ), mask );
+        Xg = XMVectorSelect( Xg, XMVectorAdd( Xg, XMVectorMultiply( dXg, f ) ), mask );
+        Xb = XMVectorSelect( Xb, XMVectorAdd( Xb, XMVectorMultiply( dXb, f ) ), mask );
+
+        mask = XMVectorAndInt( active, XMVectorGreater( d2Y, zero ) );
+        f = XMVectorDivide( g_XMNegativeOne, d2Y );
+
+        Yr = XMVectorSelect( Yr, XMVectorAdd( Yr, XMVectorMultiply( dYr, f ) ), mask );
+        Yg = XMVectorSelect( Yg, XMVectorAdd( Yg, XMVectorMultiply( dYg, f ) ), mask );
+        Yb = XMVectorSelect( Yb, XMVectorAdd( Yb, XMVectorMultiply( dYb, f ) ), mask );
+
+        XMVECTOR done = XMVectorAndInt( XMVectorAndInt( XMVectorLess( XMVectorMultiply( dXr, dXr ), vEpsilon ),
+                                                        XMVectorLess( XMVectorMultiply( dXg, dXg ), vEpsilon ) ),
+                                        XMVectorLess( XMVectorMultiply( dXb, dXb ), vEpsilon ) );
+        done = XMVectorAndInt( done, XMVectorLess( XMVectorMultiply( dYr, dYr ), vEpsilon ) );
+        done = XMVectorAndInt( done, XMVectorLess( XMVectorMultiply( dYg, dYg ), vEpsilon ) );
+        done = XMVectorAndInt( done, XMVectorLess( XMVectorMultiply( dYb, dYb ), vEpsilon ) );
+
+        active = XMVectorAndCInt( active, done );
     }
-    else
+
+    // Quantize and sort the endpoints per block
+    float fS0r[BC_BATCH_BLOCKS], fS0g[BC_BATCH_BLOCKS], fS0b[BC_BATCH_BLOCKS];
+    float fDirr[BC_BATCH_BLOCKS], fDirg[BC_BATCH_BLOCKS], fDirb[BC_BATCH_BLOCKS];
+
+    bool bSolid[BC_BATCH_BLOCKS];
+
+    for(size_t j = 0; j < BC_BATCH_BLOCKS; ++j)
     {
-        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        HDRColorA ColorA, ColorB, ColorC, ColorD;
+        ColorA.r = XMVectorGetByIndex( Xr, j );
+        ColorA.g = XMVectorGetByIndex( Xg, j );
+        ColorA.b = XMVectorGetByIndex( Xb, j );
+        ColorA.a = 1.0f;
+
+        ColorB.r = XMVectorGetByIndex( Yr, j );
+        ColorB.g = XMVectorGetByIndex( Yg, j );
+        ColorB.b = XMVectorGetByIndex( Yb, j );
+        ColorB.a = 1.0f;
+
+        if ( bUniform )
         {
-            XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[i] ), pColor[i] );
+            ColorC = ColorA;
+            ColorD = ColorB;
         }
-    }
+        else
+        {
+            ColorC.r = ColorA.r * g_LuminanceInv.r;
+            ColorC.g = ColorA.g * g_LuminanceInv.g;
+            ColorC.b = ColorA.b * g_LuminanceInv.b;
 
-    auto pBC1 = reinterpret_cast<D3DX_BC1 *>(pBC);
-    EncodeBC1(pBC1, Color, true, alphaRef, flags);
-}
+            ColorD.r = ColorB.r * g_LuminanceInv.r;
+            ColorD.g = ColorB.g * g_LuminanceInv.g;
+            ColorD.b = ColorB.b * g_LuminanceInv.b;
+        }
 
+        uint16_t wColorA = Encode565(&ColorC);
+        uint16_t wColorB = Encode565(&ColorD);
 
-//-------------------------------------------------------------------------------------
-// BC2 Compression
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-void D3DXDecodeBC2(XMVECTOR *pColor, const uint8_t *pBC)
-{
-    assert( pColor && pBC );
-    static_assert( sizeof(D3DX_BC2) == 16, "D3DX_BC2 should be 16 bytes" );
+        bSolid[j] = (wColorA == wColorB);
+        if ( bSolid[j] )
+        {
+            pBC[j]->rgb[0] = wColorA;
+            pBC[j]->rgb[1] = wColorB;
+            pBC[j]->bitmap = 0x00000000;
 
-    auto pBC2 = reinterpret_cast<const D3DX_BC2 *>(pBC);
+            fS0r[j] = fS0g[j] = fS0b[j] = 0.0f;
+            fDirr[j] = fDirg[j] = fDirb[j] = 0.0f;
+            continue;
+        }
 
-    // RGB part
-    DecodeBC1(pColor, &pBC2->bc1, false);
+        Decode565(&ColorC, wColorA);
+        Decode565(&ColorD, wColorB);
 
-    // 4-bit alpha part
-    DWORD dw = pBC2->bitmap[0];
+        if ( bUniform )
+        {
+            ColorA = ColorC;
+            ColorB = ColorD;
+        }
+        else
+        {
+            ColorA.r = ColorC.r * g_Luminance.r;
+            ColorA.g = ColorC.g * g_Luminance.g;
+            ColorA.b = ColorC.b * g_Luminance.b;
 
-    for(size_t i = 0; i < 8; ++i, dw >>= 4)
-    {
-        #pragma prefast(suppress:22103, "writing blocks in two halves confuses tool")
-        pColor[i] = XMVectorSetW( pColor[i], (float) (dw & 0xf) * (1.0f / 15.0f) );
+            ColorB.r = ColorD.r * g_Luminance.r;
+            ColorB.g = ColorD.g * g_Luminance.g;
+            ColorB.b = ColorD.b * g_Luminance.b;
+        }
+
+        HDRColorA Step[2];
+
+        if(wColorA > wColorB)
+        {
+            pBC[j]->rgb[0] = wColorA;
+            pBC[j]->rgb[1] = wColorB;
+
+            Step[0] = ColorA;
+            Step[1] = ColorB;
+        }
+        else
+        {
+            pBC[j]->rgb[0] = wColorB;
+            pBC[j]->rgb[1] = wColorA;
+
+            Step[0] = ColorB;
+            Step[1] = ColorA;
+        }
+
+        // Calculate color direction
+        HDRColorA Dir;
+
+        Dir.r = Step[1].r - Step[0].r;
+        Dir.g = Step[1].g - Step[0].g;
+        Dir.b = Step[1].b - Step[0].b;
+
+        float fScale = 3.0f / (Dir.r * Dir.r + Dir.g * Dir.g + Dir.b * Dir.b);
+
+        fS0r[j] = Step[0].r;
+        fS0g[j] = Step[0].g;
+        fS0b[j] = Step[0].b;
+
+        fDirr[j] = Dir.r * fScale;
+        fDirg[j] = Dir.g * fScale;
+        fDirb[j] = Dir.b * fScale;
     }
 
-    dw = pBC2->bitmap[1];
+    // Encode colors
+    const XMVECTOR S0r = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fS0r ) );
+    const XMVECTOR S0g = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fS0g ) );
+    const XMVECTOR S0b = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fS0b ) );
 
-    for(size_t i = 8; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 4)
-        pColor[i] = XMVectorSetW( pColor[i], (float) (dw & 0xf) * (1.0f / 15.0f) );
-}
+    Dirr = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fDirr ) );
+    Dirg = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fDirg ) );
+    Dirb = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fDirb ) );
 
-_Use_decl_annotations_
-void D3DXEncodeBC2(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
-{
-    assert( pBC && pColor );
-    static_assert( sizeof(D3DX_BC2) == 16, "D3DX_BC2 should be 16 bytes" );
+    uint32_t dw[BC_BATCH_BLOCKS] = { 0, 0, 0, 0 };
 
-    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
-        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[i] ), pColor[i] );
+        XMVECTOR fDot = XMVectorAdd( XMVectorAdd( XMVectorMultiply( XMVectorSubtract( R[i], S0r ), Dirr ),
+                                                  XMVectorMultiply( XMVectorSubtract( G[i], S0g ), Dirg ) ),
+                                                  XMVectorMultiply( XMVectorSubtract( B[i], S0b ), Dirb ) );
+
+        float fDots[BC_BATCH_BLOCKS], fSteps[BC_BATCH_BLOCKS];
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( fDots ), fDot );
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( fSteps ), XMVectorTruncate( XMVectorAdd( fDot, g_XMOneHalf ) ) );
+
+        for(size_t j = 0; j < BC_BATCH_BLOCKS; ++j)
+        {
+            uint32_t iStep;
+            if(fDots[j] <= 0.0f)
+                iStep = 0;
+            else if(fDots[j] >= 3.0f)
+                iStep = 1;
+            else
+                iStep = static_cast<uint32_t>( pSteps4[static_cast<size_t>(fSteps[j])] );
+
+            dw[j] = (iStep << 30) | (dw[j] >> 2);
+        }
     }
 
-    auto pBC2 = reinterpret_cast<D3DX_BC2 *>(pBC);
+    for(size_t j = 0; j < BC_BATCH_BLOCKS; ++j)
+    {
+        if ( !bSolid[j] )
+            pBC[j]->bitmap = dw[j];
+    }
+}
+#endif // !COLOR_WEIGHTS
 
-    // 4-bit alpha part.  Dithered using Floyd Stienberg error diffusion.
-    pBC2->bitmap[0] = 0;
-    pBC2->bitmap[1] = 0;
 
+//-------------------------------------------------------------------------------------
+static void EncodeBC3Alpha(_Out_ D3DX_BC3 *pBC3, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor, _In_ DWORD flags)
+{
+    assert( pBC3 && pColor );
+
+    // Quantize block to A8, using Floyd Stienberg error diffusion.  This 
+    // increases the chance that colors will map directly to the quantized 
+    // axis endpoints.
+    float fAlpha[NUM_PIXELS_PER_BLOCK];
     float fError[NUM_PIXELS_PER_BLOCK];
+
+    float fMinAlpha = pColor[0].a;
+    float fMaxAlpha = pColor[0].a;
+
     if (flags & BC_FLAGS_DITHER_A)
         memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
 
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
-        float fAlph = Color[i].a;
+        float fAlph = pColor[i].a;
         if (flags & BC_FLAGS_DITHER_A)
             fAlph += fError[i];
 
-        uint32_t u = (uint32_t) static_cast<int32_t>(fAlph * 15.0f + 0.5f);
-
-        pBC2->bitmap[i >> 3] >>= 4;
-        pBC2->bitmap[i >> 3] |= (u << 28);
+        fAlpha[i] = static_cast<int32_t>(fAlph * 255.0f + 0.5f) * (1.0f / 255.0f);
 
+        if(fAlpha[i] < fMinAlpha)
+            fMinAlpha = fAlpha[i];
+        else if(fAlpha[i] > fMaxAlpha)
+            fMaxAlpha = fAlpha[i];
+    
         if (flags & BC_FLAGS_DITHER_A)
-        {     
-            float fDiff = fAlph - (float) u * (1.0f / 15.0f);
+        {
+            float fDiff = fAlph - fAlpha[i];
 
             if(3 != (i & 3))
             {
@@ -877,69 +1182,303 @@ void D3DXEncodeBC2(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
         }
     }
 
-    // RGB part
-#ifdef COLOR_WEIGHTS
-    if(!pBC2->bitmap[0] && !pBC2->bitmap[1])
+    if(1.0f == fMinAlpha)
     {
-        EncodeSolidBC1(pBC2->dxt1, Color);
+        pBC3->alpha[0] = 0xff;
+        pBC3->alpha[1] = 0xff;
+        memset(pBC3->bitmap, 0x00, 6);
         return;
     }
-#endif // COLOR_WEIGHTS
 
-    EncodeBC1(&pBC2->bc1, Color, false, 0.f, flags);
-}
+    // Optimize and Quantize Min and Max values
+    size_t uSteps = ((0.0f == fMinAlpha) || (1.0f == fMaxAlpha)) ? 6 : 8;
 
+    float fAlphaA, fAlphaB;
+    OptimizeAlpha<false>(&fAlphaA, &fAlphaB, fAlpha, uSteps);
 
-//-------------------------------------------------------------------------------------
-// BC3 Compression
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-void D3DXDecodeBC3(XMVECTOR *pColor, const uint8_t *pBC)
-{
-    assert( pColor && pBC );
-    static_assert( sizeof(D3DX_BC3) == 16, "D3DX_BC3 should be 16 bytes" );
+    uint8_t bAlphaA = (uint8_t) static_cast<int32_t>(fAlphaA * 255.0f + 0.5f);
+    uint8_t bAlphaB = (uint8_t) static_cast<int32_t>(fAlphaB * 255.0f + 0.5f);
 
-    auto pBC3 = reinterpret_cast<const D3DX_BC3 *>(pBC);
+    fAlphaA = (float) bAlphaA * (1.0f / 255.0f);
+    fAlphaB = (float) bAlphaB * (1.0f / 255.0f);
 
-    // RGB part
-    DecodeBC1(pColor, &pBC3->bc1, false);
+    // Setup block
+    if((8 == uSteps) && (bAlphaA == bAlphaB))
+    {
+        pBC3->alpha[0] = bAlphaA;
+        pBC3->alpha[1] = bAlphaB;
+        memset(pBC3->bitmap, 0x00, 6);
+        return;
+    }
 
-    // Adaptive 3-bit alpha part
-    float fAlpha[8];
+    static const size_t pSteps6[] = { 0, 2, 3, 4, 5, 1 };
+    static const size_t pSteps8[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
 
-    fAlpha[0] = ((float) pBC3->alpha[0]) * (1.0f / 255.0f);
-    fAlpha[1] = ((float) pBC3->alpha[1]) * (1.0f / 255.0f);
+    const size_t *pSteps;
+    float fStep[8];
 
-    if(pBC3->alpha[0] > pBC3->alpha[1]) 
+    if(6 == uSteps)
     {
+        pBC3->alpha[0] = bAlphaA;
+        pBC3->alpha[1] = bAlphaB;
+
+        fStep[0] = fAlphaA;
+        fStep[1] = fAlphaB;
+
+        for(size_t i = 1; i < 5; ++i)
+            fStep[i + 1] = (fStep[0] * (5 - i) + fStep[1] * i) * (1.0f / 5.0f);
+
+        fStep[6] = 0.0f;
+        fStep[7] = 1.0f;
+
+        pSteps = pSteps6;
+    }
+    else
+    {
+        pBC3->alpha[0] = bAlphaB;
+        pBC3->alpha[1] = bAlphaA;
+
+        fStep[0] = fAlphaB;
+        fStep[1] = fAlphaA;
+
         for(size_t i = 1; i < 7; ++i)
-            fAlpha[i + 1] = (fAlpha[0] * (7 - i) + fAlpha[1] * i) * (1.0f / 7.0f);
+            fStep[i + 1] = (fStep[0] * (7 - i) + fStep[1] * i) * (1.0f / 7.0f);
+
+        pSteps = pSteps8;
     }
-    else 
+
+    // Encode alpha bitmap
+    float fSteps = (float) (uSteps - 1);
+    float fScale = (fStep[0] != fStep[1]) ? (fSteps / (fStep[1] - fStep[0])) : 0.0f;
+
+    if (flags & BC_FLAGS_DITHER_A)
+        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+
+    for(size_t iSet = 0; iSet < 2; iSet++)
     {
-        for(size_t i = 1; i < 5; ++i)
-            fAlpha[i + 1] = (fAlpha[0] * (5 - i) + fAlpha[1] * i) * (1.0f / 5.0f);
+        uint32_t dw = 0;
 
-        fAlpha[6] = 0.0f;
-        fAlpha[7] = 1.0f;
+        size_t iMin = iSet * 8;
+        size_t iLim = iMin + 8;
+
+        for(size_t i = iMin; i < iLim; ++i)
+        {
+            float fAlph = pColor[i].a;
+            if (flags & BC_FLAGS_DITHER_A)
+                fAlph += fError[i];
+            float fDot = (fAlph - fStep[0]) * fScale;
+
+            uint32_t iStep;
+            if(fDot <= 0.0f)
+                iStep = ((6 == uSteps) && (fAlph <= fStep[0] * 0.5f)) ? 6 : 0;
+            else if(fDot >= fSteps)
+                iStep = ((6 == uSteps) && (fAlph >= (fStep[1] + 1.0f) * 0.5f)) ? 7 : 1;
+            else
+                iStep = static_cast<uint32_t>( pSteps[static_cast<size_t>(fDot + 0.5f)] );
+
+            dw = (iStep << 21) | (dw >> 3);
+
+            if (flags & BC_FLAGS_DITHER_A)
+            {
+                float fDiff = (fAlph - fStep[iStep]);
+
+                if(3 != (i & 3))
+                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+
+                if(i < 12)
+                {
+                    if(i & 3)
+                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                    if(3 != (i & 3))
+                        fError[i + 5] += fDiff * (1.0f / 16.0f);
+                }
+            }
+        }
+
+        pBC3->bitmap[0 + iSet * 3] = ((uint8_t *) &dw)[0];
+        pBC3->bitmap[1 + iSet * 3] = ((uint8_t *) &dw)[1];
+        pBC3->bitmap[2 + iSet * 3] = ((uint8_t *) &dw)[2];
     }
+}
 
-    DWORD dw = pBC3->bitmap[0] | (pBC3->bitmap[1] << 8) | (pBC3->bitmap[2] << 16);
+//=====================================================================================
+// Entry points
+//=====================================================================================
 
-    for(size_t i = 0; i < 8; ++i, dw >>= 3)
-        pColor[i] = XMVectorSetW( pColor[i], fAlpha[dw & 0x7] );
+//-------------------------------------------------------------------------------------
+// BC1 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXDecodeBC1(XMVECTOR *pColor, const uint8_t *pBC)
+{
+    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
+    DecodeBC1( pColor, pBC1, true );
+}
 
-    dw = pBC3->bitmap[3] | (pBC3->bitmap[4] << 8) | (pBC3->bitmap[5] << 16);
+_Use_decl_annotations_
+void D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float alphaRef, DWORD flags)
+{
+    assert( pBC && pColor );
 
-    for(size_t i = 8; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 3)
-        pColor[i] = XMVectorSetW( pColor[i], fAlpha[dw & 0x7] );
+    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+
+    if (flags & BC_FLAGS_DITHER_A)
+    {
+        float fError[NUM_PIXELS_PER_BLOCK];
+        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            HDRColorA clr;
+            XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &clr ), pColor[i] );
+
+            float fAlph = clr.a + fError[i];
+
+            Color[i].r = clr.r;
+            Color[i].g = clr.g;
+            Color[i].b = clr.b;
+            Color[i].a = (float) static_cast<int32_t>(clr.a + fError[i] + 0.5f);
+
+            float fDiff = fAlph - Color[i].a;
+
+            if(3 != (i & 3))
+            {
+                assert( i < 15 );
+                _Analysis_assume_( i < 15 );
+                fError[i + 1] += fDiff * (7.0f / 16.0f);
+            }
+
+            if(i < 12)
+            {
+                if(i & 3)
+                    fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                if(3 != (i & 3))
+                {
+                    assert( i < 11 );
+                    _Analysis_assume_( i < 11 );
+                    fError[i + 5] += fDiff * (1.0f / 16.0f);
+                }
+            }
+        }
+    }
+    else
+    {
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[i] ), pColor[i] );
+        }
+    }
+
+    auto pBC1 = reinterpret_cast<D3DX_BC1 *>(pBC);
+    EncodeBC1(pBC1, Color, true, alphaRef, flags);
 }
 
 _Use_decl_annotations_
-void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
+void D3DXEncodeBC1Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, float alphaRef, DWORD flags)
 {
     assert( pBC && pColor );
-    static_assert( sizeof(D3DX_BC3) == 16, "D3DX_BC3 should be 16 bytes" );
+
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A)) )
+    {
+        D3DX_BC1 unused;
+        D3DX_BC1 *pOut[BC_BATCH_BLOCKS];
+        const XMVECTOR *pIn[BC_BATCH_BLOCKS];
+        size_t n = 0;
+
+        for(size_t j = 0; j < nBlocks; ++j)
+        {
+            const XMVECTOR *pBlock = pColor + j * NUM_PIXELS_PER_BLOCK;
+            uint8_t *pDest = pBC + j * sizeof(D3DX_BC1);
+
+            // Color-keyed blocks use the 3-color mode, which only the scalar encoder handles
+            bool bColorKey = false;
+            for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                if ( XMVectorGetW( pBlock[i] ) < alphaRef )
+                {
+                    bColorKey = true;
+                    break;
+                }
+            }
+
+            if ( bColorKey )
+            {
+                D3DXEncodeBC1( pDest, pBlock, alphaRef, flags );
+                continue;
+            }
+
+            pIn[n] = pBlock;
+            pOut[n] = reinterpret_cast<D3DX_BC1 *>(pDest);
+
+            if ( ++n == BC_BATCH_BLOCKS )
+            {
+                EncodeBC1Batch( pOut, pIn, flags );
+                n = 0;
+            }
+        }
+
+        if ( n > 0 )
+        {
+            for(size_t j = n; j < BC_BATCH_BLOCKS; ++j)
+            {
+                pIn[j] = pIn[0];
+                pOut[j] = &unused;
+            }
+
+            EncodeBC1Batch( pOut, pIn, flags );
+        }
+        return;
+    }
+#endif // !COLOR_WEIGHTS
+
+    for(size_t j = 0; j < nBlocks; ++j)
+    {
+        D3DXEncodeBC1( pBC + j * sizeof(D3DX_BC1), pColor + j * NUM_PIXELS_PER_BLOCK, alphaRef, flags );
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// BC2 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXDecodeBC2(XMVECTOR *pColor, const uint8_t *pBC)
+{
+    assert( pColor && pBC );
+    static_assert( sizeof(D3DX_BC2) == 16, "D3DX_BC2 should be 16 bytes" );
+
+    auto pBC2 = reinterpret_cast<const D3DX_BC2 *>(pBC);
+
+    // RGB part
+    DecodeBC1(pColor, &pBC2->bc1, false);
+
+    // 4-bit alpha part
+    DWORD dw = pBC2->bitmap[0];
+
+    for(size_t i = 0; i < 8; ++i, dw >>= 4)
+    {
+        #pragma prefast(suppress:22103, "writing blocks in two halves confuses tool")
+        pColor[i] = XMVectorSetW( pColor[i], (float) (dw & 0xf) * (1.0f / 15.0f) );
+    }
+
+    dw = pBC2->bitmap[1];
+
+    for(size_t i = 8; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 4)
+        pColor[i] = XMVectorSetW( pColor[i], (float) (dw & 0xf) * (1.0f / 15.0f) );
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC2(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
+{
+    assert( pBC && pColor );
+    static_assert( sizeof(D3DX_BC2) == 16, "D3DX_BC2 should be 16 bytes" );
 
     HDRColorA Color[NUM_PIXELS_PER_BLOCK];
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
@@ -947,17 +1486,13 @@ void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
         XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[i] ), pColor[i] );
     }
 
-    auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
-
-    // Quantize block to A8, using Floyd Stienberg error diffusion.  This 
-    // increases the chance that colors will map directly to the quantized 
-    // axis endpoints.
-    float fAlpha[NUM_PIXELS_PER_BLOCK];
-    float fError[NUM_PIXELS_PER_BLOCK];
+    auto pBC2 = reinterpret_cast<D3DX_BC2 *>(pBC);
 
-    float fMinAlpha = Color[0].a;
-    float fMaxAlpha = Color[0].a;
+    // 4-bit alpha part.  Dithered using Floyd Stienberg error diffusion.
+    pBC2->bitmap[0] = 0;
+    pBC2->bitmap[1] = 0;
 
+    float fError[NUM_PIXELS_PER_BLOCK];
     if (flags & BC_FLAGS_DITHER_A)
         memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
 
@@ -967,16 +1502,14 @@ void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
         if (flags & BC_FLAGS_DITHER_A)
             fAlph += fError[i];
 
-        fAlpha[i] = static_cast<int32_t>(fAlph * 255.0f + 0.5f) * (1.0f / 255.0f);
+        uint32_t u = (uint32_t) static_cast<int32_t>(fAlph * 15.0f + 0.5f);
+
+        pBC2->bitmap[i >> 3] >>= 4;
+        pBC2->bitmap[i >> 3] |= (u << 28);
 
-        if(fAlpha[i] < fMinAlpha)
-            fMinAlpha = fAlpha[i];
-        else if(fAlpha[i] > fMaxAlpha)
-            fMaxAlpha = fAlpha[i];
-    
         if (flags & BC_FLAGS_DITHER_A)
-        {
-            float fDiff = fAlph - fAlpha[i];
+        {     
+            float fDiff = fAlph - (float) u * (1.0f / 15.0f);
 
             if(3 != (i & 3))
             {
@@ -1002,139 +1535,224 @@ void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
         }
     }
 
+    // RGB part
 #ifdef COLOR_WEIGHTS
-    if(0.0f == fMaxAlpha)
+    if(!pBC2->bitmap[0] && !pBC2->bitmap[1])
     {
-        EncodeSolidBC1(&pBC3->dxt1, Color);
-        pBC3->alpha[0] = 0x00;
-        pBC3->alpha[1] = 0x00;
-        memset(pBC3->bitmap, 0x00, 6);
+        EncodeSolidBC1(pBC2->dxt1, Color);
+        return;
     }
-#endif
+#endif // COLOR_WEIGHTS
+
+    EncodeBC1(&pBC2->bc1, Color, false, 0.f, flags);
+}
+
+
+//-------------------------------------------------------------------------------------
+// BC3 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXDecodeBC3(XMVECTOR *pColor, const uint8_t *pBC)
+{
+    assert( pColor && pBC );
+    static_assert( sizeof(D3DX_BC3) == 16, "D3DX_BC3 should be 16 bytes" );
+
+    auto pBC3 = reinterpret_cast<const D3DX_BC3 *>(pBC);
 
     // RGB part
-    EncodeBC1(&pBC3->bc1, Color, false, 0.f, flags);
+    DecodeBC1(pColor, &pBC3->bc1, false);
 
-    // Alpha part
-    if(1.0f == fMinAlpha)
+    // Adaptive 3-bit alpha part
+    float fAlpha[8];
+    D3DXDecodeAlphaPalette( fAlpha, pBC );
+
+    DWORD dw = pBC3->bitmap[0] | (pBC3->bitmap[1] << 8) | (pBC3->bitmap[2] << 16);
+
+    for(size_t i = 0; i < 8; ++i, dw >>= 3)
+        pColor[i] = XMVectorSetW( pColor[i], fAlpha[dw & 0x7] );
+
+    dw = pBC3->bitmap[3] | (pBC3->bitmap[4] << 8) | (pBC3->bitmap[5] << 16);
+
+    for(size_t i = 8; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 3)
+        pColor[i] = XMVectorSetW( pColor[i], fAlpha[dw & 0x7] );
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
+{
+    assert( pBC && pColor );
+    static_assert( sizeof(D3DX_BC3) == 16, "D3DX_BC3 should be 16 bytes" );
+
+    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
-        pBC3->alpha[0] = 0xff;
-        pBC3->alpha[1] = 0xff;
-        memset(pBC3->bitmap, 0x00, 6);
-        return;
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[i] ), pColor[i] );
     }
 
-    // Optimize and Quantize Min and Max values
-    size_t uSteps = ((0.0f == fMinAlpha) || (1.0f == fMaxAlpha)) ? 6 : 8;
+    auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
 
-    float fAlphaA, fAlphaB;
-    OptimizeAlpha<false>(&fAlphaA, &fAlphaB, fAlpha, uSteps);
+    // RGB part
+    EncodeBC1(&pBC3->bc1, Color, false, 0.f, flags);
 
-    uint8_t bAlphaA = (uint8_t) static_cast<int32_t>(fAlphaA * 255.0f + 0.5f);
-    uint8_t bAlphaB = (uint8_t) static_cast<int32_t>(fAlphaB * 255.0f + 0.5f);
+    // Alpha part
+    EncodeBC3Alpha(pBC3, Color, flags);
+}
 
-    fAlphaA = (float) bAlphaA * (1.0f / 255.0f);
-    fAlphaB = (float) bAlphaB * (1.0f / 255.0f);
+_Use_decl_annotations_
+void D3DXEncodeBC3Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags)
+{
+    assert( pBC && pColor );
+    static_assert( sizeof(D3DX_BC3) == 16, "D3DX_BC3 should be 16 bytes" );
 
-    // Setup block
-    if((8 == uSteps) && (bAlphaA == bAlphaB))
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & BC_FLAGS_DITHER_RGB) )
     {
-        pBC3->alpha[0] = bAlphaA;
-        pBC3->alpha[1] = bAlphaB;
-        memset(pBC3->bitmap, 0x00, 6);
+        auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
+
+        for(size_t j = 0; j < nBlocks; j += BC_BATCH_BLOCKS)
+        {
+            const size_t n = std::min<size_t>( BC_BATCH_BLOCKS, nBlocks - j );
+
+            D3DX_BC1 unused;
+            D3DX_BC1 *pOut[BC_BATCH_BLOCKS];
+            const XMVECTOR *pIn[BC_BATCH_BLOCKS];
+
+            for(size_t k = 0; k < BC_BATCH_BLOCKS; ++k)
+            {
+                if ( k < n )
+                {
+                    pIn[k] = pColor + (j + k) * NUM_PIXELS_PER_BLOCK;
+                    pOut[k] = &pBC3[j + k].bc1;
+                }
+                else
+                {
+                    pIn[k] = pIn[0];
+                    pOut[k] = &unused;
+                }
+            }
+
+            // RGB part
+            EncodeBC1Batch( pOut, pIn, flags );
+
+            // Alpha part
+            for(size_t k = 0; k < n; ++k)
+            {
+                HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+                for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                {
+                    XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[i] ), pIn[k][i] );
+                }
+
+                EncodeBC3Alpha( &pBC3[j + k], Color, flags );
+            }
+        }
         return;
     }
+#endif // !COLOR_WEIGHTS
 
-    static const size_t pSteps6[] = { 0, 2, 3, 4, 5, 1 };
-    static const size_t pSteps8[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+    for(size_t j = 0; j < nBlocks; ++j)
+    {
+        D3DXEncodeBC3( pBC + j * sizeof(D3DX_BC3), pColor + j * NUM_PIXELS_PER_BLOCK, flags );
+    }
+}
 
-    const size_t *pSteps;
-    float fStep[8];
 
-    if(6 == uSteps)
+//-------------------------------------------------------------------------------------
+// Integer decoding to RGBA8
+//-------------------------------------------------------------------------------------
+// Builds the 4 colors of a BC1 color block with the float decoder's math, stored the way XMStoreUByteN4 does,
+// so only the 4 palette entries are converted rather than all 16 pixels
+static void DecodeBC1Palette( _Out_writes_(4) uint32_t* pPalette, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1, _In_ bool bgr )
+{
+    XMVECTOR clr[4];
+    DecodeBC1Colors( clr, pBC, isbc1 );
+
+    for(size_t i = 0; i < 4; ++i)
     {
-        pBC3->alpha[0] = bAlphaA;
-        pBC3->alpha[1] = bAlphaB;
+        XMStoreUByteN4( reinterpret_cast<XMUBYTEN4*>( &pPalette[i] ), ( bgr ) ? XMVectorSwizzle<2, 1, 0, 3>( clr[i] ) : clr[i] );
+    }
+}
 
-        fStep[0] = fAlphaA;
-        fStep[1] = fAlphaB;
+inline static void StoreBlockRGBA8( _Out_ uint8_t *pDest, _In_ size_t rowPitch, _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t* pTexels )
+{
+    for(size_t j = 0; j < 4; ++j)
+    {
+        memcpy( pDest + j * rowPitch, pTexels + j * 4, sizeof(uint32_t) * 4 );
+    }
+}
 
-        for(size_t i = 1; i < 5; ++i)
-            fStep[i + 1] = (fStep[0] * (5 - i) + fStep[1] * i) * (1.0f / 5.0f);
+_Use_decl_annotations_
+void D3DXDecodeBC1RGBA8(uint8_t *pDest, size_t rowPitch, const uint8_t *pBC, size_t nBlocks, bool bgr)
+{
+    assert( pDest && pBC );
 
-        fStep[6] = 0.0f;
-        fStep[7] = 1.0f;
+    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
 
-        pSteps = pSteps6;
-    }
-    else
+    for(size_t j = 0; j < nBlocks; ++j, pDest += 16)
     {
-        pBC3->alpha[0] = bAlphaB;
-        pBC3->alpha[1] = bAlphaA;
+        uint32_t palette[4];
+        DecodeBC1Palette( palette, &pBC1[j], true, bgr );
 
-        fStep[0] = fAlphaB;
-        fStep[1] = fAlphaA;
+        uint32_t texels[NUM_PIXELS_PER_BLOCK];
+        uint32_t dw = pBC1[j].bitmap;
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
+            texels[i] = palette[dw & 3];
 
-        for(size_t i = 1; i < 7; ++i)
-            fStep[i + 1] = (fStep[0] * (7 - i) + fStep[1] * i) * (1.0f / 7.0f);
-
-        pSteps = pSteps8;
+        StoreBlockRGBA8( pDest, rowPitch, texels );
     }
+}
 
-    // Encode alpha bitmap
-    float fSteps = (float) (uSteps - 1);
-    float fScale = (fStep[0] != fStep[1]) ? (fSteps / (fStep[1] - fStep[0])) : 0.0f;
+_Use_decl_annotations_
+void D3DXDecodeBC2RGBA8(uint8_t *pDest, size_t rowPitch, const uint8_t *pBC, size_t nBlocks, bool bgr)
+{
+    assert( pDest && pBC );
 
-    if (flags & BC_FLAGS_DITHER_A)
-        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+    auto pBC2 = reinterpret_cast<const D3DX_BC2 *>(pBC);
 
-    for(size_t iSet = 0; iSet < 2; iSet++)
+    for(size_t j = 0; j < nBlocks; ++j, pDest += 16)
     {
-        uint32_t dw = 0;
+        uint32_t palette[4];
+        DecodeBC1Palette( palette, &pBC2[j].bc1, false, bgr );
 
-        size_t iMin = iSet * 8;
-        size_t iLim = iMin + 8;
+        uint32_t texels[NUM_PIXELS_PER_BLOCK];
+        uint32_t dw = pBC2[j].bc1.bitmap;
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
+            texels[i] = palette[dw & 3] & 0x00ffffff;
 
-        for(size_t i = iMin; i < iLim; ++i)
+        // 4-bit alpha part
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
         {
-            float fAlph = Color[i].a;
-            if (flags & BC_FLAGS_DITHER_A)
-                fAlph += fError[i];
-            float fDot = (fAlph - fStep[0]) * fScale;
-
-            uint32_t iStep;
-            if(fDot <= 0.0f)
-                iStep = ((6 == uSteps) && (fAlph <= fStep[0] * 0.5f)) ? 6 : 0;
-            else if(fDot >= fSteps)
-                iStep = ((6 == uSteps) && (fAlph >= (fStep[1] + 1.0f) * 0.5f)) ? 7 : 1;
-            else
-                iStep = static_cast<uint32_t>( pSteps[static_cast<size_t>(fDot + 0.5f)] );
+            uint32_t a = ( pBC2[j].bitmap[i >> 3] >> ((i & 7) * 4) ) & 0xf;
+            texels[i] |= uint32_t( D3DXQuantizeUNorm8( (float) a * (1.0f / 15.0f) ) ) << 24;
+        }
 
-            dw = (iStep << 21) | (dw >> 3);
+        StoreBlockRGBA8( pDest, rowPitch, texels );
+    }
+}
 
-            if (flags & BC_FLAGS_DITHER_A)
-            {
-                float fDiff = (fAlph - fStep[iStep]);
+_Use_decl_annotations_
+void D3DXDecodeBC3RGBA8(uint8_t *pDest, size_t rowPitch, const uint8_t *pBC, size_t nBlocks, bool bgr)
+{
+    assert( pDest && pBC );
 
-                if(3 != (i & 3))
-                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+    auto pBC3 = reinterpret_cast<const D3DX_BC3 *>(pBC);
 
-                if(i < 12)
-                {
-                    if(i & 3)
-                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+    for(size_t j = 0; j < nBlocks; ++j, pDest += 16)
+    {
+        uint32_t palette[4];
+        DecodeBC1Palette( palette, &pBC3[j].bc1, false, bgr );
 
-                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+        // Adaptive 3-bit alpha part
+        uint8_t alpha[8];
+        D3DXDecodeAlphaPalette8( alpha, reinterpret_cast<const uint8_t*>( &pBC3[j] ) );
+        uint64_t aw = D3DXGetAlphaIndices( reinterpret_cast<const uint8_t*>( &pBC3[j] ) );
 
-                    if(3 != (i & 3))
-                        fError[i + 5] += fDiff * (1.0f / 16.0f);
-                }
-            }
-        }
+        uint32_t texels[NUM_PIXELS_PER_BLOCK];
+        uint32_t dw = pBC3[j].bc1.bitmap;
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2, aw >>= 3)
+            texels[i] = ( palette[dw & 3] & 0x00ffffff ) | ( uint32_t( alpha[aw & 7] ) << 24 );
 
-        pBC3->bitmap[0 + iSet * 3] = ((uint8_t *) &dw)[0];
-        pBC3->bitmap[1 + iSet * 3] = ((uint8_t *) &dw)[1];
-        pBC3->bitmap[2 + iSet * 3] = ((uint8_t *) &dw)[2];
+        StoreBlockRGBA8( pDest, rowPitch, texels );
     }
 }
 
@@ -47,6 +47,8 @@ const size_t BC6H_MAX_SHAPES = 32;
 const size_t BC7_NUM_CHANNELS = 4;
 const size_t BC7_MAX_SHAPES = 64;
 
+const size_t BC_BATCH_BLOCKS = 4;      // Blocks encoded together by the D3DXEncodeBC?Batch functions (one per SIMD lane)
+
 const int32_t BC67_WEIGHT_MAX = 64;
 const uint32_t BC67_WEIGHT_SHIFT = 6;
 const int32_t BC67_WEIGHT_ROUND = 32;
@@ -61,8 +63,14 @@ enum BC_FLAGS
     BC_FLAGS_DITHER_RGB = 0x10000,  // Enables dithering for RGB colors for BC1-3
     BC_FLAGS_DITHER_A   = 0x20000,  // Enables dithering for Alpha channel for BC1-3
     BC_FLAGS_UNIFORM    = 0x40000,  // By default, uses perceptual weighting for BC1-3; this flag makes it a uniform weighting
+    BC_FLAGS_BC7_QUICK      = 0x100000, // BC7 level 1: skips modes that can't win for the block and refines fewer partitions
+    BC_FLAGS_BC7_QUICKER    = 0x200000, // BC7 level 2: also skips the 3-subset modes and caps endpoint refinement
+    BC_FLAGS_BC7_QUICKEST   = 0x300000, // BC7 level 3: only tries mode 6, with minimal endpoint refinement
+    BC_FLAGS_BC6H_QUICK     = 0x400000, // BC6H: near-uniform blocks only try the one-region modes, and fewer shapes are refined
 };
 
+#define BC_FLAGS_BC7_LEVEL_MASK 0x300000
+
 //-------------------------------------------------------------------------------------
 // Structures
 //-------------------------------------------------------------------------------------
@@ -521,7 +529,7 @@ class D3DX_BC6H : private CBits< 16 >
 {
 public:
     void Decode(_In_ bool bSigned, _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const;
-    void Encode(_In_ bool bSigned, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
+    void Encode(_In_ bool bSigned, _In_ DWORD flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
 
 private:
 #pragma warning(push)
@@ -625,7 +633,7 @@ class D3DX_BC7 : private CBits< 16 >
 {
 public:
     void Decode(_Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const;
-    void Encode(_In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
+    void Encode(_In_ DWORD flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
 
 private:
     struct ModeInfo
@@ -649,8 +657,10 @@ private:
         LDREndPntPair aEndPts[BC7_MAX_SHAPES][BC7_MAX_REGIONS];
         LDRColorA aLDRPixels[NUM_PIXELS_PER_BLOCK];
         const HDRColorA* const aHDRPixels;
+        size_t uPerturbPasses;      // Limit on alternating endpoint perturbation passes (0 for no limit)
+        int iExhaustiveDelta;       // Range of the final exhaustive endpoint search (0 to skip it)
 
-        EncodeParams(const HDRColorA* const aOriginal) : aHDRPixels(aOriginal) {}
+        EncodeParams(const HDRColorA* const aOriginal) : aHDRPixels(aOriginal), uPerturbPasses(0), iExhaustiveDelta(5) {}
     };
 #pragma warning(pop)
 
@@ -864,6 +874,7 @@ template <bool bRange> void OptimizeAlpha(float *pX, float *pY, const float *pPo
 
 typedef void (*BC_DECODE)(XMVECTOR *pColor, const uint8_t *pBC);
 typedef void (*BC_ENCODE)(uint8_t *pDXT, const XMVECTOR *pColor, DWORD flags);
+typedef void (*BC_ENCODE_BATCH)(uint8_t *pDXT, const XMVECTOR *pColor, size_t nBlocks, DWORD flags);
 
 void D3DXDecodeBC1(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(8) const uint8_t *pBC);
 void D3DXDecodeBC2(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC);
@@ -889,4 +900,69 @@ void D3DXEncodeBC6HU(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BL
 void D3DXEncodeBC6HS(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 void D3DXEncodeBC7(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 
+// Encodes nBlocks consecutive blocks (NUM_PIXELS_PER_BLOCK colors each) into consecutive output blocks.
+// Results are identical to calling the single-block encoder for each block.
+void D3DXEncodeBC1Batch(_Out_writes_(nBlocks * 8) uint8_t *pBC, _In_reads_(nBlocks * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t nBlocks, _In_ float alphaRef, _In_ DWORD flags);
+    // BC1 requires one additional parameter, so it doesn't match signature of BC_ENCODE_BATCH above
+
+void D3DXEncodeBC3Batch(_Out_writes_(nBlocks * 16) uint8_t *pBC, _In_reads_(nBlocks * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ size_t nBlocks, _In_ DWORD flags);
+
+// Decodes nBlocks consecutive blocks (a row of blocks) to 8-bit RGBA, or BGRA if bgr is set, with integer math only.
+// Writes 4 rows of nBlocks * 4 pixels starting at pDest, rowPitch bytes apart. Channels match decoding to float and
+// storing as R8G8B8A8_UNORM (BC4 red is replicated to RGB, BC5 has zero blue) bit for bit
+typedef void (*BC_DECODE_RGBA8)(uint8_t *pDest, size_t rowPitch, const uint8_t *pBC, size_t nBlocks, bool bgr);
+
+void D3DXDecodeBC1RGBA8(_Out_ uint8_t *pDest, _In_ size_t rowPitch, _In_reads_(nBlocks * 8) const uint8_t *pBC, _In_ size_t nBlocks, _In_ bool bgr);
+void D3DXDecodeBC2RGBA8(_Out_ uint8_t *pDest, _In_ size_t rowPitch, _In_reads_(nBlocks * 16) const uint8_t *pBC, _In_ size_t nBlocks, _In_ bool bgr);
+void D3DXDecodeBC3RGBA8(_Out_ uint8_t *pDest, _In_ size_t rowPitch, _In_reads_(nBlocks * 16) const uint8_t *pBC, _In_ size_t nBlocks, _In_ bool bgr);
+void D3DXDecodeBC4URGBA8(_Out_ uint8_t *pDest, _In_ size_t rowPitch, _In_reads_(nBlocks * 8) const uint8_t *pBC, _In_ size_t nBlocks, _In_ bool bgr);
+void D3DXDecodeBC5URGBA8(_Out_ uint8_t *pDest, _In_ size_t rowPitch, _In_reads_(nBlocks * 16) const uint8_t *pBC, _In_ size_t nBlocks, _In_ bool bgr);
+
+// Converts a [0,1] value to 8 bits the way XMStoreUByteN4 does (saturated, then truncated)
+inline uint8_t D3DXQuantizeUNorm8(_In_ float f)
+{
+    f = ( f > 0.0f ) ? f : 0.0f;
+    f = ( f < 1.0f ) ? f : 1.0f;
+    return static_cast<uint8_t>( f * 255.0f );
+}
+
+// Palette of a BC3 alpha block (2 endpoint bytes followed by 48 bits of 3-bit indices), as D3DXDecodeBC3 computes it
+inline void D3DXDecodeAlphaPalette(_Out_writes_(8) float *pPalette, _In_reads_(8) const uint8_t *pBlock)
+{
+    pPalette[0] = ((float) pBlock[0]) * (1.0f / 255.0f);
+    pPalette[1] = ((float) pBlock[1]) * (1.0f / 255.0f);
+
+    if(pBlock[0] > pBlock[1])
+    {
+        for(size_t i = 1; i < 7; ++i)
+            pPalette[i + 1] = (pPalette[0] * (7 - i) + pPalette[1] * i) * (1.0f / 7.0f);
+    }
+    else
+    {
+        for(size_t i = 1; i < 5; ++i)
+            pPalette[i + 1] = (pPalette[0] * (5 - i) + pPalette[1] * i) * (1.0f / 5.0f);
+
+        pPalette[6] = 0.0f;
+        pPalette[7] = 1.0f;
+    }
+}
+
+// The same palette converted to 8 bits
+inline void D3DXDecodeAlphaPalette8(_Out_writes_(8) uint8_t *pPalette, _In_reads_(8) const uint8_t *pBlock)
+{
+    float fAlpha[8];
+    D3DXDecodeAlphaPalette( fAlpha, pBlock );
+
+    for(size_t i = 0; i < 8; ++i)
+        pPalette[i] = D3DXQuantizeUNorm8( fAlpha[i] );
+}
+
+inline uint64_t D3DXGetAlphaIndices(_In_reads_(8) const uint8_t *pBlock)
+{
+    uint64_t dw = 0;
+    for( size_t i = 6; i > 0; --i )
+        dw = ( dw << 8 ) | pBlock[i + 1];
+    return dw;
+}
+
 }; // namespace
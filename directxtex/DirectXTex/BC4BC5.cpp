@@ -545,4 +545,62 @@ void D3DXEncodeBC5S( uint8_t *pBC, const XMVECTOR *pColor, DWORD flags )
     FindClosestSNORM(pBCG, theTexelsV);
 }
 
+
+//-------------------------------------------------------------------------------------
+// Integer decoding to RGBA8
+//-------------------------------------------------------------------------------------
+// BC4 computes its interpolants slightly differently from BC3 alpha, so the palette comes from DecodeFromIndex
+static void DecodeBC4UPalette8( _Out_writes_(8) uint8_t *pPalette, _In_reads_(8) const uint8_t *pBC )
+{
+    auto pBlock = reinterpret_cast<const BC4_UNORM*>( pBC );
+    for(size_t i = 0; i < 8; ++i)
+        pPalette[i] = D3DXQuantizeUNorm8( pBlock->DecodeFromIndex( i ) );
+}
+
+_Use_decl_annotations_
+void D3DXDecodeBC4URGBA8(uint8_t *pDest, size_t rowPitch, const uint8_t *pBC, size_t nBlocks, bool bgr)
+{
+    assert( pDest && pBC );
+    UNREFERENCED_PARAMETER( bgr );
+
+    for(size_t j = 0; j < nBlocks; ++j, pDest += BLOCK_LEN * 4, pBC += sizeof(BC4_UNORM))
+    {
+        uint8_t red[8];
+        DecodeBC4UPalette8( red, pBC );
+        uint64_t dw = D3DXGetAlphaIndices( pBC );
+
+        // Red is replicated to RGB, so BGR order doesn't matter
+        uint32_t texels[BLOCK_SIZE];
+        for(size_t i = 0; i < BLOCK_SIZE; ++i, dw >>= 3)
+            texels[i] = uint32_t( red[dw & 7] ) * 0x010101 | 0xff000000;
+
+        for(size_t y = 0; y < BLOCK_LEN; ++y)
+            memcpy( pDest + y * rowPitch, texels + y * BLOCK_LEN, sizeof(uint32_t) * BLOCK_LEN );
+    }
+}
+
+_Use_decl_annotations_
+void D3DXDecodeBC5URGBA8(uint8_t *pDest, size_t rowPitch, const uint8_t *pBC, size_t nBlocks, bool bgr)
+{
+    assert( pDest && pBC );
+
+    const uint32_t rShift = ( bgr ) ? 16 : 0;
+
+    for(size_t j = 0; j < nBlocks; ++j, pDest += BLOCK_LEN * 4, pBC += sizeof(BC4_UNORM) * 2)
+    {
+        uint8_t red[8], green[8];
+        DecodeBC4UPalette8( red, pBC );
+        DecodeBC4UPalette8( green, pBC + sizeof(BC4_UNORM) );
+        uint64_t rw = D3DXGetAlphaIndices( pBC );
+        uint64_t gw = D3DXGetAlphaIndices( pBC + sizeof(BC4_UNORM) );
+
+        uint32_t texels[BLOCK_SIZE];
+        for(size_t i = 0; i < BLOCK_SIZE; ++i, rw >>= 3, gw >>= 3)
+            texels[i] = ( uint32_t( red[rw & 7] ) << rShift ) | ( uint32_t( green[gw & 7] ) << 8 ) | 0xff000000;
+
+        for(size_t y = 0; y < BLOCK_LEN; ++y)
+            memcpy( pDest + y * rowPitch, texels + y * BLOCK_LEN, sizeof(uint32_t) * BLOCK_LEN );
+    }
+}
+
 } // namespace
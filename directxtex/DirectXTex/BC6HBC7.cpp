@@ -26,6 +26,11 @@ namespace DirectX
 // Constants
 //-------------------------------------------------------------------------------------
 
+// BC6H fast tier (BC_FLAGS_BC6H_QUICK)
+static const int BC6H_QUICK_UNIFORM_RANGE = 64;     // max per-channel spread (in f16 bit patterns) for a block to be treated as near-uniform
+static const uint8_t BC6H_FIRST_ONE_REGION_MODE = 10; // index in ms_aInfo of Mode 11, the first of the one-region modes
+static const size_t BC6H_QUICK_SHAPES = 2;          // number of ranked shapes refined per two-region mode
+
 static const float fEpsilon = (0.25f / 64.0f) * (0.25f / 64.0f);
 static const float pC3[] = { 2.0f/2.0f, 1.0f/2.0f, 0.0f/2.0f };
 static const float pD3[] = { 0.0f/2.0f, 1.0f/2.0f, 2.0f/2.0f };
@@ -1236,40 +1241,78 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const
 }
 
 _Use_decl_annotations_
-void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
+void D3DX_BC6H::Encode(bool bSigned, DWORD flags, const HDRColorA* const pIn)
 {
     assert( pIn );
 
     EncodeParams EP(pIn, bSigned);
 
-    for(EP.uMode = 0; EP.uMode < ARRAYSIZE(ms_aInfo) && EP.fBestErr > 0; ++EP.uMode)
+    const bool bQuick = (flags & BC_FLAGS_BC6H_QUICK) != 0;
+    uint8_t uFirstMode = 0;
+
+    if(bQuick)
+    {
+        // Solid and near-uniform blocks are represented well by a single region with 4-bit indices,
+        // so skip the two-region modes (and their 32 shapes each) entirely
+        INTColor clrMin = EP.aIPixels[0], clrMax = EP.aIPixels[0];
+        for(size_t i = 1; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            for(uint8_t ch = 0; ch < 3; ++ch)
+            {
+                clrMin[ch] = std::min<int>(clrMin[ch], EP.aIPixels[i][ch]);
+                clrMax[ch] = std::max<int>(clrMax[ch], EP.aIPixels[i][ch]);
+            }
+        }
+
+        int iRange = 0;
+        for(uint8_t ch = 0; ch < 3; ++ch)
+        {
+            iRange = std::max<int>(iRange, clrMax[ch] - clrMin[ch]);
+        }
+
+        if(iRange <= BC6H_QUICK_UNIFORM_RANGE)
+            uFirstMode = BC6H_FIRST_ONE_REGION_MODE;
+    }
+
+    float afRoughMSE[BC6H_MAX_SHAPES];
+    uint8_t auShape[BC6H_MAX_SHAPES];
+    bool bRanked = false;
+
+    for(EP.uMode = uFirstMode; EP.uMode < ARRAYSIZE(ms_aInfo) && EP.fBestErr > 0; ++EP.uMode)
     {
         const uint8_t uShapes = ms_aInfo[EP.uMode].uPartitions ? 32 : 1;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
-        float afRoughMSE[BC6H_MAX_SHAPES];
-        uint8_t auShape[BC6H_MAX_SHAPES];
+        size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        if(bQuick)
+            uItems = std::min<size_t>(uItems, BC6H_QUICK_SHAPES);
 
-        // pick the best uItems shapes and refine these.
-        for(EP.uShape = 0; EP.uShape < uShapes; ++EP.uShape)
+        // The rough estimate only depends on the unquantized endpoints and the index precision, which all the
+        // two-region modes share, so the shapes only need to be ranked once per block
+        if(uShapes == 1 || !bRanked)
         {
-            size_t uShape = EP.uShape;
-            afRoughMSE[uShape] = RoughMSE(&EP);
-            auShape[uShape] = static_cast<uint8_t>(uShape);
-        }
+            // pick the best uItems shapes and refine these.
+            for(EP.uShape = 0; EP.uShape < uShapes; ++EP.uShape)
+            {
+                size_t uShape = EP.uShape;
+                afRoughMSE[uShape] = RoughMSE(&EP);
+                auShape[uShape] = static_cast<uint8_t>(uShape);
+            }
 
-        // Bubble up the first uItems items
-        for(register size_t i = 0; i < uItems; i++)
-        {
-            for(register size_t j = i + 1; j < uShapes; j++)
+            // Bubble up the first uItems items
+            for(register size_t i = 0; i < uItems; i++)
             {
-                if(afRoughMSE[i] > afRoughMSE[j])
+                for(register size_t j = i + 1; j < uShapes; j++)
                 {
-                    std::swap(afRoughMSE[i], afRoughMSE[j]);
-                    std::swap(auShape[i], auShape[j]);
+                    if(afRoughMSE[i] > afRoughMSE[j])
+                    {
+                        std::swap(afRoughMSE[i], afRoughMSE[j]);
+                        std::swap(auShape[i], auShape[j]);
+                    }
                 }
             }
+
+            bRanked = (uShapes > 1);
         }
 
         for(size_t i = 0; i < uItems && EP.fBestErr > 0; i++)
@@ -1280,7 +1323,6 @@ void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
     }
 }
 
-
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
 int D3DX_BC6H::Quantize(int iValue, int prec, bool bSigned)
@@ -2144,13 +2186,14 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const
 }
 
 _Use_decl_annotations_
-void D3DX_BC7::Encode(const HDRColorA* const pIn)
+void D3DX_BC7::Encode(DWORD flags, const HDRColorA* const pIn)
 {
     assert( pIn );
 
     D3DX_BC7 final = *this;
     EncodeParams EP(pIn);
     float fMSEBest = FLT_MAX;
+    bool bOpaque = true;
     
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
@@ -2158,10 +2201,52 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
         EP.aLDRPixels[i].g = uint8_t( std::max<float>( 0.0f, std::min<float>( 255.0f, pIn[i].g * 255.0f + 0.01f ) ) );
         EP.aLDRPixels[i].b = uint8_t( std::max<float>( 0.0f, std::min<float>( 255.0f, pIn[i].b * 255.0f + 0.01f ) ) );
         EP.aLDRPixels[i].a = uint8_t( std::max<float>( 0.0f, std::min<float>( 255.0f, pIn[i].a * 255.0f + 0.01f ) ) );
+
+        if ( EP.aLDRPixels[i].a != 255 )
+            bOpaque = false;
+    }
+
+    // Quick levels trade quality for speed. They refine only the best few shapes ranked by the
+    // principal-axis estimate from RoughMSE, and skip modes that can't win for this block. On
+    // opaque blocks, mode 7 and the unrotated modes 4 and 5 spend bits on a constant alpha
+    // channel (modes 3 and 6 do better); on translucent blocks, modes 0-3 have no alpha.
+    const DWORD level = flags & BC_FLAGS_BC7_LEVEL_MASK;
+
+    size_t uMaxItems = BC7_MAX_SHAPES;
+    switch( level )
+    {
+    case BC_FLAGS_BC7_QUICK:
+        uMaxItems = 4;
+        EP.iExhaustiveDelta = 2;
+        break;
+
+    case BC_FLAGS_BC7_QUICKER:
+        uMaxItems = 2;
+        EP.uPerturbPasses = 4;
+        EP.iExhaustiveDelta = 0;
+        break;
+
+    case BC_FLAGS_BC7_QUICKEST:
+        uMaxItems = 1;
+        EP.uPerturbPasses = 1;
+        EP.iExhaustiveDelta = 0;
+        break;
     }
 
     for(EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
     {
+        if ( level )
+        {
+            if ( bOpaque ? (EP.uMode == 7) : (EP.uMode < 4) )
+                continue;
+
+            if ( level >= BC_FLAGS_BC7_QUICKER && ms_aInfo[EP.uMode].uPartitions == 2 )
+                continue;
+
+            if ( level == BC_FLAGS_BC7_QUICKEST && EP.uMode != 6 )
+                continue;
+        }
+
         const size_t uShapes = size_t(1) << ms_aInfo[EP.uMode].uPartitionBits;
         assert( uShapes <= BC7_MAX_SHAPES );
         _Analysis_assume_( uShapes <= BC7_MAX_SHAPES );
@@ -2170,12 +2255,15 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
         const size_t uNumIdxMode = size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::min<size_t>(uMaxItems, std::max<size_t>(1, uShapes >> 2));
         float afRoughMSE[BC7_MAX_SHAPES];
         size_t auShape[BC7_MAX_SHAPES];
 
         for(size_t r = 0; r < uNumRots && fMSEBest > 0; ++r)
         {
+            if ( level && bOpaque && uNumRots > 1 && r == 0 )
+                continue;
+
             switch(r)
             {
             case 1: for(register size_t i = 0; i < NUM_PIXELS_PER_BLOCK; i++) std::swap(EP.aLDRPixels[i].r, EP.aLDRPixels[i].a); break;
@@ -2311,7 +2399,7 @@ void D3DX_BC7::Exhaustive(const EncodeParams* pEP, const LDRColorA aColors[], si
     if(fOrgErr == 0)
         return;
 
-    int delta = 5;
+    const int delta = pEP->iExhaustiveDelta;
 
     // ok figure out the range of A and B
     tmpEndPt = optEndPt;
@@ -2419,7 +2507,7 @@ void D3DX_BC7::OptimizeOne(const EncodeParams* pEP, const LDRColorA aColors[], s
         }
 
         // now alternate endpoints and keep trying until there is no improvement
-        for( ; ; )
+        for(size_t uPass = 0; !pEP->uPerturbPasses || uPass < pEP->uPerturbPasses; ++uPass)
         {
             float fErr = PerturbOne(pEP, aColors, np, uIndexMode, ch, opt, newEndPts, fOptErr, do_b);
             if(fErr >= fOptErr)
@@ -2434,8 +2522,11 @@ void D3DX_BC7::OptimizeOne(const EncodeParams* pEP, const LDRColorA aColors[], s
     }
 
     // finally, do a small exhaustive search around what we think is the global minima to be sure
-    for(size_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
-        Exhaustive(pEP, aColors, np, uIndexMode, ch, fOptErr, opt);
+    if(pEP->iExhaustiveDelta > 0)
+    {
+        for(size_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
+            Exhaustive(pEP, aColors, np, uIndexMode, ch, fOptErr, opt);
+    }
 }
 
 _Use_decl_annotations_
@@ -2832,19 +2923,17 @@ void D3DXDecodeBC6HS(XMVECTOR *pColor, const uint8_t *pBC)
 _Use_decl_annotations_
 void D3DXEncodeBC6HU(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(false, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(false, flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 _Use_decl_annotations_
 void D3DXEncodeBC6HS(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(true, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(true, flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 
@@ -2862,10 +2951,9 @@ void D3DXDecodeBC7(XMVECTOR *pColor, const uint8_t *pBC)
 _Use_decl_annotations_
 void D3DXEncodeBC7(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes" );
-    reinterpret_cast< D3DX_BC7* >( pBC )->Encode(reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC7* >( pBC )->Encode(flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 } // namespace
@@ -169,6 +169,9 @@ namespace DirectX
 
         DDS_FLAGS_FORCE_DX10_EXT_MISC2  = 0x20000,
             // DDS_FLAGS_FORCE_DX10_EXT including miscFlags2 information (result may not be compatible with D3DX10 or D3DX11)
+
+        DDS_FLAGS_PARALLEL              = 0x10000000,
+            // SaveToDDSFile packs re-pitched rows on worker threads while earlier writes are in flight (requires OpenMP)
     };
 
     enum WIC_FLAGS
@@ -206,6 +209,17 @@ namespace DirectX
             // Filtering mode to use for any required image resizing (only needed when loading arrays of differently sized images; defaults to Fant)
     };
 
+    enum TGA_FLAGS
+    {
+        TGA_FLAGS_NONE                  = 0x0,
+
+        TGA_FLAGS_RLE                   = 0x1,
+            // Save: writes run-length encoded pixels (truecolor or black & white RLE image types)
+
+        TGA_FLAGS_PARALLEL              = 0x10000000,
+            // Load: decodes bands of rows in parallel (requires OpenMP)
+    };
+
     HRESULT GetMetadataFromDDSMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ DWORD flags,
                                       _Out_ TexMetadata& metadata );
     HRESULT GetMetadataFromDDSFile( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
@@ -221,6 +235,43 @@ namespace DirectX
     HRESULT GetMetadataFromWICFile( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
                                     _Out_ TexMetadata& metadata );
 
+    //---------------------------------------------------------------------------------
+    // Memory allocation
+    struct ImageAllocator
+    {
+        void* (*pfAllocate)( _In_ size_t size, _In_opt_ void* pContext );
+            // Must return memory aligned to at least 16 bytes, or nullptr on failure
+        void (*pfFree)( _In_ void* p, _In_ size_t size, _In_opt_ void* pContext );
+        void* pContext;
+    };
+
+    HRESULT SetImageAllocator( _In_opt_ const ImageAllocator* allocator );
+    void GetImageAllocator( _Out_ ImageAllocator& allocator );
+        // Allocator for ScratchImage pixel memory, unless overridden per object with ScratchImage::SetAllocator
+        // nullptr restores the default (_aligned_malloc)
+
+    HRESULT GetLargePageAllocator( _Out_ ImageAllocator& allocator );
+        // Allocator that backs buffers of at least GetLargePageMinimum() bytes with large pages, falling back to the default
+        // for smaller buffers or when no large pages are left. Fails if SeLockMemoryPrivilege can't be enabled for the process
+
+    struct TexMemoryStats
+    {
+        uint64_t imageAllocations;          // ScratchImage pixel buffers allocated
+        uint64_t imageBytes;
+        uint64_t largePageAllocations;      // buffers backed by large pages (see GetLargePageAllocator)
+        uint64_t largePageBytes;
+        uint64_t scratchRequests;           // temporary scanline buffers used by the library
+        uint64_t scratchAllocationsAvoided; // ...of which were reused from the per-thread cache rather than allocated
+        uint64_t scratchBytesAvoided;
+        uint64_t scratchBytesCached;        // freed scratch buffers currently held by all threads (not cleared by ResetMemoryStats)
+    };
+
+    void GetMemoryStats( _Out_ TexMemoryStats& stats );
+    void ResetMemoryStats();
+
+    void ReleaseScratchCache();
+        // Frees the scratch buffers cached by every thread; long-running processes can call this when idle
+
     //---------------------------------------------------------------------------------
     // Bitmap image container
     struct Image
@@ -237,9 +288,9 @@ namespace DirectX
     {
     public:
         ScratchImage()
-            : _nimages(0), _size(0), _image(nullptr), _memory(nullptr) {}
+            : _nimages(0), _size(0), _image(nullptr), _memory(nullptr), _allocator(), _memoryAllocator() {}
         ScratchImage(ScratchImage&& moveFrom)
-            : _nimages(0), _size(0), _image(nullptr), _memory(nullptr) { *this = std::move(moveFrom); }
+            : _nimages(0), _size(0), _image(nullptr), _memory(nullptr), _allocator(), _memoryAllocator() { *this = std::move(moveFrom); }
         ~ScratchImage() { Release(); }
 
         ScratchImage& operator= (ScratchImage&& moveFrom);
@@ -258,6 +309,10 @@ namespace DirectX
 
         void Release();
 
+        void SetAllocator( _In_opt_ const ImageAllocator* allocator );
+            // Allocator for this object's following Initialize* calls, including those made by functions writing into it;
+            // nullptr reverts to the global one (see SetImageAllocator)
+
         bool OverrideFormat( _In_ DXGI_FORMAT f );
 
         const TexMetadata& GetMetadata() const { return _metadata; }
@@ -278,6 +333,9 @@ namespace DirectX
         Image*      _image;
         uint8_t*    _memory;
 
+        ImageAllocator _allocator;          // set by SetAllocator
+        ImageAllocator _memoryAllocator;    // the one _memory came from
+
         // Hide copy constructor and assignment operator
         ScratchImage( const ScratchImage& );
         ScratchImage& operator=( const ScratchImage& );
@@ -296,6 +354,9 @@ namespace DirectX
 
         HRESULT Initialize( _In_ size_t size );
 
+        HRESULT Trim( _In_ size_t size );
+            // Shrinks the reported size without reallocating (for writers that allocate a worst-case buffer)
+
         void Release();
 
         void *GetBufferPointer() const { return _buffer; }
@@ -310,6 +371,49 @@ namespace DirectX
         Blob& operator=( const Blob& );
     };
 
+    //---------------------------------------------------------------------------------
+    // Read-only image container whose pixels are a view of a memory-mapped file
+    //   (see LoadFromDDSFileMapped); the file stays mapped until Release
+    class MappedImage
+    {
+    public:
+        MappedImage()
+            : _nimages(0), _size(0), _image(nullptr), _view(nullptr), _memory(nullptr) {}
+        MappedImage(MappedImage&& moveFrom)
+            : _nimages(0), _size(0), _image(nullptr), _view(nullptr), _memory(nullptr) { *this = std::move(moveFrom); }
+        ~MappedImage() { Release(); }
+
+        MappedImage& operator= (MappedImage&& moveFrom);
+
+        void Release();
+
+        const TexMetadata& GetMetadata() const { return _metadata; }
+        const Image* GetImage(_In_ size_t mip, _In_ size_t item, _In_ size_t slice) const;
+
+        const Image* GetImages() const { return _image; }
+        size_t GetImageCount() const { return _nimages; }
+
+        const uint8_t* GetPixels() const { return _memory; }
+        size_t GetPixelsSize() const { return _size; }
+
+    private:
+        size_t      _nimages;
+        size_t      _size;
+        TexMetadata _metadata;
+        Image*      _image;
+        void*       _view;
+        uint8_t*    _memory;
+
+        HRESULT Initialize( _In_ const TexMetadata& mdata, _In_ void* view, _In_ size_t offset, _In_ size_t size );
+
+        friend HRESULT LoadFromDDSFileMapped( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
+                                              _Out_opt_ TexMetadata* metadata, _Out_ MappedImage& image );
+
+        // Hide copy constructor and assignment operator
+        MappedImage( const MappedImage& );
+        MappedImage& operator=( const MappedImage& );
+    };
+
     //---------------------------------------------------------------------------------
     // Image I/O
 
@@ -319,6 +423,18 @@ namespace DirectX
     HRESULT LoadFromDDSFile( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
                              _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
 
+    HRESULT LoadFromDDSFileMapped( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
+                                   _Out_opt_ TexMetadata* metadata, _Out_ MappedImage& image );
+        // Maps the file instead of reading it, so the images point directly at the file data and must not be written to.
+        // Only for files that need no conversion on load; otherwise returns HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED ),
+        // and LoadFromDDSFile should be used instead
+
+    HRESULT LoadFromDDSFileRange( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
+                                  _In_ size_t firstItem, _In_ size_t itemCount, _In_ size_t firstMip, _In_ size_t mipCount,
+                                  _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
+        // Reads only array items [firstItem, firstItem+itemCount) and mips [firstMip, firstMip+mipCount) (every slice of each mip for volume maps).
+        // metadata describes the whole file; image holds just the requested sub-resources, starting at mip firstMip, and is only a cubemap if whole cubes were requested
+
     HRESULT SaveToDDSMemory( _In_ const Image& image, _In_ DWORD flags,
                              _Out_ Blob& blob );
     HRESULT SaveToDDSMemory( _In_reads_(nimages) const Image* images, _In_ size_t nimages, _In_ const TexMetadata& metadata, _In_ DWORD flags,
@@ -329,12 +445,12 @@ namespace DirectX
 
     // TGA operations
     HRESULT LoadFromTGAMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size,
-                               _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
+                               _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image, _In_ DWORD flags = TGA_FLAGS_NONE );
     HRESULT LoadFromTGAFile( _In_z_ LPCWSTR szFile,
-                             _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
+                             _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image, _In_ DWORD flags = TGA_FLAGS_NONE );
 
-    HRESULT SaveToTGAMemory( _In_ const Image& image, _Out_ Blob& blob );
-    HRESULT SaveToTGAFile( _In_ const Image& image, _In_z_ LPCWSTR szFile );
+    HRESULT SaveToTGAMemory( _In_ const Image& image, _Out_ Blob& blob, _In_ DWORD flags = TGA_FLAGS_NONE );
+    HRESULT SaveToTGAFile( _In_ const Image& image, _In_z_ LPCWSTR szFile, _In_ DWORD flags = TGA_FLAGS_NONE );
 
     // WIC operations
     HRESULT LoadFromWICMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ DWORD flags,
@@ -365,6 +481,13 @@ namespace DirectX
 
     REFGUID GetWICCodec( _In_ WICCodecs codec );
 
+    //---------------------------------------------------------------------------------
+    // Multithreading
+
+    void SetMaxThreads( _In_ size_t count );
+    size_t GetMaxThreads();
+        // Limits the number of threads used by TEX_COMPRESS_PARALLEL and TEX_FILTER_PARALLEL; 0 (the default) uses all processors
+
     //---------------------------------------------------------------------------------
     // Texture conversion, resizing, mipmap generation, and block compression
 
@@ -381,7 +504,8 @@ namespace DirectX
     HRESULT FlipRotate( _In_ const Image& srcImage, _In_ DWORD flags, _Out_ ScratchImage& image );
     HRESULT FlipRotate( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
                         _In_ DWORD flags, _Out_ ScratchImage& result );
-        // Flip and/or rotate image
+        // Flip and/or rotate image (rotation is applied first, then flips)
+        // BC1 - BC5 are handled at the block level without decompressing, provided each flipped axis is a multiple of 4
 
     enum TEX_FILTER_FLAGS
     {
@@ -400,6 +524,11 @@ namespace DirectX
         TEX_FILTER_SEPARATE_ALPHA   = 0x100,
             // Resize color and alpha channel independently
 
+        TEX_FILTER_PREMULTIPLY_ALPHA = 0x200,
+            // Convert also premultiplies alpha, each scanline straight after it is stored, rather than needing a separate
+            // PremultiplyAlpha of the result. Matches PremultiplyAlpha given the same TEX_FILTER_SRGB flags exactly. Requires
+            // a target format with alpha
+
         TEX_FILTER_RGB_COPY_RED     = 0x1000,
         TEX_FILTER_RGB_COPY_GREEN   = 0x2000,
         TEX_FILTER_RGB_COPY_BLUE    = 0x4000,
@@ -417,7 +546,10 @@ namespace DirectX
         TEX_FILTER_BOX              = 0x400000,
         TEX_FILTER_FANT             = 0x400000, // Equiv to Box filtering for mipmap generation
         TEX_FILTER_TRIANGLE         = 0x500000,
+        TEX_FILTER_LANCZOS          = 0x600000,
             // Filtering mode to use for any required image resizing
+            // LANCZOS (3-lobe, widened to the footprint when minifying) is only supported by Resize, not GenerateMipMaps,
+            // and is the only filter using the banded polyphase path; the others keep their own Resize code
 
         TEX_FILTER_SRGB_IN          = 0x1000000,
         TEX_FILTER_SRGB_OUT         = 0x2000000,
@@ -431,6 +563,12 @@ namespace DirectX
 
         TEX_FILTER_FORCE_WIC        = 0x20000000,
             // Forces use of the WIC path even when logic would have picked a non-WIC path when both are an option
+
+        TEX_FILTER_PARALLEL         = 0x40000000,
+            // Resize, Convert and GenerateMipMaps are free to use multithreading across the images (by default they do not);
+            // Convert, the Lanczos Resize filter and the linear and cubic GenerateMipMaps filters also split each image into bands
+            // of rows. With error diffusion dithering, Convert instead overlaps loading the next chunk of rows with dithering the
+            // current one, for images of at least 256*256 pixels. Only applies to the non-WIC paths
     };
 
     HRESULT Resize( _In_ const Image& srcImage, _In_ size_t width, _In_ size_t height, _In_ DWORD filter,
@@ -499,6 +637,17 @@ namespace DirectX
         TEX_COMPRESS_UNIFORM        = 0x40000,
             // Uniform color weighting for BC1-3 compression; by default uses perceptual weighting
 
+        TEX_COMPRESS_BC7_QUICK      = 0x100000,
+        TEX_COMPRESS_BC7_QUICKER    = 0x200000,
+        TEX_COMPRESS_BC7_QUICKEST   = 0x300000,
+            // Faster BC7 CPU compression at reduced quality (by default it does an exhaustive search)
+            // QUICK skips modes that can't win for the block and refines fewer partitions
+            // QUICKER also skips the 3-subset modes and caps endpoint refinement
+            // QUICKEST only uses mode 6
+
+        TEX_COMPRESS_BC6H_QUICK     = 0x400000,
+            // Faster BC6H CPU compression at reduced quality; solid and near-uniform blocks only try the one-region modes
+
         TEX_COMPRESS_SRGB_IN        = 0x1000000,
         TEX_COMPRESS_SRGB_OUT       = 0x2000000,
         TEX_COMPRESS_SRGB           = ( TEX_COMPRESS_SRGB_IN | TEX_COMPRESS_SRGB_OUT ),
@@ -515,6 +664,24 @@ namespace DirectX
                       _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef, _Out_ ScratchImage& cImages );
         // Note that alphaRef is only used by BC1. 0.5f is a typical value to use
 
+    typedef HRESULT (*TEX_COMPRESS_STRIP_CALLBACK)( _In_reads_bytes_(size) const uint8_t* pBlocks, _In_ size_t size,
+                                                    _In_ size_t blockRow, _In_opt_ void* pContext );
+
+    HRESULT CompressStrips( _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef,
+                            _In_ TEX_COMPRESS_STRIP_CALLBACK pfCallback, _In_opt_ void* pContext );
+    HRESULT CompressStrips( _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef,
+                            _Out_ Blob& blob );
+        // Compresses the image one 4-pixel high strip at a time, passing each row of blocks to the callback in order
+        // (or writing the blocks to the blob); working memory is one row of blocks, so very large images never need
+        // a full-size scratch copy. The blob receives the same bytes as the pixels of the Compress result
+
+    HRESULT GenerateMipMapsAndCompress( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+                                        _In_ DWORD filter, _In_ size_t levels, _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef,
+                                        _Out_ ScratchImage& cImages );
+        // Generates the mipchain of a 1D/2D texture or array and block compresses each level as soon as the next one has been made from it,
+        // so at most two uncompressed levels exist at a time. The result is the same as GenerateMipMaps followed by Compress; when
+        // GenerateMipMaps would use WIC filtering (which scales every level from the base image), the full chain is generated first
+
     HRESULT Compress( _In_ ID3D11Device* pDevice, _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ DWORD compress,
                       _In_ float alphaWeight, _Out_ ScratchImage& image );
     HRESULT Compress( _In_ ID3D11Device* pDevice, _In_ const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
@@ -524,6 +691,17 @@ namespace DirectX
     HRESULT Decompress( _In_ const Image& cImage, _In_ DXGI_FORMAT format, _Out_ ScratchImage& image );
     HRESULT Decompress( _In_reads_(nimages) const Image* cImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
                         _In_ DXGI_FORMAT format, _Out_ ScratchImage& images );
+        // BC1-BC5 (UNORM) to R8G8B8A8_UNORM or B8G8R8A8_UNORM (or their _SRGB versions for BC1-BC3 _SRGB) decodes
+        // with integer math directly to 8 bits per channel, with rounding
+
+    HRESULT Transcode( _In_ const Image& cImage, _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef,
+                       _Out_ ScratchImage& image );
+    HRESULT Transcode( _In_reads_(nimages) const Image* cImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+                       _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef, _Out_ ScratchImage& images );
+        // Converts from one BC format to another a block at a time (e.g. BC3 to BC1, or BC5 to BC1 with the normal in RG),
+        // without decompressing the whole image. compress and alphaRef are as for Compress. Blocks are copied unchanged
+        // where the source already has what the destination needs: the color of opaque BC2/BC3 blocks for BC1, and the
+        // red channel between BC4 and BC5
 
     //---------------------------------------------------------------------------------
     // Normal map operations
@@ -550,6 +728,12 @@ namespace DirectX
 
         CNMAP_COMPUTE_OCCLUSION = 0x8000,
             // Computes a crude occlusion term stored in the alpha channel
+
+        CNMAP_SOBEL             = 0x10000,
+            // Weights the center row/column of the 3x3 difference kernel by 2 (Sobel) rather than evenly
+
+        CNMAP_PARALLEL          = 0x10000000,
+            // Computes bands of rows (across all images for the complex ComputeNormalMap) in parallel (requires OpenMP)
     };
 
     HRESULT ComputeNormalMap( _In_ const Image& srcImage, _In_ DWORD flags, _In_ float amplitude,
@@ -557,6 +741,18 @@ namespace DirectX
     HRESULT ComputeNormalMap( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
                               _In_ DWORD flags, _In_ float amplitude, _In_ DXGI_FORMAT format, _Out_ ScratchImage& normalMaps );
 
+    typedef HRESULT (*TEX_NMAP_READ_CALLBACK)( _In_ size_t y, _Out_writes_bytes_(size) uint8_t* pScanline, _In_ size_t size, _In_opt_ void* pContext );
+    typedef HRESULT (*TEX_NMAP_WRITE_CALLBACK)( _In_ size_t y, _In_reads_bytes_(size) const uint8_t* pScanline, _In_ size_t size, _In_opt_ void* pContext );
+
+    HRESULT ComputeNormalMapStreaming( _In_ size_t width, _In_ size_t height, _In_ DXGI_FORMAT srcFormat, _In_ TEX_NMAP_READ_CALLBACK pfRead,
+                                       _In_ DWORD flags, _In_ float amplitude, _In_ DXGI_FORMAT format,
+                                       _In_ TEX_NMAP_WRITE_CALLBACK pfWrite, _In_opt_ void* pContext );
+        // Reads the height map one scanline at a time (pfRead fills in row y in srcFormat) and hands each finished scanline of the
+        // normal map to pfWrite in order. Memory use doesn't depend on the height: four evaluated rows (the rows above, at and below
+        // the one being generated, plus the first row for wrapping in V), one float scanline, and one source and one destination
+        // scanline. Rows are read in order, except that wrapping in V (no CNMAP_MIRROR_V) reads the last row first; CNMAP_PARALLEL
+        // is ignored
+
     //---------------------------------------------------------------------------------
     // Misc image operations
     struct Rect
@@ -573,6 +769,21 @@ namespace DirectX
     HRESULT CopyRectangle( _In_ const Image& srcImage, _In_ const Rect& srcRect, _In_ const Image& dstImage,
                            _In_ DWORD filter, _In_ size_t xOffset, _In_ size_t yOffset );
 
+    struct AtlasPlacement
+    {
+        size_t  page;   // array index of the page holding the image
+        Rect    rect;   // where the image was placed on that page
+    };
+
+    HRESULT PackAtlas( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ size_t pageWidth, _In_ size_t pageHeight,
+                       _In_ size_t padding, _Out_writes_(nimages) AtlasPlacement* placements, _Out_ size_t& pageCount );
+    HRESULT CreateAtlas( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ DXGI_FORMAT format,
+                         _In_ size_t pageWidth, _In_ size_t pageHeight, _In_ size_t padding, _In_ DWORD filter,
+                         _Out_writes_(nimages) AtlasPlacement* placements, _Out_ ScratchImage& atlas );
+        // PackAtlas places the images on as few pageWidth x pageHeight pages as it can (skyline bottom-left, tallest first), leaving
+        // padding pixels between neighbours. CreateAtlas also builds the pages as a cleared 2D texture array and copies each image into
+        // place with CopyRectangle; filter takes the same flags as CopyRectangle plus TEX_FILTER_PARALLEL to copy images in parallel
+
     enum CMSE_FLAGS
     {
         CMSE_DEFAULT                = 0,
@@ -590,10 +801,59 @@ namespace DirectX
         CMSE_IMAGE1_X2_BIAS         = 0x100,
         CMSE_IMAGE2_X2_BIAS         = 0x200,
             // Indicates that image should be scaled and biased before comparison (i.e. UNORM -> SNORM)
+
+        CMSE_PARALLEL               = 0x10000000,
+            // Compare bands of rows (across all images for the complex ComputeMetrics) in parallel (requires OpenMP)
     };
 
     HRESULT ComputeMSE( _In_ const Image& image1, _In_ const Image& image2, _Out_ float& mse, _Out_writes_opt_(4) float* mseV, _In_ DWORD flags = 0 );
 
+    struct ImageMetrics
+    {
+        float mse;          // sum of the per-channel MSEs (same as ComputeMSE)
+        float mseV[4];
+        float psnr;         // dB, for a peak value of 1.0 and the mean MSE of the channels compared; +infinity if identical
+        float maxError;     // largest absolute difference in any channel
+        float maxErrorV[4];
+        float ssim;         // mean SSIM of the channels compared
+        float ssimV[4];
+    };
+
+    HRESULT ComputeMetrics( _In_ const Image& image1, _In_ const Image& image2, _In_ DWORD flags, _Out_ ImageMetrics& metrics );
+    HRESULT ComputeMetrics( _In_reads_(nimages) const Image* images1, _In_reads_(nimages) const Image* images2, _In_ size_t nimages,
+                            _In_ DWORD flags, _Out_writes_opt_(nimages) ImageMetrics* imageMetrics, _Out_opt_ ImageMetrics* totalMetrics );
+        // MSE, PSNR, max error and SSIM in a single pass. SSIM uses non-overlapping 8x8 windows. BC images are decoded a
+        // block row at a time rather than decompressed up front. The complex version compares images1[i] with images2[i]
+        // (e.g. every mip and array item of two ScratchImages) and reports each pair and/or the pixel-weighted total
+
+    enum CSTATS_FLAGS
+    {
+        CSTATS_DEFAULT              = 0,
+
+        CSTATS_OPAQUE_ONLY          = 0x1,
+            // Only determine 'opaque', stopping at the first pixel with alpha below 0.99; the other results are zero
+
+        CSTATS_PARALLEL             = 0x10000000,
+            // Scan bands of rows (across all images for the complex ComputeImageStatistics) in parallel (requires OpenMP)
+    };
+
+    struct ImageStatistics
+    {
+        float minV[4];      // per channel (RGBA) minimum, maximum and mean of the stored values (no sRGB conversion)
+        float maxV[4];
+        float meanV[4];
+        bool opaque;        // every alpha is 0.99 or more (always true for formats without alpha)
+        bool binaryAlpha;   // every alpha is either 0.01 or less, or 0.99 or more
+        bool grayscale;     // R, G and B are within 1/64 of each other everywhere (always true for single channel formats)
+        bool normalMap;     // every pixel is a unit length vector (x2 biased for UNORM) with z >= 0; for two channel formats, x^2 + y^2 <= 1
+    };
+
+    HRESULT ComputeImageStatistics( _In_ const Image& image, _In_ DWORD flags, _Out_ ImageStatistics& stats );
+    HRESULT ComputeImageStatistics( _In_reads_(nimages) const Image* images, _In_ size_t nimages, _In_ DWORD flags, _Out_ ImageStatistics& stats );
+        // Single pass over the image(s). 8-bit RGBA/BGRA images and BC1-BC3 (decoded to 8 bits per channel) are read directly
+        // as bytes, other formats through the float scanline path. sRGB formats, BC ones included, report gamma-encoded values.
+        // The complex version reports the statistics of all the images together, e.g. every mip and array item of a ScratchImage
+
     //---------------------------------------------------------------------------------
     // Direct3D 11 functions
     bool IsSupportedTexture( _In_ ID3D11Device* pDevice, _In_ const TexMetadata& metadata );
@@ -15,11 +15,6 @@
 
 #include "directxtexp.h"
 
-#ifdef _OPENMP
-#include <omp.h>
-#pragma warning(disable : 4616 6993)
-#endif
-
 #include "bc.h"
 
 
@@ -32,7 +27,11 @@ inline static DWORD _GetBCFlags( _In_ DWORD compress )
     static_assert( TEX_COMPRESS_A_DITHER == BC_FLAGS_DITHER_A, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
     static_assert( TEX_COMPRESS_DITHER == (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A), "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
     static_assert( TEX_COMPRESS_UNIFORM == BC_FLAGS_UNIFORM, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
-    return ( compress & (BC_FLAGS_DITHER_RGB|BC_FLAGS_DITHER_A|BC_FLAGS_UNIFORM) );
+    static_assert( TEX_COMPRESS_BC7_QUICK == BC_FLAGS_BC7_QUICK, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    static_assert( TEX_COMPRESS_BC7_QUICKER == BC_FLAGS_BC7_QUICKER, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    static_assert( TEX_COMPRESS_BC7_QUICKEST == BC_FLAGS_BC7_QUICKEST, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    static_assert( TEX_COMPRESS_BC6H_QUICK == BC_FLAGS_BC6H_QUICK, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    return ( compress & (BC_FLAGS_DITHER_RGB|BC_FLAGS_DITHER_A|BC_FLAGS_UNIFORM|BC_FLAGS_BC7_LEVEL_MASK|BC_FLAGS_BC6H_QUICK) );
 }
 
 inline static DWORD _GetSRGBFlags( _In_ DWORD compress )
@@ -43,16 +42,21 @@ inline static DWORD _GetSRGBFlags( _In_ DWORD compress )
     return ( compress & TEX_COMPRESS_SRGB );
 }
 
-inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_ENCODE& pfEncode, _Out_ size_t& blocksize, _Out_ DWORD& cflags )
+inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_ENCODE& pfEncode, _Out_ BC_ENCODE_BATCH& pfEncodeBatch,
+                                              _Out_ size_t& blocksize, _Out_ size_t& batch, _Out_ DWORD& cflags )
 {
+    // batch is the number of blocks the encoder prefers per call; BC1 uses D3DXEncodeBC1Batch directly as it needs alphaRef
+    pfEncodeBatch = nullptr;
+    batch = 1;
+
     switch(format)
     {
     case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfEncode = nullptr;         blocksize = 8;   cflags = 0; break;
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfEncode = nullptr;         blocksize = 8;   cflags = 0; batch = BC_BATCH_BLOCKS; break;
     case DXGI_FORMAT_BC2_UNORM:
     case DXGI_FORMAT_BC2_UNORM_SRGB:    pfEncode = D3DXEncodeBC2;   blocksize = 16;  cflags = 0; break;
     case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfEncode = D3DXEncodeBC3;   blocksize = 16;  cflags = 0; break;
+    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfEncode = D3DXEncodeBC3;   blocksize = 16;  cflags = 0; pfEncodeBatch = D3DXEncodeBC3Batch; batch = BC_BATCH_BLOCKS; break;
     case DXGI_FORMAT_BC4_UNORM:         pfEncode = D3DXEncodeBC4U;  blocksize = 8;   cflags = TEX_FILTER_RGB_COPY_RED; break;
     case DXGI_FORMAT_BC4_SNORM:         pfEncode = D3DXEncodeBC4S;  blocksize = 8;   cflags = TEX_FILTER_RGB_COPY_RED; break;
     case DXGI_FORMAT_BC5_UNORM:         pfEncode = D3DXEncodeBC5U;  blocksize = 16;  cflags = TEX_FILTER_RGB_COPY_RED | TEX_FILTER_RGB_COPY_GREEN; break;
@@ -67,6 +71,158 @@ inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_
     return true;
 }
 
+inline static void _EncodeBlocks( _Out_writes_bytes_(count * blocksize) uint8_t* pDest, _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR* pBlocks, _In_ size_t count,
+                                  _In_ BC_ENCODE pfEncode, _In_opt_ BC_ENCODE_BATCH pfEncodeBatch, _In_ size_t blocksize, _In_ DWORD bcflags, _In_ float alphaRef )
+{
+    if ( pfEncodeBatch )
+    {
+        pfEncodeBatch( pDest, pBlocks, count, bcflags );
+    }
+    else if ( pfEncode )
+    {
+        for( size_t j = 0; j < count; ++j )
+        {
+            pfEncode( pDest + j * blocksize, pBlocks + j * NUM_PIXELS_PER_BLOCK, bcflags );
+        }
+    }
+    else
+    {
+        D3DXEncodeBC1Batch( pDest, pBlocks, count, alphaRef, bcflags );
+    }
+}
+
+inline static bool _DetermineDecoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_DECODE& pfDecode, _Out_ size_t& blocksize, _Out_ DXGI_FORMAT& cformat )
+{
+    // Promote "typeless" BC formats
+    switch( format )
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:  cformat = DXGI_FORMAT_BC1_UNORM; break;
+    case DXGI_FORMAT_BC2_TYPELESS:  cformat = DXGI_FORMAT_BC2_UNORM; break;
+    case DXGI_FORMAT_BC3_TYPELESS:  cformat = DXGI_FORMAT_BC3_UNORM; break;
+    case DXGI_FORMAT_BC4_TYPELESS:  cformat = DXGI_FORMAT_BC4_UNORM; break;
+    case DXGI_FORMAT_BC5_TYPELESS:  cformat = DXGI_FORMAT_BC5_UNORM; break;
+    case DXGI_FORMAT_BC6H_TYPELESS: cformat = DXGI_FORMAT_BC6H_UF16; break;
+    case DXGI_FORMAT_BC7_TYPELESS:  cformat = DXGI_FORMAT_BC7_UNORM; break;
+    default:                        cformat = format;                break;
+    }
+
+    switch(cformat)
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfDecode = D3DXDecodeBC1;   blocksize = 8;   break;
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:    pfDecode = D3DXDecodeBC2;   blocksize = 16;  break;
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfDecode = D3DXDecodeBC3;   blocksize = 16;  break;
+    case DXGI_FORMAT_BC4_UNORM:         pfDecode = D3DXDecodeBC4U;  blocksize = 8;   break;
+    case DXGI_FORMAT_BC4_SNORM:         pfDecode = D3DXDecodeBC4S;  blocksize = 8;   break;
+    case DXGI_FORMAT_BC5_UNORM:         pfDecode = D3DXDecodeBC5U;  blocksize = 16;  break;
+    case DXGI_FORMAT_BC5_SNORM:         pfDecode = D3DXDecodeBC5S;  blocksize = 16;  break;
+    case DXGI_FORMAT_BC6H_UF16:         pfDecode = D3DXDecodeBC6HU; blocksize = 16;  break;
+    case DXGI_FORMAT_BC6H_SF16:         pfDecode = D3DXDecodeBC6HS; blocksize = 16;  break;
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:    pfDecode = D3DXDecodeBC7;   blocksize = 16;  break;
+    default:                            pfDecode = nullptr;         blocksize = 0;   return false;
+    }
+
+    return true;
+}
+
+inline static bool _DetermineDecoderRGBA8( _In_ DXGI_FORMAT cformat, _In_ DXGI_FORMAT format, _Out_ BC_DECODE_RGBA8& pfDecode, _Out_ bool& bgr )
+{
+    // Only when no color space conversion is involved (sRGB to sRGB or linear to linear)
+    pfDecode = nullptr;
+    bgr = false;
+
+    bool srgb;
+    switch( format )
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:        srgb = false;   break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:   srgb = true;    break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:        srgb = false;   bgr = true; break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:   srgb = true;    bgr = true; break;
+    default:                                return false;
+    }
+
+    switch( cformat )
+    {
+    case DXGI_FORMAT_BC1_UNORM:         if ( !srgb ) pfDecode = D3DXDecodeBC1RGBA8;  break;
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    if ( srgb ) pfDecode = D3DXDecodeBC1RGBA8;   break;
+    case DXGI_FORMAT_BC2_UNORM:         if ( !srgb ) pfDecode = D3DXDecodeBC2RGBA8;  break;
+    case DXGI_FORMAT_BC2_UNORM_SRGB:    if ( srgb ) pfDecode = D3DXDecodeBC2RGBA8;   break;
+    case DXGI_FORMAT_BC3_UNORM:         if ( !srgb ) pfDecode = D3DXDecodeBC3RGBA8;  break;
+    case DXGI_FORMAT_BC3_UNORM_SRGB:    if ( srgb ) pfDecode = D3DXDecodeBC3RGBA8;   break;
+    case DXGI_FORMAT_BC4_UNORM:         if ( !srgb ) pfDecode = D3DXDecodeBC4URGBA8; break;
+    case DXGI_FORMAT_BC5_UNORM:         if ( !srgb ) pfDecode = D3DXDecodeBC5URGBA8; break;
+    default:                            break;
+    }
+
+    return ( pfDecode != nullptr );
+}
+
+
+//-------------------------------------------------------------------------------------
+// Loads a 4x4 block of pixels, replicating pixels to fill out partial blocks
+//-------------------------------------------------------------------------------------
+static bool _LoadBlock( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR* temp, _In_ const uint8_t* pSrc, _In_ size_t rowPitch, _In_ DXGI_FORMAT format,
+                        _In_ size_t pw, _In_ size_t ph )
+{
+    assert( pw > 0 && ph > 0 );
+
+    if ( !_LoadScanline( &temp[0], pw, pSrc, rowPitch, format ) )
+        return false;
+
+    if ( ph > 1 )
+    {
+        if ( !_LoadScanline( &temp[4], pw, pSrc + rowPitch, rowPitch, format ) )
+            return false;
+
+        if ( ph > 2 )
+        {
+            if ( !_LoadScanline( &temp[8], pw, pSrc + rowPitch*2, rowPitch, format ) )
+                return false;
+
+            if ( ph > 3 )
+            {
+                if ( !_LoadScanline( &temp[12], pw, pSrc + rowPitch*3, rowPitch, format ) )
+                    return false;
+            }
+        }
+    }
+
+    if ( pw != 4 || ph != 4 )
+    {
+        // Replicate pixels for partial block
+        static const size_t uSrc[] = { 0, 0, 0, 1 };
+
+        if ( pw < 4 )
+        {
+            for( size_t t = 0; t < ph && t < 4; ++t )
+            {
+                for( size_t s = pw; s < 4; ++s )
+                {
+#pragma prefast(suppress: 26000, "PREFAST false positive")
+                    temp[ (t << 2) | s ] = temp[ (t << 2) | uSrc[s] ]; 
+                }
+            }
+        }
+
+        if ( ph < 4 )
+        {
+            for( size_t t = ph; t < 4; ++t )
+            {
+                for( size_t s = 0; s < 4; ++s )
+                {
+#pragma prefast(suppress: 26000, "PREFAST false positive")
+                    temp[ (t << 2) | s ] = temp[ (uSrc[t] << 2) | s ]; 
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
 
 //-------------------------------------------------------------------------------------
 static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _In_ DWORD bcflags,
@@ -96,12 +252,14 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
 
     // Determine BC format encoder
     BC_ENCODE pfEncode;
+    BC_ENCODE_BATCH pfEncodeBatch;
     size_t blocksize;
+    size_t batch;
     DWORD cflags;
-    if ( !_DetermineEncoderSettings( result.format, pfEncode, blocksize, cflags ) )
+    if ( !_DetermineEncoderSettings( result.format, pfEncode, pfEncodeBatch, blocksize, batch, cflags ) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
-    XMVECTOR temp[16];
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK * BC_BATCH_BLOCKS];
     const uint8_t *pSrc = image.pixels;
     const size_t rowPitch = image.rowPitch;
     for( size_t h=0; h < image.height; h += 4 )
@@ -110,73 +268,30 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
         uint8_t* dptr = pDest;
         size_t ph = std::min<size_t>( 4, image.height - h );
         size_t w = 0;
+        size_t nblocks = 0;
         for( size_t count = 0; count < result.rowPitch; count += blocksize, w += 4 )
         {
             size_t pw = std::min<size_t>( 4, image.width - w );
-            assert( pw > 0 && ph > 0 );
 
-            if ( !_LoadScanline( &temp[0], pw, sptr, rowPitch, format ) )
+            XMVECTOR* block = &temp[ nblocks * NUM_PIXELS_PER_BLOCK ];
+            if ( !_LoadBlock( block, sptr, rowPitch, format, pw, ph ) )
                 return E_FAIL;
 
-            if ( ph > 1 )
-            {
-                if ( !_LoadScanline( &temp[4], pw, sptr + rowPitch, rowPitch, format ) )
-                    return E_FAIL;
-
-                if ( ph > 2 )
-                {
-                    if ( !_LoadScanline( &temp[8], pw, sptr + rowPitch*2, rowPitch, format ) )
-                        return E_FAIL;
-
-                    if ( ph > 3 )
-                    {
-                        if ( !_LoadScanline( &temp[12], pw, sptr + rowPitch*3, rowPitch, format ) )
-                            return E_FAIL;
-                    }
-                }
-            }
+            _ConvertScanline( block, NUM_PIXELS_PER_BLOCK, result.format, format, cflags | srgb );
 
-            if ( pw != 4 || ph != 4 )
+            if ( ++nblocks == batch )
             {
-                // Replicate pixels for partial block
-                static const size_t uSrc[] = { 0, 0, 0, 1 };
-
-                if ( pw < 4 )
-                {
-                    for( size_t t = 0; t < ph && t < 4; ++t )
-                    {
-                        for( size_t s = pw; s < 4; ++s )
-                        {
-#pragma prefast(suppress: 26000, "PREFAST false positive")
-                            temp[ (t << 2) | s ] = temp[ (t << 2) | uSrc[s] ]; 
-                        }
-                    }
-                }
-
-                if ( ph < 4 )
-                {
-                    for( size_t t = ph; t < 4; ++t )
-                    {
-                        for( size_t s = 0; s < 4; ++s )
-                        {
-#pragma prefast(suppress: 26000, "PREFAST false positive")
-                            temp[ (t << 2) | s ] = temp[ (uSrc[t] << 2) | s ]; 
-                        }
-                    }
-                }
+                _EncodeBlocks( dptr, temp, nblocks, pfEncode, pfEncodeBatch, blocksize, bcflags, alphaRef );
+                dptr += nblocks * blocksize;
+                nblocks = 0;
             }
 
-            _ConvertScanline( temp, 16, result.format, format, cflags | srgb );
-            
-            if ( pfEncode )
-                pfEncode( dptr, temp, bcflags );
-            else
-                D3DXEncodeBC1( dptr, temp, alphaRef, bcflags );
-
             sptr += sbpp*4;
-            dptr += blocksize;
         }
 
+        if ( nblocks > 0 )
+            _EncodeBlocks( dptr, temp, nblocks, pfEncode, pfEncodeBatch, blocksize, bcflags, alphaRef );
+
         pSrc += rowPitch*4;
         pDest += result.rowPitch;
     }
@@ -185,18 +300,84 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
 }
 
 
+//-------------------------------------------------------------------------------------
+// Parallel compression
+//   The blocks of every image are split into runs which are scheduled together, so
+//   small mips and array slices don't leave threads idle
 //-------------------------------------------------------------------------------------
 #ifdef _OPENMP
-static HRESULT _CompressBC_Parallel( _In_ const Image& image, _In_ const Image& result, _In_ DWORD bcflags,
-                                     _In_ DWORD srgb, _In_ float alphaRef )
+static const size_t COMPRESS_TASK_BLOCKS = 16;  // blocks per work item, a multiple of BC_BATCH_BLOCKS
+
+struct CompressTask
 {
-    if ( !image.pixels || !result.pixels )
-        return E_POINTER;
+    const Image*        srcImages;
+    const Image*        destImages;
+    std::vector<size_t> offsets;
+    size_t              sbpp;
+    BC_ENCODE           pfEncode;
+    BC_ENCODE_BATCH     pfEncodeBatch;
+    size_t              blocksize;
+    size_t              batch;
+    DWORD               cflags;
+    DWORD               bcflags;
+    DWORD               srgb;
+    float               alphaRef;
+};
+
+static HRESULT _CompressBC_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const CompressTask* task = reinterpret_cast<const CompressTask*>( pContext );
+    assert( task );
 
-    assert( image.width == result.width );
-    assert( image.height == result.height );
+    const size_t index = _FindTaskImage( task->offsets, item );
+    const Image& image = task->srcImages[ index ];
+    const Image& result = task->destImages[ index ];
 
-    const DXGI_FORMAT format = image.format;
+    const size_t nbWidth = std::max<size_t>(1, (image.width + 3) / 4 );
+    const size_t nBlocks = nbWidth * std::max<size_t>(1, (image.height + 3) / 4 );
+
+    const size_t first = ( item - task->offsets[ index ] ) * COMPRESS_TASK_BLOCKS;
+    const size_t last = std::min<size_t>( first + COMPRESS_TASK_BLOCKS, nBlocks );
+
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK * BC_BATCH_BLOCKS];
+
+    // Each batch of up to 'batch' consecutive blocks is contiguous in the output
+    for( size_t nb = first; nb < last; nb += task->batch )
+    {
+        const size_t count = std::min<size_t>( task->batch, last - nb );
+
+        for( size_t j = 0; j < count; ++j )
+        {
+            const size_t y = (nb + j) / nbWidth;
+            const size_t x = (nb + j) - (y*nbWidth);
+
+            assert( x*4 < image.width && y*4 < image.height );
+
+            const size_t rowPitch = image.rowPitch;
+            const uint8_t *pSrc = image.pixels + (y*4*rowPitch) + (x*4*task->sbpp);
+
+            size_t ph = std::min<size_t>( 4, image.height - y*4 );
+            size_t pw = std::min<size_t>( 4, image.width - x*4 );
+
+            XMVECTOR* block = &temp[ j * NUM_PIXELS_PER_BLOCK ];
+            if ( !_LoadBlock( block, pSrc, rowPitch, image.format, pw, ph ) )
+                return E_FAIL;
+
+            _ConvertScanline( block, NUM_PIXELS_PER_BLOCK, result.format, image.format, task->cflags | task->srgb );
+        }
+
+        _EncodeBlocks( result.pixels + (nb*task->blocksize), temp, count, task->pfEncode, task->pfEncodeBatch, task->blocksize, task->bcflags, task->alphaRef );
+    }
+
+    return S_OK;
+}
+
+static HRESULT _CompressBC_Parallel( _In_reads_(nimages) const Image* srcImages, _In_reads_(nimages) const Image* destImages, _In_ size_t nimages,
+                                     _In_ DWORD bcflags, _In_ DWORD srgb, _In_ float alphaRef )
+{
+    assert( srcImages && destImages && nimages > 0 );
+
+    const DXGI_FORMAT format = srcImages[0].format;
     size_t sbpp = BitsPerPixel( format );
     if ( !sbpp )
         return E_FAIL;
@@ -207,99 +388,44 @@ static HRESULT _CompressBC_Parallel( _In_ const Image& image, _In_ const Image&
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    CompressTask task;
+    task.srcImages = srcImages;
+    task.destImages = destImages;
+    task.bcflags = bcflags;
+    task.srgb = srgb;
+    task.alphaRef = alphaRef;
+
     // Round to bytes
-    sbpp = ( sbpp + 7 ) / 8;
+    task.sbpp = ( sbpp + 7 ) / 8;
 
     // Determine BC format encoder
-    BC_ENCODE pfEncode;
-    size_t blocksize;
-    DWORD cflags;
-    if ( !_DetermineEncoderSettings( result.format, pfEncode, blocksize, cflags ) )
+    if ( !_DetermineEncoderSettings( destImages[0].format, task.pfEncode, task.pfEncodeBatch, task.blocksize, task.batch, task.cflags ) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
-    // Refactored version of loop to support parallel independance
-    const size_t nBlocks = std::max<size_t>(1, (image.width + 3) / 4 ) * std::max<size_t>(1, (image.height + 3) / 4 );
+    static_assert( (COMPRESS_TASK_BLOCKS % BC_BATCH_BLOCKS) == 0, "COMPRESS_TASK_BLOCKS should be a multiple of BC_BATCH_BLOCKS" );
 
-    bool fail = false;
+    task.offsets.reserve( nimages + 1 );
+    task.offsets.push_back( 0 );
 
-#pragma omp parallel for
-    for( int nb=0; nb < static_cast<int>( nBlocks ); ++nb )
+    for( size_t index = 0; index < nimages; ++index )
     {
-        const size_t nbWidth = std::max<size_t>(1, (image.width + 3) / 4 );
-
-        const size_t y = nb / nbWidth;
-        const size_t x = nb - (y*nbWidth);
-
-        assert( x < image.width && y < image.height );
-
-        size_t rowPitch = image.rowPitch;
-        const uint8_t *pSrc = image.pixels + (y*4*rowPitch) + (x*4*sbpp);
-
-        uint8_t *pDest = result.pixels + (nb*blocksize);
+        const Image& image = srcImages[ index ];
+        const Image& result = destImages[ index ];
 
-        size_t ph = std::min<size_t>( 4, image.height - y );
-        size_t pw = std::min<size_t>( 4, image.width - x );
-        assert( pw > 0 && ph > 0 );
+        if ( !image.pixels || !result.pixels )
+            return E_POINTER;
 
-        XMVECTOR temp[16];
-        if ( !_LoadScanline( &temp[0], pw, pSrc, rowPitch, format ) )
-            fail = true;
+        assert( image.width == result.width );
+        assert( image.height == result.height );
 
-        if ( ph > 1 )
-        {
-            if ( !_LoadScanline( &temp[4], pw, pSrc + rowPitch, rowPitch, format ) )
-                fail = true;
-
-            if ( ph > 2 )
-            {
-                if ( !_LoadScanline( &temp[8], pw, pSrc + rowPitch*2, rowPitch, format ) )
-                    fail = true;
-
-                if ( ph > 3 )
-                {
-                    if ( !_LoadScanline( &temp[12], pw, pSrc + rowPitch*3, rowPitch, format ) )
-                        fail = true;
-                }
-            }
-        }
-
-        if ( pw != 4 || ph != 4 )
-        {
-            // Replicate pixels for partial block
-            static const size_t uSrc[] = { 0, 0, 0, 1 };
-
-            if ( pw < 4 )
-            {
-                for( size_t t = 0; t < ph && t < 4; ++t )
-                {
-                    for( size_t s = pw; s < 4; ++s )
-                    {
-                        temp[ (t << 2) | s ] = temp[ (t << 2) | uSrc[s] ]; 
-                    }
-                }
-            }
-
-            if ( ph < 4 )
-            {
-                for( size_t t = ph; t < 4; ++t )
-                {
-                    for( size_t s = 0; s < 4; ++s )
-                    {
-                        temp[ (t << 2) | s ] = temp[ (uSrc[t] << 2) | s ]; 
-                    }
-                }
-            }
-        }
+        if ( image.format != format || result.format != destImages[0].format )
+            return E_FAIL;
 
-        _ConvertScanline( temp, 16, result.format, format, cflags | srgb );
-            
-        if ( pfEncode )
-            pfEncode( pDest, temp, bcflags );
-        else
-            D3DXEncodeBC1( pDest, temp, alphaRef, bcflags );
+        const size_t nBlocks = std::max<size_t>(1, (image.width + 3) / 4 ) * std::max<size_t>(1, (image.height + 3) / 4 );
+        task.offsets.push_back( task.offsets.back() + ( nBlocks + COMPRESS_TASK_BLOCKS - 1 ) / COMPRESS_TASK_BLOCKS );
     }
 
-    return (fail) ? E_FAIL : S_OK;
+    return _RunTasks( task.offsets.back(), true, _CompressBC_Task, &task );
 }
 
 #endif // _OPENMP
@@ -353,6 +479,54 @@ static DXGI_FORMAT _DefaultDecompress( _In_ DXGI_FORMAT format )
 }
 
 
+//-------------------------------------------------------------------------------------
+// Decodes a row of blocks at a time straight into 8-bit RGBA/BGRA; partial blocks on the right or bottom edge
+// go through a strip buffer
+//-------------------------------------------------------------------------------------
+static HRESULT _DecompressBCRGBA8( _In_ const Image& cImage, _In_ const Image& result, _In_ BC_DECODE_RGBA8 pfDecode, _In_ bool bgr )
+{
+    const size_t width = cImage.width;
+    const size_t nbWidth = std::max<size_t>( 1, (width + 3) / 4 );
+    const size_t stripPitch = nbWidth * 4 * sizeof(uint32_t);
+
+    std::unique_ptr<uint8_t, scratch_deleter> strip;
+    if ( ( width & 3 ) || ( cImage.height & 3 ) )
+    {
+        strip.reset( reinterpret_cast<uint8_t*>( _AllocScratch( stripPitch * 4 ) ) );
+        if ( !strip )
+            return E_OUTOFMEMORY;
+    }
+
+    const uint8_t *pSrc = cImage.pixels;
+    uint8_t *pDest = result.pixels;
+    const size_t rowPitch = result.rowPitch;
+
+    for( size_t h=0; h < cImage.height; h += 4 )
+    {
+        const size_t ph = std::min<size_t>( 4, cImage.height - h );
+
+        if ( !( width & 3 ) && ph == 4 )
+        {
+            pfDecode( pDest, rowPitch, pSrc, nbWidth, bgr );
+        }
+        else
+        {
+            pfDecode( strip.get(), stripPitch, pSrc, nbWidth, bgr );
+
+            for( size_t y = 0; y < ph; ++y )
+            {
+                memcpy_s( pDest + y*rowPitch, rowPitch, strip.get() + y*stripPitch, width * sizeof(uint32_t) );
+            }
+        }
+
+        pSrc += cImage.rowPitch;
+        pDest += rowPitch*4;
+    }
+
+    return S_OK;
+}
+
+
 //-------------------------------------------------------------------------------------
 static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result )
 {
@@ -380,41 +554,19 @@ static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result
     if ( !pDest )
         return E_POINTER;
 
-    // Promote "typeless" BC formats
-    DXGI_FORMAT cformat;
-    switch( cImage.format )
-    {
-    case DXGI_FORMAT_BC1_TYPELESS:  cformat = DXGI_FORMAT_BC1_UNORM; break;
-    case DXGI_FORMAT_BC2_TYPELESS:  cformat = DXGI_FORMAT_BC2_UNORM; break;
-    case DXGI_FORMAT_BC3_TYPELESS:  cformat = DXGI_FORMAT_BC3_UNORM; break;
-    case DXGI_FORMAT_BC4_TYPELESS:  cformat = DXGI_FORMAT_BC4_UNORM; break;
-    case DXGI_FORMAT_BC5_TYPELESS:  cformat = DXGI_FORMAT_BC5_UNORM; break;
-    case DXGI_FORMAT_BC6H_TYPELESS: cformat = DXGI_FORMAT_BC6H_UF16; break;
-    case DXGI_FORMAT_BC7_TYPELESS:  cformat = DXGI_FORMAT_BC7_UNORM; break;
-    default:                        cformat = cImage.format;         break;
-    }
-
-    // Determine BC format decoder
+    // Promote "typeless" BC formats and determine BC format decoder
     BC_DECODE pfDecode;
     size_t sbpp;
-    switch(cformat)
-    {
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfDecode = D3DXDecodeBC1;   sbpp = 8;   break;
-    case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC2_UNORM_SRGB:    pfDecode = D3DXDecodeBC2;   sbpp = 16;  break;
-    case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfDecode = D3DXDecodeBC3;   sbpp = 16;  break;
-    case DXGI_FORMAT_BC4_UNORM:         pfDecode = D3DXDecodeBC4U;  sbpp = 8;   break;
-    case DXGI_FORMAT_BC4_SNORM:         pfDecode = D3DXDecodeBC4S;  sbpp = 8;   break;
-    case DXGI_FORMAT_BC5_UNORM:         pfDecode = D3DXDecodeBC5U;  sbpp = 16;  break;
-    case DXGI_FORMAT_BC5_SNORM:         pfDecode = D3DXDecodeBC5S;  sbpp = 16;  break;
-    case DXGI_FORMAT_BC6H_UF16:         pfDecode = D3DXDecodeBC6HU; sbpp = 16;  break;
-    case DXGI_FORMAT_BC6H_SF16:         pfDecode = D3DXDecodeBC6HS; sbpp = 16;  break;
-    case DXGI_FORMAT_BC7_UNORM:
-    case DXGI_FORMAT_BC7_UNORM_SRGB:    pfDecode = D3DXDecodeBC7;   sbpp = 16;  break;
-    default:
+    DXGI_FORMAT cformat;
+    if ( !_DetermineDecoderSettings( cImage.format, pfDecode, sbpp, cformat ) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    // BC1-BC5 to 8-bit RGBA/BGRA doesn't need to go through float
+    BC_DECODE_RGBA8 pfDecodeRGBA8;
+    bool bgr;
+    if ( _DetermineDecoderRGBA8( cformat, format, pfDecodeRGBA8, bgr ) )
+    {
+        return _DecompressBCRGBA8( cImage, result, pfDecodeRGBA8, bgr );
     }
 
     XMVECTOR temp[16];
@@ -468,91 +620,261 @@ static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result
 
 
 //-------------------------------------------------------------------------------------
-bool _IsAlphaAllOpaqueBC( _In_ const Image& cImage )
+// Transcoding
+//   Works one row of blocks at a time: each block is decoded, converted and re-encoded
+//   without expanding the whole image. Where the source block already holds exactly
+//   what the destination needs, the bits are copied instead
+//-------------------------------------------------------------------------------------
+enum TRANSCODE_COPY
 {
-    if ( !cImage.pixels )
-        return false;
+    TRANSCODE_COPY_NONE = 0,
+    TRANSCODE_COPY_BLOCK,       // Same format
+    TRANSCODE_COPY_BC1_COLOR,   // BC2/BC3 -> BC1: color part of blocks that are opaque at alphaRef
+    TRANSCODE_COPY_BC5_RED,     // BC5 -> BC4: red channel
+    TRANSCODE_COPY_BC4_RED,     // BC4 -> BC5: red channel, replicated to green as the conversion would
+};
+
+static TRANSCODE_COPY _DetermineTranscodeCopy( _In_ DXGI_FORMAT sformat, _In_ DXGI_FORMAT dformat, _In_ DWORD srgb )
+{
+    if ( srgb )
+        return TRANSCODE_COPY_NONE;
 
-    // Promote "typeless" BC formats
-    DXGI_FORMAT cformat;
-    switch( cImage.format )
+    if ( sformat == dformat )
+        return TRANSCODE_COPY_BLOCK;
+
+    if ( IsSRGB( sformat ) != IsSRGB( dformat ) )
+        return TRANSCODE_COPY_NONE;
+
+    switch( dformat )
     {
-    case DXGI_FORMAT_BC1_TYPELESS:  cformat = DXGI_FORMAT_BC1_UNORM; break;
-    case DXGI_FORMAT_BC2_TYPELESS:  cformat = DXGI_FORMAT_BC2_UNORM; break;
-    case DXGI_FORMAT_BC3_TYPELESS:  cformat = DXGI_FORMAT_BC3_UNORM; break;
-    case DXGI_FORMAT_BC7_TYPELESS:  cformat = DXGI_FORMAT_BC7_UNORM; break;
-    default:                        cformat = cImage.format;         break;
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+        switch( sformat )
+        {
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return TRANSCODE_COPY_BC1_COLOR;
+
+        default:
+            break;
+        }
+        break;
+
+    case DXGI_FORMAT_BC4_UNORM:
+        return ( sformat == DXGI_FORMAT_BC5_UNORM ) ? TRANSCODE_COPY_BC5_RED : TRANSCODE_COPY_NONE;
+
+    case DXGI_FORMAT_BC4_SNORM:
+        return ( sformat == DXGI_FORMAT_BC5_SNORM ) ? TRANSCODE_COPY_BC5_RED : TRANSCODE_COPY_NONE;
+
+    case DXGI_FORMAT_BC5_UNORM:
+        return ( sformat == DXGI_FORMAT_BC4_UNORM ) ? TRANSCODE_COPY_BC4_RED : TRANSCODE_COPY_NONE;
+
+    case DXGI_FORMAT_BC5_SNORM:
+        return ( sformat == DXGI_FORMAT_BC4_SNORM ) ? TRANSCODE_COPY_BC4_RED : TRANSCODE_COPY_NONE;
+
+    default:
+        break;
     }
 
-    // Determine BC format decoder
-    BC_DECODE pfDecode;
-    size_t sbpp;
-    switch(cformat)
+    return TRANSCODE_COPY_NONE;
+}
+
+static bool _IsBlockOpaque( _In_reads_(16) const uint8_t* pBC, _In_ DXGI_FORMAT format, _In_ float alphaRef )
+{
+    // Uses the float decoders' alpha values, so this agrees with the BC1 encoder's alphaRef test
+    float minAlpha = 1.0f;
+
+    switch( format )
     {
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfDecode = D3DXDecodeBC1;   sbpp = 8;   break;
     case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC2_UNORM_SRGB:    pfDecode = D3DXDecodeBC2;   sbpp = 16;  break;
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+        for( size_t i = 0; i < 8; ++i )
+        {
+            minAlpha = std::min<float>( minAlpha, (float) ( pBC[i] & 0xf ) * (1.0f / 15.0f) );
+            minAlpha = std::min<float>( minAlpha, (float) ( pBC[i] >> 4 ) * (1.0f / 15.0f) );
+        }
+        break;
+
     case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfDecode = D3DXDecodeBC3;   sbpp = 16;  break;
-    case DXGI_FORMAT_BC7_UNORM:
-    case DXGI_FORMAT_BC7_UNORM_SRGB:    pfDecode = D3DXDecodeBC7;   sbpp = 16;  break;
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        {
+            float alpha[8];
+            D3DXDecodeAlphaPalette( alpha, pBC );
+            uint64_t dw = D3DXGetAlphaIndices( pBC );
+            for( size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 3 )
+            {
+                minAlpha = std::min<float>( minAlpha, alpha[dw & 7] );
+            }
+        }
+        break;
+
     default:
-        // BC4, BC5, and BC6 don't have alpha channels
         return false;
     }
 
-    // Scan blocks for non-opaque alpha
-    static const XMVECTORF32 threshold = { 0.99f, 0.99f, 0.99f, 0.99f };
+    return ( minAlpha >= alphaRef );
+}
 
-    XMVECTOR temp[16];
-    const uint8_t *pPixels = cImage.pixels;
-    for( size_t h = 0; h < cImage.height; h += 4 )
+static void _CopyBC1Color( _Out_writes_(8) uint8_t* pDest, _In_reads_(8) const uint8_t* pSrc )
+{
+    // BC2/BC3 colors are always in 4-color mode, which BC1 only uses when rgb[0] > rgb[1]
+    D3DX_BC1 bc1;
+    memcpy( &bc1, pSrc, sizeof(D3DX_BC1) );
+
+    if ( bc1.rgb[0] < bc1.rgb[1] )
     {
-        const uint8_t *ptr = pPixels;
-        size_t ph = std::min<size_t>( 4, cImage.height - h );
-        size_t w = 0;
-        for( size_t count = 0; count < cImage.rowPitch; count += sbpp, w += 4 )
+        // Swapping the endpoints swaps indices 0/1 and 2/3
+        std::swap( bc1.rgb[0], bc1.rgb[1] );
+        bc1.bitmap ^= 0x55555555;
+    }
+    else if ( bc1.rgb[0] == bc1.rgb[1] )
+    {
+        // All 4 colors are the same
+        bc1.bitmap = 0;
+    }
+
+    memcpy( pDest, &bc1, sizeof(D3DX_BC1) );
+}
+
+struct TranscodeTask
+{
+    const Image*        srcImages;
+    const Image*        destImages;
+    std::vector<size_t> offsets;
+    BC_DECODE           pfDecode;
+    size_t              sbpp;
+    DXGI_FORMAT         sformat;
+    BC_ENCODE           pfEncode;
+    BC_ENCODE_BATCH     pfEncodeBatch;
+    size_t              blocksize;
+    size_t              batch;
+    DWORD               cflags;
+    DWORD               bcflags;
+    DWORD               srgb;
+    float               alphaRef;
+    TRANSCODE_COPY      copy;
+};
+
+static HRESULT _Transcode_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const TranscodeTask* task = reinterpret_cast<const TranscodeTask*>( pContext );
+    assert( task );
+
+    const size_t index = _FindTaskImage( task->offsets, item );
+    const Image& image = task->srcImages[ index ];
+    const Image& result = task->destImages[ index ];
+
+    const size_t by = item - task->offsets[ index ];
+    const size_t nbWidth = std::max<size_t>( 1, (image.width + 3) / 4 );
+
+    const uint8_t* pSrc = image.pixels + by * image.rowPitch;
+    uint8_t* pDest = result.pixels + by * result.rowPitch;
+
+    switch( task->copy )
+    {
+    case TRANSCODE_COPY_BLOCK:
+        memcpy( pDest, pSrc, nbWidth * task->blocksize );
+        return S_OK;
+
+    case TRANSCODE_COPY_BC5_RED:
+        for( size_t nb = 0; nb < nbWidth; ++nb )
         {
-            pfDecode( temp, ptr );
+            memcpy( pDest + nb * 8, pSrc + nb * 16, 8 );
+        }
+        return S_OK;
 
-            size_t pw = std::min<size_t>( 4, cImage.width - w );
-            assert( pw > 0 && ph > 0 );
+    case TRANSCODE_COPY_BC4_RED:
+        for( size_t nb = 0; nb < nbWidth; ++nb )
+        {
+            memcpy( pDest + nb * 16, pSrc + nb * 8, 8 );
+            memcpy( pDest + nb * 16 + 8, pSrc + nb * 8, 8 );
+        }
+        return S_OK;
 
-            if ( pw == 4 && ph == 4 )
-            {
-                // Full blocks
-                for( size_t j = 0; j < 16; ++j )
-                {
-                    XMVECTOR alpha = XMVectorSplatW( temp[j] );
-                    if ( XMVector4Less( alpha, threshold ) )
-                        return false;
-                }
-            }
-            else
-            {
-                // Handle partial blocks
-                for( size_t y = 0; y < ph; ++y )
-                {
-                    for( size_t x = 0; x < pw; ++x )
-                    {
-                        XMVECTOR alpha = XMVectorSplatW( temp[ y * 4 + x ] );
-                        if ( XMVector4Less( alpha, threshold ) )
-                            return false;
-                    }
-                }
-            }
+    default:
+        break;
+    }
+
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK * BC_BATCH_BLOCKS];
 
-            ptr += sbpp;
+    for( size_t nb = 0; nb < nbWidth; )
+    {
+        // Decode a run of up to 'batch' blocks that need re-encoding
+        size_t count = 0;
+        for( ; count < task->batch && (nb + count) < nbWidth; ++count )
+        {
+            const uint8_t* sptr = pSrc + (nb + count) * task->sbpp;
+            if ( task->copy == TRANSCODE_COPY_BC1_COLOR && _IsBlockOpaque( sptr, task->sformat, task->alphaRef ) )
+                break;
+
+            XMVECTOR* block = &temp[ count * NUM_PIXELS_PER_BLOCK ];
+            task->pfDecode( block, sptr );
+            _ConvertScanline( block, NUM_PIXELS_PER_BLOCK, result.format, task->sformat, task->cflags | task->srgb );
         }
 
-        pPixels += cImage.rowPitch;
+        if ( count > 0 )
+        {
+            _EncodeBlocks( pDest + nb * task->blocksize, temp, count, task->pfEncode, task->pfEncodeBatch, task->blocksize, task->bcflags, task->alphaRef );
+            nb += count;
+        }
+        else
+        {
+            // Opaque BC2/BC3 block: its color part is already a BC1 block
+            _CopyBC1Color( pDest + nb * task->blocksize, pSrc + nb * task->sbpp + 8 );
+            ++nb;
+        }
     }
 
-    return true;
+    return S_OK;
+}
+
+static HRESULT _Transcode( _In_reads_(nimages) const Image* srcImages, _In_reads_(nimages) const Image* destImages, _In_ size_t nimages,
+                           _In_ DWORD compress, _In_ float alphaRef )
+{
+    assert( srcImages && destImages && nimages > 0 );
+
+    TranscodeTask task;
+    task.srcImages = srcImages;
+    task.destImages = destImages;
+    task.bcflags = _GetBCFlags( compress );
+    task.srgb = _GetSRGBFlags( compress );
+    task.alphaRef = alphaRef;
+
+    if ( !_DetermineDecoderSettings( srcImages[0].format, task.pfDecode, task.sbpp, task.sformat ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    if ( !_DetermineEncoderSettings( destImages[0].format, task.pfEncode, task.pfEncodeBatch, task.blocksize, task.batch, task.cflags ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    task.copy = _DetermineTranscodeCopy( task.sformat, destImages[0].format, task.srgb );
+
+    task.offsets.reserve( nimages + 1 );
+    task.offsets.push_back( 0 );
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        const Image& image = srcImages[ index ];
+        const Image& result = destImages[ index ];
+
+        if ( !image.pixels || !result.pixels )
+            return E_POINTER;
+
+        if ( image.width != result.width || image.height != result.height )
+            return E_FAIL;
+
+        if ( image.format != srcImages[0].format || result.format != destImages[0].format )
+            return E_FAIL;
+
+        task.offsets.push_back( task.offsets.back() + std::max<size_t>( 1, (image.height + 3) / 4 ) );
+    }
+
+    return _RunTasks( task.offsets.back(), (compress & TEX_COMPRESS_PARALLEL) != 0, _Transcode_Task, &task );
 }
 
 
+
 //=====================================================================================
 // Entry-points
 //=====================================================================================
@@ -588,7 +910,7 @@ HRESULT Compress( const Image& srcImage, DXGI_FORMAT format, DWORD compress, flo
 #ifndef _OPENMP
         return E_NOTIMPL;
 #else
-        hr = _CompressBC_Parallel( srcImage, *img, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+        hr = _CompressBC_Parallel( &srcImage, img, 1, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
 #endif // _OPENMP
     }
     else
@@ -648,26 +970,27 @@ HRESULT Compress( const Image* srcImages, size_t nimages, const TexMetadata& met
             cImages.Release();
             return E_FAIL;
         }
+    }
 
-        if ( (compress & TEX_COMPRESS_PARALLEL) )
-        {
+    if ( (compress & TEX_COMPRESS_PARALLEL) )
+    {
 #ifndef _OPENMP
-            return E_NOTIMPL;
+        return E_NOTIMPL;
 #else
-            if ( compress & TEX_COMPRESS_PARALLEL )
-            {
-                hr = _CompressBC_Parallel( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
-                if ( FAILED(hr) )
-                {
-                    cImages.Release();
-                    return  hr;
-                }
-            }
-#endif // _OPENMP
+        // All mips and array slices are compressed as one batch of work
+        hr = _CompressBC_Parallel( srcImages, dest, nimages, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+        if ( FAILED(hr) )
+        {
+            cImages.Release();
+            return  hr;
         }
-        else
+#endif // _OPENMP
+    }
+    else
+    {
+        for( size_t index=0; index < nimages; ++index )
         {
-            hr = _CompressBC( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+            hr = _CompressBC( srcImages[ index ], dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
             if ( FAILED(hr) )
             {
                 cImages.Release();
@@ -680,6 +1003,114 @@ HRESULT Compress( const Image* srcImages, size_t nimages, const TexMetadata& met
 }
 
 
+//-------------------------------------------------------------------------------------
+// Streaming compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT CompressStrips( const Image& srcImage, DXGI_FORMAT format, DWORD compress, float alphaRef,
+                        TEX_COMPRESS_STRIP_CALLBACK pfCallback, void* pContext )
+{
+    if ( !pfCallback || !srcImage.width || !srcImage.height )
+        return E_INVALIDARG;
+
+    if ( IsCompressed(srcImage.format) || !IsCompressed(format) )
+        return E_INVALIDARG;
+
+    if ( IsTypeless(format)
+         || IsTypeless(srcImage.format) || IsPlanar(srcImage.format) || IsPalettized(srcImage.format) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    if ( !srcImage.pixels )
+        return E_POINTER;
+
+#ifndef _OPENMP
+    if ( compress & TEX_COMPRESS_PARALLEL )
+        return E_NOTIMPL;
+#endif
+
+    size_t rowPitch, slicePitch;
+    ComputePitch( format, srcImage.width, srcImage.height, rowPitch, slicePitch, CP_FLAGS_NONE );
+
+    std::unique_ptr<uint8_t[]> strip( new (std::nothrow) uint8_t[ rowPitch ] );
+    if ( !strip )
+        return E_OUTOFMEMORY;
+
+    // Each strip is described as a 4-pixel high image (and a one block high result) so it goes through
+    // exactly the same encoder paths as Compress
+    Image src = srcImage;
+    Image dest;
+    dest.width = srcImage.width;
+    dest.format = format;
+    dest.rowPitch = rowPitch;
+    dest.slicePitch = rowPitch;
+    dest.pixels = strip.get();
+
+    const size_t nRows = std::max<size_t>( 1, ( srcImage.height + 3 ) / 4 );
+
+    for( size_t row = 0; row < nRows; ++row )
+    {
+        src.height = dest.height = std::min<size_t>( 4, srcImage.height - row*4 );
+        src.pixels = srcImage.pixels + row*4*srcImage.rowPitch;
+
+        HRESULT hr;
+#ifdef _OPENMP
+        if ( compress & TEX_COMPRESS_PARALLEL )
+        {
+            hr = _CompressBC_Parallel( &src, &dest, 1, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+        }
+        else
+#endif
+        {
+            hr = _CompressBC( src, dest, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+        }
+
+        if ( FAILED(hr) )
+            return hr;
+
+        hr = pfCallback( strip.get(), rowPitch, row, pContext );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
+    return S_OK;
+}
+
+static HRESULT _CopyStripToBlob( _In_reads_bytes_(size) const uint8_t* pBlocks, _In_ size_t size, _In_ size_t blockRow, _In_opt_ void* pContext )
+{
+    Blob* blob = reinterpret_cast<Blob*>( pContext );
+    assert( blob );
+
+    const size_t offset = blockRow * size;
+    if ( offset + size > blob->GetBufferSize() )
+        return E_UNEXPECTED;
+
+    memcpy_s( reinterpret_cast<uint8_t*>( blob->GetBufferPointer() ) + offset, blob->GetBufferSize() - offset, pBlocks, size );
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT CompressStrips( const Image& srcImage, DXGI_FORMAT format, DWORD compress, float alphaRef, Blob& blob )
+{
+    blob.Release();
+
+    if ( !IsCompressed(format) )
+        return E_INVALIDARG;
+
+    size_t rowPitch, slicePitch;
+    ComputePitch( format, srcImage.width, srcImage.height, rowPitch, slicePitch, CP_FLAGS_NONE );
+
+    HRESULT hr = blob.Initialize( slicePitch );
+    if ( FAILED(hr) )
+        return hr;
+
+    hr = CompressStrips( srcImage, format, compress, alphaRef, _CopyStripToBlob, &blob );
+    if ( FAILED(hr) )
+        blob.Release();
+
+    return hr;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Decompression
 //-------------------------------------------------------------------------------------
@@ -806,4 +1237,81 @@ HRESULT Decompress( const Image* cImages, size_t nimages, const TexMetadata& met
     return S_OK;
 }
 
+
+//-------------------------------------------------------------------------------------
+// Transcoding
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT Transcode( const Image& cImage, DXGI_FORMAT format, DWORD compress, float alphaRef, ScratchImage& image )
+{
+    if ( !IsCompressed(cImage.format) || !IsCompressed(format) )
+        return E_INVALIDARG;
+
+    if ( IsTypeless(format) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    // Create compressed image
+    HRESULT hr = image.Initialize2D( format, cImage.width, cImage.height, 1, 1 );
+    if ( FAILED(hr) )
+        return hr;
+
+    const Image *img = image.GetImage( 0, 0, 0 );
+    if ( !img )
+    {
+        image.Release();
+        return E_POINTER;
+    }
+
+    hr = _Transcode( &cImage, img, 1, compress, alphaRef );
+    if ( FAILED(hr) )
+        image.Release();
+
+    return hr;
+}
+
+_Use_decl_annotations_
+HRESULT Transcode( const Image* cImages, size_t nimages, const TexMetadata& metadata,
+                   DXGI_FORMAT format, DWORD compress, float alphaRef, ScratchImage& images )
+{
+    if ( !cImages || !nimages )
+        return E_INVALIDARG;
+
+    if ( !IsCompressed(metadata.format) || !IsCompressed(format) )
+        return E_INVALIDARG;
+
+    if ( IsTypeless(format) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    images.Release();
+
+    TexMetadata mdata2 = metadata;
+    mdata2.format = format;
+    HRESULT hr = images.Initialize( mdata2 );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( nimages != images.GetImageCount() )
+    {
+        images.Release();
+        return E_FAIL;
+    }
+
+    const Image* dest = images.GetImages();
+    if ( !dest )
+    {
+        images.Release();
+        return E_POINTER;
+    }
+
+    // All mips and array slices are transcoded as one batch of work
+    hr = _Transcode( cImages, dest, nimages, compress, alphaRef );
+    if ( FAILED(hr) )
+    {
+        images.Release();
+        return hr;
+    }
+
+    return S_OK;
+}
+
 }; // namespace
@@ -57,7 +57,7 @@ static HRESULT _ConvertToRGBA32( _In_ const Image& srcImage, _In_ ScratchImage&
         return E_POINTER;
     }
 
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( ( sizeof(XMVECTOR) * srcImage.width ), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( ( sizeof(XMVECTOR) * srcImage.width ) ) ) );
     if ( !scanline )
     {
         image.Release();
@@ -677,6 +677,254 @@ bool _ExpandScanline( LPVOID pDestination, size_t outSize, DXGI_FORMAT outFormat
 }
 
 
+//-------------------------------------------------------------------------------------
+// SSE2 fast paths for the most common formats
+//
+// These work on four pixels at a time as planes of R, G, B, and A. They reproduce the
+// SSE code paths of XMLoadUByteN4, XMStoreUByteN4, XMLoadUDecN4, XMStoreUDecN4, and the
+// XMConvertHalfToFloat used by XMLoadHalf4 bit-for-bit. Later versions of DirectXMath
+// change the rounding of the normalized stores, so they are limited to 3.06 or earlier.
+//-------------------------------------------------------------------------------------
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_) && (DIRECTX_MATH_VERSION < 307)
+#define TEXP_SCANLINE_SSE2
+
+static const XMVECTORI32 g_ScanlineMask8    = { 0xFF, 0xFF, 0xFF, 0xFF };
+static const XMVECTORI32 g_ScanlineMask10   = { 0x3FF, 0x3FF, 0x3FF, 0x3FF };
+static const XMVECTORF32 g_ScanlineScale8   = { 255.f, 255.f, 255.f, 255.f };
+static const XMVECTORF32 g_ScanlineInv8     = { 1.f/255.f, 1.f/255.f, 1.f/255.f, 1.f/255.f };
+static const XMVECTORF32 g_ScanlineScale10  = { 1023.f, 1023.f, 1023.f, 1023.f };
+static const XMVECTORF32 g_ScanlineInv10    = { 1.f/1023.f, 1.f/1023.f, 1.f/1023.f, 1.f/1023.f };
+static const XMVECTORF32 g_ScanlineScale2   = { 3.f, 3.f, 3.f, 3.f };
+static const XMVECTORF32 g_ScanlineInv2     = { 1.f/3.f, 1.f/3.f, 1.f/3.f, 1.f/3.f };
+
+static inline __m128i _ScanlineQuantize( FXMVECTOR v, FXMVECTOR scale )
+{
+    // Same clamp order as DirectXMath so NaN stores as zero, truncated rather than rounded
+    XMVECTOR n = _mm_max_ps( v, g_XMZero );
+    n = _mm_min_ps( n, g_XMOne );
+    return _mm_cvttps_epi32( _mm_mul_ps( n, scale ) );
+}
+
+static bool _LoadScanlineUByteN4( _Out_writes_(count) XMVECTOR* pDestination, _In_ size_t count,
+                                  _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ bool bgr )
+{
+    if ( size < sizeof(XMUBYTEN4) )
+        return false;
+
+    const size_t pixels = std::min<size_t>( count, size / sizeof(XMUBYTEN4) );
+
+    const XMUBYTEN4 * __restrict sPtr = reinterpret_cast<const XMUBYTEN4*>(pSource);
+    XMVECTOR* __restrict dPtr = pDestination;
+
+    size_t icount = 0;
+    for( ; icount + 4 <= pixels; icount += 4 )
+    {
+        __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( sPtr ) );
+        sPtr += 4;
+
+        XMVECTOR r = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( p, g_ScanlineMask8 ) ), g_ScanlineInv8 );
+        XMVECTOR g = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( p, 8 ), g_ScanlineMask8 ) ), g_ScanlineInv8 );
+        XMVECTOR b = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( p, 16 ), g_ScanlineMask8 ) ), g_ScanlineInv8 );
+        XMVECTOR a = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( p, 24 ) ), g_ScanlineInv8 );
+
+        if ( bgr )
+            std::swap( r, b );
+
+        _MM_TRANSPOSE4_PS( r, g, b, a );
+        dPtr[0] = r;
+        dPtr[1] = g;
+        dPtr[2] = b;
+        dPtr[3] = a;
+        dPtr += 4;
+    }
+
+    for( ; icount < pixels; ++icount )
+    {
+        XMVECTOR v = XMLoadUByteN4( sPtr++ );
+        *(dPtr++) = ( bgr ) ? XMVectorSwizzle<2, 1, 0, 3>( v ) : v;
+    }
+
+    return true;
+}
+
+static bool _StoreScanlineUByteN4( _Out_writes_bytes_(size) LPVOID pDestination, _In_ size_t size,
+                                   _In_reads_(count) const XMVECTOR* pSource, _In_ size_t count, _In_ bool bgr )
+{
+    if ( size < sizeof(XMUBYTEN4) )
+        return false;
+
+    const size_t pixels = std::min<size_t>( count, size / sizeof(XMUBYTEN4) );
+
+    const XMVECTOR* __restrict sPtr = pSource;
+    XMUBYTEN4 * __restrict dPtr = reinterpret_cast<XMUBYTEN4*>(pDestination);
+
+    size_t icount = 0;
+    for( ; icount + 4 <= pixels; icount += 4 )
+    {
+        XMVECTOR r = sPtr[0];
+        XMVECTOR g = sPtr[1];
+        XMVECTOR b = sPtr[2];
+        XMVECTOR a = sPtr[3];
+        sPtr += 4;
+
+        _MM_TRANSPOSE4_PS( r, g, b, a );
+
+        if ( bgr )
+            std::swap( r, b );
+
+        __m128i p = _ScanlineQuantize( r, g_ScanlineScale8 );
+        p = _mm_or_si128( p, _mm_slli_epi32( _ScanlineQuantize( g, g_ScanlineScale8 ), 8 ) );
+        p = _mm_or_si128( p, _mm_slli_epi32( _ScanlineQuantize( b, g_ScanlineScale8 ), 16 ) );
+        p = _mm_or_si128( p, _mm_slli_epi32( _ScanlineQuantize( a, g_ScanlineScale8 ), 24 ) );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dPtr ), p );
+        dPtr += 4;
+    }
+
+    for( ; icount < pixels; ++icount )
+    {
+        XMVECTOR v = *sPtr++;
+        XMStoreUByteN4( dPtr++, ( bgr ) ? XMVectorSwizzle<2, 1, 0, 3>( v ) : v );
+    }
+
+    return true;
+}
+
+static bool _LoadScanlineUDecN4( _Out_writes_(count) XMVECTOR* pDestination, _In_ size_t count,
+                                 _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size )
+{
+    if ( size < sizeof(XMUDECN4) )
+        return false;
+
+    const size_t pixels = std::min<size_t>( count, size / sizeof(XMUDECN4) );
+
+    const XMUDECN4 * __restrict sPtr = reinterpret_cast<const XMUDECN4*>(pSource);
+    XMVECTOR* __restrict dPtr = pDestination;
+
+    size_t icount = 0;
+    for( ; icount + 4 <= pixels; icount += 4 )
+    {
+        __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( sPtr ) );
+        sPtr += 4;
+
+        XMVECTOR r = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( p, g_ScanlineMask10 ) ), g_ScanlineInv10 );
+        XMVECTOR g = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( p, 10 ), g_ScanlineMask10 ) ), g_ScanlineInv10 );
+        XMVECTOR b = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( p, 20 ), g_ScanlineMask10 ) ), g_ScanlineInv10 );
+        XMVECTOR a = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( p, 30 ) ), g_ScanlineInv2 );
+
+        _MM_TRANSPOSE4_PS( r, g, b, a );
+        dPtr[0] = r;
+        dPtr[1] = g;
+        dPtr[2] = b;
+        dPtr[3] = a;
+        dPtr += 4;
+    }
+
+    for( ; icount < pixels; ++icount )
+    {
+        *(dPtr++) = XMLoadUDecN4( sPtr++ );
+    }
+
+    return true;
+}
+
+static bool _StoreScanlineUDecN4( _Out_writes_bytes_(size) LPVOID pDestination, _In_ size_t size,
+                                  _In_reads_(count) const XMVECTOR* pSource, _In_ size_t count )
+{
+    if ( size < sizeof(XMUDECN4) )
+        return false;
+
+    const size_t pixels = std::min<size_t>( count, size / sizeof(XMUDECN4) );
+
+    const XMVECTOR* __restrict sPtr = pSource;
+    XMUDECN4 * __restrict dPtr = reinterpret_cast<XMUDECN4*>(pDestination);
+
+    size_t icount = 0;
+    for( ; icount + 4 <= pixels; icount += 4 )
+    {
+        XMVECTOR r = sPtr[0];
+        XMVECTOR g = sPtr[1];
+        XMVECTOR b = sPtr[2];
+        XMVECTOR a = sPtr[3];
+        sPtr += 4;
+
+        _MM_TRANSPOSE4_PS( r, g, b, a );
+
+        __m128i p = _ScanlineQuantize( r, g_ScanlineScale10 );
+        p = _mm_or_si128( p, _mm_slli_epi32( _ScanlineQuantize( g, g_ScanlineScale10 ), 10 ) );
+        p = _mm_or_si128( p, _mm_slli_epi32( _ScanlineQuantize( b, g_ScanlineScale10 ), 20 ) );
+        p = _mm_or_si128( p, _mm_slli_epi32( _ScanlineQuantize( a, g_ScanlineScale2 ), 30 ) );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dPtr ), p );
+        dPtr += 4;
+    }
+
+    for( ; icount < pixels; ++icount )
+    {
+        XMStoreUDecN4( dPtr++, *sPtr++ );
+    }
+
+    return true;
+}
+
+#if !defined(_XM_F16C_INTRINSICS_)
+static const XMVECTORI32 g_ScanlineHalfSign     = { 0x8000, 0x8000, 0x8000, 0x8000 };
+static const XMVECTORI32 g_ScanlineHalfMagnitude = { 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF };
+static const XMVECTORI32 g_ScanlineHalfMinNormal = { 0x0400, 0x0400, 0x0400, 0x0400 };
+static const XMVECTORI32 g_ScanlineHalfBias     = { 112 << 23, 112 << 23, 112 << 23, 112 << 23 };
+static const XMVECTORF32 g_ScanlineHalfDenorm   = { 1.f/16777216.f, 1.f/16777216.f, 1.f/16777216.f, 1.f/16777216.f };
+
+static inline XMVECTOR _ScanlineHalfToFloat( __m128i h )
+{
+    // h holds four halfs zero-extended to 32-bits. As with XMConvertHalfToFloat, an exponent of 31 is
+    // treated as a normal number rather than INF/NaN, and denorms are exact as mantissa * 2^-24
+    __m128i sign = _mm_slli_epi32( _mm_and_si128( h, g_ScanlineHalfSign ), 16 );
+    __m128i mag = _mm_and_si128( h, g_ScanlineHalfMagnitude );
+
+    __m128i normal = _mm_add_epi32( _mm_slli_epi32( mag, 13 ), g_ScanlineHalfBias );
+    __m128i denorm = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( mag ), g_ScanlineHalfDenorm ) );
+
+    __m128i isdenorm = _mm_cmplt_epi32( mag, g_ScanlineHalfMinNormal );
+    __m128i v = _mm_or_si128( _mm_andnot_si128( isdenorm, normal ), _mm_and_si128( isdenorm, denorm ) );
+    return _mm_castsi128_ps( _mm_or_si128( v, sign ) );
+}
+
+static bool _LoadScanlineHalf4( _Out_writes_(count) XMVECTOR* pDestination, _In_ size_t count,
+                                _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size )
+{
+    if ( size < sizeof(XMHALF4) )
+        return false;
+
+    const size_t pixels = std::min<size_t>( count, size / sizeof(XMHALF4) );
+
+    const XMHALF4 * __restrict sPtr = reinterpret_cast<const XMHALF4*>(pSource);
+    XMVECTOR* __restrict dPtr = pDestination;
+
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t icount = 0;
+    for( ; icount + 2 <= pixels; icount += 2 )
+    {
+        __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( sPtr ) );
+        sPtr += 2;
+
+        dPtr[0] = _ScanlineHalfToFloat( _mm_unpacklo_epi16( p, zero ) );
+        dPtr[1] = _ScanlineHalfToFloat( _mm_unpackhi_epi16( p, zero ) );
+        dPtr += 2;
+    }
+
+    for( ; icount < pixels; ++icount )
+    {
+        *(dPtr++) = XMLoadHalf4( sPtr++ );
+    }
+
+    return true;
+}
+#endif // !_XM_F16C_INTRINSICS_
+
+#endif // TEXP_SCANLINE_SSE2
+
+
 //-------------------------------------------------------------------------------------
 // Loads an image row into standard RGBA XMVECTOR (aligned) array
 //-------------------------------------------------------------------------------------
@@ -760,7 +1008,11 @@ _Use_decl_annotations_ bool _LoadScanline( XMVECTOR* pDestination, size_t count,
         LOAD_SCANLINE3( XMINT3, XMLoadSInt3, g_XMIdentityR3 )
 
     case DXGI_FORMAT_R16G16B16A16_FLOAT:
+#if defined(TEXP_SCANLINE_SSE2) && !defined(_XM_F16C_INTRINSICS_)
+        return _LoadScanlineHalf4( dPtr, count, pSource, size );
+#else
         LOAD_SCANLINE( XMHALF4, XMLoadHalf4 )
+#endif
 
     case DXGI_FORMAT_R16G16B16A16_UNORM:
         LOAD_SCANLINE( XMUSHORTN4, XMLoadUShortN4 ) 
@@ -837,7 +1089,11 @@ _Use_decl_annotations_ bool _LoadScanline( XMVECTOR* pDestination, size_t count,
         return false;
 
     case DXGI_FORMAT_R10G10B10A2_UNORM:
+#ifdef TEXP_SCANLINE_SSE2
+        return _LoadScanlineUDecN4( dPtr, count, pSource, size );
+#else
         LOAD_SCANLINE( XMUDECN4, XMLoadUDecN4 );
+#endif
 
     case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
 #if DIRECTX_MATH_VERSION >= 306
@@ -878,7 +1134,11 @@ _Use_decl_annotations_ bool _LoadScanline( XMVECTOR* pDestination, size_t count,
 
     case DXGI_FORMAT_R8G8B8A8_UNORM:
     case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+#ifdef TEXP_SCANLINE_SSE2
+        return _LoadScanlineUByteN4( dPtr, count, pSource, size, false );
+#else
         LOAD_SCANLINE( XMUBYTEN4, XMLoadUByteN4 )
+#endif
 
     case DXGI_FORMAT_R8G8B8A8_UINT:
         LOAD_SCANLINE( XMUBYTE4, XMLoadUByte4 )
@@ -1253,6 +1513,9 @@ _Use_decl_annotations_ bool _LoadScanline( XMVECTOR* pDestination, size_t count,
 
     case DXGI_FORMAT_B8G8R8A8_UNORM:
     case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+#ifdef TEXP_SCANLINE_SSE2
+        return _LoadScanlineUByteN4( dPtr, count, pSource, size, true );
+#else
         if ( size >= sizeof(XMUBYTEN4) )
         {
             const XMUBYTEN4 * __restrict sPtr = reinterpret_cast<const XMUBYTEN4*>(pSource);
@@ -1265,6 +1528,7 @@ _Use_decl_annotations_ bool _LoadScanline( XMVECTOR* pDestination, size_t count,
             return true;
         }
         return false;
+#endif
 
     case DXGI_FORMAT_B8G8R8X8_UNORM:
     case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
@@ -1675,7 +1939,11 @@ bool _StoreScanline( LPVOID pDestination, size_t size, DXGI_FORMAT format,
         return false;
 
     case DXGI_FORMAT_R10G10B10A2_UNORM:
+#ifdef TEXP_SCANLINE_SSE2
+        return _StoreScanlineUDecN4( pDestination, size, sPtr, count );
+#else
         STORE_SCANLINE( XMUDECN4, XMStoreUDecN4 );
+#endif
 
     case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
 #if DIRECTX_MATH_VERSION >= 306
@@ -1717,7 +1985,11 @@ bool _StoreScanline( LPVOID pDestination, size_t size, DXGI_FORMAT format,
 
     case DXGI_FORMAT_R8G8B8A8_UNORM:
     case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+#ifdef TEXP_SCANLINE_SSE2
+        return _StoreScanlineUByteN4( pDestination, size, sPtr, count, false );
+#else
         STORE_SCANLINE( XMUBYTEN4, XMStoreUByteN4 )
+#endif
 
     case DXGI_FORMAT_R8G8B8A8_UINT:
         STORE_SCANLINE( XMUBYTE4, XMStoreUByte4 )
@@ -2104,6 +2376,9 @@ bool _StoreScanline( LPVOID pDestination, size_t size, DXGI_FORMAT format,
 
     case DXGI_FORMAT_B8G8R8A8_UNORM:
     case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+#ifdef TEXP_SCANLINE_SSE2
+        return _StoreScanlineUByteN4( pDestination, size, sPtr, count, true );
+#else
         if ( size >= sizeof(XMUBYTEN4) )
         {
             XMUBYTEN4 * __restrict dPtr = reinterpret_cast<XMUBYTEN4*>(pDestination);
@@ -2116,6 +2391,7 @@ bool _StoreScanline( LPVOID pDestination, size_t size, DXGI_FORMAT format,
             return true;
         }
         return false;
+#endif
 
     case DXGI_FORMAT_B8G8R8X8_UNORM:
     case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
@@ -2617,29 +2893,161 @@ HRESULT _ConvertFromR32G32B32A32( const Image* srcImages, size_t nimages, const
 
 
 //-------------------------------------------------------------------------------------
-// Convert from Linear RGB to sRGB
+// sRGB <-> Linear RGB
 //
 // if C_linear <= 0.0031308 -> C_srgb = 12.92 * C_linear
 // if C_linear >  0.0031308 -> C_srgb = ( 1 + a ) * pow( C_Linear, 1 / 2.4 ) - a
-//                             where a = 0.055
+//
+// if C_srgb <= 0.04045 -> C_linear = C_srgb / 12.92
+// if C_srgb >  0.04045 -> C_linear = pow( ( C_srgb + a ) / ( 1 + a ), 2.4 )
+//                         where a = 0.055
+//
+// Rather than calling pow per channel, 8-bit sRGB values decode through an exact
+// 256-entry table, and everything else interpolates linearly between SRGB_TABLE_SIZE+1
+// samples of the curve (the linear segments are computed directly). Against the
+// double-precision formulas the encode error is under 0.005 of an 8-bit step, worst
+// just above the 0.0031308 cutoff, and the decode error is under 1e-6
 //-------------------------------------------------------------------------------------
-#if DIRECTX_MATH_VERSION < 306
-static inline XMVECTOR XMColorRGBToSRGB( FXMVECTOR rgb )
+#define SRGB_TABLE_SIZE 4096
+
+static INIT_ONCE g_SRGBInitOnce = INIT_ONCE_STATIC_INIT;
+static float g_SRGBToLinear8[ 256 ];
+static float g_SRGBToLinear[ SRGB_TABLE_SIZE + 1 ];
+static float g_LinearToSRGB[ SRGB_TABLE_SIZE + 1 ];
+
+static double _SRGBToLinearExact( double v )
 {
-    static const XMVECTORF32 Cutoff = { 0.0031308f, 0.0031308f, 0.0031308f, 1.f };
-    static const XMVECTORF32 Linear = { 12.92f, 12.92f, 12.92f, 1.f };
-    static const XMVECTORF32 Scale = { 1.055f, 1.055f, 1.055f, 1.f };
-    static const XMVECTORF32 Bias = { 0.055f, 0.055f, 0.055f, 0.f };
-    static const XMVECTORF32 InvGamma = { 1.0f/2.4f, 1.0f/2.4f, 1.0f/2.4f, 1.f };
-
-    XMVECTOR V = XMVectorSaturate(rgb);
-    XMVECTOR V0 = XMVectorMultiply( V, Linear );
-    XMVECTOR V1 = Scale * XMVectorPow( V, InvGamma ) - Bias;
-    XMVECTOR select = XMVectorLess( V, Cutoff );
-    V = XMVectorSelect( V1, V0, select );
-    return XMVectorSelect( rgb, V, g_XMSelect1110 );
+    return ( v <= 0.04045 ) ? ( v / 12.92 ) : pow( ( v + 0.055 ) / 1.055, 2.4 );
+}
+
+static double _LinearToSRGBExact( double v )
+{
+    return ( v <= 0.0031308 ) ? ( v * 12.92 ) : ( 1.055 * pow( v, 1.0 / 2.4 ) - 0.055 );
+}
+
+static BOOL CALLBACK _SRGBInit( PINIT_ONCE, PVOID, PVOID* )
+{
+    for( size_t i = 0; i < 256; ++i )
+    {
+        g_SRGBToLinear8[ i ] = static_cast<float>( _SRGBToLinearExact( double(i) / 255.0 ) );
+    }
+
+    for( size_t i = 0; i <= SRGB_TABLE_SIZE; ++i )
+    {
+        const double v = double(i) / double(SRGB_TABLE_SIZE);
+        g_SRGBToLinear[ i ] = static_cast<float>( _SRGBToLinearExact( v ) );
+        g_LinearToSRGB[ i ] = static_cast<float>( _LinearToSRGBExact( v ) );
+    }
+
+    return TRUE;
+}
+
+static inline void _InitSRGBTables()
+{
+    // Only fails if the callback does, which it doesn't
+    InitOnceExecuteOnce( &g_SRGBInitOnce, _SRGBInit, nullptr, nullptr );
+}
+
+static inline float _LookupSRGBTable( _In_reads_(SRGB_TABLE_SIZE+1) const float* table, _In_ float v )
+{
+    const float f = v * float(SRGB_TABLE_SIZE);
+    const int i = static_cast<int>( f );
+    assert( i >= 0 && i < SRGB_TABLE_SIZE );
+    return table[ i ] + ( f - float(i) ) * ( table[ i + 1 ] - table[ i ] );
+}
+
+static inline float _SRGBToLinear( float v )
+{
+    if ( !( v > 0.f ) )
+        return 0.f;
+
+    if ( v >= 1.f )
+        return 1.f;
+
+    if ( v <= 0.04045f )
+        return v * ( 1.f / 12.92f );
+
+    return _LookupSRGBTable( g_SRGBToLinear, v );
+}
+
+static inline float _LinearToSRGB( float v )
+{
+    if ( !( v > 0.f ) )
+        return 0.f;
+
+    if ( v >= 1.f )
+        return 1.f;
+
+    if ( v <= 0.0031308f )
+        return v * 12.92f;
+
+    return _LookupSRGBTable( g_LinearToSRGB, v );
+}
+
+_Use_decl_annotations_
+void _ConvertScanlineSRGBToLinear( XMVECTOR* pBuffer, size_t count )
+{
+    assert( pBuffer && count > 0 && (((uintptr_t)pBuffer & 0xF) == 0) );
+
+    _InitSRGBTables();
+
+    XMVECTOR* __restrict ptr = pBuffer;
+    for( size_t i = 0; i < count; ++i, ++ptr )
+    {
+        XMFLOAT4A f;
+        XMStoreFloat4A( &f, *ptr );
+        f.x = _SRGBToLinear( f.x );
+        f.y = _SRGBToLinear( f.y );
+        f.z = _SRGBToLinear( f.z );
+        *ptr = XMLoadFloat4A( &f );
+    }
+}
+
+_Use_decl_annotations_
+void _ConvertScanlineLinearToSRGB( XMVECTOR* pBuffer, size_t count )
+{
+    assert( pBuffer && count > 0 && (((uintptr_t)pBuffer & 0xF) == 0) );
+
+    _InitSRGBTables();
+
+    XMVECTOR* __restrict ptr = pBuffer;
+    for( size_t i = 0; i < count; ++i, ++ptr )
+    {
+        XMFLOAT4A f;
+        XMStoreFloat4A( &f, *ptr );
+        f.x = _LinearToSRGB( f.x );
+        f.y = _LinearToSRGB( f.y );
+        f.z = _LinearToSRGB( f.z );
+        *ptr = XMLoadFloat4A( &f );
+    }
+}
+
+// Loads 8:8:8:8 sRGB pixels straight through the exact table
+static bool _LoadScanlineSRGB8( _Out_writes_(count) XMVECTOR* pDestination, _In_ size_t count,
+                                _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ DXGI_FORMAT format )
+{
+    if ( size < 4 )
+        return false;
+
+    _InitSRGBTables();
+
+    const bool bgr = ( format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB && format != DXGI_FORMAT_R8G8B8A8_UNORM );
+    const bool noalpha = ( format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8X8_UNORM );
+
+    const size_t n = std::min<size_t>( count, size / 4 );
+    const uint8_t * __restrict sPtr = reinterpret_cast<const uint8_t*>( pSource );
+    for( size_t i = 0; i < n; ++i, sPtr += 4 )
+    {
+        XMFLOAT4A f;
+        f.x = g_SRGBToLinear8[ sPtr[ bgr ? 2 : 0 ] ];
+        f.y = g_SRGBToLinear8[ sPtr[ 1 ] ];
+        f.z = g_SRGBToLinear8[ sPtr[ bgr ? 0 : 2 ] ];
+        f.w = noalpha ? 1.f : ( float( sPtr[ 3 ] ) * ( 1.f / 255.f ) );
+        pDestination[ i ] = XMLoadFloat4A( &f );
+    }
+
+    return true;
 }
-#endif
 
 _Use_decl_annotations_
 bool _StoreScanlineLinear( LPVOID pDestination, size_t size, DXGI_FORMAT format,
@@ -2693,42 +3101,13 @@ bool _StoreScanlineLinear( LPVOID pDestination, size_t size, DXGI_FORMAT format,
     {
         // To avoid the need for another temporary scanline buffer, we allow this function to overwrite the source buffer in-place
         // Given the intended usage in the filtering routines, this is not a problem.
-        XMVECTOR* ptr = pSource;
-        for( size_t i=0; i < count; ++i, ++ptr )
-        {
-            *ptr = XMColorRGBToSRGB( *ptr );
-        }
+        _ConvertScanlineLinearToSRGB( pSource, count );
     }
 
     return _StoreScanline( pDestination, size, format, pSource, count );
 }
 
 
-//-------------------------------------------------------------------------------------
-// Convert from sRGB to Linear RGB
-//
-// if C_srgb <= 0.04045 -> C_linear = C_srgb / 12.92
-// if C_srgb >  0.04045 -> C_linear = pow( ( C_srgb + a ) / ( 1 + a ), 2.4 )
-//                         where a = 0.055
-//-------------------------------------------------------------------------------------
-#if DIRECTX_MATH_VERSION < 306
-static inline XMVECTOR XMColorSRGBToRGB( FXMVECTOR srgb )
-{
-    static const XMVECTORF32 Cutoff = { 0.04045f, 0.04045f, 0.04045f, 1.f };
-    static const XMVECTORF32 ILinear = { 1.f/12.92f, 1.f/12.92f, 1.f/12.92f, 1.f };
-    static const XMVECTORF32 Scale = { 1.f/1.055f, 1.f/1.055f, 1.f/1.055f, 1.f };
-    static const XMVECTORF32 Bias = { 0.055f, 0.055f, 0.055f, 0.f };
-    static const XMVECTORF32 Gamma = { 2.4f, 2.4f, 2.4f, 1.f };
-
-    XMVECTOR V = XMVectorSaturate(srgb);
-    XMVECTOR V0 = XMVectorMultiply( V, ILinear );
-    XMVECTOR V1 = XMVectorPow( (V + Bias) * Scale, Gamma );
-    XMVECTOR select = XMVectorGreater( V, Cutoff );
-    V = XMVectorSelect( V0, V1, select );
-    return XMVectorSelect( srgb, V, g_XMSelect1110 );
-}
-#endif
-
 _Use_decl_annotations_
 bool _LoadScanlineLinear( XMVECTOR* pDestination, size_t count,
                           LPCVOID pSource, size_t size, DXGI_FORMAT format, DWORD flags )
@@ -2776,16 +3155,29 @@ bool _LoadScanlineLinear( XMVECTOR* pDestination, size_t count,
         break;
     }
 
+    if ( flags & TEX_FILTER_SRGB_IN )
+    {
+        switch( format )
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            return _LoadScanlineSRGB8( pDestination, count, pSource, size, format );
+
+        default:
+            break;
+        }
+    }
+
     if ( _LoadScanline( pDestination, count, pSource, size, format ) )
     {
         // sRGB input processing (sRGB -> Linear RGB)
         if ( flags & TEX_FILTER_SRGB_IN )
         {
-            XMVECTOR* ptr = pDestination;
-            for( size_t i=0; i < count; ++i, ++ptr )
-            {
-                *ptr = XMColorSRGBToRGB( *ptr );
-            }
+            _ConvertScanlineSRGBToLinear( pDestination, count );
         }
 
         return true;
@@ -3006,11 +3398,7 @@ void _ConvertScanline( XMVECTOR* pBuffer, size_t count, DXGI_FORMAT outFormat, D
     {
         if ( !(in->flags & CONVF_DEPTH) && ( (in->flags & CONVF_FLOAT) || (in->flags & CONVF_UNORM) ) )
         {
-            XMVECTOR* ptr = pBuffer;
-            for( size_t i=0; i < count; ++i, ++ptr )
-            {
-                *ptr = XMColorSRGBToRGB( *ptr );
-            }
+            _ConvertScanlineSRGBToLinear( pBuffer, count );
         }
     }
 
@@ -3206,11 +3594,7 @@ void _ConvertScanline( XMVECTOR* pBuffer, size_t count, DXGI_FORMAT outFormat, D
     {
         if ( !(out->flags & CONVF_DEPTH) && ( (out->flags & CONVF_FLOAT) || (out->flags & CONVF_UNORM) ) )
         {
-            XMVECTOR* ptr = pBuffer;
-            for( size_t i=0; i < count; ++i, ++ptr )
-            {
-                *ptr = XMColorRGBToSRGB( *ptr );
-            }
+            _ConvertScanlineLinearToSRGB( pBuffer, count );
         }
     }
 }
@@ -3900,6 +4284,31 @@ static inline bool _UseWICConversion( _In_ DWORD filter, _In_ DXGI_FORMAT sforma
 }
 
 
+//-------------------------------------------------------------------------------------
+// Premultiplies a scanline Convert has just stored (TEX_FILTER_PREMULTIPLY_ALPHA)
+//   The row is read back from the target format while it is still in cache, so the result
+//   matches PremultiplyAlpha (with the same sRGB flags) run on the converted image exactly
+//-------------------------------------------------------------------------------------
+static bool _PremultiplyStoredScanline( _Out_writes_(destImage.width) XMVECTOR* pBuffer, _Inout_ uint8_t* pDest, _In_ const Image& destImage,
+                                        _In_ DWORD filter )
+{
+    const DWORD flags = filter & TEX_FILTER_SRGB;
+
+    if ( !_LoadScanlineLinear( pBuffer, destImage.width, pDest, destImage.rowPitch, destImage.format, flags ) )
+        return false;
+
+    XMVECTOR* ptr = pBuffer;
+    for( size_t i=0; i < destImage.width; ++i )
+    {
+        XMVECTOR v = *ptr;
+        XMVECTOR alpha = XMVectorMultiply( v, XMVectorSplatW( v ) );
+        *ptr++ = XMVectorSelect( v, alpha, g_XMSelect1110 );
+    }
+
+    return _StoreScanlineLinear( pDest, destImage.rowPitch, destImage.format, pBuffer, destImage.width, flags );
+}
+
+
 //-------------------------------------------------------------------------------------
 // Convert the source image using WIC
 //-------------------------------------------------------------------------------------
@@ -3945,36 +4354,59 @@ static HRESULT _ConvertUsingWIC( _In_ const Image& srcImage, _In_ const WICPixel
     if ( FAILED(hr) )
         return hr;
 
+    if ( filter & TEX_FILTER_PREMULTIPLY_ALPHA )
+    {
+        // WIC can't premultiply, so it is a second pass over the converted rows
+        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR)*destImage.width ) ) );
+        if ( !scanline )
+            return E_OUTOFMEMORY;
+
+        uint8_t* pDest = destImage.pixels;
+        for( size_t h = 0; h < destImage.height; ++h, pDest += destImage.rowPitch )
+        {
+            if ( !_PremultiplyStoredScanline( scanline.get(), pDest, destImage, filter ) )
+                return E_FAIL;
+        }
+    }
+
     return S_OK;
 }
 
 
 //-------------------------------------------------------------------------------------
 // Convert the source image (not using WIC)
+//   Rows [y0,y1) are converted; error diffusion carries state between rows so it must be given the whole image
 //-------------------------------------------------------------------------------------
-static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ float threshold, _In_ size_t z )
+static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ float threshold, _In_ size_t z,
+                         _In_ size_t y0, _In_ size_t y1 )
 {
     assert( srcImage.width == destImage.width );
     assert( srcImage.height == destImage.height );
+    assert( y0 < y1 && y1 <= srcImage.height );
 
     const uint8_t *pSrc = srcImage.pixels;
     uint8_t *pDest = destImage.pixels;
     if ( !pSrc || !pDest )
         return E_POINTER;
 
+    pSrc += y0 * srcImage.rowPitch;
+    pDest += y0 * destImage.rowPitch;
+
     size_t width = srcImage.width;
 
     if ( filter & TEX_FILTER_DITHER_DIFFUSION )
     {
         // Error diffusion dithering (aka Floyd-Steinberg dithering)
-        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*(width*2 + 2)), 16 ) ) );
+        assert( y0 == 0 && y1 == srcImage.height );
+
+        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*(width*2 + 2)) ) ) );
         if ( !scanline )
             return E_OUTOFMEMORY;
 
         XMVECTOR* pDiffusionErrors = scanline.get() + width;
         memset( pDiffusionErrors, 0, sizeof(XMVECTOR)*(width+2) );
 
-        for( size_t h = 0; h < srcImage.height; ++h )
+        for( size_t h = y0; h < y1; ++h )
         {
             if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
                 return E_FAIL;
@@ -3984,20 +4416,23 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
             if ( !_StoreScanlineDither( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold, h, z, pDiffusionErrors ) )
                 return E_FAIL;
 
+            if ( ( filter & TEX_FILTER_PREMULTIPLY_ALPHA ) && !_PremultiplyStoredScanline( scanline.get(), pDest, destImage, filter ) )
+                return E_FAIL;
+
             pSrc += srcImage.rowPitch;
             pDest += destImage.rowPitch;
         }
     }
     else
     {
-        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width), 16 ) ) );
+        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width) ) ) );
         if ( !scanline )
             return E_OUTOFMEMORY;
 
         if ( filter & TEX_FILTER_DITHER )
         {
             // Ordered dithering
-            for( size_t h = 0; h < srcImage.height; ++h )
+            for( size_t h = y0; h < y1; ++h )
             {
                 if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
                     return E_FAIL;
@@ -4007,6 +4442,9 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
                 if ( !_StoreScanlineDither( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold, h, z, nullptr ) )
                     return E_FAIL;
 
+                if ( ( filter & TEX_FILTER_PREMULTIPLY_ALPHA ) && !_PremultiplyStoredScanline( scanline.get(), pDest, destImage, filter ) )
+                    return E_FAIL;
+
                 pSrc += srcImage.rowPitch;
                 pDest += destImage.rowPitch;
             }
@@ -4014,7 +4452,7 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
         else
         {
             // No dithering
-            for( size_t h = 0; h < srcImage.height; ++h )
+            for( size_t h = y0; h < y1; ++h )
             {
                 if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
                     return E_FAIL;
@@ -4024,6 +4462,9 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
                 if ( !_StoreScanline( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold ) )
                     return E_FAIL;
 
+                if ( ( filter & TEX_FILTER_PREMULTIPLY_ALPHA ) && !_PremultiplyStoredScanline( scanline.get(), pDest, destImage, filter ) )
+                    return E_FAIL;
+
                 pSrc += srcImage.rowPitch;
                 pDest += destImage.rowPitch;
             }
@@ -4034,6 +4475,239 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
 }
 
 
+//-------------------------------------------------------------------------------------
+// Pipelined error diffusion for large images (TEX_FILTER_PARALLEL)
+//   Floyd-Steinberg is serpentine, so a row can't start until the one above it is done
+//   (the right-to-left rows begin where the left-to-right rows end). Instead the rows are
+//   loaded and converted to float in parallel a chunk ahead of the serial diffusion pass,
+//   which still runs every row in order with the same arithmetic as _Convert.
+//-------------------------------------------------------------------------------------
+#define DIFFUSION_CHUNK_ROWS 32
+#define DIFFUSION_BAND_ROWS 4
+#define DIFFUSION_PIPELINE_PIXELS (256 * 256)
+
+struct DiffusionTask
+{
+    const Image*    srcImage;
+    const Image*    destImage;
+    DWORD           filter;
+    float           threshold;
+    size_t          z;
+    XMVECTOR*       rows[2];
+    XMVECTOR*       pDiffusionErrors;
+    size_t          loadChunk;
+    size_t          ditherChunk;
+};
+
+static HRESULT _Diffusion_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const DiffusionTask* task = reinterpret_cast<const DiffusionTask*>( pContext );
+    assert( task );
+
+    const Image& srcImage = *task->srcImage;
+    const Image& destImage = *task->destImage;
+    const size_t width = srcImage.width;
+
+    if ( !item )
+    {
+        // Item 0 is the serial diffusion pass over the chunk loaded by the previous step
+        if ( task->ditherChunk == size_t(-1) )
+            return S_OK;
+
+        const size_t y0 = task->ditherChunk * DIFFUSION_CHUNK_ROWS;
+        const size_t y1 = std::min<size_t>( y0 + DIFFUSION_CHUNK_ROWS, srcImage.height );
+
+        XMVECTOR* scanline = task->rows[ task->ditherChunk & 1 ];
+        uint8_t* pDest = destImage.pixels + y0 * destImage.rowPitch;
+
+        for( size_t h = y0; h < y1; ++h )
+        {
+            if ( !_StoreScanlineDither( pDest, destImage.rowPitch, destImage.format, scanline, width, task->threshold, h, task->z, task->pDiffusionErrors ) )
+                return E_FAIL;
+
+            if ( ( task->filter & TEX_FILTER_PREMULTIPLY_ALPHA ) && !_PremultiplyStoredScanline( scanline, pDest, destImage, task->filter ) )
+                return E_FAIL;
+
+            scanline += width;
+            pDest += destImage.rowPitch;
+        }
+
+        return S_OK;
+    }
+
+    // The remaining items load and convert a band of the next chunk
+    assert( task->loadChunk != size_t(-1) );
+
+    const size_t y0 = task->loadChunk * DIFFUSION_CHUNK_ROWS + ( item - 1 ) * DIFFUSION_BAND_ROWS;
+    const size_t y1 = std::min<size_t>( std::min<size_t>( y0 + DIFFUSION_BAND_ROWS, ( task->loadChunk + 1 ) * DIFFUSION_CHUNK_ROWS ), srcImage.height );
+
+    XMVECTOR* scanline = task->rows[ task->loadChunk & 1 ] + ( y0 - task->loadChunk * DIFFUSION_CHUNK_ROWS ) * width;
+    const uint8_t* pSrc = srcImage.pixels + y0 * srcImage.rowPitch;
+
+    for( size_t h = y0; h < y1; ++h )
+    {
+        if ( !_LoadScanline( scanline, width, pSrc, srcImage.rowPitch, srcImage.format ) )
+            return E_FAIL;
+
+        _ConvertScanline( scanline, width, destImage.format, srcImage.format, task->filter );
+
+        scanline += width;
+        pSrc += srcImage.rowPitch;
+    }
+
+    return S_OK;
+}
+
+static HRESULT _ConvertDiffusionPipelined( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ float threshold, _In_ size_t z )
+{
+    assert( srcImage.width == destImage.width );
+    assert( srcImage.height == destImage.height );
+
+    if ( !srcImage.pixels || !destImage.pixels )
+        return E_POINTER;
+
+    const size_t width = srcImage.width;
+    const size_t chunkSize = width * DIFFUSION_CHUNK_ROWS;
+
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*(chunkSize*2 + width + 2)) ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
+
+    DiffusionTask task;
+    task.srcImage = &srcImage;
+    task.destImage = &destImage;
+    task.filter = filter;
+    task.threshold = threshold;
+    task.z = z;
+    task.rows[0] = scanline.get();
+    task.rows[1] = scanline.get() + chunkSize;
+    task.pDiffusionErrors = scanline.get() + chunkSize*2;
+    memset( task.pDiffusionErrors, 0, sizeof(XMVECTOR)*(width+2) );
+
+    const size_t nchunks = ( srcImage.height + DIFFUSION_CHUNK_ROWS - 1 ) / DIFFUSION_CHUNK_ROWS;
+
+    // Step n loads chunk n while chunk n-1 is diffused, each one into its own half of the buffer
+    for( size_t step = 0; step <= nchunks; ++step )
+    {
+        size_t nitems = 1;
+        task.ditherChunk = ( step > 0 ) ? ( step - 1 ) : size_t(-1);
+        task.loadChunk = size_t(-1);
+
+        if ( step < nchunks )
+        {
+            task.loadChunk = step;
+
+            const size_t rows = std::min<size_t>( DIFFUSION_CHUNK_ROWS, srcImage.height - step * DIFFUSION_CHUNK_ROWS );
+            nitems += ( rows + DIFFUSION_BAND_ROWS - 1 ) / DIFFUSION_BAND_ROWS;
+        }
+
+        HRESULT hr = _RunTasks( nitems, true, _Diffusion_Task, &task );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Converts a band of rows from one image per work item (TEX_FILTER_PARALLEL)
+//   Error diffusion dithering can't be split, so those images are a single item each
+//   (large ones are pipelined separately by _ConvertDiffusionPipelined)
+//-------------------------------------------------------------------------------------
+#define CONVERT_TASK_ROWS 16
+
+struct ConvertTask
+{
+    const Image*        srcImages;
+    const Image*        destImages;
+    const TexMetadata*  metadata;
+    DWORD               filter;
+    float               threshold;
+    std::vector<size_t> offsets;
+};
+
+static size_t _ConvertSliceZ( _In_opt_ const TexMetadata* metadata, _In_ size_t index )
+{
+    // Volume slices need their z for ordered dithering
+    size_t z = 0;
+    if ( metadata && metadata->dimension == TEX_DIMENSION_TEXTURE3D )
+    {
+        size_t d = metadata->depth;
+        for( z = index; z >= d; )
+        {
+            z -= d;
+            if ( d > 1 )
+                d >>= 1;
+        }
+    }
+
+    return z;
+}
+
+static HRESULT _Convert_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const ConvertTask* task = reinterpret_cast<const ConvertTask*>( pContext );
+    assert( task );
+
+    size_t index = _FindTaskImage( task->offsets, item );
+    const Image& src = task->srcImages[ index ];
+
+    size_t y0 = 0;
+    size_t y1 = src.height;
+    if ( !( task->filter & TEX_FILTER_DITHER_DIFFUSION ) )
+    {
+        y0 = ( item - task->offsets[ index ] ) * CONVERT_TASK_ROWS;
+        y1 = std::min<size_t>( y0 + CONVERT_TASK_ROWS, src.height );
+    }
+    else if ( src.width * src.height >= DIFFUSION_PIPELINE_PIXELS )
+    {
+        // Already done by _ConvertDiffusionPipelined
+        return S_OK;
+    }
+
+    return _Convert( src, task->filter, task->destImages[ index ], task->threshold, _ConvertSliceZ( task->metadata, index ), y0, y1 );
+}
+
+static HRESULT _ConvertParallel( _In_reads_(nimages) const Image* srcImages, _In_reads_(nimages) const Image* destImages, _In_ size_t nimages,
+                                 _In_opt_ const TexMetadata* metadata, _In_ DWORD filter, _In_ float threshold )
+{
+    ConvertTask task;
+    task.srcImages = srcImages;
+    task.destImages = destImages;
+    task.metadata = metadata;
+    task.filter = filter;
+    task.threshold = threshold;
+
+    task.offsets.reserve( nimages + 1 );
+    task.offsets.push_back( 0 );
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        const size_t height = srcImages[ index ].height;
+        const size_t nitems = ( filter & TEX_FILTER_DITHER_DIFFUSION ) ? 1 : ( ( height + CONVERT_TASK_ROWS - 1 ) / CONVERT_TASK_ROWS );
+        task.offsets.push_back( task.offsets.back() + nitems );
+    }
+
+    if ( filter & TEX_FILTER_DITHER_DIFFUSION )
+    {
+        // Large images are pipelined one at a time, then the rest run an image per item
+        for( size_t index = 0; index < nimages; ++index )
+        {
+            const Image& src = srcImages[ index ];
+            if ( src.width * src.height < DIFFUSION_PIPELINE_PIXELS )
+                continue;
+
+            HRESULT hr = _ConvertDiffusionPipelined( src, filter, destImages[ index ], threshold, _ConvertSliceZ( metadata, index ) );
+            if ( FAILED(hr) )
+                return hr;
+        }
+    }
+
+    return _RunTasks( task.offsets.back(), true, _Convert_Task, &task );
+}
+
+
 //-------------------------------------------------------------------------------------
 static DXGI_FORMAT _PlanarToSingle( _In_ DXGI_FORMAT format )
 {
@@ -4206,6 +4880,9 @@ HRESULT Convert( const Image& srcImage, DXGI_FORMAT format, DWORD filter, float
          || IsTypeless(srcImage.format) || IsTypeless(format) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
+    if ( ( filter & TEX_FILTER_PREMULTIPLY_ALPHA ) && !HasAlpha(format) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
 #ifdef _M_X64
     if ( (srcImage.width > 0xFFFFFFFF) || (srcImage.height > 0xFFFFFFFF) )
         return E_INVALIDARG;
@@ -4227,9 +4904,13 @@ HRESULT Convert( const Image& srcImage, DXGI_FORMAT format, DWORD filter, float
     {
         hr = _ConvertUsingWIC( srcImage, pfGUID, targetGUID, filter, threshold, *rimage );
     }
+    else if ( filter & TEX_FILTER_PARALLEL )
+    {
+        hr = _ConvertParallel( &srcImage, rimage, 1, nullptr, filter, threshold );
+    }
     else
     {
-        hr = _Convert( srcImage, filter, *rimage, threshold, 0 );
+        hr = _Convert( srcImage, filter, *rimage, threshold, 0, 0, srcImage.height );
     }
 
     if ( FAILED(hr) )
@@ -4265,6 +4946,21 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
 
     TexMetadata mdata2 = metadata;
     mdata2.format = format;
+
+    if ( filter & TEX_FILTER_PREMULTIPLY_ALPHA )
+    {
+        if ( !HasAlpha(format) )
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+        if ( metadata.IsPMAlpha() )
+        {
+            // Already premultiplied
+            return E_FAIL;
+        }
+
+        mdata2.SetAlphaMode(TEX_ALPHA_MODE_PREMULTIPLIED);
+    }
+
     HRESULT hr = result.Initialize( mdata2 );
     if ( FAILED(hr) )
         return hr;
@@ -4285,6 +4981,9 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
     WICPixelFormatGUID pfGUID, targetGUID;
     bool usewic = _UseWICConversion( filter, metadata.format, format, pfGUID, targetGUID );
 
+    // When parallel, the images are only validated here and then converted together as one batch of work
+    const bool parallel = ( filter & TEX_FILTER_PARALLEL ) && !usewic;
+
     switch (metadata.dimension)
     {
     case TEX_DIMENSION_TEXTURE1D:
@@ -4312,13 +5011,16 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
                 return E_FAIL;
             }
 
+            if ( parallel )
+                continue;
+
             if ( usewic )
             {
                 hr = _ConvertUsingWIC( src, pfGUID, targetGUID, filter, threshold, dst );
             }
             else
             {
-                hr = _Convert( src, filter, dst, threshold, 0 );
+                hr = _Convert( src, filter, dst, threshold, 0, 0, src.height );
             }
 
             if ( FAILED(hr) )
@@ -4361,13 +5063,16 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
                         return E_FAIL;
                     }
 
+                    if ( parallel )
+                        continue;
+
                     if ( usewic )
                     {
                         hr = _ConvertUsingWIC( src, pfGUID, targetGUID, filter, threshold, dst );
                     }
                     else
                     {
-                        hr = _Convert( src, filter, dst, threshold, slice );
+                        hr = _Convert( src, filter, dst, threshold, slice, 0, src.height );
                     }
 
                     if ( FAILED(hr) )
@@ -4387,6 +5092,16 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
         return E_FAIL;
     }
 
+    if ( parallel )
+    {
+        hr = _ConvertParallel( srcImages, dest, nimages, &metadata, filter, threshold );
+        if ( FAILED(hr) )
+        {
+            result.Release();
+            return hr;
+        }
+    }
+
     return S_OK;
 }
 
@@ -1019,17 +1019,10 @@ static bool _LegacyExpandScanline( _Out_writes_bytes_(outSize) LPVOID pDestinati
 
 
 //-------------------------------------------------------------------------------------
-// Converts or copies image data from pPixels into scratch image data
+// Pitch flags describing the pixel data as stored in the file
 //-------------------------------------------------------------------------------------
-static HRESULT _CopyImage( _In_reads_bytes_(size) const void* pPixels, _In_ size_t size, 
-                           _In_ const TexMetadata& metadata, _In_ DWORD cpFlags, _In_ DWORD convFlags, _In_reads_opt_(256) const uint32_t *pal8, _In_ const ScratchImage& image )
+inline static DWORD _FilePitchFlags( DWORD cpFlags, DWORD convFlags )
 {
-    assert( pPixels );
-    assert( image.GetPixels() );
-
-    if ( !size )
-        return E_FAIL;
-     
     if ( convFlags & CONV_FLAGS_EXPAND )
     {
         if ( convFlags & CONV_FLAGS_888 )
@@ -1040,6 +1033,106 @@ static HRESULT _CopyImage( _In_reads_bytes_(size) const void* pPixels, _In_ size
             cpFlags |= CP_FLAGS_8BPP;
     }
 
+    return cpFlags;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Converts or copies one sub-resource from file layout into a scratch image
+//-------------------------------------------------------------------------------------
+static HRESULT _CopySubresource( _In_ const Image& src, _In_ const Image& dst, _In_ DXGI_FORMAT format, _In_ DWORD convFlags,
+                                 _In_reads_opt_(256) const uint32_t *pal8, _In_ DWORD tflags )
+{
+    if ( dst.height != src.height )
+        return E_FAIL;
+
+    size_t dpitch = dst.rowPitch;
+    size_t spitch = src.rowPitch;
+
+    const uint8_t *pSrc = const_cast<const uint8_t*>( src.pixels );
+    if ( !pSrc )
+        return E_POINTER;
+
+    uint8_t *pDest = dst.pixels;
+    if ( !pDest )
+        return E_POINTER;
+
+    if ( IsCompressed( format ) )
+    {
+        size_t csize = std::min<size_t>( dst.slicePitch, src.slicePitch );
+        memcpy_s( pDest, dst.slicePitch, pSrc, csize );
+    }
+    else if ( IsPlanar( format ) )
+    {
+        size_t count = ComputeScanlines( format, dst.height );
+        if ( !count )
+            return E_UNEXPECTED;
+
+        size_t csize = std::min<size_t>( dpitch, spitch );
+        for( size_t h = 0; h < count; ++h )
+        {
+            memcpy_s( pDest, dpitch, pSrc, csize );
+            pSrc += spitch;
+            pDest += dpitch;
+        }
+    }
+    else
+    {
+        for( size_t h = 0; h < dst.height; ++h )
+        {
+            if ( convFlags & CONV_FLAGS_EXPAND )
+            {
+                if ( convFlags & (CONV_FLAGS_565|CONV_FLAGS_5551|CONV_FLAGS_4444) )
+                {
+                    if ( !_ExpandScanline( pDest, dpitch, DXGI_FORMAT_R8G8B8A8_UNORM,
+                                           pSrc, spitch,
+                                           (convFlags & CONV_FLAGS_565) ? DXGI_FORMAT_B5G6R5_UNORM : DXGI_FORMAT_B5G5R5A1_UNORM,
+                                           tflags ) )
+                        return E_FAIL;
+                }
+                else
+                {
+                    TEXP_LEGACY_FORMAT lformat = _FindLegacyFormat( convFlags );
+                    if ( !_LegacyExpandScanline( pDest, dpitch, format,
+                                                 pSrc, spitch, lformat, pal8,
+                                                 tflags ) )
+                        return E_FAIL;
+                }
+            }
+            else if ( convFlags & CONV_FLAGS_SWIZZLE )
+            {
+                _SwizzleScanline( pDest, dpitch, pSrc, spitch,
+                                  format, tflags );
+            }
+            else
+            {
+                _CopyScanline( pDest, dpitch, pSrc, spitch,
+                               format, tflags );
+            }
+
+            pSrc += spitch;
+            pDest += dpitch;
+        }
+    }
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Converts or copies image data from pPixels into scratch image data
+//-------------------------------------------------------------------------------------
+static HRESULT _CopyImage( _In_reads_bytes_(size) const void* pPixels, _In_ size_t size, 
+                           _In_ const TexMetadata& metadata, _In_ DWORD cpFlags, _In_ DWORD convFlags, _In_reads_opt_(256) const uint32_t *pal8, _In_ const ScratchImage& image )
+{
+    assert( pPixels );
+    assert( image.GetPixels() );
+
+    if ( !size )
+        return E_FAIL;
+
+    cpFlags = _FilePitchFlags( cpFlags, convFlags );
+
     size_t pixelSize, nimages;
     _DetermineImageArray( metadata, cpFlags, nimages, pixelSize );
     if ( (nimages == 0) || (nimages != image.GetImageCount()) )
@@ -1088,77 +1181,9 @@ static HRESULT _CopyImage( _In_reads_bytes_(size) const void* pPixels, _In_ size
                     if ( index >= nimages )
                         return E_FAIL;
 
-                    if ( images[ index ].height != timages[ index ].height )
-                        return E_FAIL;
-
-                    size_t dpitch = images[ index ].rowPitch;
-                    size_t spitch = timages[ index ].rowPitch;
-
-                    const uint8_t *pSrc = const_cast<const uint8_t*>( timages[ index ].pixels );
-                    if ( !pSrc )
-                        return E_POINTER;
-
-                    uint8_t *pDest = images[ index ].pixels;
-                    if ( !pDest )
-                        return E_POINTER;
-
-                    if ( IsCompressed( metadata.format ) )
-                    {
-                        size_t csize = std::min<size_t>( images[ index ].slicePitch, timages[ index ].slicePitch );
-                        memcpy_s( pDest, images[ index ].slicePitch, pSrc, csize );
-                    }
-                    else if ( IsPlanar( metadata.format ) )
-                    {
-                        size_t count = ComputeScanlines( metadata.format, images[ index ].height );
-                        if ( !count )
-                            return E_UNEXPECTED;
-
-                        size_t csize = std::min<size_t>( dpitch, spitch );
-                        for( size_t h = 0; h < count; ++h )
-                        {
-                            memcpy_s( pDest, dpitch, pSrc, csize );
-                            pSrc += spitch;
-                            pDest += dpitch;
-                        }
-                    }
-                    else
-                    {
-                        for( size_t h = 0; h < images[ index ].height; ++h )
-                        {
-                            if ( convFlags & CONV_FLAGS_EXPAND )
-                            {
-                                if ( convFlags & (CONV_FLAGS_565|CONV_FLAGS_5551|CONV_FLAGS_4444) )
-                                {
-                                    if ( !_ExpandScanline( pDest, dpitch, DXGI_FORMAT_R8G8B8A8_UNORM,
-                                                           pSrc, spitch,
-                                                           (convFlags & CONV_FLAGS_565) ? DXGI_FORMAT_B5G6R5_UNORM : DXGI_FORMAT_B5G5R5A1_UNORM,
-                                                           tflags ) )
-                                        return E_FAIL;
-                                }
-                                else
-                                {
-                                    TEXP_LEGACY_FORMAT lformat = _FindLegacyFormat( convFlags );
-                                    if ( !_LegacyExpandScanline( pDest, dpitch, metadata.format,
-                                                                 pSrc, spitch, lformat, pal8,
-                                                                 tflags ) )
-                                        return E_FAIL;
-                                }
-                            }
-                            else if ( convFlags & CONV_FLAGS_SWIZZLE )
-                            {
-                                _SwizzleScanline( pDest, dpitch, pSrc, spitch,
-                                                  metadata.format, tflags );
-                            }
-                            else
-                            {
-                                _CopyScanline( pDest, dpitch, pSrc, spitch,
-                                               metadata.format, tflags );
-                            }
-
-                            pSrc += spitch;
-                            pDest += dpitch;
-                        }
-                    }
+                    HRESULT hr = _CopySubresource( timages[ index ], images[ index ], metadata.format, convFlags, pal8, tflags );
+                    if ( FAILED(hr) )
+                        return hr;
                 }
             }
         }
@@ -1166,6 +1191,12 @@ static HRESULT _CopyImage( _In_reads_bytes_(size) const void* pPixels, _In_ size
 
     case TEX_DIMENSION_TEXTURE3D:
         {
+            if ( IsPlanar( metadata.format ) )
+            {
+                // Direct3D does not support any planar formats for Texture3D
+                return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+            }
+
             size_t index = 0;
             size_t d = metadata.depth;
 
@@ -1176,66 +1207,9 @@ static HRESULT _CopyImage( _In_reads_bytes_(size) const void* pPixels, _In_ size
                     if ( index >= nimages )
                         return E_FAIL;
 
-                    if ( images[ index ].height != timages[ index ].height )
-                        return E_FAIL;
-
-                    size_t dpitch = images[ index ].rowPitch;
-                    size_t spitch = timages[ index ].rowPitch;
-
-                    const uint8_t *pSrc = const_cast<const uint8_t*>( timages[ index ].pixels );
-                    if ( !pSrc )
-                        return E_POINTER;
-
-                    uint8_t *pDest = images[ index ].pixels;
-                    if ( !pDest )
-                        return E_POINTER;
-
-                    if ( IsCompressed( metadata.format ) )
-                    {
-                        size_t csize = std::min<size_t>( images[ index ].slicePitch, timages[ index ].slicePitch );
-                        memcpy_s( pDest, images[ index ].slicePitch, pSrc, csize );
-                    }
-                    else if ( IsPlanar( metadata.format ) )
-                    {
-                        // Direct3D does not support any planar formats for Texture3D
-                        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
-                    }
-                    else
-                    {
-                        for( size_t h = 0; h < images[ index ].height; ++h )
-                        {
-                            if ( convFlags & CONV_FLAGS_EXPAND )
-                            {
-                                if ( convFlags & (CONV_FLAGS_565|CONV_FLAGS_5551|CONV_FLAGS_4444) )
-                                {
-                                    if ( !_ExpandScanline( pDest, dpitch, DXGI_FORMAT_R8G8B8A8_UNORM,
-                                                           pSrc, spitch,
-                                                           (convFlags & CONV_FLAGS_565) ? DXGI_FORMAT_B5G6R5_UNORM : DXGI_FORMAT_B5G5R5A1_UNORM,
-                                                           tflags ) )
-                                        return E_FAIL;
-                                }
-                                else
-                                {
-                                    TEXP_LEGACY_FORMAT lformat = _FindLegacyFormat( convFlags );
-                                    if ( !_LegacyExpandScanline( pDest, dpitch, metadata.format,
-                                                                 pSrc, spitch, lformat, pal8,
-                                                                 tflags ) )
-                                        return E_FAIL;
-                                }
-                            }
-                            else if ( convFlags & CONV_FLAGS_SWIZZLE )
-                            {
-                                _SwizzleScanline( pDest, dpitch, pSrc, spitch, metadata.format, tflags );
-                            }
-                            else
-                            {
-                                _CopyScanline( pDest, dpitch, pSrc, spitch, metadata.format, tflags );
-                            }
-
-                            pSrc += spitch;
-                            pDest += dpitch;
-                        }
-                    }
+                    HRESULT hr = _CopySubresource( timages[ index ], images[ index ], metadata.format, convFlags, pal8, tflags );
+                    if ( FAILED(hr) )
+                        return hr;
                 }
 
                 if ( d > 1 )
@@ -1297,123 +1271,446 @@ static HRESULT _CopyImageInPlace( DWORD convFlags, _In_ const ScratchImage& imag
 }
 
 
-//=====================================================================================
-// Entry-points
-//=====================================================================================
-
 //-------------------------------------------------------------------------------------
-// Obtain metadata from DDS file in memory/on disk
+// DDS file writer
+//   The file offset of every sub-resource follows from the header and the DDS pitches,
+//   so the whole payload is cut into large chunks before anything is written. Chunks
+//   whose rows need re-pitching are packed into staging buffers (on worker threads with
+//   DDS_FLAGS_PARALLEL) while the previous batch of overlapped writes is still in flight.
+//   Images that already have the DDS layout are written straight from their pixels.
+//
+//   NTFS completes any write past the valid data length synchronously, so the file is
+//   sized up front and, when the caller holds SE_MANAGE_VOLUME_NAME, its valid data length
+//   is set as well. Without that privilege the writes still extend the valid data length
+//   one after the other and only the packing of each batch runs alongside them
 //-------------------------------------------------------------------------------------
+#define DDS_WRITE_CHUNK     ( 4 * 1024 * 1024 )
+#define DDS_WRITE_BATCH     8
 
-_Use_decl_annotations_
-HRESULT GetMetadataFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadata& metadata )
+struct DDSWriteItem
 {
-    if ( !pSource || size == 0 )
-        return E_INVALIDARG;
+    const Image*    image;
+    uint64_t        offset;         // File offset of the first scanline
+    size_t          ddsRowPitch;
+    size_t          size;
+};
 
-    DWORD convFlags = 0;
-    return _DecodeDDSHeader( pSource, size, flags, metadata, convFlags );
-}
+struct DDSWriteChunk
+{
+    uint64_t        offset;
+    size_t          size;
+    const uint8_t*  pixels;         // Written directly if set, otherwise packed into a staging buffer
+};
 
-_Use_decl_annotations_
-HRESULT GetMetadataFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata& metadata )
+struct DDSPackTask
 {
-    if ( !szFile )
-        return E_INVALIDARG;
+    const uint8_t*                      header;
+    size_t                              headerSize;
+    const std::vector<DDSWriteItem>*    items;
+    const DDSWriteChunk*                chunks;         // First chunk of the batch
+    uint8_t*                            staging;        // Staging buffer for the first chunk of the batch
+    size_t                              stagingSize;
+};
 
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-    ScopedHandle hFile( safe_handle( CreateFile2( szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, 0 ) ) );
-#else
-    ScopedHandle hFile( safe_handle( CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
-                                                  FILE_FLAG_SEQUENTIAL_SCAN, 0 ) ) );
-#endif
-    if ( !hFile )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
+static HRESULT _AddDDSWriteItem( _In_ const Image& image, _In_ DXGI_FORMAT format, _Inout_ uint64_t& offset, _Inout_ std::vector<DDSWriteItem>& items )
+{
+    if ( !image.pixels )
+        return E_POINTER;
 
-    // Get the file size
-    LARGE_INTEGER fileSize = {0};
+    if ( image.format != format )
+        return E_FAIL;
 
-#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
-    FILE_STANDARD_INFO fileInfo;
-    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
-    fileSize = fileInfo.EndOfFile;
-#else
-    if ( !GetFileSizeEx( hFile.get(), &fileSize ) )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
-#endif
+    assert( image.rowPitch > 0 );
+    assert( image.slicePitch > 0 );
 
-    // File is too big for 32-bit allocation, so reject read (4 GB should be plenty large enough for a valid DDS file)
-    if ( fileSize.HighPart > 0 )
-    {
-        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
-    }
+    size_t ddsRowPitch, ddsSlicePitch;
+    ComputePitch( format, image.width, image.height, ddsRowPitch, ddsSlicePitch, CP_FLAGS_NONE );
 
-    // Need at least enough data to fill the standard header and magic number to be a valid DDS
-    if ( fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    if ( image.slicePitch != ddsSlicePitch )
     {
-        return E_FAIL;
+        if ( image.rowPitch < ddsRowPitch )
+        {
+            // DDS uses 1-byte alignment, so if this is happening then the input pitch isn't actually a full line of data
+            return E_FAIL;
+        }
+
+        assert( ComputeScanlines( format, image.height ) * ddsRowPitch == ddsSlicePitch );
     }
 
-    // Read the header in (including extended header if present)
-    const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
-    uint8_t header[MAX_HEADER_SIZE];
+    DDSWriteItem item;
+    item.image = &image;
+    item.offset = offset;
+    item.ddsRowPitch = ddsRowPitch;
+    item.size = ddsSlicePitch;
+    items.push_back( item );
 
-    DWORD bytesRead = 0;
-    if ( !ReadFile( hFile.get(), header, MAX_HEADER_SIZE, &bytesRead, 0 ) )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
+    offset += ddsSlicePitch;
 
-    DWORD convFlags = 0;
-    return _DecodeDDSHeader( header, bytesRead, flags, metadata, convFlags );
+    return S_OK;
 }
 
-
-//-------------------------------------------------------------------------------------
-// Load a DDS file in memory
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-HRESULT LoadFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadata* metadata, ScratchImage& image )
+static HRESULT _ComputeDDSWriteItems( _In_reads_(nimages) const Image* images, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+                                      _In_ size_t headerSize, _Out_ std::vector<DDSWriteItem>& items )
 {
-    if ( !pSource || size == 0 )
-        return E_INVALIDARG;
+    items.clear();
+    items.reserve( nimages );
 
-    image.Release();
+    uint64_t offset = headerSize;
 
-    DWORD convFlags = 0;
-    TexMetadata mdata;
-    HRESULT hr = _DecodeDDSHeader( pSource, size, flags, mdata, convFlags );  
-    if ( FAILED(hr) )
-        return hr;
+    switch( metadata.dimension )
+    {
+    case DDS_DIMENSION_TEXTURE1D:
+    case DDS_DIMENSION_TEXTURE2D:
+        {
+            size_t index = 0;
+            for( size_t item = 0; item < metadata.arraySize; ++item )
+            {
+                for( size_t level = 0; level < metadata.mipLevels; ++level, ++index )
+                {
+                    if ( index >= nimages )
+                        return E_FAIL;
 
-    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
-    if ( convFlags & CONV_FLAGS_DX10 )
-        offset += sizeof(DDS_HEADER_DXT10);
+                    HRESULT hr = _AddDDSWriteItem( images[ index ], metadata.format, offset, items );
+                    if ( FAILED(hr) )
+                        return hr;
+                }
+            }
+        }
+        break;
 
-    assert( offset <= size );
+    case DDS_DIMENSION_TEXTURE3D:
+        {
+            if ( metadata.arraySize != 1 )
+                return E_FAIL;
 
-    const uint32_t *pal8 = nullptr;
-    if ( convFlags & CONV_FLAGS_PAL8 )
-    {
-        pal8 = reinterpret_cast<const uint32_t*>( reinterpret_cast<const uint8_t*>(pSource) + offset );
-        assert( pal8 );
-        offset += ( 256 * sizeof(uint32_t) );
-        if ( size < offset )
-            return E_FAIL;
+            size_t d = metadata.depth;
+
+            size_t index = 0;
+            for( size_t level = 0; level < metadata.mipLevels; ++level )
+            {
+                for( size_t slice = 0; slice < d; ++slice, ++index )
+                {
+                    if ( index >= nimages )
+                        return E_FAIL;
+
+                    HRESULT hr = _AddDDSWriteItem( images[ index ], metadata.format, offset, items );
+                    if ( FAILED(hr) )
+                        return hr;
+                }
+
+                if ( d > 1 )
+                    d >>= 1;
+            }
+        }
+        break;
+
+    default:
+        return E_FAIL;
     }
 
-    hr = image.Initialize( mdata );
-    if ( FAILED(hr) )
-        return hr;
+    return S_OK;
+}
 
-    auto pPixels = reinterpret_cast<LPCVOID>( reinterpret_cast<const uint8_t*>(pSource) + offset );
+static void _AddDDSWriteChunk( _In_ uint64_t offset, _In_ size_t size, _In_opt_ const uint8_t* pixels, _Inout_ std::vector<DDSWriteChunk>& chunks )
+{
+    DDSWriteChunk chunk;
+    chunk.offset = offset;
+    chunk.size = size;
+    chunk.pixels = pixels;
+    chunks.push_back( chunk );
+}
+
+static void _ComputeDDSWriteChunks( _In_ size_t headerSize, _In_ const std::vector<DDSWriteItem>& items,
+                                    _Out_ std::vector<DDSWriteChunk>& chunks, _Out_ size_t& stagingSize )
+{
+    chunks.clear();
+
+    // [start,end) is the staged range not yet cut into chunks, starting with the header
+    uint64_t start = 0;
+    uint64_t end = headerSize;
+
+    for( auto it = items.cbegin(); it != items.cend(); ++it )
+    {
+        if ( it->image->slicePitch == it->size && it->size >= DDS_WRITE_CHUNK )
+        {
+            if ( end > start )
+                _AddDDSWriteChunk( start, static_cast<size_t>( end - start ), nullptr, chunks );
+
+            auto pixels = reinterpret_cast<const uint8_t*>( it->image->pixels );
+            for( size_t pos = 0; pos < it->size; pos += DDS_WRITE_CHUNK )
+            {
+                _AddDDSWriteChunk( it->offset + pos, std::min<size_t>( DDS_WRITE_CHUNK, it->size - pos ), pixels + pos, chunks );
+            }
+
+            start = end = it->offset + it->size;
+        }
+        else
+        {
+            end += it->size;
+
+            while( ( end - start ) >= DDS_WRITE_CHUNK )
+            {
+                _AddDDSWriteChunk( start, DDS_WRITE_CHUNK, nullptr, chunks );
+                start += DDS_WRITE_CHUNK;
+            }
+        }
+    }
+
+    if ( end > start )
+        _AddDDSWriteChunk( start, static_cast<size_t>( end - start ), nullptr, chunks );
+
+    stagingSize = 0;
+    for( auto it = chunks.cbegin(); it != chunks.cend(); ++it )
+    {
+        if ( !it->pixels )
+            stagingSize = std::max<size_t>( stagingSize, it->size );
+    }
+}
+
+static HRESULT _PackDDSChunk_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const DDSPackTask* task = reinterpret_cast<const DDSPackTask*>( pContext );
+    assert( task );
+
+    const DDSWriteChunk& chunk = task->chunks[ item ];
+    if ( chunk.pixels )
+        return S_OK;
+
+    uint8_t* pDest = task->staging + item * task->stagingSize;
+
+    uint64_t pos = chunk.offset;
+    const uint64_t end = chunk.offset + chunk.size;
+
+    if ( pos < task->headerSize )
+    {
+        const size_t n = std::min<size_t>( task->headerSize - static_cast<size_t>( pos ), chunk.size );
+        memcpy( pDest, task->header + pos, n );
+        pDest += n;
+        pos += n;
+    }
+
+    if ( pos >= end )
+        return S_OK;
+
+    // Find the first sub-resource overlapping the chunk
+    const std::vector<DDSWriteItem>& items = *task->items;
+
+    size_t lo = 0;
+    size_t hi = items.size();
+    while( lo < hi )
+    {
+        const size_t mid = ( lo + hi ) / 2;
+        if ( items[ mid ].offset + items[ mid ].size <= pos )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for( size_t i = lo; pos < end; ++i )
+    {
+        if ( i >= items.size() )
+            return E_FAIL;
+
+        const DDSWriteItem& witem = items[ i ];
+        assert( witem.offset <= pos );
+
+        size_t rel = static_cast<size_t>( pos - witem.offset );
+        const size_t last = static_cast<size_t>( std::min<uint64_t>( end, witem.offset + witem.size ) - witem.offset );
+
+        auto pPixels = reinterpret_cast<const uint8_t*>( witem.image->pixels );
+
+        if ( witem.image->slicePitch == witem.size )
+        {
+            memcpy( pDest, pPixels + rel, last - rel );
+            pDest += last - rel;
+        }
+        else
+        {
+            // Rows may be split across chunks
+            const size_t rowPitch = witem.image->rowPitch;
+            while( rel < last )
+            {
+                const size_t row = rel / witem.ddsRowPitch;
+                const size_t col = rel % witem.ddsRowPitch;
+                const size_t n = std::min<size_t>( witem.ddsRowPitch - col, last - rel );
+
+                memcpy( pDest, pPixels + row * rowPitch + col, n );
+                pDest += n;
+                rel += n;
+            }
+        }
+
+        pos = witem.offset + last;
+    }
+
+    return S_OK;
+}
+
+static HRESULT _WaitDDSWrite( _In_ HANDLE hFile, _Inout_ OVERLAPPED& ov, _Inout_ size_t& pending )
+{
+    if ( !pending )
+        return S_OK;
+
+    const size_t expected = pending;
+    pending = 0;
+
+    DWORD bytesWritten;
+    if ( !GetOverlappedResult( hFile, &ov, &bytesWritten, TRUE ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    if ( bytesWritten != expected )
+    {
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+static HRESULT _ReserveDDSFile( _In_ HANDLE hFile, _In_ uint64_t size, _Out_ bool& validData )
+{
+    validData = false;
+
+    // Setting the end of file first keeps the chunk writes from each extending it
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_END_OF_FILE_INFO eof;
+    eof.EndOfFile.QuadPart = static_cast<LONGLONG>( size );
+    if ( !SetFileInformationByHandle( hFile, FileEndOfFileInfo, &eof, sizeof(eof) ) )
+        return HRESULT_FROM_WIN32( GetLastError() );
+#else
+    LARGE_INTEGER eof;
+    eof.QuadPart = static_cast<LONGLONG>( size );
+    if ( !SetFilePointerEx( hFile, eof, nullptr, FILE_BEGIN ) || !SetEndOfFile( hFile ) )
+        return HRESULT_FROM_WIN32( GetLastError() );
+#endif
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA) && ( !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP) )
+    // Only succeeds with SE_MANAGE_VOLUME_NAME enabled; otherwise NTFS zero-fills as the writes arrive
+    validData = ( SetFileValidData( hFile, static_cast<LONGLONG>( size ) ) != FALSE );
+#endif
+
+    return S_OK;
+}
+
+
+//=====================================================================================
+// Entry-points
+//=====================================================================================
+
+//-------------------------------------------------------------------------------------
+// Obtain metadata from DDS file in memory/on disk
+//-------------------------------------------------------------------------------------
+
+_Use_decl_annotations_
+HRESULT GetMetadataFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadata& metadata )
+{
+    if ( !pSource || size == 0 )
+        return E_INVALIDARG;
+
+    DWORD convFlags = 0;
+    return _DecodeDDSHeader( pSource, size, flags, metadata, convFlags );
+}
+
+_Use_decl_annotations_
+HRESULT GetMetadataFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata& metadata )
+{
+    if ( !szFile )
+        return E_INVALIDARG;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile( safe_handle( CreateFile2( szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, 0 ) ) );
+#else
+    ScopedHandle hFile( safe_handle( CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                                                  FILE_FLAG_SEQUENTIAL_SCAN, 0 ) ) );
+#endif
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Get the file size
+    LARGE_INTEGER fileSize = {0};
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+    fileSize = fileInfo.EndOfFile;
+#else
+    if ( !GetFileSizeEx( hFile.get(), &fileSize ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+#endif
+
+    // File is too big for 32-bit allocation, so reject read (4 GB should be plenty large enough for a valid DDS file)
+    if ( fileSize.HighPart > 0 )
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+    // Need at least enough data to fill the standard header and magic number to be a valid DDS
+    if ( fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // Read the header in (including extended header if present)
+    const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+    uint8_t header[MAX_HEADER_SIZE];
+
+    DWORD bytesRead = 0;
+    if ( !ReadFile( hFile.get(), header, MAX_HEADER_SIZE, &bytesRead, 0 ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    DWORD convFlags = 0;
+    return _DecodeDDSHeader( header, bytesRead, flags, metadata, convFlags );
+}
+
+
+//-------------------------------------------------------------------------------------
+// Load a DDS file in memory
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT LoadFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadata* metadata, ScratchImage& image )
+{
+    if ( !pSource || size == 0 )
+        return E_INVALIDARG;
+
+    image.Release();
+
+    DWORD convFlags = 0;
+    TexMetadata mdata;
+    HRESULT hr = _DecodeDDSHeader( pSource, size, flags, mdata, convFlags );  
+    if ( FAILED(hr) )
+        return hr;
+
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if ( convFlags & CONV_FLAGS_DX10 )
+        offset += sizeof(DDS_HEADER_DXT10);
+
+    assert( offset <= size );
+
+    const uint32_t *pal8 = nullptr;
+    if ( convFlags & CONV_FLAGS_PAL8 )
+    {
+        pal8 = reinterpret_cast<const uint32_t*>( reinterpret_cast<const uint8_t*>(pSource) + offset );
+        assert( pal8 );
+        offset += ( 256 * sizeof(uint32_t) );
+        if ( size < offset )
+            return E_FAIL;
+    }
+
+    hr = image.Initialize( mdata );
+    if ( FAILED(hr) )
+        return hr;
+
+    auto pPixels = reinterpret_cast<LPCVOID>( reinterpret_cast<const uint8_t*>(pSource) + offset );
     assert( pPixels );
     hr = _CopyImage( pPixels, size - offset, mdata,
                      (flags & DDS_FLAGS_LEGACY_DWORD) ? CP_FLAGS_LEGACY_DWORD : CP_FLAGS_NONE, convFlags, pal8, image );
@@ -1422,20 +1719,326 @@ HRESULT LoadFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadat
         image.Release();
         return hr;
     }
-    if ( metadata )
-        memcpy( metadata, &mdata, sizeof(TexMetadata) );
+    if ( metadata )
+        memcpy( metadata, &mdata, sizeof(TexMetadata) );
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Load a DDS file from disk
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, ScratchImage& image )
+{
+    if ( !szFile )
+        return E_INVALIDARG;
+
+    image.Release();
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile( safe_handle ( CreateFile2( szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, 0 ) ) );
+#else
+    ScopedHandle hFile( safe_handle ( CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                                                   FILE_FLAG_SEQUENTIAL_SCAN, 0 ) ) );
+#endif
+
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Get the file size
+    LARGE_INTEGER fileSize = {0};
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+    fileSize = fileInfo.EndOfFile;
+#else
+    if ( !GetFileSizeEx( hFile.get(), &fileSize ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+#endif
+
+    // File is too big for 32-bit allocation, so reject read (4 GB should be plenty large enough for a valid DDS file)
+    if ( fileSize.HighPart > 0 )
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+    // Need at least enough data to fill the standard header and magic number to be a valid DDS
+    if ( fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // Read the header in (including extended header if present)
+    const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+    uint8_t header[MAX_HEADER_SIZE];
+
+    DWORD bytesRead = 0;
+    if ( !ReadFile( hFile.get(), header, MAX_HEADER_SIZE, &bytesRead, 0 ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    DWORD convFlags = 0;
+    TexMetadata mdata;
+    HRESULT hr = _DecodeDDSHeader( header, bytesRead, flags, mdata, convFlags );
+    if ( FAILED(hr) )
+        return hr;
+
+    DWORD offset = MAX_HEADER_SIZE;
+
+    if ( !(convFlags & CONV_FLAGS_DX10) )
+    {
+        // Must reset file position since we read more than the standard header above
+        LARGE_INTEGER filePos = { sizeof(uint32_t) + sizeof(DDS_HEADER), 0};
+        if ( !SetFilePointerEx( hFile.get(), filePos, 0, FILE_BEGIN ) )
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    }
+
+    std::unique_ptr<uint32_t[]> pal8;
+    if ( convFlags & CONV_FLAGS_PAL8 )
+    {
+        pal8.reset( new (std::nothrow) uint32_t[256] );
+        if ( !pal8 )
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        if ( !ReadFile( hFile.get(), pal8.get(), 256 * sizeof(uint32_t), &bytesRead, 0 ) )
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        if ( bytesRead != (256 * sizeof(uint32_t)) )
+        {
+            return E_FAIL;
+        }
+
+        offset += ( 256 * sizeof(uint32_t) );
+    }
+
+    DWORD remaining = fileSize.LowPart - offset;
+    if ( remaining == 0 )
+        return E_FAIL;
+
+    hr = image.Initialize( mdata );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( (convFlags & CONV_FLAGS_EXPAND) || (flags & DDS_FLAGS_LEGACY_DWORD) )
+    {
+        std::unique_ptr<uint8_t[]> temp( new (std::nothrow) uint8_t[ remaining ] );
+        if ( !temp )
+        {
+            image.Release();
+            return E_OUTOFMEMORY;
+        }
+
+        if ( !ReadFile( hFile.get(), temp.get(), remaining, &bytesRead, 0 ) )
+        {
+            image.Release();
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        if ( bytesRead != remaining )
+        {
+            image.Release();
+            return E_FAIL;
+        }
+
+        hr = _CopyImage( temp.get(), remaining, mdata,
+                         (flags & DDS_FLAGS_LEGACY_DWORD) ? CP_FLAGS_LEGACY_DWORD : CP_FLAGS_NONE,
+                         convFlags, pal8.get(), image );
+        if ( FAILED(hr) )
+        {
+            image.Release();
+            return hr;
+        }
+    }
+    else
+    {
+        if ( remaining > image.GetPixelsSize() )
+        {
+            image.Release();
+            return E_FAIL;
+        }
+
+        if ( !ReadFile( hFile.get(), image.GetPixels(), static_cast<DWORD>( image.GetPixelsSize() ), &bytesRead, 0 ) )
+        {
+            image.Release();
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        if ( convFlags & (CONV_FLAGS_SWIZZLE|CONV_FLAGS_NOALPHA) )
+        {
+            // Swizzle/copy image in place
+            hr = _CopyImageInPlace( convFlags, image );
+            if ( FAILED(hr) )
+            {
+                image.Release();
+                return hr;
+            }
+        }
+    }
+
+    if ( metadata )
+        memcpy( metadata, &mdata, sizeof(TexMetadata) );
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Map a DDS file from disk, returning images which point directly at the file data
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT LoadFromDDSFileMapped( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, MappedImage& image )
+{
+    if ( !szFile )
+        return E_INVALIDARG;
+
+    image.Release();
+
+    if ( flags & DDS_FLAGS_LEGACY_DWORD )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile( safe_handle ( CreateFile2( szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, 0 ) ) );
+#else
+    ScopedHandle hFile( safe_handle ( CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                                                   FILE_FLAG_SEQUENTIAL_SCAN, 0 ) ) );
+#endif
+
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Get the file size
+    LARGE_INTEGER fileSize = {0};
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+    fileSize = fileInfo.EndOfFile;
+#else
+    if ( !GetFileSizeEx( hFile.get(), &fileSize ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+#endif
+
+    // File is too big for 32-bit allocation, so reject read (4 GB should be plenty large enough for a valid DDS file)
+    if ( fileSize.HighPart > 0 )
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+    // Need at least enough data to fill the standard header and magic number to be a valid DDS
+    if ( fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // The view keeps the file mapped after the file and mapping handles are closed
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hMapping( CreateFileMappingFromApp( hFile.get(), nullptr, PAGE_READONLY, 0, nullptr ) );
+#else
+    ScopedHandle hMapping( CreateFileMappingW( hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr ) );
+#endif
+
+    if ( !hMapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedMappedView pView( MapViewOfFileFromApp( hMapping.get(), FILE_MAP_READ, 0, 0 ) );
+#else
+    ScopedMappedView pView( MapViewOfFile( hMapping.get(), FILE_MAP_READ, 0, 0, 0 ) );
+#endif
+
+    if ( !pView )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    DWORD convFlags = 0;
+    TexMetadata mdata;
+    HRESULT hr = _DecodeDDSHeader( pView.get(), fileSize.LowPart, flags, mdata, convFlags );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( convFlags & (CONV_FLAGS_EXPAND|CONV_FLAGS_SWIZZLE|CONV_FLAGS_NOALPHA|CONV_FLAGS_PAL8) )
+    {
+        // The pixels need converting on load, so they can't be used in place
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if ( convFlags & CONV_FLAGS_DX10 )
+        offset += sizeof(DDS_HEADER_DXT10);
+
+    hr = image.Initialize( mdata, pView.release(), offset, fileSize.LowPart );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( metadata )
+        memcpy( metadata, &mdata, sizeof(TexMetadata) );
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Load selected mips and array items of a DDS file from disk
+//   Only the byte ranges of the requested sub-resources are read, and any legacy
+//   conversion is applied to just those
+//-------------------------------------------------------------------------------------
+static HRESULT _ReadDDSRange( _In_ HANDLE hFile, _In_ size_t offset, _Out_writes_bytes_(size) void* pDestination, _In_ size_t size )
+{
+    LARGE_INTEGER filePos;
+    filePos.QuadPart = static_cast<LONGLONG>( offset );
+    if ( !SetFilePointerEx( hFile, filePos, 0, FILE_BEGIN ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    DWORD bytesRead = 0;
+    if ( !ReadFile( hFile, pDestination, static_cast<DWORD>( size ), &bytesRead, 0 ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    if ( bytesRead != size )
+    {
+        return E_FAIL;
+    }
 
     return S_OK;
 }
 
-
-//-------------------------------------------------------------------------------------
-// Load a DDS file from disk
-//-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, ScratchImage& image )
+HRESULT LoadFromDDSFileRange( LPCWSTR szFile, DWORD flags, size_t firstItem, size_t itemCount, size_t firstMip, size_t mipCount,
+                              TexMetadata* metadata, ScratchImage& image )
 {
-    if ( !szFile )
+    if ( !szFile || !itemCount || !mipCount )
         return E_INVALIDARG;
 
     image.Release();
@@ -1444,7 +2047,7 @@ HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, Scr
     ScopedHandle hFile( safe_handle ( CreateFile2( szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, 0 ) ) );
 #else
     ScopedHandle hFile( safe_handle ( CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
-                                                   FILE_FLAG_SEQUENTIAL_SCAN, 0 ) ) );
+                                                   FILE_FLAG_RANDOM_ACCESS, 0 ) ) );
 #endif
 
     if ( !hFile )
@@ -1497,20 +2100,16 @@ HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, Scr
     if ( FAILED(hr) )
         return hr;
 
-    DWORD offset = MAX_HEADER_SIZE;
-
-    if ( !(convFlags & CONV_FLAGS_DX10) )
+    if ( ( firstItem >= mdata.arraySize ) || ( itemCount > mdata.arraySize - firstItem )
+         || ( firstMip >= mdata.mipLevels ) || ( mipCount > mdata.mipLevels - firstMip ) )
     {
-        // Must reset file position since we read more than the standard header above
-        LARGE_INTEGER filePos = { sizeof(uint32_t) + sizeof(DDS_HEADER), 0};
-        if ( !SetFilePointerEx( hFile.get(), filePos, 0, FILE_BEGIN ) )
-        {
-            return HRESULT_FROM_WIN32( GetLastError() );
-        }
-
-        offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+        return E_INVALIDARG;
     }
 
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if ( convFlags & CONV_FLAGS_DX10 )
+        offset += sizeof(DDS_HEADER_DXT10);
+
     std::unique_ptr<uint32_t[]> pal8;
     if ( convFlags & CONV_FLAGS_PAL8 )
     {
@@ -1520,80 +2119,162 @@ HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, Scr
             return E_OUTOFMEMORY;
         }
 
-        if ( !ReadFile( hFile.get(), pal8.get(), 256 * sizeof(uint32_t), &bytesRead, 0 ) )
-        {
-            return HRESULT_FROM_WIN32( GetLastError() );
-        }
-
-        if ( bytesRead != (256 * sizeof(uint32_t)) )
-        {
-            return E_FAIL;
-        }
+        hr = _ReadDDSRange( hFile.get(), offset, pal8.get(), 256 * sizeof(uint32_t) );
+        if ( FAILED(hr) )
+            return hr;
 
         offset += ( 256 * sizeof(uint32_t) );
     }
 
-    DWORD remaining = fileSize.LowPart - offset;
-    if ( remaining == 0 )
-        return E_FAIL;
+    // Offset of each mip within an array item as stored in the file, followed by the item size
+    const bool volume = ( mdata.dimension == TEX_DIMENSION_TEXTURE3D );
+    const DWORD cpFlags = _FilePitchFlags( (flags & DDS_FLAGS_LEGACY_DWORD) ? CP_FLAGS_LEGACY_DWORD : CP_FLAGS_NONE, convFlags );
 
-    hr = image.Initialize( mdata );
+    std::vector<size_t> mipOffsets;
+    mipOffsets.reserve( mdata.mipLevels + 1 );
+    mipOffsets.push_back( 0 );
+
+    size_t width = mdata.width;
+    size_t height = mdata.height;
+    size_t depth = mdata.depth;
+    for( size_t level = 0; level < mdata.mipLevels; ++level )
+    {
+        size_t rowPitch, slicePitch;
+        ComputePitch( mdata.format, width, height, rowPitch, slicePitch, cpFlags );
+
+        mipOffsets.push_back( mipOffsets.back() + slicePitch * ( volume ? depth : 1 ) );
+
+        if ( height > 1 )
+            height >>= 1;
+
+        if ( width > 1 )
+            width >>= 1;
+
+        if ( depth > 1 )
+            depth >>= 1;
+    }
+
+    const size_t itemSize = mipOffsets.back();
+    const size_t rangeSize = mipOffsets[ firstMip + mipCount ] - mipOffsets[ firstMip ];
+
+    // Describe just the sub-resources being loaded
+    TexMetadata rdata = mdata;
+    rdata.width = std::max<size_t>( 1, mdata.width >> firstMip );
+    rdata.height = std::max<size_t>( 1, mdata.height >> firstMip );
+    if ( volume )
+        rdata.depth = std::max<size_t>( 1, mdata.depth >> firstMip );
+    rdata.mipLevels = mipCount;
+    rdata.arraySize = itemCount;
+
+    if ( rdata.IsCubemap() && ( ( firstItem % 6 ) || ( itemCount % 6 ) ) )
+    {
+        // Not whole cubes, so return the faces as a plain array
+        rdata.miscFlags &= ~TEX_MISC_TEXTURECUBE;
+    }
+
+    hr = image.Initialize( rdata );
     if ( FAILED(hr) )
         return hr;
 
-    if ( (convFlags & CONV_FLAGS_EXPAND) || (flags & DDS_FLAGS_LEGACY_DWORD) )
+    const bool convert = ( (convFlags & CONV_FLAGS_EXPAND) || (flags & DDS_FLAGS_LEGACY_DWORD) );
+
+    std::unique_ptr<uint8_t[]> temp;
+    if ( convert )
     {
-        std::unique_ptr<uint8_t[]> temp( new (std::nothrow) uint8_t[ remaining ] );
+        temp.reset( new (std::nothrow) uint8_t[ rangeSize ] );
         if ( !temp )
         {
             image.Release();
             return E_OUTOFMEMORY;
         }
+    }
 
-        if ( !ReadFile( hFile.get(), temp.get(), remaining, &bytesRead, 0 ) )
+    DWORD tflags = (convFlags & CONV_FLAGS_NOALPHA) ? TEXP_SCANLINE_SETALPHA : 0;
+    if ( convFlags & CONV_FLAGS_SWIZZLE )
+        tflags |= TEXP_SCANLINE_LEGACY;
+
+    for( size_t item = 0; item < itemCount; ++item )
+    {
+        // The requested mips of an item are contiguous in the file
+        const size_t rangeOffset = offset + ( firstItem + item ) * itemSize + mipOffsets[ firstMip ];
+        if ( rangeOffset + rangeSize > fileSize.LowPart )
         {
             image.Release();
-            return HRESULT_FROM_WIN32( GetLastError() );
+            return E_FAIL;
         }
 
-        if ( bytesRead != remaining )
+        if ( !convert )
         {
-            image.Release();
-            return E_FAIL;
+            // The scratch image uses the file's layout, so the pixels are read in place
+            const Image* dest = image.GetImage( 0, item, 0 );
+            if ( !dest )
+            {
+                image.Release();
+                return E_POINTER;
+            }
+
+            assert( dest->pixels + rangeSize <= image.GetPixels() + image.GetPixelsSize() );
+
+            hr = _ReadDDSRange( hFile.get(), rangeOffset, dest->pixels, rangeSize );
+            if ( FAILED(hr) )
+            {
+                image.Release();
+                return hr;
+            }
+
+            continue;
         }
 
-        hr = _CopyImage( temp.get(), remaining, mdata,
-                         (flags & DDS_FLAGS_LEGACY_DWORD) ? CP_FLAGS_LEGACY_DWORD : CP_FLAGS_NONE,
-                         convFlags, pal8.get(), image );
+        hr = _ReadDDSRange( hFile.get(), rangeOffset, temp.get(), rangeSize );
         if ( FAILED(hr) )
         {
             image.Release();
             return hr;
         }
-    }
-    else
-    {
-        if ( remaining > image.GetPixelsSize() )
-        {
-            image.Release();
-            return E_FAIL;
-        }
 
-        if ( !ReadFile( hFile.get(), image.GetPixels(), static_cast<DWORD>( image.GetPixelsSize() ), &bytesRead, 0 ) )
+        const uint8_t* pSrc = temp.get();
+        size_t d = rdata.depth;
+        for( size_t level = 0; level < mipCount; ++level )
         {
-            image.Release();
-            return HRESULT_FROM_WIN32( GetLastError() );
+            for( size_t slice = 0; slice < d; ++slice )
+            {
+                const Image* dest = image.GetImage( level, item, slice );
+                if ( !dest )
+                {
+                    image.Release();
+                    return E_POINTER;
+                }
+
+                Image src;
+                src.width = dest->width;
+                src.height = dest->height;
+                src.format = mdata.format;
+                ComputePitch( mdata.format, src.width, src.height, src.rowPitch, src.slicePitch, cpFlags );
+                src.pixels = const_cast<uint8_t*>( pSrc );
+
+                hr = _CopySubresource( src, *dest, mdata.format, convFlags, pal8.get(), tflags );
+                if ( FAILED(hr) )
+                {
+                    image.Release();
+                    return hr;
+                }
+
+                pSrc += src.slicePitch;
+            }
+
+            if ( d > 1 )
+                d >>= 1;
         }
+    }
 
-        if ( convFlags & (CONV_FLAGS_SWIZZLE|CONV_FLAGS_NOALPHA) )
+    if ( !convert && ( convFlags & (CONV_FLAGS_SWIZZLE|CONV_FLAGS_NOALPHA) ) )
+    {
+        // Swizzle/copy image in place
+        hr = _CopyImageInPlace( convFlags, image );
+        if ( FAILED(hr) )
         {
-            // Swizzle/copy image in place
-            hr = _CopyImageInPlace( convFlags, image );
-            if ( FAILED(hr) )
-            {
-                image.Release();
-                return hr;
-            }
+            image.Release();
+            return hr;
         }
     }
 
@@ -1824,6 +2505,9 @@ HRESULT SaveToDDSFile( const Image* images, size_t nimages, const TexMetadata& m
     if ( !szFile )
         return E_INVALIDARG;
 
+    if ( !images || (nimages == 0) )
+        return E_INVALIDARG;
+
     // Create DDS Header
     const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
     uint8_t header[MAX_HEADER_SIZE];
@@ -1832,171 +2516,144 @@ HRESULT SaveToDDSFile( const Image* images, size_t nimages, const TexMetadata& m
     if ( FAILED(hr) )
         return hr;
 
-    // Create file and write header
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-    ScopedHandle hFile( safe_handle( CreateFile2( szFile, GENERIC_WRITE, 0, CREATE_ALWAYS, 0 ) ) );
-#else
-    ScopedHandle hFile( safe_handle( CreateFileW( szFile, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0 ) ) );
-#endif
-    if ( !hFile )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
+    // Lay out every sub-resource in the file
+    std::vector<DDSWriteItem> items;
+    hr = _ComputeDDSWriteItems( images, nimages, metadata, required, items );
+    if ( FAILED(hr) )
+        return hr;
 
-    DWORD bytesWritten;
-    if ( !WriteFile( hFile.get(), header, static_cast<DWORD>( required ), &bytesWritten, 0 ) )
+    std::vector<DDSWriteChunk> chunks;
+    size_t stagingSize;
+    _ComputeDDSWriteChunks( required, items, chunks, stagingSize );
+
+    uint64_t fileSize = 0;
+    for( auto it = chunks.cbegin(); it != chunks.cend(); ++it )
     {
-        return HRESULT_FROM_WIN32( GetLastError() );
+        fileSize = std::max<uint64_t>( fileSize, it->offset + it->size );
     }
 
-    if ( bytesWritten != required )
+    const size_t nslots = 2 * DDS_WRITE_BATCH;
+
+    std::unique_ptr<uint8_t[]> staging;
+    if ( stagingSize > 0 )
     {
-        return E_FAIL;
+        staging.reset( new (std::nothrow) uint8_t[ nslots * stagingSize ] );
+        if ( !staging )
+            return E_OUTOFMEMORY;
     }
 
-    // Write images
-    switch( metadata.dimension )
+    ScopedHandle events[ nslots ];
+    for( size_t s = 0; s < nslots; ++s )
     {
-    case DDS_DIMENSION_TEXTURE1D:
-    case DDS_DIMENSION_TEXTURE2D:
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+        events[ s ].reset( CreateEventEx( 0, 0, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
+#else
+        events[ s ].reset( CreateEvent( 0, TRUE, FALSE, 0 ) );
+#endif
+        if ( !events[ s ] )
         {
-            size_t index = 0;
-            for( size_t item = 0; item < metadata.arraySize; ++item )
-            {
-                for( size_t level = 0; level < metadata.mipLevels; ++level, ++index )
-                {
-                    if ( index >= nimages )
-                        return E_FAIL;
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+    }
 
-                    if ( !images[ index ].pixels )
-                        return E_POINTER;
+    // Create file
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    CREATEFILE2_EXTENDED_PARAMETERS params;
+    memset( &params, 0, sizeof(params) );
+    params.dwSize = sizeof(CREATEFILE2_EXTENDED_PARAMETERS);
+    params.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+    params.dwFileFlags = FILE_FLAG_OVERLAPPED;
+    ScopedHandle hFile( safe_handle( CreateFile2( szFile, GENERIC_WRITE | DELETE, 0, CREATE_ALWAYS, &params ) ) );
+#else
+    ScopedHandle hFile( safe_handle( CreateFileW( szFile, GENERIC_WRITE | DELETE, 0, 0, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, 0 ) ) );
+#endif
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
 
-                    assert( images[ index ].rowPitch > 0 );
-                    assert( images[ index ].slicePitch > 0 );
+    bool validData;
+    hr = _ReserveDDSFile( hFile.get(), fileSize, validData );
+    if ( FAILED(hr) )
+        return hr;
 
-                    size_t ddsRowPitch, ddsSlicePitch;
-                    ComputePitch( metadata.format, images[ index ].width, images[ index ].height, ddsRowPitch, ddsSlicePitch, CP_FLAGS_NONE );
+    // Write header and images, alternating between two sets of staging buffers
+    DDSPackTask task;
+    task.header = header;
+    task.headerSize = required;
+    task.items = &items;
+    task.stagingSize = stagingSize;
 
-                    if ( images[ index ].slicePitch == ddsSlicePitch )
-                    {
-                        if ( !WriteFile( hFile.get(), images[ index ].pixels, static_cast<DWORD>( ddsSlicePitch ), &bytesWritten, 0 ) )
-                        {
-                            return HRESULT_FROM_WIN32( GetLastError() );
-                        }
+    OVERLAPPED ov[ nslots ];
+    size_t pending[ nslots ];
+    memset( pending, 0, sizeof(pending) );
 
-                        if ( bytesWritten != ddsSlicePitch )
-                        {
-                            return E_FAIL;
-                        }
-                    }
-                    else
-                    {
-                        size_t rowPitch = images[ index ].rowPitch;
-                        if ( rowPitch < ddsRowPitch )
-                        {
-                            // DDS uses 1-byte alignment, so if this is happening then the input pitch isn't actually a full line of data
-                            return E_FAIL;
-                        }
+    const size_t nchunks = chunks.size();
+    for( size_t first = 0; first < nchunks && SUCCEEDED(hr); first += DDS_WRITE_BATCH )
+    {
+        const size_t count = std::min<size_t>( DDS_WRITE_BATCH, nchunks - first );
+        const size_t slot0 = ( ( first / DDS_WRITE_BATCH ) & 1 ) * DDS_WRITE_BATCH;
 
-                        const uint8_t * __restrict sPtr = reinterpret_cast<const uint8_t*>(images[ index ].pixels);
+        // These staging buffers are free once the writes issued two batches ago have completed
+        for( size_t i = 0; i < count && SUCCEEDED(hr); ++i )
+        {
+            hr = _WaitDDSWrite( hFile.get(), ov[ slot0 + i ], pending[ slot0 + i ] );
+        }
 
-                        size_t lines = ComputeScanlines( metadata.format, images[ index ].height );
-                        for( size_t j = 0; j < lines; ++j )
-                        {
-                            if ( !WriteFile( hFile.get(), sPtr, static_cast<DWORD>( ddsRowPitch ), &bytesWritten, 0 ) )
-                            {
-                                return HRESULT_FROM_WIN32( GetLastError() );
-                            }
+        if ( FAILED(hr) )
+            break;
 
-                            if ( bytesWritten != ddsRowPitch )
-                            {
-                                return E_FAIL;
-                            }
+        task.chunks = &chunks[ first ];
+        task.staging = staging.get() + slot0 * stagingSize;
 
-                            sPtr += rowPitch;
-                        }
-                    }
-                }
-            }
-        }
-        break;
+        hr = _RunTasks( count, (flags & DDS_FLAGS_PARALLEL) != 0, _PackDDSChunk_Task, &task );
+        if ( FAILED(hr) )
+            break;
 
-    case DDS_DIMENSION_TEXTURE3D:
+        for( size_t i = 0; i < count; ++i )
         {
-            if ( metadata.arraySize != 1 )
-                return E_FAIL;
+            const DDSWriteChunk& chunk = chunks[ first + i ];
+            const size_t s = slot0 + i;
 
-            size_t d = metadata.depth;
+            memset( &ov[ s ], 0, sizeof(OVERLAPPED) );
+            ov[ s ].Offset = static_cast<DWORD>( chunk.offset );
+            ov[ s ].OffsetHigh = static_cast<DWORD>( chunk.offset >> 32 );
+            ov[ s ].hEvent = events[ s ].get();
 
-            size_t index = 0;
-            for( size_t level = 0; level < metadata.mipLevels; ++level )
+            const uint8_t* pSource = ( chunk.pixels ) ? chunk.pixels : ( staging.get() + s * stagingSize );
+            if ( !WriteFile( hFile.get(), pSource, static_cast<DWORD>( chunk.size ), 0, &ov[ s ] ) )
             {
-                for( size_t slice = 0; slice < d; ++slice, ++index )
+                const DWORD error = GetLastError();
+                if ( error != ERROR_IO_PENDING )
                 {
-                    if ( index >= nimages )
-                        return E_FAIL;
-
-                    if ( !images[ index ].pixels )
-                        return E_POINTER;
-
-                    assert( images[ index ].rowPitch > 0 );
-                    assert( images[ index ].slicePitch > 0 );
-
-                    size_t ddsRowPitch, ddsSlicePitch;
-                    ComputePitch( metadata.format, images[ index ].width, images[ index ].height, ddsRowPitch, ddsSlicePitch, CP_FLAGS_NONE );
-
-                    if ( images[ index ].slicePitch == ddsSlicePitch )
-                    {
-                        if ( !WriteFile( hFile.get(), images[ index ].pixels, static_cast<DWORD>( ddsSlicePitch ), &bytesWritten, 0 ) )
-                        {
-                            return HRESULT_FROM_WIN32( GetLastError() );
-                        }
-
-                        if ( bytesWritten != ddsSlicePitch )
-                        {
-                            return E_FAIL;
-                        }
-                    }
-                    else
-                    {
-                        size_t rowPitch = images[ index ].rowPitch;
-                        if ( rowPitch < ddsRowPitch )
-                        {
-                            // DDS uses 1-byte alignment, so if this is happening then the input pitch isn't actually a full line of data
-                            return E_FAIL;
-                        }
-
-                        const uint8_t * __restrict sPtr = reinterpret_cast<const uint8_t*>(images[ index ].pixels);
-
-                        size_t lines = ComputeScanlines( metadata.format, images[ index ].height );
-                        for( size_t j = 0; j < lines; ++j )
-                        {
-                            if ( !WriteFile( hFile.get(), sPtr, static_cast<DWORD>( ddsRowPitch ), &bytesWritten, 0 ) )
-                            {
-                                return HRESULT_FROM_WIN32( GetLastError() );
-                            }
-
-                            if ( bytesWritten != ddsRowPitch )
-                            {
-                                return E_FAIL;
-                            }
-
-                            sPtr += rowPitch;
-                        }
-                    }
+                    hr = HRESULT_FROM_WIN32( error );
+                    break;
                 }
-
-                if ( d > 1 )
-                    d >>= 1;
             }
+
+            pending[ s ] = chunk.size;
         }
-        break;
+    }
 
-    default:
-        return E_FAIL;
+    // Everything in flight must finish before the staging buffers are released, even on failure
+    for( size_t s = 0; s < nslots; ++s )
+    {
+        HRESULT hrw = _WaitDDSWrite( hFile.get(), ov[ s ], pending[ s ] );
+        if ( SUCCEEDED(hr) )
+            hr = hrw;
     }
 
-    return S_OK;
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    if ( FAILED(hr) && validData )
+    {
+        // Whatever was on disk before is part of the file now, so don't leave a partly written one behind
+        FILE_DISPOSITION_INFO info;
+        info.DeleteFile = TRUE;
+        (void)SetFileInformationByHandle( hFile.get(), FileDispositionInfo, &info, sizeof(info) );
+    }
+#endif
+
+    return hr;
 }
 
 }; // namespace
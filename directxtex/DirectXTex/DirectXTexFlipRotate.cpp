@@ -20,6 +20,387 @@ using Microsoft::WRL::ComPtr;
 namespace DirectX
 {
 
+//-------------------------------------------------------------------------------------
+// Flip/rotate mapping
+//   Follows WICBitmapTransformOptions: the rotation (clockwise) is applied first, then
+//   the flips. Every combination reduces to an optional transpose plus a reversal of the
+//   source x and/or y axis, so destination (dx,dy) reads source:
+//      (revX ? w-1-dx : dx, revY ? h-1-dy : dy)    without transpose
+//      (revX ? w-1-dy : dy, revY ? h-1-dx : dx)    with transpose
+//-------------------------------------------------------------------------------------
+static void _GetFlipRotateMapping( _In_ DWORD flags, _Out_ bool& transpose, _Out_ bool& revX, _Out_ bool& revY )
+{
+    switch( flags & (TEX_FR_ROTATE90|TEX_FR_ROTATE180|TEX_FR_ROTATE270) )
+    {
+    case TEX_FR_ROTATE90:
+        transpose = true;
+        revX = false;
+        revY = true;
+        break;
+
+    case TEX_FR_ROTATE180:
+        transpose = false;
+        revX = true;
+        revY = true;
+        break;
+
+    case TEX_FR_ROTATE270:
+        transpose = true;
+        revX = true;
+        revY = false;
+        break;
+
+    default:
+        transpose = false;
+        revX = false;
+        revY = false;
+        break;
+    }
+
+    // Flips act on the destination axes, which are the source's swapped ones after a transpose
+    if ( flags & TEX_FR_FLIP_HORIZONTAL )
+    {
+        if ( transpose )
+            revY = !revY;
+        else
+            revX = !revX;
+    }
+
+    if ( flags & TEX_FR_FLIP_VERTICAL )
+    {
+        if ( transpose )
+            revX = !revX;
+        else
+            revY = !revY;
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// BC block index layouts
+//   BC1 through BC5 store each block as endpoints plus one index per texel (row-major,
+//   least significant bits first), so flipping or rotating a block is just a permutation of
+//   its indices. BC6H and BC7 can't be handled this way since their partition shapes and
+//   anchor indices don't survive a permutation.
+//-------------------------------------------------------------------------------------
+struct BCIndexField
+{
+    size_t offset;  // byte offset of the 16 indices within the block
+    size_t bits;    // bits per index
+};
+
+static bool _GetBCIndexLayout( _In_ DXGI_FORMAT format, _Out_ size_t& blockSize,
+                               _Out_writes_(2) BCIndexField* fields, _Out_ size_t& nfields )
+{
+    static const BCIndexField s_BC1[]  = { { 4, 2 } };
+    static const BCIndexField s_BC2[]  = { { 0, 4 }, { 12, 2 } };
+    static const BCIndexField s_BC3[]  = { { 2, 3 }, { 12, 2 } };
+    static const BCIndexField s_BC4[]  = { { 2, 3 } };
+    static const BCIndexField s_BC5[]  = { { 2, 3 }, { 10, 3 } };
+
+    const BCIndexField* layout = nullptr;
+
+    switch( format )
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+        blockSize = 8;
+        layout = s_BC1;
+        nfields = _countof(s_BC1);
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+        blockSize = 16;
+        layout = s_BC2;
+        nfields = _countof(s_BC2);
+        break;
+
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        blockSize = 16;
+        layout = s_BC3;
+        nfields = _countof(s_BC3);
+        break;
+
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        blockSize = 8;
+        layout = s_BC4;
+        nfields = _countof(s_BC4);
+        break;
+
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+        blockSize = 16;
+        layout = s_BC5;
+        nfields = _countof(s_BC5);
+        break;
+
+    default:
+        blockSize = 0;
+        nfields = 0;
+        return false;
+    }
+
+    for( size_t j = 0; j < nfields; ++j )
+        fields[ j ] = layout[ j ];
+
+    return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Can the format be flipped/rotated by moving raw pixels (or blocks)?
+//-------------------------------------------------------------------------------------
+static bool _CanFlipRotateNative( _In_ DXGI_FORMAT format )
+{
+    if ( IsCompressed( format ) )
+    {
+        size_t blockSize, nfields;
+        BCIndexField fields[2];
+        return _GetBCIndexLayout( format, blockSize, fields, nfields );
+    }
+
+    // Packed formats share data between pixel pairs, and planar formats aren't a single array of pixels
+    if ( IsPacked( format ) || IsPlanar( format ) )
+        return false;
+
+    switch( BitsPerPixel( format ) )
+    {
+    case 8:
+    case 16:
+    case 32:
+    case 64:
+    case 96:
+    case 128:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// Flip/rotate by moving whole pixels
+//   Transposes are done a tile at a time so that the rows being read and written both
+//   stay in cache, rather than striding through the whole source image per output row
+//-------------------------------------------------------------------------------------
+#define FLIPROTATE_TILE 32
+
+struct FRPixel96 { uint32_t v[3]; };
+struct FRPixel128 { uint32_t v[4]; };
+
+#define FLIPROTATE_PIXELS( type )\
+        if ( !transpose )\
+        {\
+            for( size_t dy = 0; dy < destImage.height; ++dy )\
+            {\
+                const size_t sy = ( revY ) ? ( srcImage.height - 1 - dy ) : dy;\
+                auto sPtr = reinterpret_cast<const type*>( pSrc + sy * srcImage.rowPitch );\
+                auto dPtr = reinterpret_cast<type*>( pDest + dy * destImage.rowPitch );\
+                if ( revX )\
+                {\
+                    const type* sEnd = sPtr + srcImage.width;\
+                    for( size_t dx = 0; dx < destImage.width; ++dx )\
+                        *(dPtr++) = *(--sEnd);\
+                }\
+                else\
+                {\
+                    memcpy( dPtr, sPtr, sizeof(type) * destImage.width );\
+                }\
+            }\
+        }\
+        else\
+        {\
+            for( size_t ty = 0; ty < destImage.height; ty += FLIPROTATE_TILE )\
+            {\
+                const size_t tyEnd = std::min<size_t>( ty + FLIPROTATE_TILE, destImage.height );\
+                for( size_t tx = 0; tx < destImage.width; tx += FLIPROTATE_TILE )\
+                {\
+                    const size_t txEnd = std::min<size_t>( tx + FLIPROTATE_TILE, destImage.width );\
+                    for( size_t dy = ty; dy < tyEnd; ++dy )\
+                    {\
+                        const size_t sx = ( revX ) ? ( srcImage.width - 1 - dy ) : dy;\
+                        auto dPtr = reinterpret_cast<type*>( pDest + dy * destImage.rowPitch );\
+                        for( size_t dx = tx; dx < txEnd; ++dx )\
+                        {\
+                            const size_t sy = ( revY ) ? ( srcImage.height - 1 - dx ) : dx;\
+                            dPtr[ dx ] = reinterpret_cast<const type*>( pSrc + sy * srcImage.rowPitch )[ sx ];\
+                        }\
+                    }\
+                }\
+            }\
+        }\
+        return S_OK;
+
+static HRESULT _PerformFlipRotatePixels( _In_ const Image& srcImage, _In_ DWORD flags, _In_ const Image& destImage )
+{
+    if ( !srcImage.pixels || !destImage.pixels )
+        return E_POINTER;
+
+    assert( srcImage.format == destImage.format );
+
+    bool transpose, revX, revY;
+    _GetFlipRotateMapping( flags, transpose, revX, revY );
+
+    if ( transpose )
+    {
+        if ( srcImage.width != destImage.height || srcImage.height != destImage.width )
+            return E_FAIL;
+    }
+    else if ( srcImage.width != destImage.width || srcImage.height != destImage.height )
+    {
+        return E_FAIL;
+    }
+
+    const uint8_t* pSrc = srcImage.pixels;
+    uint8_t* pDest = destImage.pixels;
+
+    switch( BitsPerPixel( srcImage.format ) )
+    {
+    case 8:     FLIPROTATE_PIXELS( uint8_t )
+    case 16:    FLIPROTATE_PIXELS( uint16_t )
+    case 32:    FLIPROTATE_PIXELS( uint32_t )
+    case 64:    FLIPROTATE_PIXELS( uint64_t )
+    case 96:    FLIPROTATE_PIXELS( FRPixel96 )
+    case 128:   FLIPROTATE_PIXELS( FRPixel128 )
+
+    default:
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// Flip/rotate BC1-BC5 without decompressing
+//   Blocks are moved with the same mapping as pixels, and the indices inside each block
+//   are permuted to match. A reversed axis has to be a multiple of 4 (or fit in a single
+//   block) so that no output block straddles two source blocks.
+//-------------------------------------------------------------------------------------
+static HRESULT _PerformFlipRotateBlocks( _In_ const Image& srcImage, _In_ DWORD flags, _In_ const Image& destImage )
+{
+    if ( !srcImage.pixels || !destImage.pixels )
+        return E_POINTER;
+
+    assert( srcImage.format == destImage.format );
+
+    size_t blockSize, nfields;
+    BCIndexField fields[2];
+    if ( !_GetBCIndexLayout( srcImage.format, blockSize, fields, nfields ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    bool transpose, revX, revY;
+    _GetFlipRotateMapping( flags, transpose, revX, revY );
+
+    const size_t width = srcImage.width;
+    const size_t height = srcImage.height;
+
+    if ( transpose )
+    {
+        if ( width != destImage.height || height != destImage.width )
+            return E_FAIL;
+    }
+    else if ( width != destImage.width || height != destImage.height )
+    {
+        return E_FAIL;
+    }
+
+    if ( ( revX && ( width % 4 ) && width > 4 ) || ( revY && ( height % 4 ) && height > 4 ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    // Texel permutation within a block. Texels past the edge of a partial destination block
+    // are padding, so they just reuse the nearest real texel
+    const size_t nx = std::min<size_t>( width, 4 );
+    const size_t ny = std::min<size_t>( height, 4 );
+    const size_t dnx = ( transpose ) ? ny : nx;
+    const size_t dny = ( transpose ) ? nx : ny;
+
+    size_t perm[ 16 ];
+    for( size_t ty = 0; ty < 4; ++ty )
+    {
+        for( size_t tx = 0; tx < 4; ++tx )
+        {
+            const size_t cx = std::min<size_t>( tx, dnx - 1 );
+            const size_t cy = std::min<size_t>( ty, dny - 1 );
+
+            size_t ux, uy;
+            if ( transpose )
+            {
+                ux = ( revX ) ? ( nx - 1 - cy ) : cy;
+                uy = ( revY ) ? ( ny - 1 - cx ) : cx;
+            }
+            else
+            {
+                ux = ( revX ) ? ( nx - 1 - cx ) : cx;
+                uy = ( revY ) ? ( ny - 1 - cy ) : cy;
+            }
+
+            perm[ ty * 4 + tx ] = uy * 4 + ux;
+        }
+    }
+
+    const size_t sbw = std::max<size_t>( 1, ( width + 3 ) / 4 );
+    const size_t sbh = std::max<size_t>( 1, ( height + 3 ) / 4 );
+    const size_t dbw = ( transpose ) ? sbh : sbw;
+    const size_t dbh = ( transpose ) ? sbw : sbh;
+
+    if ( srcImage.rowPitch < sbw * blockSize || destImage.rowPitch < dbw * blockSize )
+        return E_FAIL;
+
+    for( size_t by = 0; by < dbh; ++by )
+    {
+        uint8_t* pDest = destImage.pixels + by * destImage.rowPitch;
+
+        for( size_t bx = 0; bx < dbw; ++bx, pDest += blockSize )
+        {
+            size_t sbx, sby;
+            if ( transpose )
+            {
+                sbx = ( revX ) ? ( sbw - 1 - by ) : by;
+                sby = ( revY ) ? ( sbh - 1 - bx ) : bx;
+            }
+            else
+            {
+                sbx = ( revX ) ? ( sbw - 1 - bx ) : bx;
+                sby = ( revY ) ? ( sbh - 1 - by ) : by;
+            }
+
+            const uint8_t* pSrc = srcImage.pixels + sby * srcImage.rowPitch + sbx * blockSize;
+
+            // Endpoints are copied as-is
+            memcpy( pDest, pSrc, blockSize );
+
+            for( size_t j = 0; j < nfields; ++j )
+            {
+                const size_t bits = fields[ j ].bits;
+                const size_t bytes = bits * 16 / 8;
+                const uint64_t mask = ( uint64_t(1) << bits ) - 1;
+
+                uint64_t sindices = 0;
+                memcpy( &sindices, pSrc + fields[ j ].offset, bytes );
+
+                uint64_t dindices = 0;
+                for( size_t i = 0; i < 16; ++i )
+                {
+                    dindices |= ( ( sindices >> ( perm[ i ] * bits ) ) & mask ) << ( i * bits );
+                }
+
+                memcpy( pDest + fields[ j ].offset, &dindices, bytes );
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Do flip/rotate operation using WIC
 //-------------------------------------------------------------------------------------
@@ -142,9 +523,11 @@ HRESULT FlipRotate( const Image& srcImage, DWORD flags, ScratchImage& image )
         return E_INVALIDARG;
 #endif
 
-    if ( IsCompressed( srcImage.format ) )
+    const bool native = _CanFlipRotateNative( srcImage.format );
+
+    if ( IsCompressed( srcImage.format ) && !native )
     {
-        // We don't support flip/rotate operations on compressed images
+        // Only BC1 - BC5 can be flipped/rotated without decompressing
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
@@ -186,14 +569,20 @@ HRESULT FlipRotate( const Image& srcImage, DWORD flags, ScratchImage& image )
         return E_POINTER;
 
     WICPixelFormatGUID pfGUID;
-    if ( _DXGIToWIC( srcImage.format, pfGUID ) )
+    if ( native )
     {
-        // Case 1: Source format is supported by Windows Imaging Component
+        // Case 1: Pixels (or BC blocks) can be moved directly
+        hr = IsCompressed( srcImage.format ) ? _PerformFlipRotateBlocks( srcImage, flags, *rimage )
+                                             : _PerformFlipRotatePixels( srcImage, flags, *rimage );
+    }
+    else if ( _DXGIToWIC( srcImage.format, pfGUID ) )
+    {
+        // Case 2: Source format is supported by Windows Imaging Component
         hr = _PerformFlipRotateUsingWIC( srcImage, flags, pfGUID, *rimage );
     }
     else
     {
-        // Case 2: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
+        // Case 3: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
         hr = _PerformFlipRotateViaF32( srcImage, flags, *rimage );
     }
 
@@ -217,9 +606,11 @@ HRESULT FlipRotate( const Image* srcImages, size_t nimages, const TexMetadata& m
     if ( !srcImages || !nimages )
         return E_INVALIDARG;
 
-    if ( IsCompressed( metadata.format ) )
+    const bool native = _CanFlipRotateNative( metadata.format );
+
+    if ( IsCompressed( metadata.format ) && !native )
     {
-        // We don't support flip/rotate operations on compressed images
+        // Only BC1 - BC5 can be flipped/rotated without decompressing
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
@@ -307,14 +698,20 @@ HRESULT FlipRotate( const Image* srcImages, size_t nimages, const TexMetadata& m
             }
         }
 
-        if (wicpf)
+        if ( native )
+        {
+            // Case 1: Pixels (or BC blocks) can be moved directly
+            hr = IsCompressed( metadata.format ) ? _PerformFlipRotateBlocks( src, flags, dst )
+                                                 : _PerformFlipRotatePixels( src, flags, dst );
+        }
+        else if (wicpf)
         {
-            // Case 1: Source format is supported by Windows Imaging Component
+            // Case 2: Source format is supported by Windows Imaging Component
             hr = _PerformFlipRotateUsingWIC( src, flags, pfGUID, dst );
         }
         else
         {
-            // Case 2: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
+            // Case 3: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
             hr = _PerformFlipRotateViaF32( src, flags, dst );
         }
 
@@ -20,7 +20,6 @@ namespace DirectX
 
 extern bool _CalculateMipLevels( _In_ size_t width, _In_ size_t height, _Inout_ size_t& mipLevels );
 extern bool _CalculateMipLevels3D( _In_ size_t width, _In_ size_t height, _In_ size_t depth, _Inout_ size_t& mipLevels );
-extern bool _IsAlphaAllOpaqueBC( _In_ const Image& cImage );
 
 //-------------------------------------------------------------------------------------
 // Determines number of image array entries and pixel size
@@ -240,6 +239,7 @@ ScratchImage& ScratchImage::operator= (ScratchImage&& moveFrom)
         _metadata = moveFrom._metadata;
         _image = moveFrom._image;
         _memory = moveFrom._memory;
+        _memoryAllocator = moveFrom._memoryAllocator;
 
         moveFrom._nimages = 0;
         moveFrom._size = 0;
@@ -331,7 +331,7 @@ HRESULT ScratchImage::Initialize( const TexMetadata& mdata, DWORD flags )
     _nimages = nimages;
     memset( _image, 0, sizeof(Image) * nimages );
 
-    _memory = reinterpret_cast<uint8_t*>( _aligned_malloc( pixelSize, 16 ) );
+    _memory = reinterpret_cast<uint8_t*>( _AllocateImageMemory( pixelSize, _allocator, _memoryAllocator ) );
     if ( !_memory )
     {
         Release();
@@ -400,7 +400,7 @@ HRESULT ScratchImage::Initialize2D( DXGI_FORMAT fmt, size_t width, size_t height
     _nimages = nimages;
     memset( _image, 0, sizeof(Image) * nimages );
 
-    _memory = reinterpret_cast<uint8_t*>( _aligned_malloc( pixelSize, 16 ) );
+    _memory = reinterpret_cast<uint8_t*>( _AllocateImageMemory( pixelSize, _allocator, _memoryAllocator ) );
     if ( !_memory )
     {
         Release();
@@ -452,7 +452,7 @@ HRESULT ScratchImage::Initialize3D( DXGI_FORMAT fmt, size_t width, size_t height
     _nimages = nimages;
     memset( _image, 0, sizeof(Image) * nimages );
 
-    _memory = reinterpret_cast<uint8_t*>( _aligned_malloc( pixelSize, 16 ) );
+    _memory = reinterpret_cast<uint8_t*>( _AllocateImageMemory( pixelSize, _allocator, _memoryAllocator ) );
     if ( !_memory )
     {
         Release();
@@ -667,7 +667,6 @@ HRESULT ScratchImage::Initialize3DFromImages( const Image* images, size_t depth,
 void ScratchImage::Release()
 {
     _nimages = 0;
-    _size = 0;
 
     if ( _image )
     {
@@ -677,13 +676,28 @@ void ScratchImage::Release()
 
     if ( _memory )
     {
-        _aligned_free( _memory );
+        _FreeImageMemory( _memory, _size, _memoryAllocator );
         _memory = 0;
     }
+
+    _size = 0;
     
     memset(&_metadata, 0, sizeof(_metadata));
 }
 
+_Use_decl_annotations_
+void ScratchImage::SetAllocator( const ImageAllocator* allocator )
+{
+    if ( allocator && allocator->pfAllocate && allocator->pfFree )
+    {
+        _allocator = *allocator;
+    }
+    else
+    {
+        memset( &_allocator, 0, sizeof(_allocator) );
+    }
+}
+
 _Use_decl_annotations_
 bool ScratchImage::OverrideFormat( DXGI_FORMAT f )
 {
@@ -772,50 +786,118 @@ bool ScratchImage::IsAlphaAllOpaque() const
     if ( !HasAlpha( _metadata.format ) )
         return true;
 
-    if ( IsCompressed( _metadata.format ) )
+    ImageStatistics stats;
+    if ( FAILED( ComputeImageStatistics( _image, _nimages, CSTATS_OPAQUE_ONLY, stats ) ) )
+        return false;
+
+    return stats.opaque;
+}
+
+
+//=====================================================================================
+// MappedImage - Read-only image container over a memory-mapped file
+//=====================================================================================
+
+MappedImage& MappedImage::operator= (MappedImage&& moveFrom)
+{
+    if ( this != &moveFrom )
     {
-        for( size_t index = 0; index < _nimages; ++index )
-        {
-            if ( !_IsAlphaAllOpaqueBC( _image[ index ] ) )
-                return false;
-        }
+        Release();
+
+        _nimages = moveFrom._nimages;
+        _size = moveFrom._size;
+        _metadata = moveFrom._metadata;
+        _image = moveFrom._image;
+        _view = moveFrom._view;
+        _memory = moveFrom._memory;
+
+        moveFrom._nimages = 0;
+        moveFrom._size = 0;
+        moveFrom._image = nullptr;
+        moveFrom._view = nullptr;
+        moveFrom._memory = nullptr;
     }
-    else
+    return *this;
+}
+
+//-------------------------------------------------------------------------------------
+// Takes ownership of the view (even on failure) and sets up images for the pixel
+// data which starts at 'offset' bytes into it
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT MappedImage::Initialize( const TexMetadata& mdata, void* view, size_t offset, size_t size )
+{
+    Release();
+
+    if ( !view )
+        return E_POINTER;
+
+    _view = view;
+
+    size_t pixelSize, nimages;
+    _DetermineImageArray( mdata, CP_FLAGS_NONE, nimages, pixelSize );
+
+    if ( offset > size || pixelSize > ( size - offset ) )
     {
-        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*_metadata.width), 16 ) ) );
-        if ( !scanline )
-            return false;
+        Release();
+        return E_FAIL;
+    }
 
-        static const XMVECTORF32 threshold = { 0.99f, 0.99f, 0.99f, 0.99f };
+    _image = new (std::nothrow) Image[ nimages ];
+    if ( !_image )
+    {
+        Release();
+        return E_OUTOFMEMORY;
+    }
 
-        for( size_t index = 0; index < _nimages; ++index )
-        {
-#pragma warning( suppress : 6011 )
-            const Image& img = _image[ index ];
+    _nimages = nimages;
+    memset( _image, 0, sizeof(Image) * nimages );
 
-            const uint8_t *pPixels = img.pixels;
-            assert( pPixels );
+    _metadata = mdata;
+    _memory = reinterpret_cast<uint8_t*>( view ) + offset;
+    _size = pixelSize;
 
-            for( size_t h = 0; h < img.height; ++h )
-            {
-                if ( !_LoadScanline( scanline.get(), img.width, pPixels, img.rowPitch, img.format ) )
-                    return false;
+    if ( !_SetupImageArray( _memory, pixelSize, _metadata, CP_FLAGS_NONE, _image, nimages ) )
+    {
+        Release();
+        return E_FAIL;
+    }
 
-                XMVECTOR* ptr = scanline.get();
-                for( size_t w = 0; w < img.width; ++w )
-                {
-                    XMVECTOR alpha = XMVectorSplatW( *ptr );
-                    if ( XMVector4Less( alpha, threshold ) )
-                        return false;
-                    ++ptr;
-                }
+    return S_OK;
+}
 
-                pPixels += img.rowPitch;
-            }
-        }
+void MappedImage::Release()
+{
+    _nimages = 0;
+    _size = 0;
+    _memory = 0;
+
+    if ( _image )
+    {
+        delete [] _image;
+        _image = 0;
     }
 
-    return true;
+    if ( _view )
+    {
+        UnmapViewOfFile( _view );
+        _view = 0;
+    }
+
+    memset(&_metadata, 0, sizeof(_metadata));
+}
+
+_Use_decl_annotations_
+const Image* MappedImage::GetImage(size_t mip, size_t item, size_t slice) const
+{
+    if ( !_image )
+        return nullptr;
+
+    size_t index = _metadata.ComputeIndex( mip, item, slice );
+    if ( index >= _nimages )
+        return nullptr;
+
+    return &_image[index];
 }
 
 }; // namespace
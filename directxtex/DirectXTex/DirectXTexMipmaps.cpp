@@ -414,7 +414,8 @@ static bool _UseWICFiltering( _In_ DXGI_FORMAT format, _In_ DWORD filter )
         break;
 
     case TEX_FILTER_TRIANGLE:
-        // WIC does not implement this filter
+    case TEX_FILTER_LANCZOS:
+        // WIC does not implement these filters
         return false;
     }
 
@@ -601,20 +602,16 @@ static HRESULT _Setup2DMips( _In_reads_(nimages) const Image* baseImages, _In_ s
 }
 
 //--- 2D Point Filter ---
-static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const ScratchImage& mipChain, _In_ size_t item )
+static HRESULT _Generate2DMipsPointRows( _In_ const Image& src, _In_ const Image& dest, _In_ size_t y0, _In_ size_t y1 )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
+    size_t width = src.width;
+    size_t height = src.height;
 
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
+    size_t nwidth = dest.width;
+    size_t nheight = dest.height;
 
     // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*2), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*2) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -622,62 +619,42 @@ static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const Scratc
 
     XMVECTOR* row = target + width;
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
 #ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
+    memset( row, 0xCD, sizeof(XMVECTOR)*width );
 #endif
 
-        // 2D point filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
+    const uint8_t* pSrc = src.pixels;
+    uint8_t* pDest = dest.pixels + (dest.rowPitch * y0);
 
-        if ( !src || !dest )
-            return E_POINTER;
+    size_t rowPitch = src.rowPitch;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
+    size_t xinc = ( width << 16 ) / nwidth;
+    size_t yinc = ( height << 16 ) / nheight;
 
-        size_t rowPitch = src->rowPitch;
+    size_t lasty = size_t(-1);
 
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-
-        size_t xinc = ( width << 16 ) / nwidth;
-        size_t yinc = ( height << 16 ) / nheight;
-
-        size_t lasty = size_t(-1);
-
-        size_t sy = 0;
-        for( size_t y = 0; y < nheight; ++y )
+    size_t sy = yinc * y0;
+    for( size_t y = y0; y < y1; ++y )
+    {
+        if ( (lasty ^ sy) >> 16 )
         {
-            if ( (lasty ^ sy) >> 16 )
-            {
-                if ( !_LoadScanline( row, width, pSrc + ( rowPitch * (sy >> 16) ), rowPitch, src->format ) )
-                    return E_FAIL;
-                lasty = sy;
-            }
-
-            size_t sx = 0;
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                target[ x ] = row[ sx >> 16 ];
-                sx += xinc;
-            }
-
-            if ( !_StoreScanline( pDest, dest->rowPitch, dest->format, target, nwidth ) )
+            if ( !_LoadScanline( row, width, pSrc + ( rowPitch * (sy >> 16) ), rowPitch, src.format ) )
                 return E_FAIL;
-            pDest += dest->rowPitch;
+            lasty = sy;
+        }
 
-            sy += yinc;
+        size_t sx = 0;
+        for( size_t x = 0; x < nwidth; ++x )
+        {
+            target[ x ] = row[ sx >> 16 ];
+            sx += xinc;
         }
 
-        if ( height > 1 )
-            height >>= 1;
+        if ( !_StoreScanline( pDest, dest.rowPitch, dest.format, target, nwidth ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
 
-        if ( width > 1 )
-            width >>= 1;
+        sy += yinc;
     }
 
     return S_OK;
@@ -685,601 +662,619 @@ static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const Scratc
 
 
 //--- 2D Box Filter ---
-static HRESULT _Generate2DMipsBoxFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+static HRESULT _Generate2DMipsBoxRows( _In_ const Image& src, _In_ const Image& dest, _In_ DWORD filter, _In_ size_t y0, _In_ size_t y1 )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
+    size_t width = src.width;
+    size_t height = src.height;
 
     if ( !ispow2(width) || !ispow2(height) )
         return E_FAIL;
 
+    size_t nwidth = dest.width;
+
     // Allocate temporary space (3 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*3), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*3) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
     XMVECTOR* target = scanline.get();
 
     XMVECTOR* urow0 = target + width;
-    XMVECTOR* urow1 = target + width*2;
+    XMVECTOR* urow1 = ( height > 1 ) ? ( target + width*2 ) : urow0;
 
-    const XMVECTOR* urow2 = urow0 + 1;
-    const XMVECTOR* urow3 = urow1 + 1;
+    const XMVECTOR* urow2 = ( width > 1 ) ? ( urow0 + 1 ) : urow0;
+    const XMVECTOR* urow3 = ( width > 1 ) ? ( urow1 + 1 ) : urow1;
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
+    size_t rowPitch = src.rowPitch;
+
+    const uint8_t* pSrc = src.pixels + (rowPitch * ( ( height > 1 ) ? ( y0 << 1 ) : y0 ));
+    uint8_t* pDest = dest.pixels + (dest.rowPitch * y0);
+
+    for( size_t y = y0; y < y1; ++y )
     {
-        if ( height <= 1 )
+        if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src.format, filter ) )
+            return E_FAIL;
+        pSrc += rowPitch;
+
+        if ( urow0 != urow1 )
         {
-            urow1 = urow0;
+            if ( !_LoadScanlineLinear( urow1, width, pSrc, rowPitch, src.format, filter ) )
+                return E_FAIL;
+            pSrc += rowPitch;
         }
 
-        if ( width <= 1 )
+        for( size_t x = 0; x < nwidth; ++x )
         {
-            urow2 = urow0;
-            urow3 = urow1;
+            size_t x2 = x << 1;
+
+            AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
         }
 
-        // 2D box filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, nwidth, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
+    }
 
-        if ( !src || !dest )
-            return E_POINTER;
+    return S_OK;
+}
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
 
-        size_t rowPitch = src->rowPitch;
+//--- 2D Linear and Cubic Filters ---
+//   Each source row is filtered horizontally once and kept while the output rows that need it are filtered
+//   vertically, which gives the same results as interpolating each output pixel in 2D
+static bool _LoadLinearRow( _Out_writes_(nwidth) XMVECTOR* pDestination, _In_ size_t nwidth, _Inout_ XMVECTOR* row,
+                            _In_ const Image& src, _In_ size_t y, _In_reads_(nwidth) const LinearFilter* lfX, _In_ DWORD filter )
+{
+    if ( !_LoadScanlineLinear( row, src.width, src.pixels + (src.rowPitch * y), src.rowPitch, src.format, filter ) )
+        return false;
 
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
+    for( size_t x = 0; x < nwidth; ++x )
+    {
+        auto& toX = lfX[ x ];
 
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src->format, filter ) )
-                return E_FAIL;
-            pSrc += rowPitch;
+        pDestination[x] = row[ toX.u0 ] * toX.weight0 + row[ toX.u1 ] * toX.weight1;
+    }
+
+    return true;
+}
+
+static bool _LoadCubicRow( _Out_writes_(nwidth) XMVECTOR* pDestination, _In_ size_t nwidth, _Inout_ XMVECTOR* row,
+                           _In_ const Image& src, _In_ size_t y, _In_reads_(nwidth) const CubicFilter* cfX, _In_ DWORD filter )
+{
+    if ( !_LoadScanlineLinear( row, src.width, src.pixels + (src.rowPitch * y), src.rowPitch, src.format, filter ) )
+        return false;
+
+    for( size_t x = 0; x < nwidth; ++x )
+    {
+        auto& toX = cfX[ x ];
 
-            if ( urow0 != urow1 )
+        CUBIC_INTERPOLATE( pDestination[x], toX.x, row[ toX.u0 ], row[ toX.u1 ], row[ toX.u2 ], row[ toX.u3 ] );
+    }
+
+    return true;
+}
+
+static HRESULT _Generate2DMipsLinearRows( _In_ const Image& src, _In_ const Image& dest, _In_ DWORD filter,
+                                          _In_ const LinearFilter* lfX, _In_ const LinearFilter* lfY, _In_ size_t y0, _In_ size_t y1 )
+{
+    size_t width = src.width;
+    size_t nwidth = dest.width;
+
+    // Allocate temporary space (1 source scanline, 2 filtered scanlines, plus the target)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*(width + nwidth*3)) ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
+
+    XMVECTOR* row = scanline.get();
+    XMVECTOR* target = row + width;
+
+    XMVECTOR* row0 = target + nwidth;
+    XMVECTOR* row1 = target + nwidth*2;
+
+    size_t u0 = size_t(-1);
+    size_t u1 = size_t(-1);
+
+    uint8_t* pDest = dest.pixels + (dest.rowPitch * y0);
+
+    for( size_t y = y0; y < y1; ++y )
+    {
+        auto& toY = lfY[ y ];
+
+        if ( toY.u0 != u0 )
+        {
+            if ( toY.u0 != u1 )
             {
-                if ( !_LoadScanlineLinear( urow1, width, pSrc, rowPitch, src->format, filter ) )
+                u0 = toY.u0;
+
+                if ( !_LoadLinearRow( row0, nwidth, row, src, u0, lfX, filter ) )
                     return E_FAIL;
-                pSrc += rowPitch;
             }
-
-            for( size_t x = 0; x < nwidth; ++x )
+            else
             {
-                size_t x2 = x << 1;
+                u0 = u1;
+                u1 = size_t(-1);
 
-                AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
+                std::swap( row0, row1 );
             }
+        }
+
+        if ( toY.u1 != u1 )
+        {
+            u1 = toY.u1;
 
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
+            if ( !_LoadLinearRow( row1, nwidth, row, src, u1, lfX, filter ) )
                 return E_FAIL;
-            pDest += dest->rowPitch;
         }
 
-        if ( height > 1 )
-            height >>= 1;
+        for( size_t x = 0; x < nwidth; ++x )
+        {
+            target[x] = ( toY.weight0 * row0[x] ) + ( toY.weight1 * row1[x] );
+        }
 
-        if ( width > 1 )
-            width >>= 1;
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, nwidth, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
     }
 
     return S_OK;
 }
 
-
-//--- 2D Linear Filter ---
-static HRESULT _Generate2DMipsLinearFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+static HRESULT _Generate2DMipsCubicRows( _In_ const Image& src, _In_ const Image& dest, _In_ DWORD filter,
+                                         _In_ const CubicFilter* cfX, _In_ const CubicFilter* cfY, _In_ size_t y0, _In_ size_t y1 )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
+    size_t width = src.width;
+    size_t nwidth = dest.width;
 
-    // Allocate temporary space (3 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*3), 16 ) ) );
+    // Allocate temporary space (1 source scanline, 4 filtered scanlines, plus the target)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*(width + nwidth*5)) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
-    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ width+height ] );
-    if ( !lf )
-        return E_OUTOFMEMORY;
-
-    LinearFilter* lfX = lf.get();
-    LinearFilter* lfY = lf.get() + width;
- 
-    XMVECTOR* target = scanline.get();
+    XMVECTOR* row = scanline.get();
+    XMVECTOR* target = row + width;
 
-    XMVECTOR* row0 = target + width;
-    XMVECTOR* row1 = target + width*2;
+    XMVECTOR* row0 = target + nwidth;
+    XMVECTOR* row1 = target + nwidth*2;
+    XMVECTOR* row2 = target + nwidth*3;
+    XMVECTOR* row3 = target + nwidth*4;
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        // 2D linear filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
+    size_t u0 = size_t(-1);
+    size_t u1 = size_t(-1);
+    size_t u2 = size_t(-1);
+    size_t u3 = size_t(-1);
 
-        if ( !src || !dest )
-            return E_POINTER;
+    uint8_t* pDest = dest.pixels + (dest.rowPitch * y0);
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
+    for( size_t y = y0; y < y1; ++y )
+    {
+        auto& toY = cfY[ y ];
 
-        size_t rowPitch = src->rowPitch;
+        // Scanline 1
+        if ( toY.u0 != u0 )
+        {
+            if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
+            {
+                u0 = toY.u0;
 
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        _CreateLinearFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
+                if ( !_LoadCubicRow( row0, nwidth, row, src, u0, cfX, filter ) )
+                    return E_FAIL;
+            }
+            else if ( toY.u0 == u1 )
+            {
+                u0 = u1;
+                u1 = size_t(-1);
 
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        _CreateLinearFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
+                std::swap( row0, row1 );
+            }
+            else if ( toY.u0 == u2 )
+            {
+                u0 = u2;
+                u2 = size_t(-1);
 
-#ifdef _DEBUG
-        memset( row0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( row1, 0xDD, sizeof(XMVECTOR)*width );
-#endif
+                std::swap( row0, row2 );
+            }
+            else if ( toY.u0 == u3 )
+            {
+                u0 = u3;
+                u3 = size_t(-1);
 
-        size_t u0 = size_t(-1);
-        size_t u1 = size_t(-1);
+                std::swap( row0, row3 );
+            }
+        }
 
-        for( size_t y = 0; y < nheight; ++y )
+        // Scanline 2
+        if ( toY.u1 != u1 )
         {
-            auto& toY = lfY[ y ];
+            if ( toY.u1 != u2 && toY.u1 != u3 )
+            {
+                u1 = toY.u1;
 
-            if ( toY.u0 != u0 )
+                if ( !_LoadCubicRow( row1, nwidth, row, src, u1, cfX, filter ) )
+                    return E_FAIL;
+            }
+            else if ( toY.u1 == u2 )
             {
-                if ( toY.u0 != u1 )
-                {
-                    u0 = toY.u0;
+                u1 = u2;
+                u2 = size_t(-1);
 
-                    if ( !_LoadScanlineLinear( row0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else
-                {
-                    u0 = u1;
-                    u1 = size_t(-1);
+                std::swap( row1, row2 );
+            }
+            else if ( toY.u1 == u3 )
+            {
+                u1 = u3;
+                u3 = size_t(-1);
 
-                    std::swap( row0, row1 );
-                }
+                std::swap( row1, row3 );
             }
+        }
 
-            if ( toY.u1 != u1 )
+        // Scanline 3
+        if ( toY.u2 != u2 )
+        {
+            if ( toY.u2 != u3 )
             {
-                u1 = toY.u1;
+                u2 = toY.u2;
 
-                if ( !_LoadScanlineLinear( row1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
+                if ( !_LoadCubicRow( row2, nwidth, row, src, u2, cfX, filter ) )
                     return E_FAIL;
             }
-
-            for( size_t x = 0; x < nwidth; ++x )
+            else
             {
-                auto& toX = lfX[ x ];
+                u2 = u3;
+                u3 = size_t(-1);
 
-                BILINEAR_INTERPOLATE( target[x], toX, toY, row0, row1 );
+                std::swap( row2, row3 );
             }
+        }
+
+        // Scanline 4
+        if ( toY.u3 != u3 )
+        {
+            u3 = toY.u3;
 
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
+            if ( !_LoadCubicRow( row3, nwidth, row, src, u3, cfX, filter ) )
                 return E_FAIL;
-            pDest += dest->rowPitch;
         }
 
-        if ( height > 1 )
-            height >>= 1;
+        for( size_t x = 0; x < nwidth; ++x )
+        {
+            CUBIC_INTERPOLATE( target[x], toY.x, row0[x], row1[x], row2[x], row3[x] );
+        }
 
-        if ( width > 1 )
-            width >>= 1;
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, nwidth, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
     }
 
     return S_OK;
 }
 
 
-//--- 2D Cubic Filter ---
-static HRESULT _Generate2DMipsCubicFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+//--- 2D Triangle Filter ---
+static HRESULT _Generate2DMipsTriangleLevel( _In_ const Image& src, _In_ const Image& dest, _In_ DWORD filter )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
+    using namespace TriangleFilter;
 
-    assert( levels > 1 );
+    size_t width = src.width;
+    size_t height = src.height;
 
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
+    size_t nwidth = dest.width;
+    size_t nheight = dest.height;
 
-    // Allocate temporary space (5 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
+    // Allocate temporary space (1 scanline, accumulation rows, plus X and Y filters)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * width ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
-    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ width+height ] );
-    if ( !cf )
+    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ nheight ] );
+    if ( !rowActive )
         return E_OUTOFMEMORY;
 
-    CubicFilter* cfX = cf.get();
-    CubicFilter* cfY = cf.get() + width;
- 
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row0 = target + width;
-    XMVECTOR* row1 = target + width*2;
-    XMVECTOR* row2 = target + width*3;
-    XMVECTOR* row3 = target + width*4;
+    TriangleRow * rowFree = nullptr;
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        // 2D cubic filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
+    std::unique_ptr<Filter> tfX, tfY;
 
-        if (  !src || !dest )
-            return E_POINTER;
+    XMVECTOR* row = scanline.get();
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
+    const uint8_t* pSrc = src.pixels;
+    size_t rowPitch = src.rowPitch;
+    const uint8_t* pEndSrc = pSrc + rowPitch * height;
 
-        size_t rowPitch = src->rowPitch;
+    uint8_t* pDest = dest.pixels;
 
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        _CreateCubicFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
+    HRESULT hr = _Create( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
+    if ( FAILED(hr) )
+        return hr;
 
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        _CreateCubicFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
+    hr = _Create( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
+    if ( FAILED(hr) )
+        return hr;
 
 #ifdef _DEBUG
-        memset( row0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( row1, 0xDD, sizeof(XMVECTOR)*width );
-        memset( row2, 0xED, sizeof(XMVECTOR)*width );
-        memset( row3, 0xFD, sizeof(XMVECTOR)*width );
+    memset( row, 0xCD, sizeof(XMVECTOR)*width );
 #endif
 
-        size_t u0 = size_t(-1);
-        size_t u1 = size_t(-1);
-        size_t u2 = size_t(-1);
-        size_t u3 = size_t(-1);
+    auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX.get() ) + tfX->sizeInBytes );
+    auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY.get() ) + tfY->sizeInBytes );
 
-        for( size_t y = 0; y < nheight; ++y )
+    // Count times rows get written
+    for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
+    {
+        for ( size_t j = 0; j < yFrom->count; ++j )
         {
-            auto& toY = cfY[ y ];
-
-            // Scanline 1
-            if ( toY.u0 != u0 )
-            {
-                if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
-                {
-                    u0 = toY.u0;
-
-                    if ( !_LoadScanlineLinear( row0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else if ( toY.u0 == u1 )
-                {
-                    u0 = u1;
-                    u1 = size_t(-1);
+            size_t v = yFrom->to[ j ].u;
+            assert( v < nheight );
+            TriangleRow* rowAcc = &rowActive.get()[ v ];
 
-                    std::swap( row0, row1 );
-                }
-                else if ( toY.u0 == u2 )
-                {
-                    u0 = u2;
-                    u2 = size_t(-1);
+            ++rowAcc->remaining;
+        }
 
-                    std::swap( row0, row2 );
-                }
-                else if ( toY.u0 == u3 )
-                {
-                    u0 = u3;
-                    u3 = size_t(-1);
+        yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
+    }
 
-                    std::swap( row0, row3 );
-                }
-            }
+    // Filter image
+    for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
+    {
+        // Create accumulation rows as needed
+        for ( size_t j = 0; j < yFrom->count; ++j )
+        {
+            size_t v = yFrom->to[ j ].u;
+            assert( v < nheight );
+            TriangleRow* rowAcc = &rowActive.get()[ v ];
 
-            // Scanline 2
-            if ( toY.u1 != u1 )
+            if ( !rowAcc->scanline )
             {
-                if ( toY.u1 != u2 && toY.u1 != u3 )
+                if ( rowFree )
                 {
-                    u1 = toY.u1;
-
-                    if ( !_LoadScanlineLinear( row1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                        return E_FAIL;
+                    // Steal and reuse scanline from 'free row' list
+                    assert( rowFree->scanline != 0 );
+                    rowAcc->scanline.reset( rowFree->scanline.release() );
+                    rowFree = rowFree->next;
                 }
-                else if ( toY.u1 == u2 )
+                else
                 {
-                    u1 = u2;
-                    u2 = size_t(-1);
-
-                    std::swap( row1, row2 );
+                    rowAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * nwidth ) ) );
+                    if ( !rowAcc->scanline )
+                        return E_OUTOFMEMORY;
                 }
-                else if ( toY.u1 == u3 )
-                {
-                    u1 = u3;
-                    u3 = size_t(-1);
 
-                    std::swap( row1, row3 );
-                }
+                memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
             }
+        }
+
+        // Load source scanline
+        if ( (pSrc + rowPitch) > pEndSrc )
+            return E_FAIL;
 
-            // Scanline 3
-            if ( toY.u2 != u2 )
+        if ( !_LoadScanlineLinear( row, width, pSrc, rowPitch, src.format, filter ) )
+            return E_FAIL;
+
+        pSrc += rowPitch;
+
+        // Process row
+        size_t x = 0;
+        for( FilterFrom* xFrom = tfX->from; xFrom < xFromEnd; ++x )
+        {
+            for ( size_t j = 0; j < yFrom->count; ++j )
             {
-                if ( toY.u2 != u3 )
-                {
-                    u2 = toY.u2;
+                size_t v = yFrom->to[ j ].u;
+                assert( v < nheight );
+                float yweight = yFrom->to[ j ].weight;
 
-                    if ( !_LoadScanlineLinear( row2, width, pSrc + (rowPitch * u2), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else
+                XMVECTOR* accPtr = rowActive[ v ].scanline.get();
+                if ( !accPtr )
+                    return E_POINTER;
+
+                for ( size_t k = 0; k < xFrom->count; ++k )
                 {
-                    u2 = u3;
-                    u3 = size_t(-1);
+                    size_t u = xFrom->to[ k ].u;
+                    assert( u < nwidth );
 
-                    std::swap( row2, row3 );
+                    XMVECTOR weight = XMVectorReplicate( yweight * xFrom->to[ k ].weight );
+
+                    assert( x < width );
+                    accPtr[ u ] = XMVectorMultiplyAdd( row[ x ], weight, accPtr[ u ] );
                 }
             }
 
-            // Scanline 4
-            if ( toY.u3 != u3 )
-            {
-                u3 = toY.u3;
+            xFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( xFrom ) + xFrom->sizeInBytes );
+        }
 
-                if ( !_LoadScanlineLinear( row3, width, pSrc + (rowPitch * u3), rowPitch, src->format, filter ) )
-                    return E_FAIL;
-            }
+        // Write completed accumulation rows
+        for ( size_t j = 0; j < yFrom->count; ++j )
+        {
+            size_t v = yFrom->to[ j ].u;
+            assert( v < nheight );
+            TriangleRow* rowAcc = &rowActive.get()[ v ];
 
-            for( size_t x = 0; x < nwidth; ++x )
+            assert( rowAcc->remaining > 0 );
+            --rowAcc->remaining;
+
+            if ( !rowAcc->remaining )
             {
-                auto& toX = cfX[ x ];
+                XMVECTOR* pAccSrc = rowAcc->scanline.get();
+                if ( !pAccSrc )
+                    return E_POINTER;
 
-                XMVECTOR C0, C1, C2, C3;
+                switch( dest.format )
+                {
+                case DXGI_FORMAT_R10G10B10A2_UNORM:
+                case DXGI_FORMAT_R10G10B10A2_UINT:
+                    {
+                        // Need to slightly bias results for floating-point error accumulation which can
+                        // be visible with harshly quantized values
+                        static const XMVECTORF32 Bias = { 0.f, 0.f, 0.f, 0.1f };
+                   
+                        XMVECTOR* ptr = pAccSrc;
+                        for( size_t i=0; i < dest.width; ++i, ++ptr )
+                        {
+                            *ptr = XMVectorAdd( *ptr, Bias );
+                        }
+                    }
+                    break;
+                }
 
-                CUBIC_INTERPOLATE( C0, toX.x, row0[ toX.u0 ], row0[ toX.u1 ], row0[ toX.u2 ], row0[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C1, toX.x, row1[ toX.u0 ], row1[ toX.u1 ], row1[ toX.u2 ], row1[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C2, toX.x, row2[ toX.u0 ], row2[ toX.u1 ], row2[ toX.u2 ], row2[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C3, toX.x, row3[ toX.u0 ], row3[ toX.u1 ], row3[ toX.u2 ], row3[ toX.u3 ] );
+                // This performs any required clamping
+                if ( !_StoreScanlineLinear( pDest + (dest.rowPitch * v), dest.rowPitch, dest.format, pAccSrc, dest.width, filter ) )
+                    return E_FAIL;
 
-                CUBIC_INTERPOLATE( target[x], toY.x, C0, C1, C2, C3 );
+                // Put row on freelist to reuse it's allocated scanline
+                rowAcc->next = rowFree;
+                rowFree = rowAcc;
             }
-
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
         }
 
-        if ( height > 1 )
-            height >>= 1;
-
-        if ( width > 1 )
-            width >>= 1;
+        yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
     }
 
     return S_OK;
 }
 
 
-//--- 2D Triangle Filter ---
-static HRESULT _Generate2DMipsTriangleFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
-{
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    using namespace TriangleFilter;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
-
-    // Allocate initial temporary space (1 scanline, accumulation rows, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * width, 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+//-------------------------------------------------------------------------------------
+// Generates one mip level for a set of images of the same size
+//   Point, box, linear and cubic split each image into bands of rows; the triangle filter accumulates the rows
+//   of an image in order, so it is one work item per image. Linear and cubic filter tables are built once
+//   and shared by all the images.
+//-------------------------------------------------------------------------------------
+#define MIPS_TASK_ROWS 16
 
-    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ height ] );
-    if ( !rowActive )
-        return E_OUTOFMEMORY;
+struct Generate2DMipsLevelTask
+{
+    const Image*        srcImages;
+    const Image*        destImages;
+    size_t              bands;
+    DWORD               filter;
+    DWORD               filter_select;
+    const LinearFilter* lfX;
+    const LinearFilter* lfY;
+    const CubicFilter*  cfX;
+    const CubicFilter*  cfY;
+};
+
+static HRESULT _Generate2DMipsLevel_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const Generate2DMipsLevelTask* task = reinterpret_cast<const Generate2DMipsLevelTask*>( pContext );
+    assert( task && task->bands > 0 );
 
-    TriangleRow * rowFree = nullptr;
+    const size_t index = item / task->bands;
+    const Image& src = task->srcImages[ index ];
+    const Image& dest = task->destImages[ index ];
 
-    std::unique_ptr<Filter> tfX, tfY;
+    if ( !src.pixels || !dest.pixels )
+        return E_POINTER;
 
-    XMVECTOR* row = scanline.get();
+    const size_t y0 = ( item % task->bands ) * MIPS_TASK_ROWS;
+    const size_t y1 = std::min<size_t>( y0 + MIPS_TASK_ROWS, dest.height );
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
+    switch( task->filter_select )
     {
-        // 2D triangle filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
-
-        if ( !src || !dest )
-            return E_POINTER;
-
-        const uint8_t* pSrc = src->pixels;
-        size_t rowPitch = src->rowPitch;
-        const uint8_t* pEndSrc = pSrc + rowPitch * height;
-
-        uint8_t* pDest = dest->pixels;
+    case TEX_FILTER_BOX:
+        return _Generate2DMipsBoxRows( src, dest, task->filter, y0, y1 );
 
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        HRESULT hr = _Create( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
-        if ( FAILED(hr) )
-            return hr;
-        
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        hr = _Create( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
-        if ( FAILED(hr) )
-            return hr;
+    case TEX_FILTER_POINT:
+        return _Generate2DMipsPointRows( src, dest, y0, y1 );
 
-#ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
-#endif
+    case TEX_FILTER_LINEAR:
+        return _Generate2DMipsLinearRows( src, dest, task->filter, task->lfX, task->lfY, y0, y1 );
 
-        auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX.get() ) + tfX->sizeInBytes );
-        auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY.get() ) + tfY->sizeInBytes );
+    case TEX_FILTER_CUBIC:
+        return _Generate2DMipsCubicRows( src, dest, task->filter, task->cfX, task->cfY, y0, y1 );
 
-        // Count times rows get written (and clear out any leftover accumulation rows from last miplevel)
-        for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
-        {
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive.get()[ v ];
+    case TEX_FILTER_TRIANGLE:
+        return _Generate2DMipsTriangleLevel( src, dest, task->filter );
 
-                ++rowAcc->remaining;
+    default:
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+}
 
-                if ( rowAcc->scanline )
-                {
-                    memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
-                }
-            }
+static HRESULT _Generate2DMipsLevel( _In_reads_(nimages) const Image* srcImages, _In_reads_(nimages) const Image* destImages, _In_ size_t nimages,
+                                     _In_ DWORD filter, _In_ DWORD filter_select, _In_ bool parallel )
+{
+    assert( srcImages && destImages && nimages > 0 );
 
-            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
-        }
+    size_t width = srcImages[0].width;
+    size_t height = srcImages[0].height;
 
-        // Filter image
-        for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
-        {
-            // Create accumulation rows as needed
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive.get()[ v ];
+    size_t nwidth = destImages[0].width;
+    size_t nheight = destImages[0].height;
 
-                if ( !rowAcc->scanline )
-                {
-                    if ( rowFree )
-                    {
-                        // Steal and reuse scanline from 'free row' list
-                        // (it will always be at least as wide as nwidth due to loop decending order)
-                        assert( rowFree->scanline != 0 );
-                        rowAcc->scanline.reset( rowFree->scanline.release() );
-                        rowFree = rowFree->next;
-                    }
-                    else
-                    {
-                        rowAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * nwidth, 16 ) ) );
-                        if ( !rowAcc->scanline )
-                            return E_OUTOFMEMORY;
-                    }
+    Generate2DMipsLevelTask task;
+    memset( &task, 0, sizeof(task) );
+    task.srcImages = srcImages;
+    task.destImages = destImages;
+    task.bands = ( filter_select == TEX_FILTER_TRIANGLE ) ? 1 : ( ( nheight + MIPS_TASK_ROWS - 1 ) / MIPS_TASK_ROWS );
+    task.filter = filter;
+    task.filter_select = filter_select;
 
-                    memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
-                }
-            }
+    std::unique_ptr<LinearFilter[]> lf;
+    std::unique_ptr<CubicFilter[]> cf;
 
-            // Load source scanline
-            if ( (pSrc + rowPitch) > pEndSrc )
-                return E_FAIL;
+    switch( filter_select )
+    {
+    case TEX_FILTER_LINEAR:
+        lf.reset( new (std::nothrow) LinearFilter[ nwidth+nheight ] );
+        if ( !lf )
+            return E_OUTOFMEMORY;
 
-            if ( !_LoadScanlineLinear( row, width, pSrc, rowPitch, src->format, filter ) )
-                return E_FAIL;
+        _CreateLinearFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, lf.get() );
+        _CreateLinearFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, lf.get() + nwidth );
 
-            pSrc += rowPitch;
+        task.lfX = lf.get();
+        task.lfY = lf.get() + nwidth;
+        break;
 
-            // Process row
-            size_t x = 0;
-            for( FilterFrom* xFrom = tfX->from; xFrom < xFromEnd; ++x )
-            {
-                for ( size_t j = 0; j < yFrom->count; ++j )
-                {
-                    size_t v = yFrom->to[ j ].u;
-                    assert( v < nheight );
-                    float yweight = yFrom->to[ j ].weight;
+    case TEX_FILTER_CUBIC:
+        cf.reset( new (std::nothrow) CubicFilter[ nwidth+nheight ] );
+        if ( !cf )
+            return E_OUTOFMEMORY;
 
-                    XMVECTOR* accPtr = rowActive[ v ].scanline.get();
-                    if ( !accPtr )
-                        return E_POINTER;
+        _CreateCubicFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cf.get() );
+        _CreateCubicFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cf.get() + nwidth );
 
-                    for ( size_t k = 0; k < xFrom->count; ++k )
-                    {
-                        size_t u = xFrom->to[ k ].u;
-                        assert( u < nwidth );
+        task.cfX = cf.get();
+        task.cfY = cf.get() + nwidth;
+        break;
+    }
 
-                        XMVECTOR weight = XMVectorReplicate( yweight * xFrom->to[ k ].weight );
+    return _RunTasks( nimages * task.bands, parallel, _Generate2DMipsLevel_Task, &task );
+}
 
-                        assert( x < width );
-                        accPtr[ u ] = XMVectorMultiplyAdd( row[ x ], weight, accPtr[ u ] );
-                    }
-                }
 
-                xFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( xFrom ) + xFrom->sizeInBytes );
-            }
+//--- Generates the mip chain of every array item ---
+static HRESULT _Generate2DMips( _In_ size_t levels, _In_ DWORD filter, _In_ DWORD filter_select, _In_ const ScratchImage& mipChain, _In_ bool parallel )
+{
+    if ( !mipChain.GetImages() )
+        return E_INVALIDARG;
 
-            // Write completed accumulation rows
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive.get()[ v ];
+    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
 
-                assert( rowAcc->remaining > 0 );
-                --rowAcc->remaining;
+    assert( levels > 1 );
 
-                if ( !rowAcc->remaining )
-                {
-                    XMVECTOR* pAccSrc = rowAcc->scanline.get();
-                    if ( !pAccSrc )
-                        return E_POINTER;
+    const size_t nitems = mipChain.GetMetadata().arraySize;
 
-                    switch( dest->format )
-                    {
-                    case DXGI_FORMAT_R10G10B10A2_UNORM:
-                    case DXGI_FORMAT_R10G10B10A2_UINT:
-                        {
-                            // Need to slightly bias results for floating-point error accumulation which can
-                            // be visible with harshly quantized values
-                            static const XMVECTORF32 Bias = { 0.f, 0.f, 0.f, 0.1f };
-                       
-                            XMVECTOR* ptr = pAccSrc;
-                            for( size_t i=0; i < dest->width; ++i, ++ptr )
-                            {
-                                *ptr = XMVectorAdd( *ptr, Bias );
-                            }
-                        }
-                        break;
-                    }
+    std::vector<Image> srcImages( nitems );
+    std::vector<Image> destImages( nitems );
 
-                    // This performs any required clamping
-                    if ( !_StoreScanlineLinear( pDest + (dest->rowPitch * v), dest->rowPitch, dest->format, pAccSrc, dest->width, filter ) )
-                        return E_FAIL;
+    // Each level is made from the one before it, so the levels are generated in order
+    for( size_t level=1; level < levels; ++level )
+    {
+        for( size_t item=0; item < nitems; ++item )
+        {
+            const Image* src = mipChain.GetImage( level-1, item, 0 );
+            const Image* dest = mipChain.GetImage( level, item, 0 );
 
-                    // Put row on freelist to reuse it's allocated scanline
-                    rowAcc->next = rowFree;
-                    rowFree = rowAcc;
-                }
-            }
+            if ( !src || !dest )
+                return E_POINTER;
 
-            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
+            srcImages[ item ] = *src;
+            destImages[ item ] = *dest;
         }
 
-        if ( height > 1 )
-            height >>= 1;
-
-        if ( width > 1 )
-            width >>= 1;
+        HRESULT hr = _Generate2DMipsLevel( &srcImages[0], &destImages[0], nitems, filter, filter_select, parallel );
+        if ( FAILED(hr) )
+            return hr;
     }
 
     return S_OK;
@@ -1354,7 +1349,7 @@ static HRESULT _Generate3DMipsPointFilter( _In_ size_t depth, _In_ size_t levels
     size_t height = mipChain.GetMetadata().height;
 
     // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*2), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*2) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -1503,7 +1498,7 @@ static HRESULT _Generate3DMipsBoxFilter( _In_ size_t depth, _In_ size_t levels,
         return E_FAIL;
 
     // Allocate temporary space (5 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*5) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -1672,7 +1667,7 @@ static HRESULT _Generate3DMipsLinearFilter( _In_ size_t depth, _In_ size_t level
     size_t height = mipChain.GetMetadata().height;
 
     // Allocate temporary space (5 scanlines, plus X/Y/Z filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*5) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -1865,7 +1860,7 @@ static HRESULT _Generate3DMipsCubicFilter( _In_ size_t depth, _In_ size_t levels
     size_t height = mipChain.GetMetadata().height;
 
     // Allocate temporary space (17 scanlines, plus X/Y/Z filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*17), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*17) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -2246,7 +2241,7 @@ static HRESULT _Generate3DMipsTriangleFilter( _In_ size_t depth, _In_ size_t lev
     size_t height = mipChain.GetMetadata().height;
 
     // Allocate initial temporary space (1 scanline, accumulation rows, plus X/Y/Z filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * width, 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * width ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -2330,7 +2325,7 @@ static HRESULT _Generate3DMipsTriangleFilter( _In_ size_t depth, _In_ size_t lev
                     else
                     {
                         size_t bytes = sizeof(XMVECTOR) * nwidth * nheight;
-                        sliceAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _aligned_malloc( bytes, 16 ) ) );
+                        sliceAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _AllocScratch( bytes ) ) );
                         if ( !sliceAcc->scanline )
                             return E_OUTOFMEMORY;
                     }
@@ -2585,58 +2580,24 @@ HRESULT GenerateMipMaps( const Image& baseImage, DWORD filter, size_t levels, Sc
         switch( filter_select )
         {
             case TEX_FILTER_BOX:
-                hr = _Setup2DMips( &baseImage, 1, mdata, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
-
-                hr = _Generate2DMipsBoxFilter( levels, filter, mipChain, 0 );
-                if ( FAILED(hr) )
-                    mipChain.Release();
-                return hr;
-
             case TEX_FILTER_POINT:
-                hr = _Setup2DMips( &baseImage, 1, mdata, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
-
-                hr = _Generate2DMipsPointFilter( levels, mipChain, 0 );
-                if ( FAILED(hr) )
-                    mipChain.Release();
-                return hr;
-
             case TEX_FILTER_LINEAR:
-                hr = _Setup2DMips( &baseImage, 1, mdata, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
-
-                hr = _Generate2DMipsLinearFilter( levels, filter, mipChain, 0 );
-                if ( FAILED(hr) )
-                    mipChain.Release();
-                return hr;
-
             case TEX_FILTER_CUBIC:
-                hr = _Setup2DMips( &baseImage, 1, mdata, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
-
-                hr = _Generate2DMipsCubicFilter( levels, filter, mipChain, 0 );
-                if ( FAILED(hr) )
-                    mipChain.Release();
-                return hr;
-
             case TEX_FILTER_TRIANGLE:
-                hr = _Setup2DMips( &baseImage, 1, mdata, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
-
-                hr = _Generate2DMipsTriangleFilter( levels, filter, mipChain, 0 );
-                if ( FAILED(hr) )
-                    mipChain.Release();
-                return hr;
+                break;
 
             default:
                 return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
         }
+
+        hr = _Setup2DMips( &baseImage, 1, mdata, mipChain );
+        if ( FAILED(hr) )
+            return hr;
+
+        hr = _Generate2DMips( levels, filter, filter_select, mipChain, ( filter & TEX_FILTER_PARALLEL ) != 0 );
+        if ( FAILED(hr) )
+            mipChain.Release();
+        return hr;
     }
 }
 
@@ -2773,74 +2734,185 @@ HRESULT GenerateMipMaps( const Image* srcImages, size_t nimages, const TexMetada
         switch( filter_select )
         {
             case TEX_FILTER_BOX:
-                hr = _Setup2DMips( &baseImages[0], metadata.arraySize, mdata2, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
+            case TEX_FILTER_POINT:
+            case TEX_FILTER_LINEAR:
+            case TEX_FILTER_CUBIC:
+            case TEX_FILTER_TRIANGLE:
+                break;
 
-                for( size_t item = 0; item < metadata.arraySize; ++item )
-                {
-                    hr = _Generate2DMipsBoxFilter( levels, filter, mipChain, item );
-                    if ( FAILED(hr) )
-                        mipChain.Release();
-                }
-                return hr;
+            default:
+                return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+        }
 
-            case TEX_FILTER_POINT:
-                hr = _Setup2DMips( &baseImages[0], metadata.arraySize, mdata2, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
+        hr = _Setup2DMips( &baseImages[0], metadata.arraySize, mdata2, mipChain );
+        if ( FAILED(hr) )
+            return hr;
 
-                for( size_t item = 0; item < metadata.arraySize; ++item )
-                {
-                    hr = _Generate2DMipsPointFilter( levels, mipChain, item );
-                    if ( FAILED(hr) )
-                        mipChain.Release();
-                }
-                return hr;
+        hr = _Generate2DMips( levels, filter, filter_select, mipChain, ( filter & TEX_FILTER_PARALLEL ) != 0 );
+        if ( FAILED(hr) )
+            mipChain.Release();
+        return hr;
+    }
+}
 
-            case TEX_FILTER_LINEAR:
-                hr = _Setup2DMips( &baseImages[0], metadata.arraySize, mdata2, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
 
-                for( size_t item = 0; item < metadata.arraySize; ++item )
-                {
-                    hr = _Generate2DMipsLinearFilter( levels, filter, mipChain, item );
-                    if ( FAILED(hr) )
-                        mipChain.Release();
-                }
-                return hr;
+//-------------------------------------------------------------------------------------
+// Generate mipmap chain and block compress it one level at a time
+//-------------------------------------------------------------------------------------
+static HRESULT _CompressMipLevel( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+                                  _In_ size_t level, _In_ DWORD compress, _In_ float alphaRef, _In_ const ScratchImage& cImages )
+{
+    ScratchImage temp;
+    HRESULT hr = Compress( srcImages, nimages, metadata, cImages.GetMetadata().format, compress, alphaRef, temp );
+    if ( FAILED(hr) )
+        return hr;
 
-            case TEX_FILTER_CUBIC:
-                hr = _Setup2DMips( &baseImages[0], metadata.arraySize, mdata2, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
+    for( size_t item = 0; item < nimages; ++item )
+    {
+        const Image* src = temp.GetImage( 0, item, 0 );
+        const Image* dest = cImages.GetImage( level, item, 0 );
+        if ( !src || !dest )
+            return E_POINTER;
 
-                for( size_t item = 0; item < metadata.arraySize; ++item )
-                {
-                    hr = _Generate2DMipsCubicFilter( levels, filter, mipChain, item );
-                    if ( FAILED(hr) )
-                        mipChain.Release();
-                }
+        assert( src->slicePitch == dest->slicePitch );
+        memcpy_s( dest->pixels, dest->slicePitch, src->pixels, src->slicePitch );
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT GenerateMipMapsAndCompress( const Image* srcImages, size_t nimages, const TexMetadata& metadata,
+                                    DWORD filter, size_t levels, DXGI_FORMAT format, DWORD compress, float alphaRef, ScratchImage& cImages )
+{
+    if ( !srcImages || !nimages || !IsValid(metadata.format) || !IsCompressed(format) )
+        return E_INVALIDARG;
+
+    if ( metadata.IsVolumemap()
+         || IsCompressed(metadata.format) || IsTypeless(metadata.format) || IsPlanar(metadata.format) || IsPalettized(metadata.format) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    if ( !_CalculateMipLevels(metadata.width, metadata.height, levels) )
+        return E_INVALIDARG;
+
+    if ( levels <= 1 )
+        return E_INVALIDARG;
+
+    HRESULT hr;
+
+    if ( _UseWICFiltering( metadata.format, filter ) )
+    {
+        // The WIC path scales every level from the base image, so the full chain has to exist before compressing it
+        ScratchImage mipChain;
+        hr = GenerateMipMaps( srcImages, nimages, metadata, filter, levels, mipChain );
+        if ( FAILED(hr) )
+            return hr;
+
+        return Compress( mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(), format, compress, alphaRef, cImages );
+    }
+
+    DWORD filter_select = ( filter & TEX_FILTER_MASK );
+    if ( !filter_select )
+    {
+        // Default filter choice
+        filter_select = ( ispow2(metadata.width) && ispow2(metadata.height) ) ? TEX_FILTER_BOX : TEX_FILTER_LINEAR;
+    }
+
+    switch( filter_select )
+    {
+        case TEX_FILTER_BOX:
+        case TEX_FILTER_POINT:
+        case TEX_FILTER_LINEAR:
+        case TEX_FILTER_CUBIC:
+        case TEX_FILTER_TRIANGLE:
+            break;
+
+        default:
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    std::vector<Image> current;
+    current.reserve( metadata.arraySize );
+    for( size_t item=0; item < metadata.arraySize; ++item )
+    {
+        size_t index = metadata.ComputeIndex( 0, item, 0);
+        if ( index >= nimages )
+            return E_FAIL;
+
+        const Image& src = srcImages[ index ];
+        if ( !src.pixels )
+            return E_POINTER;
+
+        if ( src.format != metadata.format || src.width != metadata.width || src.height != metadata.height )
+        {
+            // All base images must be the same format, width, and height
+            return E_FAIL;
+        }
+
+        current.push_back( src );
+    }
+
+    TexMetadata mdata2 = metadata;
+    mdata2.mipLevels = levels;
+    mdata2.format = format;
+    hr = cImages.Initialize( mdata2 );
+    if ( FAILED(hr) )
+        return hr;
+
+    const bool parallel = ( filter & TEX_FILTER_PARALLEL ) != 0;
+
+    // Only the level being compressed and the one made from it are held uncompressed; the base level is used in place
+    TexMetadata ldata = metadata;
+    ldata.mipLevels = 1;
+
+    std::vector<Image> next( metadata.arraySize );
+    ScratchImage currentLevel;
+    ScratchImage nextLevel;
+
+    for( size_t level = 0; level < levels; ++level )
+    {
+        TexMetadata cdata = ldata;
+
+        if ( level + 1 < levels )
+        {
+            if ( ldata.width > 1 )
+                ldata.width >>= 1;
+
+            if ( ldata.height > 1 )
+                ldata.height >>= 1;
+
+            hr = nextLevel.Initialize( ldata );
+            if ( FAILED(hr) )
+            {
+                cImages.Release();
                 return hr;
+            }
 
-            case TEX_FILTER_TRIANGLE:
-                hr = _Setup2DMips( &baseImages[0], metadata.arraySize, mdata2, mipChain );
-                if ( FAILED(hr) )
-                    return hr;
+            for( size_t item = 0; item < metadata.arraySize; ++item )
+            {
+                next[ item ] = *nextLevel.GetImage( 0, item, 0 );
+            }
 
-                for( size_t item = 0; item < metadata.arraySize; ++item )
-                {
-                    hr = _Generate2DMipsTriangleFilter( levels, filter, mipChain, item );
-                    if ( FAILED(hr) )
-                        mipChain.Release();
-                }
+            hr = _Generate2DMipsLevel( &current[0], &next[0], metadata.arraySize, filter, filter_select, parallel );
+            if ( FAILED(hr) )
+            {
+                cImages.Release();
                 return hr;
+            }
+        }
 
-            default:
-                return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+        hr = _CompressMipLevel( &current[0], metadata.arraySize, cdata, level, compress, alphaRef, cImages );
+        if ( FAILED(hr) )
+        {
+            cImages.Release();
+            return hr;
         }
+
+        currentLevel = std::move( nextLevel );
+        current.swap( next );
     }
+
+    return S_OK;
 }
 
 
@@ -15,29 +15,29 @@
 
 #include "directxtexp.h"
 
+#include "bc.h"
+
 namespace DirectX
 {
 static const XMVECTORF32 g_Gamma22 = { 2.2f, 2.2f, 2.2f, 1.f };
 
 //-------------------------------------------------------------------------------------
-static HRESULT _ComputeMSE( _In_ const Image& image1, _In_ const Image& image2,
-                            _Out_ float& mse, _Out_writes_opt_(4) float* mseV,
-                            _In_ DWORD flags )
-{
-    if ( !image1.pixels || !image2.pixels )
-        return E_POINTER;
-
-    assert( image1.width == image2.width && image1.height == image2.height );
-    assert( !IsCompressed( image1.format ) && !IsCompressed( image2.format )  );
-
-    const size_t width = image1.width;
+// Image metrics
+//   Both images are read in bands of METRICS_BAND_ROWS rows, which is also the SSIM
+//   window size and a whole number of BC block rows. Bands are independent work items;
+//   their partial sums are combined afterwards in a fixed order, so the result doesn't
+//   depend on how many threads were used
+//-------------------------------------------------------------------------------------
+#define METRICS_BAND_ROWS 8
 
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width)*2, 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+static const XMVECTORF32 g_SSIM_Two = { 2.0f, 2.0f, 2.0f, 2.0f };
+static const XMVECTORF32 g_SSIM_C1 = { 0.0001f, 0.0001f, 0.0001f, 0.0001f };    // (0.01 * L)^2, L = 1
+static const XMVECTORF32 g_SSIM_C2 = { 0.0009f, 0.0009f, 0.0009f, 0.0009f };    // (0.03 * L)^2
 
+static DWORD _GetMetricsFlags( _In_ DXGI_FORMAT format1, _In_ DXGI_FORMAT format2, _In_ DWORD flags )
+{
     // Flags implied from image formats
-    switch( image1.format )
+    switch( format1 )
     {
     case DXGI_FORMAT_B8G8R8X8_UNORM:
         flags |= CMSE_IGNORE_ALPHA;
@@ -57,7 +57,7 @@ static HRESULT _ComputeMSE( _In_ const Image& image1, _In_ const Image& image2,
         break;
     }
 
-    switch( image2.format )
+    switch( format2 )
     {
     case DXGI_FORMAT_B8G8R8X8_UNORM:
         flags |= CMSE_IGNORE_ALPHA;
@@ -77,89 +77,1139 @@ static HRESULT _ComputeMSE( _In_ const Image& image1, _In_ const Image& image2,
         break;
     }
 
-    const uint8_t *pSrc1 = image1.pixels;
-    const size_t rowPitch1 = image1.rowPitch;
+    return flags;
+}
+
+static bool _GetMetricsDecoder( _In_ DXGI_FORMAT format, _Out_ BC_DECODE& pfDecode, _Out_ size_t& blocksize, _Out_ DXGI_FORMAT& cformat )
+{
+    // Promote "typeless" BC formats, and read sRGB ones as their UNORM twin so the values
+    // stay gamma-encoded like any other sRGB format; CMSE_IMAGEn_SRGB does the linearizing
+    switch( format )
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    cformat = DXGI_FORMAT_BC1_UNORM; break;
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:    cformat = DXGI_FORMAT_BC2_UNORM; break;
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:    cformat = DXGI_FORMAT_BC3_UNORM; break;
+    case DXGI_FORMAT_BC4_TYPELESS:      cformat = DXGI_FORMAT_BC4_UNORM; break;
+    case DXGI_FORMAT_BC5_TYPELESS:      cformat = DXGI_FORMAT_BC5_UNORM; break;
+    case DXGI_FORMAT_BC6H_TYPELESS:     cformat = DXGI_FORMAT_BC6H_UF16; break;
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:    cformat = DXGI_FORMAT_BC7_UNORM; break;
+    default:                            cformat = format;                break;
+    }
+
+    switch( cformat )
+    {
+    case DXGI_FORMAT_BC1_UNORM:         pfDecode = D3DXDecodeBC1;   blocksize = 8;   break;
+    case DXGI_FORMAT_BC2_UNORM:         pfDecode = D3DXDecodeBC2;   blocksize = 16;  break;
+    case DXGI_FORMAT_BC3_UNORM:         pfDecode = D3DXDecodeBC3;   blocksize = 16;  break;
+    case DXGI_FORMAT_BC4_UNORM:         pfDecode = D3DXDecodeBC4U;  blocksize = 8;   break;
+    case DXGI_FORMAT_BC4_SNORM:         pfDecode = D3DXDecodeBC4S;  blocksize = 8;   break;
+    case DXGI_FORMAT_BC5_UNORM:         pfDecode = D3DXDecodeBC5U;  blocksize = 16;  break;
+    case DXGI_FORMAT_BC5_SNORM:         pfDecode = D3DXDecodeBC5S;  blocksize = 16;  break;
+    case DXGI_FORMAT_BC6H_UF16:         pfDecode = D3DXDecodeBC6HU; blocksize = 16;  break;
+    case DXGI_FORMAT_BC6H_SF16:         pfDecode = D3DXDecodeBC6HS; blocksize = 16;  break;
+    case DXGI_FORMAT_BC7_UNORM:         pfDecode = D3DXDecodeBC7;   blocksize = 16;  break;
+    default:
+        pfDecode = nullptr;
+        blocksize = 0;
+        return false;
+    }
+
+    return true;
+}
 
-    const uint8_t *pSrc2 = image2.pixels;
-    const size_t rowPitch2 = image2.rowPitch;
+//-------------------------------------------------------------------------------------
+// Reads rows [y, y+rows) of an image as RGBA32F, decoding BC blocks directly into the rows
+//-------------------------------------------------------------------------------------
+static bool _LoadMetricsRows( _Out_writes_(image.width*rows) XMVECTOR* pDestination, _In_ const Image& image, _In_ size_t y, _In_ size_t rows,
+                              _In_ bool srgb, _In_ bool bias )
+{
+    assert( pDestination && rows > 0 && (y + rows) <= image.height );
 
-    XMVECTOR acc = g_XMZero;
-    static XMVECTORF32 two = { 2.0f, 2.0f, 2.0f, 2.0f };
+    const size_t width = image.width;
 
-    for( size_t h = 0; h < image1.height; ++h )
+    if ( IsCompressed( image.format ) )
     {
-        XMVECTOR* ptr1 = scanline.get();
-        if ( !_LoadScanline( ptr1, width, pSrc1, rowPitch1, image1.format ) )
-            return E_FAIL;
+        BC_DECODE pfDecode;
+        size_t blocksize;
+        DXGI_FORMAT cformat;
+        if ( !_GetMetricsDecoder( image.format, pfDecode, blocksize, cformat ) )
+            return false;
 
-        XMVECTOR* ptr2 = scanline.get() + width;
-        if ( !_LoadScanline( ptr2, width, pSrc2, rowPitch2, image2.format ) )
-            return E_FAIL;
+        assert( (y % 4) == 0 );
+
+        XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+        for( size_t by = 0; by < rows; by += 4 )
+        {
+            const uint8_t* pSrc = image.pixels + ((y + by) / 4) * image.rowPitch;
+            const size_t ph = std::min<size_t>( 4, rows - by );
+
+            for( size_t x = 0; x < width; x += 4, pSrc += blocksize )
+            {
+                pfDecode( temp, pSrc );
+                _ConvertScanline( temp, NUM_PIXELS_PER_BLOCK, DXGI_FORMAT_R32G32B32A32_FLOAT, cformat, 0 );
+
+                const size_t pw = std::min<size_t>( 4, width - x );
+                for( size_t j = 0; j < ph; ++j )
+                {
+                    XMVECTOR* dptr = pDestination + (by + j) * width + x;
+                    for( size_t i = 0; i < pw; ++i )
+                    {
+                        dptr[i] = temp[ j*4 + i ];
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        const uint8_t* pSrc = image.pixels + y * image.rowPitch;
+        for( size_t j = 0; j < rows; ++j, pSrc += image.rowPitch )
+        {
+            if ( !_LoadScanline( pDestination + j * width, width, pSrc, image.rowPitch, image.format ) )
+                return false;
+        }
+    }
+
+    if ( srgb || bias )
+    {
+        static const XMVECTORF32 two = { 2.0f, 2.0f, 2.0f, 2.0f };
 
-        for( size_t i = 0; i < width; ++i )
+        XMVECTOR* ptr = pDestination;
+        for( size_t i = 0; i < width*rows; ++i, ++ptr )
         {
-            XMVECTOR v1 = *(ptr1++);
-            if ( flags & CMSE_IMAGE1_SRGB )
+            XMVECTOR v = *ptr;
+            if ( srgb )
             {
-                v1 = XMVectorPow( v1, g_Gamma22 );
+                v = XMVectorPow( v, g_Gamma22 );
             }
-            if ( flags & CMSE_IMAGE1_X2_BIAS )
+            if ( bias )
             {
-                v1 = XMVectorMultiplyAdd( v1, two, g_XMNegativeOne );
+                v = XMVectorMultiplyAdd( v, two, g_XMNegativeOne );
             }
+            *ptr = v;
+        }
+    }
+
+    return true;
+}
+
+static XMVECTOR _GetMetricsIgnoreMask( _In_ DWORD flags )
+{
+    XMVECTOR mask = XMVectorFalseInt();
+    if ( flags & CMSE_IGNORE_RED )
+    {
+        mask = XMVectorOrInt( mask, g_XMMaskX );
+    }
+    if ( flags & CMSE_IGNORE_GREEN )
+    {
+        mask = XMVectorOrInt( mask, g_XMMaskY );
+    }
+    if ( flags & CMSE_IGNORE_BLUE )
+    {
+        mask = XMVectorOrInt( mask, g_XMMaskZ );
+    }
+    if ( flags & CMSE_IGNORE_ALPHA )
+    {
+        mask = XMVectorOrInt( mask, g_XMMaskW );
+    }
+    return mask;
+}
+
+struct MetricsBand
+{
+    double      sqError[4]; // sum[ (I1 - I2)^2 ]
+    XMFLOAT4    maxError;   // max[ |I1 - I2| ]
+    double      ssim[4];    // sum of the SSIM of each window
+    size_t      windows;
+};
+
+struct MetricsTask
+{
+    const Image*                images1;
+    const Image*                images2;
+    const DWORD*                flags;
+    std::vector<size_t>         offsets;
+    std::vector<MetricsBand>    bands;
+};
+
+static HRESULT _ComputeMetrics_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    MetricsTask* task = reinterpret_cast<MetricsTask*>( pContext );
+    assert( task );
+
+    const size_t index = _FindTaskImage( task->offsets, item );
+    const Image& image1 = task->images1[ index ];
+    const Image& image2 = task->images2[ index ];
+    const DWORD flags = task->flags[ index ];
+
+    const size_t width = image1.width;
+    const size_t y = ( item - task->offsets[ index ] ) * METRICS_BAND_ROWS;
+    const size_t rows = std::min<size_t>( METRICS_BAND_ROWS, image1.height - y );
 
-            XMVECTOR v2 = *(ptr2++);
-            if ( flags & CMSE_IMAGE2_SRGB )
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*width*rows)*2 ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
+
+    XMVECTOR* band1 = scanline.get();
+    XMVECTOR* band2 = scanline.get() + width*rows;
+
+    if ( !_LoadMetricsRows( band1, image1, y, rows, (flags & CMSE_IMAGE1_SRGB) != 0, (flags & CMSE_IMAGE1_X2_BIAS) != 0 ) )
+        return E_FAIL;
+
+    if ( !_LoadMetricsRows( band2, image2, y, rows, (flags & CMSE_IMAGE2_SRGB) != 0, (flags & CMSE_IMAGE2_X2_BIAS) != 0 ) )
+        return E_FAIL;
+
+    // Ignored channels compare as equal: no error, and an SSIM of 1
+    const XMVECTOR ignore = _GetMetricsIgnoreMask( flags );
+
+    // Each window is summed in float, then added to the band totals in double
+    MetricsBand& band = task->bands[ item ];
+    memset( &band, 0, sizeof(MetricsBand) );
+
+    XMVECTOR maxError = g_XMZero;
+
+    for( size_t x = 0; x < width; x += METRICS_BAND_ROWS )
+    {
+        const size_t cols = std::min<size_t>( METRICS_BAND_ROWS, width - x );
+
+        XMVECTOR sqError = g_XMZero;
+        XMVECTOR sum1 = g_XMZero;
+        XMVECTOR sum2 = g_XMZero;
+        XMVECTOR sumSq1 = g_XMZero;
+        XMVECTOR sumSq2 = g_XMZero;
+        XMVECTOR sum12 = g_XMZero;
+
+        for( size_t j = 0; j < rows; ++j )
+        {
+            const XMVECTOR* ptr1 = band1 + j*width + x;
+            const XMVECTOR* ptr2 = band2 + j*width + x;
+
+            for( size_t i = 0; i < cols; ++i )
             {
-                v2 = XMVectorPow( v2, g_Gamma22 );
+                XMVECTOR v1 = *(ptr1++);
+                XMVECTOR v2 = XMVectorSelect( *(ptr2++), v1, ignore );
+
+                XMVECTOR v = XMVectorSubtract( v1, v2 );
+                sqError = XMVectorMultiplyAdd( v, v, sqError );
+                maxError = XMVectorMax( maxError, XMVectorAbs( v ) );
+
+                sum1 = XMVectorAdd( sum1, v1 );
+                sum2 = XMVectorAdd( sum2, v2 );
+                sumSq1 = XMVectorMultiplyAdd( v1, v1, sumSq1 );
+                sumSq2 = XMVectorMultiplyAdd( v2, v2, sumSq2 );
+                sum12 = XMVectorMultiplyAdd( v1, v2, sum12 );
             }
-            if ( flags & CMSE_IMAGE2_X2_BIAS )
+        }
+
+        // SSIM = (2*mu1*mu2 + C1)(2*cov12 + C2) / ((mu1^2 + mu2^2 + C1)(var1 + var2 + C2))
+        const XMVECTOR n = XMVectorReplicate( 1.f / float( rows * cols ) );
+
+        XMVECTOR mu1 = XMVectorMultiply( sum1, n );
+        XMVECTOR mu2 = XMVectorMultiply( sum2, n );
+        XMVECTOR mu12 = XMVectorMultiply( mu1, mu2 );
+        XMVECTOR var1 = XMVectorNegativeMultiplySubtract( mu1, mu1, XMVectorMultiply( sumSq1, n ) );
+        XMVECTOR var2 = XMVectorNegativeMultiplySubtract( mu2, mu2, XMVectorMultiply( sumSq2, n ) );
+        XMVECTOR cov12 = XMVectorNegativeMultiplySubtract( mu1, mu2, XMVectorMultiply( sum12, n ) );
+
+        XMVECTOR num = XMVectorMultiply( XMVectorMultiplyAdd( mu12, g_SSIM_Two, g_SSIM_C1 ), XMVectorMultiplyAdd( cov12, g_SSIM_Two, g_SSIM_C2 ) );
+        XMVECTOR den = XMVectorMultiply( XMVectorAdd( XMVectorMultiplyAdd( mu1, mu1, XMVectorMultiply( mu2, mu2 ) ), g_SSIM_C1 ),
+                                         XMVectorAdd( XMVectorAdd( var1, var2 ), g_SSIM_C2 ) );
+
+        XMFLOAT4 wsq, wssim;
+        XMStoreFloat4( &wsq, sqError );
+        XMStoreFloat4( &wssim, XMVectorSelect( XMVectorDivide( num, den ), g_XMOne, ignore ) );
+
+        const float* psq = &wsq.x;
+        const float* pssim = &wssim.x;
+        for( size_t c = 0; c < 4; ++c )
+        {
+            band.sqError[c] += psq[c];
+            band.ssim[c] += pssim[c];
+        }
+        ++band.windows;
+    }
+
+    XMStoreFloat4( &band.maxError, maxError );
+
+    return S_OK;
+}
+
+static void _FinishMetrics( _Out_ ImageMetrics& metrics, _In_reads_(4) const double* sqError, _In_reads_(4) const float* maxError,
+                            _In_reads_(4) const double* ssim, _In_ size_t pixels, _In_ size_t windows, _In_ DWORD flags )
+{
+    assert( pixels > 0 && windows > 0 );
+
+    static const DWORD s_ignore[4] = { CMSE_IGNORE_RED, CMSE_IGNORE_GREEN, CMSE_IGNORE_BLUE, CMSE_IGNORE_ALPHA };
+
+    double mse = 0.0;
+    double ssimTotal = 0.0;
+    size_t channels = 0;
+
+    metrics.maxError = 0.f;
+
+    for( size_t c = 0; c < 4; ++c )
+    {
+        metrics.mseV[c] = static_cast<float>( sqError[c] / double(pixels) );
+        metrics.maxErrorV[c] = maxError[c];
+        metrics.ssimV[c] = static_cast<float>( ssim[c] / double(windows) );
+
+        mse += sqError[c] / double(pixels);
+        metrics.maxError = std::max( metrics.maxError, maxError[c] );
+
+        if ( !( flags & s_ignore[c] ) )
+        {
+            ssimTotal += metrics.ssimV[c];
+            ++channels;
+        }
+    }
+
+    metrics.mse = static_cast<float>( mse );
+
+    if ( !channels || mse <= 0.0 )
+    {
+        metrics.psnr = XMVectorGetX( g_XMInfinity );
+    }
+    else
+    {
+        // PSNR = 10 * log10( peak^2 / MSE ), with peak = 1 and MSE averaged over the channels compared
+        metrics.psnr = static_cast<float>( 10.0 * log10( double(channels) / mse ) );
+    }
+
+    metrics.ssim = ( channels ) ? static_cast<float>( ssimTotal / double(channels) ) : 1.f;
+}
+
+static HRESULT _ComputeMetrics( _In_reads_(nimages) const Image* images1, _In_reads_(nimages) const Image* images2, _In_ size_t nimages,
+                                _In_ DWORD flags, _Out_writes_opt_(nimages) ImageMetrics* imageMetrics, _Out_opt_ ImageMetrics* totalMetrics )
+{
+    if ( !images1 || !images2 || !nimages )
+        return E_INVALIDARG;
+
+    MetricsTask task;
+    task.images1 = images1;
+    task.images2 = images2;
+
+    std::vector<DWORD> imageFlags;
+    imageFlags.reserve( nimages );
+
+    task.offsets.reserve( nimages + 1 );
+    task.offsets.push_back( 0 );
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        const Image& image1 = images1[ index ];
+        const Image& image2 = images2[ index ];
+
+        if ( !image1.pixels || !image2.pixels )
+            return E_POINTER;
+
+        if ( image1.width != image2.width || image1.height != image2.height || !image1.width || !image1.height )
+            return E_INVALIDARG;
+
+        if ( IsPlanar( image1.format ) || IsPlanar( image2.format )
+             || IsPalettized( image1.format ) || IsPalettized( image2.format ) )
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+        BC_DECODE pfDecode;
+        size_t blocksize;
+        DXGI_FORMAT cformat;
+        if ( ( IsCompressed( image1.format ) && !_GetMetricsDecoder( image1.format, pfDecode, blocksize, cformat ) )
+             || ( IsCompressed( image2.format ) && !_GetMetricsDecoder( image2.format, pfDecode, blocksize, cformat ) ) )
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+        imageFlags.push_back( _GetMetricsFlags( image1.format, image2.format, flags ) );
+        task.offsets.push_back( task.offsets.back() + ( image1.height + METRICS_BAND_ROWS - 1 ) / METRICS_BAND_ROWS );
+    }
+
+    task.flags = &imageFlags[0];
+    task.bands.resize( task.offsets.back() );
+
+    HRESULT hr = _RunTasks( task.offsets.back(), (flags & CMSE_PARALLEL) != 0, _ComputeMetrics_Task, &task );
+    if ( FAILED(hr) )
+        return hr;
+
+    // Reduce in band order
+    double totalSq[4] = { 0 };
+    float totalMax[4] = { 0 };
+    double totalSSIM[4] = { 0 };
+    size_t totalPixels = 0;
+    size_t totalWindows = 0;
+    DWORD totalFlags = flags | CMSE_IGNORE_RED | CMSE_IGNORE_GREEN | CMSE_IGNORE_BLUE | CMSE_IGNORE_ALPHA;
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        double sq[4] = { 0 };
+        float maxe[4] = { 0 };
+        double ssim[4] = { 0 };
+        size_t windows = 0;
+
+        for( size_t item = task.offsets[ index ]; item < task.offsets[ index + 1 ]; ++item )
+        {
+            const MetricsBand& band = task.bands[ item ];
+            const float* bmax = &band.maxError.x;
+
+            for( size_t c = 0; c < 4; ++c )
             {
-                v1 = XMVectorMultiplyAdd( v2, two, g_XMNegativeOne );
+                sq[c] += band.sqError[c];
+                maxe[c] = std::max( maxe[c], bmax[c] );
+                ssim[c] += band.ssim[c];
             }
+            windows += band.windows;
+        }
+
+        const size_t pixels = images1[ index ].width * images1[ index ].height;
+
+        if ( imageMetrics )
+        {
+            _FinishMetrics( imageMetrics[ index ], sq, maxe, ssim, pixels, windows, imageFlags[ index ] );
+        }
+
+        for( size_t c = 0; c < 4; ++c )
+        {
+            totalSq[c] += sq[c];
+            totalMax[c] = std::max( totalMax[c], maxe[c] );
+            totalSSIM[c] += ssim[c];
+        }
+        totalPixels += pixels;
+        totalWindows += windows;
+
+        // A channel counts toward the total if any of the images compared it
+        totalFlags &= imageFlags[ index ];
+    }
+
+    if ( totalMetrics )
+    {
+        _FinishMetrics( *totalMetrics, totalSq, totalMax, totalSSIM, totalPixels, totalWindows, totalFlags );
+    }
+
+    return S_OK;
+}
+
+//-------------------------------------------------------------------------------------
+// Image statistics
+//   Bands of STATS_BAND_ROWS rows (a whole number of BC block rows) are independent work
+//   items, combined afterwards in band order. 8-bit RGBA/BGRA images, and BC1-BC3 decoded
+//   a block row at a time to RGBA8, are scanned as bytes; everything else is read through
+//   _LoadMetricsRows, which reads sRGB BC formats through their UNORM twin so every
+//   format reports its values as stored. When only the opaque flag is wanted, the first
+//   translucent pixel found stops the scan of every band
+//-------------------------------------------------------------------------------------
+#define STATS_BAND_ROWS 16
+
+#define STATS_OPAQUE_ALPHA      0.99f       // same threshold IsAlphaAllOpaque has always used
+#define STATS_CLEAR_ALPHA       0.01f
+#define STATS_GRAY_TOLERANCE    0.015625f   // 1/64, enough for the 5:6:5 endpoints of BC1-BC3
+#define STATS_NORMAL_TOLERANCE  0.2f        // on the squared length, so lengths of roughly 0.9 to 1.1
+
+enum STATS_CLASS
+{
+    STATS_OPAQUE        = 0x1,
+    STATS_BINARY_ALPHA  = 0x2,
+    STATS_GRAYSCALE     = 0x4,
+    STATS_NORMAL_MAP    = 0x8,
+};
 
-            // sum[ (I1 - I2)^2 ]
-            XMVECTOR v = XMVectorSubtract( v1, v2 );
-            if ( flags & CMSE_IGNORE_RED )
+enum STATS_SCAN
+{
+    STATS_SCAN_FLOAT = 0,
+    STATS_SCAN_RGBA8,
+    STATS_SCAN_BGRA8,
+    STATS_SCAN_BGRX8,
+    STATS_SCAN_BC_RGBA8,
+};
+
+struct StatsImage
+{
+    STATS_SCAN      scan;
+    BC_DECODE_RGBA8 pfDecode;   // STATS_SCAN_BC_RGBA8 only
+    size_t          colors;     // number of color channels stored: 1 (R), 2 (RG) or 3 (RGB)
+    bool            alpha;
+    bool            bias;       // UNORM, so normals are stored x2 biased
+    DWORD           classes;    // STATS_* classifications that can apply to the format
+};
+
+struct StatsBand
+{
+    XMFLOAT4    minV;
+    XMFLOAT4    maxV;
+    double      sum[4];
+    DWORD       classes;        // STATS_* classifications that held for every pixel of the band
+};
+
+struct StatsAccum8
+{
+    uint32_t    minV[4];
+    uint32_t    maxV[4];
+    uint64_t    sum[4];
+};
+
+struct StatsTask
+{
+    const Image*            images;
+    const StatsImage*       info;
+    bool                    opaqueOnly;
+    volatile LONG           translucent;
+    std::vector<size_t>     offsets;
+    std::vector<StatsBand>  bands;
+
+    // 8-bit equivalents of the float thresholds, so both scans classify a pixel the same way
+    uint32_t                opaqueAlpha8;   // smallest alpha >= STATS_OPAQUE_ALPHA
+    uint32_t                clearAlpha8;    // largest alpha <= STATS_CLEAR_ALPHA
+    uint32_t                grayDelta8;     // largest channel difference <= STATS_GRAY_TOLERANCE
+    float                   normal8[256];   // value * 2 - 1
+};
+
+static bool _GetStatsImage( _In_ const Image& image, _Out_ StatsImage& info )
+{
+    DXGI_FORMAT format = image.format;
+    if ( IsTypeless( format ) )
+    {
+        format = MakeTypelessFLOAT( MakeTypelessUNORM( format ) );
+    }
+
+    info.scan = STATS_SCAN_FLOAT;
+    info.pfDecode = nullptr;
+
+    switch( format )
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        info.scan = STATS_SCAN_RGBA8;
+        break;
+
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        info.scan = STATS_SCAN_BGRA8;
+        break;
+
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        info.scan = STATS_SCAN_BGRX8;
+        break;
+
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+        info.scan = STATS_SCAN_BC_RGBA8;
+        info.pfDecode = D3DXDecodeBC1RGBA8;
+        break;
+
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+        info.scan = STATS_SCAN_BC_RGBA8;
+        info.pfDecode = D3DXDecodeBC2RGBA8;
+        break;
+
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        info.scan = STATS_SCAN_BC_RGBA8;
+        info.pfDecode = D3DXDecodeBC3RGBA8;
+        break;
+
+    default:
+        if ( IsCompressed( format ) )
+        {
+            BC_DECODE pfDecode;
+            size_t blocksize;
+            DXGI_FORMAT cformat;
+            if ( !_GetMetricsDecoder( format, pfDecode, blocksize, cformat ) )
+                return false;
+        }
+        break;
+    }
+
+    // Formats the conversion table doesn't know about are read as four float channels
+    DWORD cflags = _GetConvertFlags( format );
+    if ( !cflags )
+    {
+        cflags = CONVF_FLOAT | CONVF_RGBA_MASK;
+    }
+
+    switch( cflags & CONVF_RGB_MASK )
+    {
+    case CONVF_R | CONVF_G | CONVF_B:   info.colors = 3; break;
+    case CONVF_R | CONVF_G:             info.colors = 2; break;
+    case 0:                             info.colors = 0; break;
+    default:                            info.colors = 1; break;
+    }
+
+    info.alpha = ( cflags & CONVF_A ) != 0;
+    info.bias = ( cflags & CONVF_UNORM ) != 0;
+
+    // Single channel images are grayscale as far as compression is concerned, and images without alpha are opaque
+    info.classes = STATS_OPAQUE | STATS_BINARY_ALPHA | STATS_GRAYSCALE;
+    if ( info.colors > 1 )
+    {
+        info.classes |= STATS_NORMAL_MAP;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------
+// Scans a run of RGBA32F pixels
+//-------------------------------------------------------------------------------------
+static bool _IsOpaqueFloat( _In_reads_(count) const XMVECTOR* pSource, _In_ size_t count )
+{
+    static const XMVECTORF32 threshold = { STATS_OPAQUE_ALPHA, STATS_OPAQUE_ALPHA, STATS_OPAQUE_ALPHA, STATS_OPAQUE_ALPHA };
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        XMVECTOR alpha = XMVectorSplatW( pSource[i] );
+        if ( XMVector4Less( alpha, threshold ) )
+            return false;
+    }
+
+    return true;
+}
+
+static void _ScanStatsFloat( _In_reads_(count) const XMVECTOR* pSource, _In_ size_t count, _In_ const StatsImage& info,
+                             _Inout_ XMVECTOR& vmin, _Inout_ XMVECTOR& vmax, _Inout_updates_all_(4) double* sum, _Inout_ DWORD& classes )
+{
+    XMVECTOR vsum = g_XMZero;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        XMVECTOR v = pSource[i];
+
+        vmin = XMVectorMin( vmin, v );
+        vmax = XMVectorMax( vmax, v );
+        vsum = XMVectorAdd( vsum, v );
+
+        if ( !classes )
+            continue;
+
+        XMFLOAT4A f;
+        XMStoreFloat4A( &f, v );
+
+        if ( f.w < STATS_OPAQUE_ALPHA )
+        {
+            classes &= ~STATS_OPAQUE;
+            if ( f.w > STATS_CLEAR_ALPHA )
             {
-                v = XMVectorSelect( v, g_XMZero, g_XMMaskX );
+                classes &= ~STATS_BINARY_ALPHA;
             }
-            if ( flags & CMSE_IGNORE_GREEN )
+        }
+
+        if ( ( classes & STATS_GRAYSCALE ) && info.colors > 1 )
+        {
+            const float b = ( info.colors > 2 ) ? f.z : f.y;
+            const float hi = std::max( std::max( f.x, f.y ), b );
+            const float lo = std::min( std::min( f.x, f.y ), b );
+            if ( ( hi - lo ) > STATS_GRAY_TOLERANCE )
             {
-                v = XMVectorSelect( v, g_XMZero, g_XMMaskY );
+                classes &= ~STATS_GRAYSCALE;
             }
-            if ( flags & CMSE_IGNORE_BLUE )
+        }
+
+        if ( classes & STATS_NORMAL_MAP )
+        {
+            const float x = ( info.bias ) ? f.x * 2.f - 1.f : f.x;
+            const float y = ( info.bias ) ? f.y * 2.f - 1.f : f.y;
+            const float z = ( info.bias ) ? f.z * 2.f - 1.f : f.z;
+
+            if ( info.colors > 2 )
             {
-                v = XMVectorSelect( v, g_XMZero, g_XMMaskZ );
+                // Tangent-space normals point out of the surface
+                const float len2 = x*x + y*y + z*z;
+                if ( fabsf( len2 - 1.f ) > STATS_NORMAL_TOLERANCE || z < -STATS_GRAY_TOLERANCE )
+                {
+                    classes &= ~STATS_NORMAL_MAP;
+                }
             }
-            if ( flags & CMSE_IGNORE_ALPHA )
+            else if ( ( x*x + y*y ) > ( 1.f + STATS_NORMAL_TOLERANCE ) )
             {
-                v = XMVectorSelect( v, g_XMZero, g_XMMaskW );
+                // Only x and y are stored, z is reconstructed
+                classes &= ~STATS_NORMAL_MAP;
             }
+        }
+    }
 
-            acc = XMVectorMultiplyAdd( v, v, acc );
+    XMFLOAT4A f;
+    XMStoreFloat4A( &f, vsum );
+    sum[0] += f.x;
+    sum[1] += f.y;
+    sum[2] += f.z;
+    sum[3] += f.w;
+}
+
+//-------------------------------------------------------------------------------------
+// Scans a row of 8:8:8:8 pixels
+//-------------------------------------------------------------------------------------
+static bool _IsOpaqueRGBA8( _In_reads_(width*4) const uint8_t* pSource, _In_ size_t width, _In_ uint32_t opaqueAlpha8 )
+{
+    for( size_t i = 0; i < width; ++i, pSource += 4 )
+    {
+        if ( pSource[3] < opaqueAlpha8 )
+            return false;
+    }
+
+    return true;
+}
+
+static void _ScanStatsRGBA8( _In_reads_(width*4) const uint8_t* pSource, _In_ size_t width, _In_ STATS_SCAN scan, _In_ const StatsTask& task,
+                             _Inout_ StatsAccum8& accum, _Inout_ DWORD& classes )
+{
+    const size_t ir = ( scan == STATS_SCAN_RGBA8 || scan == STATS_SCAN_BC_RGBA8 ) ? 0 : 2;
+    const size_t ib = 2 - ir;
+    const bool noAlpha = ( scan == STATS_SCAN_BGRX8 );
+
+    for( size_t i = 0; i < width; ++i, pSource += 4 )
+    {
+        const uint32_t c[4] = { pSource[ ir ], pSource[1], pSource[ ib ], ( noAlpha ) ? 255u : pSource[3] };
+
+        for( size_t k = 0; k < 4; ++k )
+        {
+            accum.minV[k] = std::min( accum.minV[k], c[k] );
+            accum.maxV[k] = std::max( accum.maxV[k], c[k] );
+            accum.sum[k] += c[k];
         }
 
-        pSrc1 += rowPitch1;
-        pSrc2 += rowPitch2;
+        if ( !classes )
+            continue;
+
+        if ( c[3] < task.opaqueAlpha8 )
+        {
+            classes &= ~STATS_OPAQUE;
+            if ( c[3] > task.clearAlpha8 )
+            {
+                classes &= ~STATS_BINARY_ALPHA;
+            }
+        }
+
+        if ( classes & STATS_GRAYSCALE )
+        {
+            const uint32_t hi = std::max( std::max( c[0], c[1] ), c[2] );
+            const uint32_t lo = std::min( std::min( c[0], c[1] ), c[2] );
+            if ( ( hi - lo ) > task.grayDelta8 )
+            {
+                classes &= ~STATS_GRAYSCALE;
+            }
+        }
+
+        if ( classes & STATS_NORMAL_MAP )
+        {
+            const float x = task.normal8[ c[0] ];
+            const float y = task.normal8[ c[1] ];
+            const float z = task.normal8[ c[2] ];
+            const float len2 = x*x + y*y + z*z;
+            if ( fabsf( len2 - 1.f ) > STATS_NORMAL_TOLERANCE || z < -STATS_GRAY_TOLERANCE )
+            {
+                classes &= ~STATS_NORMAL_MAP;
+            }
+        }
     }
+}
 
-    // MSE = sum[ (I1 - I2)^2 ] / w*h
-    XMVECTOR d = XMVectorReplicate( float(image1.width * image1.height) );
-    XMVECTOR v = XMVectorDivide( acc, d );
-    if ( mseV )
+static HRESULT _ComputeStatistics_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    StatsTask* task = reinterpret_cast<StatsTask*>( pContext );
+    assert( task );
+
+    if ( task->opaqueOnly && task->translucent )
+        return S_OK;
+
+    const size_t index = _FindTaskImage( task->offsets, item );
+    const Image& image = task->images[ index ];
+    const StatsImage& info = task->info[ index ];
+
+    const size_t width = image.width;
+    const size_t y = ( item - task->offsets[ index ] ) * STATS_BAND_ROWS;
+    const size_t rows = std::min<size_t>( STATS_BAND_ROWS, image.height - y );
+
+    StatsBand& band = task->bands[ item ];
+    DWORD classes = info.classes;
+
+    if ( info.scan == STATS_SCAN_FLOAT )
     {
-        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( mseV ), v );
-        mse = mseV[0] + mseV[1] + mseV[2] + mseV[3];
+        // BC images are read a block row at a time, anything else a row at a time
+        const size_t step = IsCompressed( image.format ) ? 4 : 1;
+
+        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR)*width*step ) ) );
+        if ( !scanline )
+            return E_OUTOFMEMORY;
+
+        XMVECTOR vmin = g_XMInfinity;
+        XMVECTOR vmax = XMVectorNegate( g_XMInfinity );
+
+        for( size_t j = 0; j < rows; j += step )
+        {
+            const size_t count = std::min( step, rows - j );
+            if ( !_LoadMetricsRows( scanline.get(), image, y + j, count, false, false ) )
+                return E_FAIL;
+
+            if ( task->opaqueOnly )
+            {
+                if ( !_IsOpaqueFloat( scanline.get(), width*count ) )
+                {
+                    InterlockedExchange( &task->translucent, 1 );
+                    return S_OK;
+                }
+
+                if ( task->translucent )
+                    return S_OK;
+            }
+            else
+            {
+                _ScanStatsFloat( scanline.get(), width*count, info, vmin, vmax, band.sum, classes );
+            }
+        }
+
+        XMStoreFloat4( &band.minV, vmin );
+        XMStoreFloat4( &band.maxV, vmax );
     }
     else
     {
-        XMFLOAT4 _mseV;
-        XMStoreFloat4( &_mseV, v );
-        mse = _mseV.x + _mseV.y + _mseV.z + _mseV.w;
+        StatsAccum8 accum;
+        for( size_t k = 0; k < 4; ++k )
+        {
+            accum.minV[k] = 255;
+            accum.maxV[k] = 0;
+            accum.sum[k] = 0;
+        }
+
+        if ( info.scan == STATS_SCAN_BC_RGBA8 )
+        {
+            const size_t nblocks = ( width + 3 ) / 4;
+            const size_t stripPitch = nblocks * 16;
+
+            std::unique_ptr<uint8_t, scratch_deleter> strip( reinterpret_cast<uint8_t*>( _AllocScratch( stripPitch * 4 ) ) );
+            if ( !strip )
+                return E_OUTOFMEMORY;
+
+            for( size_t j = 0; j < rows; j += 4 )
+            {
+                info.pfDecode( strip.get(), stripPitch, image.pixels + ( ( y + j ) / 4 ) * image.rowPitch, nblocks, false );
+
+                const size_t ph = std::min<size_t>( 4, rows - j );
+                for( size_t k = 0; k < ph; ++k )
+                {
+                    const uint8_t* pSrc = strip.get() + k * stripPitch;
+                    if ( task->opaqueOnly )
+                    {
+                        if ( !_IsOpaqueRGBA8( pSrc, width, task->opaqueAlpha8 ) )
+                        {
+                            InterlockedExchange( &task->translucent, 1 );
+                            return S_OK;
+                        }
+                    }
+                    else
+                    {
+                        _ScanStatsRGBA8( pSrc, width, info.scan, *task, accum, classes );
+                    }
+                }
+
+                if ( task->opaqueOnly && task->translucent )
+                    return S_OK;
+            }
+        }
+        else
+        {
+            const uint8_t* pSrc = image.pixels + y * image.rowPitch;
+            for( size_t j = 0; j < rows; ++j, pSrc += image.rowPitch )
+            {
+                if ( task->opaqueOnly )
+                {
+                    if ( !_IsOpaqueRGBA8( pSrc, width, task->opaqueAlpha8 ) )
+                    {
+                        InterlockedExchange( &task->translucent, 1 );
+                        return S_OK;
+                    }
+
+                    if ( task->translucent )
+                        return S_OK;
+                }
+                else
+                {
+                    _ScanStatsRGBA8( pSrc, width, info.scan, *task, accum, classes );
+                }
+            }
+        }
+
+        band.minV = XMFLOAT4( float(accum.minV[0]) / 255.f, float(accum.minV[1]) / 255.f, float(accum.minV[2]) / 255.f, float(accum.minV[3]) / 255.f );
+        band.maxV = XMFLOAT4( float(accum.maxV[0]) / 255.f, float(accum.maxV[1]) / 255.f, float(accum.maxV[2]) / 255.f, float(accum.maxV[3]) / 255.f );
+        for( size_t k = 0; k < 4; ++k )
+        {
+            band.sum[k] = double( accum.sum[k] ) / 255.0;
+        }
+    }
+
+    band.classes = classes;
+
+    return S_OK;
+}
+
+static HRESULT _ComputeStatistics( _In_reads_(nimages) const Image* images, _In_ size_t nimages, _In_ DWORD flags, _Out_ ImageStatistics& stats )
+{
+    memset( &stats, 0, sizeof(ImageStatistics) );
+
+    if ( !images || !nimages )
+        return E_INVALIDARG;
+
+    StatsTask task;
+    task.images = images;
+    task.opaqueOnly = ( flags & CSTATS_OPAQUE_ONLY ) != 0;
+    task.translucent = 0;
+
+    std::vector<StatsImage> info;
+    info.resize( nimages );
+
+    task.offsets.reserve( nimages + 1 );
+    task.offsets.push_back( 0 );
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        const Image& image = images[ index ];
+
+        if ( !image.pixels )
+            return E_POINTER;
+
+        if ( !image.width || !image.height )
+            return E_INVALIDARG;
+
+        if ( IsPlanar( image.format ) || IsPalettized( image.format ) || !_GetStatsImage( image, info[ index ] ) )
+            return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+        // Only images that can hold alpha need to be read to find out if they are opaque
+        size_t bands = ( image.height + STATS_BAND_ROWS - 1 ) / STATS_BAND_ROWS;
+        if ( task.opaqueOnly && !info[ index ].alpha )
+        {
+            bands = 0;
+        }
+
+        task.offsets.push_back( task.offsets.back() + bands );
+    }
+
+    task.info = &info[0];
+
+    StatsBand empty;
+    memset( &empty, 0, sizeof(StatsBand) );
+    task.bands.resize( task.offsets.back(), empty );
+
+    task.opaqueAlpha8 = 255;
+    task.clearAlpha8 = 0;
+    task.grayDelta8 = 0;
+    for( uint32_t i = 0; i < 256; ++i )
+    {
+        const float f = float(i) / 255.f;
+
+        if ( f < STATS_OPAQUE_ALPHA )
+        {
+            task.opaqueAlpha8 = i + 1;
+        }
+        if ( f <= STATS_CLEAR_ALPHA )
+        {
+            task.clearAlpha8 = i;
+        }
+        if ( f <= STATS_GRAY_TOLERANCE )
+        {
+            task.grayDelta8 = i;
+        }
+
+        task.normal8[i] = f * 2.f - 1.f;
+    }
+
+    if ( task.offsets.back() > 0 )
+    {
+        HRESULT hr = _RunTasks( task.offsets.back(), ( flags & CSTATS_PARALLEL ) != 0, _ComputeStatistics_Task, &task );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
+    if ( task.opaqueOnly )
+    {
+        stats.opaque = !task.translucent;
+        return S_OK;
+    }
+
+    // Reduce in band order
+    XMVECTOR vmin = g_XMInfinity;
+    XMVECTOR vmax = XMVectorNegate( g_XMInfinity );
+    double sum[4] = { 0 };
+    size_t pixels = 0;
+    DWORD classes = STATS_OPAQUE | STATS_BINARY_ALPHA | STATS_GRAYSCALE | STATS_NORMAL_MAP;
+
+    for( size_t item = 0; item < task.bands.size(); ++item )
+    {
+        const StatsBand& band = task.bands[ item ];
+
+        vmin = XMVectorMin( vmin, XMLoadFloat4( &band.minV ) );
+        vmax = XMVectorMax( vmax, XMLoadFloat4( &band.maxV ) );
+        for( size_t k = 0; k < 4; ++k )
+        {
+            sum[k] += band.sum[k];
+        }
+        classes &= band.classes;
+    }
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        pixels += images[ index ].width * images[ index ].height;
+    }
+
+    XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( stats.minV ), vmin );
+    XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( stats.maxV ), vmax );
+    for( size_t k = 0; k < 4; ++k )
+    {
+        stats.meanV[k] = static_cast<float>( sum[k] / double(pixels) );
+    }
+
+    stats.opaque = ( classes & STATS_OPAQUE ) != 0;
+    stats.binaryAlpha = ( classes & STATS_BINARY_ALPHA ) != 0;
+    stats.grayscale = ( classes & STATS_GRAYSCALE ) != 0;
+    stats.normalMap = ( classes & STATS_NORMAL_MAP ) != 0;
+
+    return S_OK;
+}
+
+//-------------------------------------------------------------------------------------
+// Atlas packing
+//   Each page keeps a skyline: the top edge of the space used so far, as a list of
+//   horizontal segments sorted by x. An image goes at the position that leaves its top
+//   edge lowest (ties go to the narrower segment), and the skyline is raised under it.
+//   Padding is handled by packing images grown by 'padding' into a page that is also
+//   'padding' larger, so there is no gap along the right and bottom edges
+//-------------------------------------------------------------------------------------
+struct SkylineNode
+{
+    size_t x;
+    size_t y;
+    size_t w;
+};
+
+struct AtlasItem
+{
+    size_t w;
+    size_t h;
+    size_t index;
+};
+
+static bool _AtlasItemLess( const AtlasItem& a, const AtlasItem& b )
+{
+    // Tallest first, then widest; index keeps the order stable
+    if ( a.h != b.h )
+        return a.h > b.h;
+    if ( a.w != b.w )
+        return a.w > b.w;
+    return a.index < b.index;
+}
+
+static bool _SkylineFit( _In_ const std::vector<SkylineNode>& skyline, _In_ size_t node, _In_ size_t w, _In_ size_t h,
+                         _In_ size_t pageWidth, _In_ size_t pageHeight, _Out_ size_t& y )
+{
+    y = 0;
+
+    const size_t x = skyline[ node ].x;
+    if ( x + w > pageWidth )
+        return false;
+
+    size_t widthLeft = w;
+    size_t top = skyline[ node ].y;
+    for( size_t i = node; widthLeft > 0; ++i )
+    {
+        assert( i < skyline.size() );
+
+        top = std::max( top, skyline[ i ].y );
+        if ( top + h > pageHeight )
+            return false;
+
+        widthLeft -= std::min( widthLeft, skyline[ i ].w );
+    }
+
+    y = top;
+    return true;
+}
+
+static bool _SkylineInsert( _Inout_ std::vector<SkylineNode>& skyline, _In_ size_t w, _In_ size_t h,
+                            _In_ size_t pageWidth, _In_ size_t pageHeight, _Out_ size_t& x, _Out_ size_t& y )
+{
+    x = y = 0;
+
+    size_t best = size_t(-1);
+    size_t bestTop = size_t(-1);
+    size_t bestWidth = size_t(-1);
+
+    for( size_t i = 0; i < skyline.size(); ++i )
+    {
+        size_t top;
+        if ( !_SkylineFit( skyline, i, w, h, pageWidth, pageHeight, top ) )
+            continue;
+
+        if ( ( top + h < bestTop ) || ( top + h == bestTop && skyline[ i ].w < bestWidth ) )
+        {
+            best = i;
+            bestTop = top + h;
+            bestWidth = skyline[ i ].w;
+            y = top;
+        }
+    }
+
+    if ( best == size_t(-1) )
+        return false;
+
+    x = skyline[ best ].x;
+
+    SkylineNode node;
+    node.x = x;
+    node.y = y + h;
+    node.w = w;
+    skyline.insert( skyline.begin() + best, node );
+
+    // Trim or remove the segments now covered by the new one
+    for( size_t i = best + 1; i < skyline.size(); )
+    {
+        const size_t right = skyline[ i - 1 ].x + skyline[ i - 1 ].w;
+        if ( skyline[ i ].x >= right )
+            break;
+
+        const size_t shrink = right - skyline[ i ].x;
+        if ( skyline[ i ].w <= shrink )
+        {
+            skyline.erase( skyline.begin() + i );
+            continue;
+        }
+
+        skyline[ i ].x += shrink;
+        skyline[ i ].w -= shrink;
+        break;
+    }
+
+    // Merge neighbours at the same height
+    for( size_t i = 0; i + 1 < skyline.size(); )
+    {
+        if ( skyline[ i ].y == skyline[ i + 1 ].y )
+        {
+            skyline[ i ].w += skyline[ i + 1 ].w;
+            skyline.erase( skyline.begin() + i + 1 );
+        }
+        else
+        {
+            ++i;
+        }
     }
 
-    return S_OK; 
+    return true;
+}
+
+struct AtlasCopyTask
+{
+    const Image*            srcImages;
+    const Image*            pages;
+    const AtlasPlacement*   placements;
+    DWORD                   filter;
+};
+
+static HRESULT _CopyAtlasImage_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const AtlasCopyTask* task = reinterpret_cast<const AtlasCopyTask*>( pContext );
+    assert( task );
+
+    const Image& src = task->srcImages[ item ];
+    const AtlasPlacement& place = task->placements[ item ];
+
+    return CopyRectangle( src, Rect( 0, 0, src.width, src.height ), task->pages[ place.page ], task->filter, place.rect.x, place.rect.y );
 }
 
 
@@ -216,6 +1266,18 @@ HRESULT CopyRectangle( const Image& srcImage, const Rect& srcRect, const Image&
         // Direct copy case (avoid intermediate conversions)
         uint8_t* pDest = dstImage.pixels + (yOffset * dstImage.rowPitch) + (xOffset * sbpp);
         const size_t copyW = srcRect.w * sbpp;
+
+        if ( copyW == srcImage.rowPitch && srcImage.rowPitch == dstImage.rowPitch )
+        {
+            // Whole rows with the same pitch are contiguous in both images
+            const size_t copySize = copyW * srcRect.h;
+            if ( ( (pSrc+copySize) > pEndSrc ) || ( (pDest+copySize) > pEndDest ) )
+                return E_FAIL;
+
+            memcpy_s( pDest, pEndDest - pDest, pSrc, copySize );
+            return S_OK;
+        }
+
         for( size_t h=0; h < srcRect.h; ++h )
         {
             if ( ( (pSrc+copyW) > pEndSrc ) || (pDest > pEndDest) )
@@ -246,7 +1308,7 @@ HRESULT CopyRectangle( const Image& srcImage, const Rect& srcRect, const Image&
 
     uint8_t* pDest = dstImage.pixels + (yOffset * dstImage.rowPitch) + (xOffset * dbpp);
 
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*srcRect.w), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*srcRect.w) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -275,80 +1337,174 @@ HRESULT CopyRectangle( const Image& srcImage, const Rect& srcRect, const Image&
 
     
 //-------------------------------------------------------------------------------------
-// Computes the Mean-Squared-Error (MSE) between two images
+// Packs images into one or more atlas pages
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT ComputeMSE( const Image& image1, const Image& image2, float& mse, float* mseV, DWORD flags )
+HRESULT PackAtlas( const Image* srcImages, size_t nimages, size_t pageWidth, size_t pageHeight, size_t padding,
+                   AtlasPlacement* placements, size_t& pageCount )
 {
-    if ( !image1.pixels || !image2.pixels )
-        return E_POINTER;
+    pageCount = 0;
 
-    if ( image1.width != image2.width || image1.height != image2.height )
+    if ( !srcImages || !nimages || !placements || !pageWidth || !pageHeight )
         return E_INVALIDARG;
 
-    if ( IsPlanar( image1.format ) || IsPlanar( image2.format )
-         || IsPalettized( image1.format ) || IsPalettized( image2.format ) )
-        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    std::vector<AtlasItem> items;
+    items.reserve( nimages );
 
-    if ( IsCompressed(image1.format) )
+    for( size_t index = 0; index < nimages; ++index )
     {
-        if ( IsCompressed(image2.format) )
-        {
-            // Case 1: both images are compressed, expand to RGBA32F
-            ScratchImage temp1;
-            HRESULT hr = Decompress( image1, DXGI_FORMAT_R32G32B32A32_FLOAT, temp1 );
-            if ( FAILED(hr) )
-                return hr;
+        const Image& img = srcImages[ index ];
+        if ( !img.width || !img.height || img.width > pageWidth || img.height > pageHeight )
+            return E_INVALIDARG;
 
-            ScratchImage temp2;
-            hr = Decompress(  image2, DXGI_FORMAT_R32G32B32A32_FLOAT, temp2 );
-            if ( FAILED(hr) )
-                return hr;
+        AtlasItem item;
+        item.w = img.width + padding;
+        item.h = img.height + padding;
+        item.index = index;
+        items.push_back( item );
+    }
 
-            const Image* img1 = temp1.GetImage(0,0,0);
-            const Image* img2 = temp2.GetImage(0,0,0);
-            if ( !img1 || !img2 )
-                return E_POINTER;
+    std::sort( items.begin(), items.end(), _AtlasItemLess );
 
-            return _ComputeMSE( *img1, *img2, mse, mseV, flags );
-        }
-        else
+    const size_t packWidth = pageWidth + padding;
+    const size_t packHeight = pageHeight + padding;
+
+    std::vector< std::vector<SkylineNode> > pages;
+
+    for( auto it = items.cbegin(); it != items.cend(); ++it )
+    {
+        size_t page = 0;
+        size_t x, y;
+        for( ; page < pages.size(); ++page )
         {
-            // Case 2: image1 is compressed, expand to RGBA32F
-            ScratchImage temp;
-            HRESULT hr = Decompress( image1, DXGI_FORMAT_R32G32B32A32_FLOAT, temp );
-            if ( FAILED(hr) )
-                return hr;
+            if ( _SkylineInsert( pages[ page ], it->w, it->h, packWidth, packHeight, x, y ) )
+                break;
+        }
 
-            const Image* img = temp.GetImage(0,0,0);
-            if ( !img )
-                return E_POINTER;
+        if ( page == pages.size() )
+        {
+            SkylineNode node;
+            node.x = node.y = 0;
+            node.w = packWidth;
+            pages.push_back( std::vector<SkylineNode>( 1, node ) );
 
-            return _ComputeMSE( *img, image2, mse, mseV, flags );
+            if ( !_SkylineInsert( pages.back(), it->w, it->h, packWidth, packHeight, x, y ) )
+                return E_UNEXPECTED;
         }
+
+        const Image& img = srcImages[ it->index ];
+        AtlasPlacement& place = placements[ it->index ];
+        place.page = page;
+        place.rect = Rect( x, y, img.width, img.height );
     }
-    else
+
+    pageCount = pages.size();
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Packs images into atlas pages and copies them into place
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT CreateAtlas( const Image* srcImages, size_t nimages, DXGI_FORMAT format, size_t pageWidth, size_t pageHeight, size_t padding,
+                     DWORD filter, AtlasPlacement* placements, ScratchImage& atlas )
+{
+    if ( !srcImages || !nimages || !placements )
+        return E_INVALIDARG;
+
+    if ( IsCompressed( format ) || IsPlanar( format ) || IsPalettized( format ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    for( size_t index = 0; index < nimages; ++index )
     {
-        if ( IsCompressed(image2.format) )
-        {
-            // Case 3: image2 is compressed, expand to RGBA32F
-            ScratchImage temp;
-            HRESULT hr = Decompress( image2, DXGI_FORMAT_R32G32B32A32_FLOAT, temp );
-            if ( FAILED(hr) )
-                return hr;
+        if ( !srcImages[ index ].pixels )
+            return E_POINTER;
+    }
 
-            const Image* img = temp.GetImage(0,0,0);
-            if ( !img )
-                return E_POINTER;
+    size_t pageCount;
+    HRESULT hr = PackAtlas( srcImages, nimages, pageWidth, pageHeight, padding, placements, pageCount );
+    if ( FAILED(hr) )
+        return hr;
 
-            return _ComputeMSE( image1, *img, mse, mseV, flags );
-        }
-        else
-        {
-            // Case 4: neither image is compressed
-            return _ComputeMSE( image1, image2, mse, mseV, flags );
-        }
+    hr = atlas.Initialize2D( format, pageWidth, pageHeight, pageCount, 1 );
+    if ( FAILED(hr) )
+        return hr;
+
+    // Whatever isn't covered by an image (padding, unused space) is left as zero
+    memset( atlas.GetPixels(), 0, atlas.GetPixelsSize() );
+
+    AtlasCopyTask task;
+    task.srcImages = srcImages;
+    task.pages = atlas.GetImages();
+    task.placements = placements;
+    task.filter = filter & ~TEX_FILTER_PARALLEL;
+
+    hr = _RunTasks( nimages, (filter & TEX_FILTER_PARALLEL) != 0, _CopyAtlasImage_Task, &task );
+    if ( FAILED(hr) )
+    {
+        atlas.Release();
+        return hr;
     }
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Computes the Mean-Squared-Error (MSE) between two images
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT ComputeMSE( const Image& image1, const Image& image2, float& mse, float* mseV, DWORD flags )
+{
+    ImageMetrics metrics;
+    HRESULT hr = _ComputeMetrics( &image1, &image2, 1, flags, nullptr, &metrics );
+    if ( FAILED(hr) )
+        return hr;
+
+    mse = metrics.mse;
+    if ( mseV )
+    {
+        memcpy( mseV, metrics.mseV, sizeof(float)*4 );
+    }
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Computes MSE, PSNR, max error and SSIM between two images
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT ComputeMetrics( const Image& image1, const Image& image2, DWORD flags, ImageMetrics& metrics )
+{
+    return _ComputeMetrics( &image1, &image2, 1, flags, nullptr, &metrics );
+}
+
+_Use_decl_annotations_
+HRESULT ComputeMetrics( const Image* images1, const Image* images2, size_t nimages, DWORD flags, ImageMetrics* imageMetrics, ImageMetrics* totalMetrics )
+{
+    if ( !imageMetrics && !totalMetrics )
+        return E_INVALIDARG;
+
+    return _ComputeMetrics( images1, images2, nimages, flags, imageMetrics, totalMetrics );
+}
+
+
+//-------------------------------------------------------------------------------------
+// Computes per-channel statistics and classifies an image
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT ComputeImageStatistics( const Image& image, DWORD flags, ImageStatistics& stats )
+{
+    return _ComputeStatistics( &image, 1, flags, stats );
+}
+
+_Use_decl_annotations_
+HRESULT ComputeImageStatistics( const Image* images, size_t nimages, DWORD flags, ImageStatistics& stats )
+{
+    return _ComputeStatistics( images, nimages, flags, stats );
 }
 
 }; // namespace
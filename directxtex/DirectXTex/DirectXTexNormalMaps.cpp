@@ -48,7 +48,14 @@ static inline float _EvaluateColor( _In_ FXMVECTOR val, _In_ DWORD flags )
     }
 }
 
-static void _EvaluateRow( _In_reads_(width) const XMVECTOR* pSource, _Out_writes_(width+2) float* pDest,
+// Evaluated rows have a height for each pixel plus one on either side (wrapped or mirrored in U), and are padded out so the
+// kernel below can always read 4 pixels' worth of neighbours at a time
+static inline size_t _NMapRowStride( _In_ size_t width )
+{
+    return ( ( width + 3 ) & ~size_t(3) ) + 4;
+}
+
+static void _EvaluateRow( _In_reads_(width) const XMVECTOR* pSource, _Out_writes_(_NMapRowStride(width)) float* pDest,
                           _In_ size_t width, _In_ DWORD flags )
 {
     assert( pSource && pDest );
@@ -71,163 +78,178 @@ static void _EvaluateRow( _In_reads_(width) const XMVECTOR* pSource, _Out_writes
         pDest[0] = _EvaluateColor( pSource[width-1], flags );
         pDest[width+1] = _EvaluateColor( pSource[0], flags );
     }
+
+    for( size_t x = width + 2; x < _NMapRowStride( width ); ++x )
+    {
+        pDest[x] = 0.f;
+    }
 }
 
-static HRESULT _ComputeNMap( _In_ const Image& srcImage, _In_ DWORD flags, _In_ float amplitude,
-                             _In_ DXGI_FORMAT format, _In_ const Image& normalMap )
+static bool _LoadAndEvaluateRow( _Out_writes_(width) XMVECTOR* pScanline, _Out_writes_(_NMapRowStride(width)) float* pDest,
+                                 _In_reads_bytes_(size) const uint8_t* pSource, _In_ size_t size, _In_ DXGI_FORMAT format,
+                                 _In_ size_t width, _In_ DWORD flags )
 {
-    if ( !srcImage.pixels || !normalMap.pixels )
-        return E_INVALIDARG;
+    if ( !_LoadScanline( pScanline, width, pSource, size, format ) )
+        return false;
 
-    const DWORD convFlags = _GetConvertFlags( format );
-    if ( !convFlags )
-        return E_FAIL;
+    _EvaluateRow( pScanline, pDest, width, flags );
+    return true;
+}
 
-    if ( !( convFlags & (CONVF_UNORM | CONVF_SNORM | CONVF_FLOAT) ) )
-        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+//-------------------------------------------------------------------------------------
+// Computes one scanline of normals (and occlusion) from three evaluated rows, 4 pixels at a time
+//-------------------------------------------------------------------------------------
+static void _ComputeNMapRow( _In_ const float* val0, _In_ const float* val1, _In_ const float* val2, _In_ size_t width,
+                             _In_ DWORD flags, _In_ float amplitude, _In_ DWORD convFlags,
+                             _Out_writes_((width+3) & ~3) XMVECTOR* pDest )
+{
+    static const XMVECTORF32 s_Six = { 6.f, 6.f, 6.f, 6.f };
+    static const XMVECTORF32 s_Eight = { 8.f, 8.f, 8.f, 8.f };
+    static const XMVECTORF32 s_Two = { 2.f, 2.f, 2.f, 2.f };
+
+    const bool sobel = ( flags & CNMAP_SOBEL ) != 0;
+    const XMVECTOR amp = XMVectorReplicate( amplitude );
+    const XMVECTOR divisor = sobel ? s_Eight : s_Six;
+    const XMVECTOR occScale = XMVectorReplicate( 0.125f * amplitude );
+
+    for( size_t x = 0; x < width; x += 4 )
+    {
+        // Heights of the 3x3 neighbourhood of pixels x .. x+3
+        const XMVECTOR a0 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val0 + x ) );
+        const XMVECTOR b0 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val0 + x + 1 ) );
+        const XMVECTOR c0 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val0 + x + 2 ) );
+        const XMVECTOR a1 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val1 + x ) );
+        const XMVECTOR b1 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val1 + x + 1 ) );
+        const XMVECTOR c1 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val1 + x + 2 ) );
+        const XMVECTOR a2 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val2 + x ) );
+        const XMVECTOR b2 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val2 + x + 1 ) );
+        const XMVECTOR c2 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( val2 + x + 2 ) );
+
+        // Differences across the neighbourhood, center row/column doubled for Sobel
+        XMVECTOR totX, totY;
+        if ( sobel )
+        {
+            totX = XMVectorAdd( XMVectorMultiplyAdd( XMVectorSubtract( a1, c1 ), s_Two, XMVectorSubtract( a0, c0 ) ), XMVectorSubtract( a2, c2 ) );
+            totY = XMVectorAdd( XMVectorMultiplyAdd( XMVectorSubtract( b0, b2 ), s_Two, XMVectorSubtract( a0, a2 ) ), XMVectorSubtract( c0, c2 ) );
+        }
+        else
+        {
+            totX = XMVectorAdd( XMVectorAdd( XMVectorSubtract( a0, c0 ), XMVectorSubtract( a1, c1 ) ), XMVectorSubtract( a2, c2 ) );
+            totY = XMVectorAdd( XMVectorAdd( XMVectorSubtract( a0, a2 ), XMVectorSubtract( b0, b2 ) ), XMVectorSubtract( c0, c2 ) );
+        }
+
+        XMVECTOR deltaZX = XMVectorDivide( XMVectorMultiply( totX, amp ), divisor );
+        XMVECTOR deltaZY = XMVectorDivide( XMVectorMultiply( totY, amp ), divisor );
 
+        // normalize( cross( (-1, 0, deltaZX), (0, -1, deltaZY) ) ) = (deltaZX, deltaZY, 1) / length
+        XMVECTOR length = XMVectorSqrt( XMVectorMultiplyAdd( deltaZX, deltaZX, XMVectorMultiplyAdd( deltaZY, deltaZY, g_XMOne ) ) );
+
+        XMVECTOR nx = XMVectorDivide( deltaZX, length );
+        XMVECTOR ny = XMVectorDivide( deltaZY, length );
+        XMVECTOR nz = XMVectorDivide( g_XMOne, length );
+
+        // Compute alpha (1.0 or an occlusion term)
+        XMVECTOR alpha = g_XMOne;
+
+        if ( flags & CNMAP_COMPUTE_OCCLUSION )
+        {
+            // Sum of the neighbours above the current pixel (skipping the pixel itself)
+            XMVECTOR delta = XMVectorMax( XMVectorSubtract( a0, b1 ), g_XMZero );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( b0, b1 ), g_XMZero ) );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( c0, b1 ), g_XMZero ) );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( a1, b1 ), g_XMZero ) );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( c1, b1 ), g_XMZero ) );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( a2, b1 ), g_XMZero ) );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( b2, b1 ), g_XMZero ) );
+            delta = XMVectorAdd( delta, XMVectorMax( XMVectorSubtract( c2, b1 ), g_XMZero ) );
+
+            // Average delta (divide by 8, scale by amplitude factor)
+            delta = XMVectorMultiply( delta, occScale );
+
+            // If <= 0, then no occlusion
+            XMVECTOR r = XMVectorSqrt( XMVectorMultiplyAdd( delta, delta, g_XMOne ) );
+            XMVECTOR occ = XMVectorDivide( XMVectorSubtract( r, delta ), r );
+            alpha = XMVectorSelect( g_XMOne, occ, XMVectorGreater( delta, g_XMZero ) );
+        }
+
+        // Encode based on target format
+        if ( convFlags & CONVF_UNORM )
+        {
+            // 0.5f*normal + 0.5f -or- invert sign case: -0.5f*normal + 0.5f
+            const XMVECTOR scale = (flags & CNMAP_INVERT_SIGN) ? g_XMNegativeOneHalf : g_XMOneHalf;
+            nx = XMVectorMultiplyAdd( scale, nx, g_XMOneHalf );
+            ny = XMVectorMultiplyAdd( scale, ny, g_XMOneHalf );
+            nz = XMVectorMultiplyAdd( scale, nz, g_XMOneHalf );
+        }
+        else if ( flags & CNMAP_INVERT_SIGN )
+        {
+            nx = XMVectorNegate( nx );
+            ny = XMVectorNegate( ny );
+            nz = XMVectorNegate( nz );
+        }
+
+        // Back to one vector per pixel
+        XMMATRIX M( nx, ny, nz, alpha );
+        M = XMMatrixTranspose( M );
+
+        pDest[x] = M.r[0];
+        pDest[x+1] = M.r[1];
+        pDest[x+2] = M.r[2];
+        pDest[x+3] = M.r[3];
+    }
+}
+
+//-------------------------------------------------------------------------------------
+// Generates a band of rows of a normal map
+//   Each band reads the row above and below it, so bands are independent
+//-------------------------------------------------------------------------------------
+#define NMAP_BAND_ROWS 16
+
+static HRESULT _ComputeNMapBand( _In_ const Image& srcImage, _In_ DWORD flags, _In_ float amplitude, _In_ DWORD convFlags,
+                                 _In_ const Image& normalMap, _In_ size_t y0, _In_ size_t rows )
+{
     const size_t width = srcImage.width;
     const size_t height = srcImage.height;
-    if ( width != normalMap.width || height != normalMap.height )
-        return E_FAIL;
+    const size_t rowPitch = srcImage.rowPitch;
 
-    // Allocate temporary space (4 scanlines and 3 evaluated rows)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*4), 16 ) ) );
+    assert( width == normalMap.width && height == normalMap.height );
+    assert( rows > 0 && (y0 + rows) <= height );
+
+    // Allocate temporary space (1 scanline and 3 evaluated rows)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * ( ( width + 3 ) & ~size_t(3) ) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
-    ScopedAlignedArrayFloat buffer( reinterpret_cast<float*>( _aligned_malloc( ( ( sizeof(float) * ( width + 2 ) ) * 3 ), 16 ) ) );
+    const size_t stride = _NMapRowStride( width );
+    ScopedAlignedArrayFloat buffer( reinterpret_cast<float*>( _AllocScratch( sizeof(float) * stride * 3 ) ) );
     if ( !buffer )
         return E_OUTOFMEMORY;
 
-    uint8_t* pDest = normalMap.pixels;
-    if ( !pDest )
-        return E_POINTER;
-
-    XMVECTOR* row0 = scanline.get();
-    XMVECTOR* row1 = row0 + width;
-    XMVECTOR* row2 = row1 + width;
-    XMVECTOR* target = row2 + width;
-
     float* val0 = buffer.get();
-    float* val1 = val0 + width + 2;
-    float* val2 = val1 + width + 2;
-
-    const size_t rowPitch = srcImage.rowPitch;
-    const uint8_t* pSrc = srcImage.pixels;
+    float* val1 = val0 + stride;
+    float* val2 = val1 + stride;
 
-    // Read first scanline row into 'row1'
-    if ( !_LoadScanline( row1, width, pSrc, rowPitch, srcImage.format ) )
+    // Row above the band (mirrored or wrapped for the first row)
+    size_t prev = ( y0 > 0 ) ? ( y0 - 1 ) : ( ( flags & CNMAP_MIRROR_V ) ? 0 : ( height - 1 ) );
+    if ( !_LoadAndEvaluateRow( scanline.get(), val0, srcImage.pixels + rowPitch*prev, rowPitch, srcImage.format, width, flags ) )
         return E_FAIL;
 
-    // Setup 'row0'
-    if ( flags & CNMAP_MIRROR_V )
-    {
-        // Mirror first row
-        memcpy_s( row0, rowPitch, row1, rowPitch );
-    }
-    else
-    {
-        // Read last row (Wrap V)
-        if ( !_LoadScanline( row0, width, pSrc + (rowPitch * (height-1)), rowPitch, srcImage.format ) )
-            return E_FAIL;
-    }
-
-    // Evaluate the initial rows
-    _EvaluateRow( row0, val0, width, flags );
-    _EvaluateRow( row1, val1, width, flags );
+    if ( !_LoadAndEvaluateRow( scanline.get(), val1, srcImage.pixels + rowPitch*y0, rowPitch, srcImage.format, width, flags ) )
+        return E_FAIL;
 
-    pSrc += rowPitch;
+    uint8_t* pDest = normalMap.pixels + normalMap.rowPitch*y0;
 
-    for( size_t y = 0; y < height; ++y )
+    for( size_t y = y0; y < (y0 + rows); ++y )
     {
-        // Load next scanline of source image
-        if ( y < (height-1) )
-        {
-            if ( !_LoadScanline( row2, width, pSrc, rowPitch, srcImage.format ) )
-                return E_FAIL;
-        }
-        else
-        {
-            if ( flags & CNMAP_MIRROR_V )
-            {
-                // Use last row of source image
-                if ( !_LoadScanline( row2, width, srcImage.pixels + (rowPitch * (height-1)), rowPitch, srcImage.format ) )
-                    return E_FAIL;
-            }
-            else
-            {
-                // Use first row of source image (Wrap V)
-                if ( !_LoadScanline( row2, width, srcImage.pixels, rowPitch, srcImage.format ) )
-                    return E_FAIL;
-            }
-        }
-
-        // Evaluate row
-        _EvaluateRow( row2, val2, width, flags );
+        // Row below (mirrored or wrapped for the last row)
+        size_t next = ( y < (height-1) ) ? ( y + 1 ) : ( ( flags & CNMAP_MIRROR_V ) ? ( height - 1 ) : 0 );
+        if ( !_LoadAndEvaluateRow( scanline.get(), val2, srcImage.pixels + rowPitch*next, rowPitch, srcImage.format, width, flags ) )
+            return E_FAIL;
 
         // Generate target scanline
-        XMVECTOR *dptr = target;
-        for( size_t x = 0; x < width; ++x )
-        {
-            // Compute normal via central differencing
-            float totDelta = ( val0[x] - val0[x+2] ) + ( val1[x] - val1[x+2] ) + ( val2[x] - val2[x+2] );
-            float deltaZX = totDelta * amplitude / 6.f;
-
-            totDelta = ( val0[x] - val2[x] ) + ( val0[x+1] - val2[x+1] ) + ( val0[x+2] - val2[x+2] );
-            float deltaZY = totDelta * amplitude / 6.f;
-
-            XMVECTOR vx = XMVectorSetZ( g_XMNegIdentityR0, deltaZX );   // (-1.0f, 0.0f, deltaZX)
-            XMVECTOR vy = XMVectorSetZ( g_XMNegIdentityR1, deltaZY );   // (0.0f, -1.0f, deltaZY)
-
-            XMVECTOR normal = XMVector3Normalize( XMVector3Cross( vx, vy ) );
-
-            // Compute alpha (1.0 or an occlusion term)
-            float alpha = 1.f;
-
-            if ( flags & CNMAP_COMPUTE_OCCLUSION )
-            {
-                float delta = 0.f;
-                float c = val1[x+1];
-
-                float t = val0[x] - c;  if ( t > 0.f ) delta += t;
-                t = val0[x+1]   - c;    if ( t > 0.f ) delta += t;
-                t = val0[x+2]   - c;    if ( t > 0.f ) delta += t;
-                t = val1[x]     - c;    if ( t > 0.f ) delta += t;
-                // Skip current pixel
-                t = val1[x+2]   - c;    if ( t > 0.f ) delta += t;
-                t = val2[x]     - c;    if ( t > 0.f ) delta += t;
-                t = val2[x+1]   - c;    if ( t > 0.f ) delta += t;
-                t = val2[x+2]   - c;    if ( t > 0.f ) delta += t;
-
-                // Average delta (divide by 8, scale by amplitude factor)
-                delta *= 0.125f * amplitude;
-                if ( delta > 0.f )
-                {
-                    // If < 0, then no occlusion
-                    float r = sqrtf( 1.f + delta*delta );
-                    alpha = (r - delta) / r;
-                }
-            }
-
-            // Encode based on target format
-            if ( convFlags & CONVF_UNORM )
-            {
-                // 0.5f*normal + 0.5f -or- invert sign case: -0.5f*normal + 0.5f
-                XMVECTOR n1 = XMVectorMultiplyAdd( (flags & CNMAP_INVERT_SIGN) ? g_XMNegativeOneHalf : g_XMOneHalf, normal, g_XMOneHalf ); 
-                *dptr++ = XMVectorSetW( n1, alpha );
-            }
-            else if ( flags & CNMAP_INVERT_SIGN )
-            {
-                *dptr++ = XMVectorSetW( XMVectorNegate( normal ), alpha );
-            }
-            else
-            {
-                *dptr++ = XMVectorSetW( normal, alpha );
-            }
-        }
+        _ComputeNMapRow( val0, val1, val2, width, flags, amplitude, convFlags, scanline.get() );
 
-        if ( !_StoreScanline( pDest, normalMap.rowPitch, format, target, width ) )
+        if ( !_StoreScanline( pDest, normalMap.rowPitch, normalMap.format, scanline.get(), width ) )
             return E_FAIL;
 
         // Cycle buffers
@@ -236,13 +258,73 @@ static HRESULT _ComputeNMap( _In_ const Image& srcImage, _In_ DWORD flags, _In_
         val1 = val2;
         val2 = temp;
 
-        pSrc += rowPitch;
         pDest += normalMap.rowPitch;
     }
 
     return S_OK;
 }
 
+struct NMapTask
+{
+    const Image*        srcImages;
+    const Image*        destImages;
+    std::vector<size_t> offsets;
+    DWORD               flags;
+    float               amplitude;
+    DWORD               convFlags;
+};
+
+static HRESULT _ComputeNMap_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const NMapTask* task = reinterpret_cast<const NMapTask*>( pContext );
+    assert( task );
+
+    const size_t index = _FindTaskImage( task->offsets, item );
+    const Image& src = task->srcImages[ index ];
+
+    const size_t y0 = ( item - task->offsets[ index ] ) * NMAP_BAND_ROWS;
+    const size_t rows = std::min<size_t>( NMAP_BAND_ROWS, src.height - y0 );
+
+    return _ComputeNMapBand( src, task->flags, task->amplitude, task->convFlags, task->destImages[ index ], y0, rows );
+}
+
+static HRESULT _ComputeNMap( _In_reads_(nimages) const Image* srcImages, _In_reads_(nimages) const Image* destImages, _In_ size_t nimages,
+                             _In_ DWORD flags, _In_ float amplitude, _In_ DXGI_FORMAT format )
+{
+    const DWORD convFlags = _GetConvertFlags( format );
+    if ( !convFlags )
+        return E_FAIL;
+
+    if ( !( convFlags & (CONVF_UNORM | CONVF_SNORM | CONVF_FLOAT) ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    NMapTask task;
+    task.srcImages = srcImages;
+    task.destImages = destImages;
+    task.flags = flags;
+    task.amplitude = amplitude;
+    task.convFlags = convFlags;
+
+    task.offsets.reserve( nimages + 1 );
+    task.offsets.push_back( 0 );
+
+    for( size_t index = 0; index < nimages; ++index )
+    {
+        const Image& src = srcImages[ index ];
+        const Image& dest = destImages[ index ];
+
+        if ( !src.pixels || !dest.pixels )
+            return E_INVALIDARG;
+
+        if ( src.width != dest.width || src.height != dest.height || dest.format != format )
+            return E_FAIL;
+
+        task.offsets.push_back( task.offsets.back() + ( src.height + NMAP_BAND_ROWS - 1 ) / NMAP_BAND_ROWS );
+    }
+
+    return _RunTasks( task.offsets.back(), (flags & CNMAP_PARALLEL) != 0, _ComputeNMap_Task, &task );
+}
+
 
 //=====================================================================================
 // Entry points
@@ -293,7 +375,7 @@ HRESULT ComputeNormalMap( const Image& srcImage, DWORD flags, float amplitude,
         return E_POINTER;
     }
 
-    hr = _ComputeNMap( srcImage, flags, amplitude, format, *img );
+    hr = _ComputeNMap( &srcImage, img, 1, flags, amplitude, format );
     if ( FAILED(hr) )
     {
         normalMap.Release();
@@ -368,13 +450,142 @@ HRESULT ComputeNormalMap( const Image* srcImages, size_t nimages, const TexMetad
             normalMaps.Release();
             return E_FAIL;
         }
+    }
+
+    // Every mip and array item is computed in a single pass, so CNMAP_PARALLEL can spread all of them across threads
+    hr = _ComputeNMap( srcImages, dest, nimages, flags, amplitude, format );
+    if ( FAILED(hr) )
+    {
+        normalMaps.Release();
+        return hr;
+    }
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Generates a normal map from a height-map supplied (and consumed) one scanline at a time
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT ComputeNormalMapStreaming( size_t width, size_t height, DXGI_FORMAT srcFormat, TEX_NMAP_READ_CALLBACK pfRead,
+                                   DWORD flags, float amplitude, DXGI_FORMAT format, TEX_NMAP_WRITE_CALLBACK pfWrite, void* pContext )
+{
+    if ( !width || !height || !pfRead || !pfWrite || !IsValid(format) || !IsValid(srcFormat) )
+        return E_INVALIDARG;
+
+    static_assert( CNMAP_CHANNEL_RED == 0x1, "CNMAP_CHANNEL_ flag values don't match mask" );
+    switch( flags & 0xf )
+    {
+    case 0:
+    case CNMAP_CHANNEL_RED:
+    case CNMAP_CHANNEL_GREEN:
+    case CNMAP_CHANNEL_BLUE:
+    case CNMAP_CHANNEL_ALPHA:
+    case CNMAP_CHANNEL_LUMINANCE:
+        break;
+
+    default:
+        return E_INVALIDARG;
+    }
+
+    if ( IsCompressed(format) || IsCompressed(srcFormat)
+         || IsTypeless(format) || IsTypeless(srcFormat) 
+         || IsPlanar(format) || IsPlanar(srcFormat) 
+         || IsPalettized(format) || IsPalettized(srcFormat) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    const DWORD convFlags = _GetConvertFlags( format );
+    if ( !convFlags )
+        return E_FAIL;
+
+    if ( !( convFlags & (CONVF_UNORM | CONVF_SNORM | CONVF_FLOAT) ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    size_t srcPitch, destPitch, slicePitch;
+    ComputePitch( srcFormat, width, 1, srcPitch, slicePitch, CP_FLAGS_NONE );
+    ComputePitch( format, width, 1, destPitch, slicePitch, CP_FLAGS_NONE );
+
+    // Allocate temporary space (source and destination scanlines, 1 converted scanline and 4 evaluated rows)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * ( ( width + 3 ) & ~size_t(3) ) ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
+
+    const size_t stride = _NMapRowStride( width );
+    ScopedAlignedArrayFloat buffer( reinterpret_cast<float*>( _AllocScratch( sizeof(float) * stride * 4 ) ) );
+    if ( !buffer )
+        return E_OUTOFMEMORY;
+
+    std::unique_ptr<uint8_t[]> raw( new (std::nothrow) uint8_t[ srcPitch + destPitch ] );
+    if ( !raw )
+        return E_OUTOFMEMORY;
 
-        hr = _ComputeNMap( src, flags, amplitude, format, dest[ index ] );
+    uint8_t* pSrc = raw.get();
+    uint8_t* pDest = raw.get() + srcPitch;
+
+    float* val0 = buffer.get();
+    float* val1 = val0 + stride;
+    float* val2 = val1 + stride;
+    float* first = val2 + stride;   // First row, kept for wrapping the last row in V
+
+    HRESULT hr;
+    if ( !( flags & CNMAP_MIRROR_V ) && height > 1 )
+    {
+        // Read last row (Wrap V)
+        hr = pfRead( height - 1, pSrc, srcPitch, pContext );
         if ( FAILED(hr) )
-        {
-            normalMaps.Release();
             return hr;
+
+        if ( !_LoadAndEvaluateRow( scanline.get(), val0, pSrc, srcPitch, srcFormat, width, flags ) )
+            return E_FAIL;
+    }
+
+    hr = pfRead( 0, pSrc, srcPitch, pContext );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( !_LoadAndEvaluateRow( scanline.get(), first, pSrc, srcPitch, srcFormat, width, flags ) )
+        return E_FAIL;
+
+    memcpy( val1, first, sizeof(float) * stride );
+    if ( ( flags & CNMAP_MIRROR_V ) || height == 1 )
+    {
+        // Mirror first row
+        memcpy( val0, first, sizeof(float) * stride );
+    }
+
+    for( size_t y = 0; y < height; ++y )
+    {
+        if ( y < (height-1) )
+        {
+            hr = pfRead( y + 1, pSrc, srcPitch, pContext );
+            if ( FAILED(hr) )
+                return hr;
+
+            if ( !_LoadAndEvaluateRow( scanline.get(), val2, pSrc, srcPitch, srcFormat, width, flags ) )
+                return E_FAIL;
+        }
+        else
+        {
+            // Use last row (Mirror V) or first row (Wrap V) of source image
+            memcpy( val2, ( flags & CNMAP_MIRROR_V ) ? val1 : first, sizeof(float) * stride );
         }
+
+        // Generate target scanline
+        _ComputeNMapRow( val0, val1, val2, width, flags, amplitude, convFlags, scanline.get() );
+
+        if ( !_StoreScanline( pDest, destPitch, format, scanline.get(), width ) )
+            return E_FAIL;
+
+        hr = pfWrite( y, pDest, destPitch, pContext );
+        if ( FAILED(hr) )
+            return hr;
+
+        // Cycle buffers
+        float* temp = val0;
+        val0 = val1;
+        val1 = val2;
+        val2 = temp;
     }
 
     return S_OK;
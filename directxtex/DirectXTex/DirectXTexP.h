@@ -27,6 +27,7 @@
 #include <memory>
 
 #include <vector>
+#include <algorithm>
 
 #include <stdlib.h>
 #include <search.h>
@@ -191,6 +192,10 @@ namespace DirectX
                                _Inout_updates_all_(count) XMVECTOR* pSource, _In_ size_t count, _In_ float threshold, size_t y, size_t z,
                                _Inout_updates_all_opt_(count+2) XMVECTOR* pDiffusionErrors );
 
+    void _ConvertScanlineSRGBToLinear( _Inout_updates_all_(count) XMVECTOR* pBuffer, _In_ size_t count );
+    void _ConvertScanlineLinearToSRGB( _Inout_updates_all_(count) XMVECTOR* pBuffer, _In_ size_t count );
+        // Table-driven sRGB curve on the RGB channels; values are clamped to [0,1] and alpha is left unchanged
+
     HRESULT _ConvertToR32G32B32A32( _In_ const Image& srcImage, _Inout_ ScratchImage& image );
 
     HRESULT _ConvertFromR32G32B32A32( _In_ const Image& srcImage, _In_ const Image& destImage );
@@ -201,6 +206,35 @@ namespace DirectX
     void _ConvertScanline( _Inout_updates_all_(count) XMVECTOR* pBuffer, _In_ size_t count,
                            _In_ DXGI_FORMAT outFormat, _In_ DXGI_FORMAT inFormat, _In_ DWORD flags );
 
+    //---------------------------------------------------------------------------------
+    // Task scheduler
+    //   pfTask is called once per work item, from up to GetMaxThreads() threads when parallel is true and OpenMP is available.
+    //   Items are handed out as threads become free, so callers flatten the work for all the images involved
+    //   (mips, array slices, volume slices) into one list rather than parallelizing one image at a time
+    typedef HRESULT (*TEXP_TASK)( _In_ size_t item, _In_opt_ void* pContext );
+
+    HRESULT _RunTasks( _In_ size_t nItems, _In_ bool parallel, _In_ TEXP_TASK pfTask, _In_opt_ void* pContext );
+
+    inline size_t _FindTaskImage( _In_ const std::vector<size_t>& offsets, _In_ size_t item )
+    {
+        // offsets holds the first item of each image followed by the total number of items
+        assert( offsets.size() > 1 && item < offsets.back() );
+        return static_cast<size_t>( std::upper_bound( offsets.begin(), offsets.end(), item ) - offsets.begin() ) - 1;
+    }
+
+    //---------------------------------------------------------------------------------
+    // Memory helper functions
+
+    // ScratchImage pixel memory, from allocator if it is set and the global image allocator otherwise; used receives the
+    // allocator the memory has to be given back to
+    _Ret_maybenull_ void* _AllocateImageMemory( _In_ size_t size, _In_ const ImageAllocator& allocator, _Out_ ImageAllocator& used );
+    void _FreeImageMemory( _In_opt_ void* p, _In_ size_t size, _In_ const ImageAllocator& allocator );
+
+    // Temporary buffers (scanlines and the like), 16-byte aligned. Freed buffers are kept in a small per-thread cache and
+    // handed out again to later requests that fit, so repeated operations stop going back to the heap for each one
+    _Ret_maybenull_ void* _AllocScratch( _In_ size_t size );
+    void _FreeScratch( _In_opt_ void* p );
+
     //---------------------------------------------------------------------------------
     // DDS helper functions
     HRESULT _EncodeDDSHeader( _In_ const TexMetadata& metadata, DWORD flags,
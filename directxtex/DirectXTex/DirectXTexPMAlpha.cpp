@@ -23,7 +23,7 @@ static HRESULT _PremultiplyAlpha( _In_ const Image& srcImage, _In_ const Image&
     assert( srcImage.width == destImage.width );
     assert( srcImage.height == destImage.height );
 
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*srcImage.width), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*srcImage.width) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -66,7 +66,7 @@ static HRESULT _PremultiplyAlphaLinear( _In_ const Image& srcImage, _In_ DWORD f
     static_assert( TEX_PMALPHA_SRGB == TEX_FILTER_SRGB, "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*" );
     flags &= TEX_PMALPHA_SRGB;
 
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*srcImage.width), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( (sizeof(XMVECTOR)*srcImage.width) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -210,7 +210,8 @@ static bool _UseWICFiltering( _In_ DXGI_FORMAT format, _In_ DWORD filter )
         break;
 
     case TEX_FILTER_TRIANGLE:
-        // WIC does not implement this filter
+    case TEX_FILTER_LANCZOS:
+        // WIC does not implement these filters
         return false;
     }
 
@@ -229,8 +230,8 @@ static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image&
     assert( srcImage.format == destImage.format );
 
     // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * (srcImage.width + destImage.width ) ), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch(
+                                         ( sizeof(XMVECTOR) * (srcImage.width + destImage.width ) ) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -290,8 +291,8 @@ static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter,
         return E_FAIL;
 
     // Allocate temporary space (3 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch(
+                                         ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -349,8 +350,8 @@ static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filte
     assert( srcImage.format == destImage.format );
 
     // Allocate temporary space (3 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch(
+                                         ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -435,8 +436,8 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
     assert( srcImage.format == destImage.format );
 
     // Allocate temporary space (5 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*4 + destImage.width ) ), 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch(
+                                         ( sizeof(XMVECTOR) * ( srcImage.width*4 + destImage.width ) ) ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -597,7 +598,7 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
     using namespace TriangleFilter;
 
     // Allocate initial temporary space (1 scanline, accumulation rows, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * srcImage.width, 16 ) ) );
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * srcImage.width ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
@@ -666,7 +667,7 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
                 }
                 else
                 {
-                    rowAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * destImage.width, 16 ) ) );
+                    rowAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _AllocScratch( sizeof(XMVECTOR) * destImage.width ) ) );
                     if ( !rowAcc->scanline )
                         return E_OUTOFMEMORY;
                 }
@@ -764,6 +765,159 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
 }
 
 
+//--- Lanczos Filter ---
+//   Separable polyphase resize with the weight tables built once per axis; each work item resizes a
+//   band of output rows, horizontally filtering each source row the band needs once and adding it into
+//   every output row whose vertical taps cover it
+#define RESIZE_TASK_ROWS 32
+
+struct PolyphaseTask
+{
+    const Image*            srcImage;
+    const Image*            destImage;
+    DWORD                   filter;
+    size_t                  tapsX;
+    size_t                  tapsY;
+    const size_t*           indexX;
+    const float*            weightX;
+    const ptrdiff_t*        startY;
+    const size_t*           indexY;
+    const float*            weightY;
+};
+
+static HRESULT _Polyphase_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const PolyphaseTask* task = reinterpret_cast<const PolyphaseTask*>( pContext );
+    assert( task );
+
+    const Image& srcImage = *task->srcImage;
+    const Image& destImage = *task->destImage;
+
+    const size_t width = destImage.width;
+    const size_t tapsX = task->tapsX;
+    const size_t tapsY = task->tapsY;
+
+    const size_t y0 = item * RESIZE_TASK_ROWS;
+    const size_t y1 = std::min<size_t>( y0 + RESIZE_TASK_ROWS, destImage.height );
+
+    // Allocate temporary space (1 source scanline, 1 filtered scanline, plus an accumulator per output row of the band)
+    // which doesn't depend on the number of taps, so heavy minification costs source reads but not memory
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _AllocScratch(
+                                         ( sizeof(XMVECTOR) * ( srcImage.width + width * ( y1 - y0 + 1 ) ) ) ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
+
+    XMVECTOR* row = scanline.get();
+    XMVECTOR* hrow = row + srcImage.width;
+    XMVECTOR* accum = hrow + width;
+
+    for( size_t i = 0; i < width * ( y1 - y0 ); ++i )
+        accum[ i ] = XMVectorZero();
+
+    const uint8_t* pSrc = srcImage.pixels;
+    uint8_t* pDest = destImage.pixels + y0 * destImage.rowPitch;
+
+    // Vertical taps only ever move forward, so output rows [done,open) are the ones covering source row v, and
+    // each is complete (and stored) as soon as v moves past its last tap
+    size_t done = y0;
+    size_t open = y0;
+
+    const ptrdiff_t vEnd = task->startY[ y1 - 1 ] + ptrdiff_t(tapsY);
+    for( ptrdiff_t v = task->startY[ y0 ]; v < vEnd; ++v )
+    {
+        for( ; done < open && task->startY[ done ] + ptrdiff_t(tapsY) <= v; ++done )
+        {
+            if ( !_StoreScanlineLinear( pDest, destImage.rowPitch, destImage.format, accum + ( done - y0 ) * width, width, task->filter ) )
+                return E_FAIL;
+            pDest += destImage.rowPitch;
+        }
+
+        for( ; open < y1 && task->startY[ open ] <= v; ++open );
+
+        if ( done == open )
+            continue;
+
+        size_t u = task->indexY[ done * tapsY + size_t( v - task->startY[ done ] ) ];
+
+        if ( !_LoadScanlineLinear( row, srcImage.width, pSrc + srcImage.rowPitch * u, srcImage.rowPitch, srcImage.format, task->filter ) )
+            return E_FAIL;
+
+        const size_t* indexX = task->indexX;
+        const float* weightX = task->weightX;
+        for( size_t x = 0; x < width; ++x, indexX += tapsX, weightX += tapsX )
+        {
+            XMVECTOR acc = XMVectorZero();
+            for( size_t t = 0; t < tapsX; ++t )
+            {
+                acc = XMVectorMultiplyAdd( row[ indexX[ t ] ], XMVectorReplicate( weightX[ t ] ), acc );
+            }
+            hrow[ x ] = acc;
+        }
+
+        for( size_t y = done; y < open; ++y )
+        {
+            float weight = task->weightY[ y * tapsY + size_t( v - task->startY[ y ] ) ];
+            if ( weight == 0.f )
+                continue;
+
+            XMVECTOR w = XMVectorReplicate( weight );
+            XMVECTOR* target = accum + ( y - y0 ) * width;
+            for( size_t x = 0; x < width; ++x )
+            {
+                target[ x ] = XMVectorMultiplyAdd( hrow[ x ], w, target[ x ] );
+            }
+        }
+    }
+
+    for( ; done < y1; ++done )
+    {
+        if ( !_StoreScanlineLinear( pDest, destImage.rowPitch, destImage.format, accum + ( done - y0 ) * width, width, task->filter ) )
+            return E_FAIL;
+        pDest += destImage.rowPitch;
+    }
+
+    return S_OK;
+}
+
+static HRESULT _ResizeLanczosFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+{
+    assert( srcImage.pixels && destImage.pixels );
+    assert( srcImage.format == destImage.format );
+
+    const size_t tapsX = _PolyphaseTaps( srcImage.width, destImage.width );
+    const size_t tapsY = _PolyphaseTaps( srcImage.height, destImage.height );
+
+    const size_t countX = destImage.width * tapsX;
+    const size_t countY = destImage.height * tapsY;
+
+    std::unique_ptr<size_t[]> index( new (std::nothrow) size_t[ countX + countY ] );
+    std::unique_ptr<float[]> weight( new (std::nothrow) float[ countX + countY ] );
+    std::unique_ptr<ptrdiff_t[]> start( new (std::nothrow) ptrdiff_t[ destImage.width + destImage.height ] );
+    if ( !index || !weight || !start )
+        return E_OUTOFMEMORY;
+
+    _CreatePolyphaseFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0,
+                            tapsX, start.get(), index.get(), weight.get() );
+    _CreatePolyphaseFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0,
+                            tapsY, start.get() + destImage.width, index.get() + countX, weight.get() + countX );
+
+    PolyphaseTask task;
+    task.srcImage = &srcImage;
+    task.destImage = &destImage;
+    task.filter = filter;
+    task.tapsX = tapsX;
+    task.tapsY = tapsY;
+    task.indexX = index.get();
+    task.weightX = weight.get();
+    task.startY = start.get() + destImage.width;
+    task.indexY = index.get() + countX;
+    task.weightY = weight.get() + countX;
+
+    const size_t nbands = ( destImage.height + RESIZE_TASK_ROWS - 1 ) / RESIZE_TASK_ROWS;
+    return _RunTasks( nbands, ( filter & TEX_FILTER_PARALLEL ) != 0, _Polyphase_Task, &task );
+}
+
+
 //--- Custom filter resize ---
 static HRESULT _PerformResizeUsingCustomFilters( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
 {
@@ -797,12 +951,32 @@ static HRESULT _PerformResizeUsingCustomFilters( _In_ const Image& srcImage, _In
     case TEX_FILTER_TRIANGLE:
         return _ResizeTriangleFilter( srcImage, filter, destImage );
 
+    case TEX_FILTER_LANCZOS:
+        return _ResizeLanczosFilter( srcImage, filter, destImage );
+
     default:
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 }
 
 
+//--- Resizes one image of a complex image per work item (TEX_FILTER_PARALLEL) ---
+struct ResizeTask
+{
+    std::vector<const Image*>   srcImages;
+    std::vector<const Image*>   destImages;
+    DWORD                       filter;
+};
+
+static HRESULT _Resize_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    const ResizeTask* task = reinterpret_cast<const ResizeTask*>( pContext );
+    assert( task && item < task->srcImages.size() );
+
+    return _PerformResizeUsingCustomFilters( *task->srcImages[ item ], task->filter, *task->destImages[ item ] );
+}
+
+
 //=====================================================================================
 // Entry-points
 //=====================================================================================
@@ -898,6 +1072,12 @@ HRESULT Resize( const Image* srcImages, size_t nimages, const TexMetadata& metad
     WICPixelFormatGUID pfGUID = {0};
     bool wicpf = ( usewic ) ? _DXGIToWIC( metadata.format, pfGUID, true ) : false;
 
+    // When parallel, the images are only validated here and then resized together as one batch of work
+    const bool parallel = ( filter & TEX_FILTER_PARALLEL ) && !usewic;
+
+    ResizeTask task;
+    task.filter = filter;
+
     switch ( metadata.dimension )
     {
     case TEX_DIMENSION_TEXTURE1D:
@@ -935,6 +1115,13 @@ HRESULT Resize( const Image* srcImages, size_t nimages, const TexMetadata& metad
             }
 #endif
 
+            if ( parallel )
+            {
+                task.srcImages.push_back( srcimg );
+                task.destImages.push_back( destimg );
+                continue;
+            }
+
             if ( usewic )
             {
                 if ( wicpf )
@@ -996,6 +1183,13 @@ HRESULT Resize( const Image* srcImages, size_t nimages, const TexMetadata& metad
             }
 #endif
 
+            if ( parallel )
+            {
+                task.srcImages.push_back( srcimg );
+                task.destImages.push_back( destimg );
+                continue;
+            }
+
             if ( usewic )
             {
                 if ( wicpf )
@@ -1028,6 +1222,16 @@ HRESULT Resize( const Image* srcImages, size_t nimages, const TexMetadata& metad
         return E_FAIL;
     }
 
+    if ( parallel )
+    {
+        hr = _RunTasks( task.srcImages.size(), true, _Resize_Task, &task );
+        if ( FAILED(hr) )
+        {
+            result.Release();
+            return hr;
+        }
+    }
+
     return S_OK;
 }
 
@@ -20,7 +20,7 @@
 //      * Does not support files that contain color maps (these are rare in practice)
 //      * Interleaved files are not supported (deprecated aspect of TGA format)
 //      * Only supports 8-bit grayscale; 16-, 24-, and 32-bit truecolor images
-//      * Always writes uncompressed files (i.e. can read RLE compression, but does not write it)
+//      * Writes uncompressed files unless TGA_FLAGS_RLE is given
 //
 
 enum TGAImageType
@@ -250,486 +250,354 @@ static HRESULT _SetAlphaChannelToOpaque( _In_ const Image* image )
 
 
 //-------------------------------------------------------------------------------------
-// Uncompress pixel data from a TGA into the target image
+// Pixel conversion
+//   TGA stores 32-bit pixels as BGRA, 24-bit pixels as BGR, and 16-bit pixels in the
+//   same bit layout as DXGI_FORMAT_B5G5R5A1_UNORM
 //-------------------------------------------------------------------------------------
-static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size, _In_ const Image* image, _In_ DWORD convFlags )
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+#define TGA_SSE2
+
+static const XMVECTORU32 g_TGAMaskGA    = { 0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00 };
+static const XMVECTORU32 g_TGAMaskG     = { 0x0000FF00, 0x0000FF00, 0x0000FF00, 0x0000FF00 };
+static const XMVECTORU32 g_TGAMaskA     = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+static const XMVECTORU32 g_TGAMask8     = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+static inline __m128i _SwapRedBlueSSE2( __m128i p, __m128i keep )
 {
-    assert( pSource && size > 0 );
+    __m128i rb = _mm_or_si128( _mm_and_si128( _mm_srli_epi32( p, 16 ), g_TGAMask8 ), _mm_slli_epi32( _mm_and_si128( p, g_TGAMask8 ), 16 ) );
+    return _mm_or_si128( _mm_and_si128( p, keep ), rb );
+}
+#endif
 
-    if ( !image || !image->pixels )
-        return E_POINTER;
+// BGRA <-> RGBA (in place is fine); returns true if any pixel has a non-zero alpha
+static bool _SwapRedBlue32( _Out_writes_bytes_(count*4) uint8_t* pDestination, _In_reads_bytes_(count*4) const uint8_t* pSource, _In_ size_t count )
+{
+    size_t i = 0;
+    uint32_t alpha = 0;
 
-    // Compute TGA image data pitch
-    size_t rowPitch;
-    if ( convFlags & CONV_FLAGS_EXPAND )
+#ifdef TGA_SSE2
+    __m128i valpha = _mm_setzero_si128();
+    for( ; i + 4 <= count; i += 4 )
     {
-        rowPitch = image->width * 3;
+        __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + i*4 ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( pDestination + i*4 ), _SwapRedBlueSSE2( p, g_TGAMaskGA ) );
+        valpha = _mm_or_si128( valpha, p );
     }
-    else
-    {
-        size_t slicePitch;
-        ComputePitch( image->format, image->width, image->height, rowPitch, slicePitch, CP_FLAGS_NONE );
-    }
-
-    auto sPtr = reinterpret_cast<const uint8_t*>( pSource );
-    const uint8_t* endPtr = sPtr + size;
+    valpha = _mm_or_si128( valpha, _mm_srli_si128( valpha, 8 ) );
+    valpha = _mm_or_si128( valpha, _mm_srli_si128( valpha, 4 ) );
+    alpha = static_cast<uint32_t>( _mm_cvtsi128_si32( valpha ) );
+#endif
 
-    switch( image->format )
+    for( ; i < count; ++i )
     {
-    //--------------------------------------------------------------------------- 8-bit
-    case DXGI_FORMAT_R8_UNORM:
-        for( size_t y=0; y < image->height; ++y )
-        {
-            size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-            assert( offset < rowPitch);
-
-            uint8_t* dPtr = reinterpret_cast<uint8_t*>( image->pixels )
-                         + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) )
-                         + offset;
-
-            for( size_t x=0; x < image->width; )
-            {
-                if ( sPtr >= endPtr )
-                    return E_FAIL;
-
-                if ( *sPtr & 0x80 )
-                {
-                    // Repeat
-                    size_t j = (*sPtr & 0x7F) + 1;
-                    if ( ++sPtr >= endPtr )
-                        return E_FAIL;
+        const uint8_t* sPtr = pSource + i*4;
+        uint8_t* dPtr = pDestination + i*4;
+        const uint8_t b = sPtr[0];
+        dPtr[0] = sPtr[2];
+        dPtr[1] = sPtr[1];
+        dPtr[2] = b;
+        dPtr[3] = sPtr[3];
+        alpha |= uint32_t( sPtr[3] ) << 24;
+    }
 
-                    for( ; j > 0; --j, ++x )
-                    {
-                        if ( x >= image->width )
-                            return E_FAIL;
+    return ( alpha & 0xFF000000 ) != 0;
+}
 
-                        *dPtr = *sPtr;
+// BGR -> RGBA with opaque alpha
+static void _ExpandBGR24( _Out_writes_(count) uint32_t* pDestination, _In_reads_bytes_(count*3) const uint8_t* pSource, _In_ size_t count )
+{
+    size_t i = 0;
 
-                        if ( convFlags & CONV_FLAGS_INVERTX )
-                            --dPtr;
-                        else
-                            ++dPtr;
-                    }
+#ifdef TGA_SSE2
+    // Four pixels are twelve bytes: read them as three dwords and realign
+    for( ; i + 4 <= count; i += 4 )
+    {
+        uint32_t w[3];
+        memcpy( w, pSource + i*3, 12 );
+
+        __m128i p = _mm_set_epi32( static_cast<int>( w[2] >> 8 ),
+                                   static_cast<int>( ( w[1] >> 16 ) | ( w[2] << 16 ) ),
+                                   static_cast<int>( ( w[0] >> 24 ) | ( w[1] << 8 ) ),
+                                   static_cast<int>( w[0] ) );
+        p = _mm_or_si128( _SwapRedBlueSSE2( p, g_TGAMaskG ), g_TGAMaskA );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( pDestination + i ), p );
+    }
+#endif
 
-                    ++sPtr;
-                }
-                else
-                {
-                    // Literal
-                    size_t j = (*sPtr & 0x7F) + 1;
-                    ++sPtr;
+    for( ; i < count; ++i )
+    {
+        const uint8_t* sPtr = pSource + i*3;
+        pDestination[i] = ( uint32_t( sPtr[0] ) << 16 ) | ( uint32_t( sPtr[1] ) << 8 ) | uint32_t( sPtr[2] ) | 0xFF000000;
+    }
+}
 
-                    if ( sPtr+j > endPtr )
-                        return E_FAIL;
+// 5:5:5:1 is stored as is; returns true if any pixel has the alpha bit set
+static bool _Copy16( _Out_writes_(count) uint16_t* pDestination, _In_reads_bytes_(count*2) const uint8_t* pSource, _In_ size_t count )
+{
+    memcpy( pDestination, pSource, count * 2 );
 
-                    for( ; j > 0; --j, ++x )
-                    {
-                        if ( x >= image->width )
-                            return E_FAIL;
+    uint16_t bits = 0;
+    for( size_t i = 0; i < count; ++i )
+    {
+        bits |= pDestination[i];
+    }
 
-                        *dPtr = *(sPtr++);
+    return ( bits & 0x8000 ) != 0;
+}
 
-                        if ( convFlags & CONV_FLAGS_INVERTX )
-                            --dPtr;
-                        else
-                            ++dPtr;
-                    }
-                }
-            }
-        }
-        break;
+static bool _ConvertTGAPixels( _Out_ uint8_t* pDestination, _In_ const uint8_t* pSource, _In_ size_t count,
+                               _In_ DXGI_FORMAT format, _In_ DWORD convFlags )
+{
+    switch( format )
+    {
+    case DXGI_FORMAT_R8_UNORM:
+        memcpy( pDestination, pSource, count );
+        return false;
 
-    //-------------------------------------------------------------------------- 16-bit
     case DXGI_FORMAT_B5G5R5A1_UNORM:
-        {
-            bool nonzeroa = false;
-            for( size_t y=0; y < image->height; ++y )
-            {
-                size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-                assert( offset*2 < rowPitch);
-
-                uint16_t* dPtr = reinterpret_cast<uint16_t*>( reinterpret_cast<uint8_t*>( image->pixels )
-                             + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) ) )
-                             + offset;
-
-                for( size_t x=0; x < image->width; )
-                {
-                    if ( sPtr >= endPtr )
-                        return E_FAIL;
-
-                    if ( *sPtr & 0x80 )
-                    {
-                        // Repeat
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+        return _Copy16( reinterpret_cast<uint16_t*>( pDestination ), pSource, count );
 
-                        if ( sPtr+1 >= endPtr )
-                            return E_FAIL;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        if ( convFlags & CONV_FLAGS_EXPAND )
+        {
+            _ExpandBGR24( reinterpret_cast<uint32_t*>( pDestination ), pSource, count );
+            return true;
+        }
+        return _SwapRedBlue32( pDestination, pSource, count );
 
-                        uint16_t t =  *sPtr | (*(sPtr+1) << 8);
-                        if ( t & 0x8000 )
-                            nonzeroa = true;
-                        sPtr += 2;
+    default:
+        assert( false );
+        return false;
+    }
+}
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
 
-                            *dPtr = t;
+//-------------------------------------------------------------------------------------
+// Decoding
+//   Rows are independent once we know where each one starts: for uncompressed data that
+//   is just y * width * bpp, for RLE data a quick pass over the packet headers records
+//   it. Runs never cross rows (such files have always been rejected), so each band of
+//   TGA_BAND_ROWS rows can then be decoded on its own
+//-------------------------------------------------------------------------------------
+#define TGA_BAND_ROWS 16
 
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                    else
-                    {
-                        // Literal
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+struct TGADecodeTask
+{
+    const uint8_t*          pSource;
+    const Image*            image;
+    DWORD                   convFlags;
+    size_t                  bpp;            // bytes per pixel in the file
+    size_t                  dpp;            // bytes per pixel in the image
+    std::vector<size_t>     rowOffsets;     // RLE only: offset of the first packet of each row
+    volatile LONG           nonzeroa;
+};
 
-                        if ( sPtr+(j*2) > endPtr )
-                            return E_FAIL;
+static void _DecodeTGARow( _In_ const TGADecodeTask& task, _In_ size_t y, _Inout_ bool& nonzeroa )
+{
+    const Image* image = task.image;
+    const size_t width = image->width;
+    const DWORD convFlags = task.convFlags;
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
-
-                            uint16_t t =  *sPtr | (*(sPtr+1) << 8);
-                            if ( t & 0x8000 )
-                                nonzeroa = true;
-                            sPtr += 2;
-                            *dPtr = t;
-
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                }
-            }
+    uint8_t* dPtr = image->pixels + image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) );
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if ( !nonzeroa )
-            {
-                HRESULT hr = _SetAlphaChannelToOpaque( image );
-                if ( FAILED(hr) )
-                    return hr;
-            }
-        }
-        break;
+    if ( convFlags & CONV_FLAGS_RLE )
+    {
+        const uint8_t* sPtr = task.pSource + task.rowOffsets[ y ];
 
-    //----------------------------------------------------------------------- 24/32-bit
-    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        for( size_t x = 0; x < width; )
         {
-            bool nonzeroa = false;
-            for( size_t y=0; y < image->height; ++y )
-            {
-                size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
+            const size_t j = (*sPtr & 0x7F) + 1;
+            assert( x + j <= width );
 
-                uint32_t* dPtr = reinterpret_cast<uint32_t*>( reinterpret_cast<uint8_t*>( image->pixels )
-                              + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) ) )
-                              + offset;
+            if ( *(sPtr++) & 0x80 )
+            {
+                // Repeat
+                uint8_t* pixel = dPtr + x * task.dpp;
+                if ( _ConvertTGAPixels( pixel, sPtr, 1, image->format, convFlags ) )
+                    nonzeroa = true;
 
-                for( size_t x=0; x < image->width; )
+                switch( task.dpp )
                 {
-                    if ( sPtr >= endPtr )
-                        return E_FAIL;
-
-                    if ( *sPtr & 0x80 )
-                    {
-                        // Repeat
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
-
-                        DWORD t;
-                        if ( convFlags & CONV_FLAGS_EXPAND )
-                        {
-                            assert( offset*3 < rowPitch);
-
-                            if ( sPtr+2 >= endPtr )
-                                return E_FAIL;
-
-                            // BGR -> RGBA
-                            t = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
-                            sPtr += 3;
+                case 1:
+                    memset( pixel + 1, *pixel, j - 1 );
+                    break;
 
-                            nonzeroa = true;
-                        }
-                        else
-                        {
-                            assert( offset*4 < rowPitch);
+                case 2:
+                    std::fill_n( reinterpret_cast<uint16_t*>( pixel ) + 1, j - 1, *reinterpret_cast<const uint16_t*>( pixel ) );
+                    break;
 
-                            if ( sPtr+3 >= endPtr )
-                                return E_FAIL;
-
-                            // BGRA -> RGBA
-                            t = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
+                default:
+                    std::fill_n( reinterpret_cast<uint32_t*>( pixel ) + 1, j - 1, *reinterpret_cast<const uint32_t*>( pixel ) );
+                    break;
+                }
 
-                            if ( *(sPtr+3) > 0 )
-                                nonzeroa = true;
+                sPtr += task.bpp;
+            }
+            else
+            {
+                // Literal
+                if ( _ConvertTGAPixels( dPtr + x * task.dpp, sPtr, j, image->format, convFlags ) )
+                    nonzeroa = true;
 
-                            sPtr += 4;
-                        }
+                sPtr += j * task.bpp;
+            }
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
+            x += j;
+        }
+    }
+    else
+    {
+        if ( _ConvertTGAPixels( dPtr, task.pSource + y * width * task.bpp, width, image->format, convFlags ) )
+            nonzeroa = true;
+    }
 
-                            *dPtr = t;
+    if ( convFlags & CONV_FLAGS_INVERTX )
+    {
+        switch( task.dpp )
+        {
+        case 1:
+            std::reverse( dPtr, dPtr + width );
+            break;
 
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                    else
-                    {
-                        // Literal
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+        case 2:
+            std::reverse( reinterpret_cast<uint16_t*>( dPtr ), reinterpret_cast<uint16_t*>( dPtr ) + width );
+            break;
 
-                        if ( convFlags & CONV_FLAGS_EXPAND )
-                        {
-                            if ( sPtr+(j*3) > endPtr )
-                                return E_FAIL;
-                        }
-                        else
-                        {
-                            if ( sPtr+(j*4) > endPtr )
-                                return E_FAIL;
-                        }
+        default:
+            std::reverse( reinterpret_cast<uint32_t*>( dPtr ), reinterpret_cast<uint32_t*>( dPtr ) + width );
+            break;
+        }
+    }
+}
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
+static HRESULT _DecodeTGA_Task( _In_ size_t item, _In_opt_ void* pContext )
+{
+    TGADecodeTask* task = reinterpret_cast<TGADecodeTask*>( pContext );
+    assert( task );
 
-                            if ( convFlags & CONV_FLAGS_EXPAND )
-                            {
-                                assert( offset*3 < rowPitch);
+    const size_t y = item * TGA_BAND_ROWS;
+    const size_t rows = std::min<size_t>( TGA_BAND_ROWS, task->image->height - y );
 
-                                if ( sPtr+2 >= endPtr )
-                                    return E_FAIL;
+    bool nonzeroa = false;
+    for( size_t j = 0; j < rows; ++j )
+    {
+        _DecodeTGARow( *task, y + j, nonzeroa );
+    }
 
-                                // BGR -> RGBA
-                                *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
-                                sPtr += 3;
+    if ( nonzeroa )
+    {
+        InterlockedExchange( &task->nonzeroa, 1 );
+    }
 
-                                nonzeroa = true;
-                            }
-                            else
-                            {
-                                assert( offset*4 < rowPitch);
+    return S_OK;
+}
 
-                                if ( sPtr+3 >= endPtr )
-                                    return E_FAIL;
+static HRESULT _DecodeTGARows( _Inout_ TGADecodeTask& task, _In_ bool parallel )
+{
+    const Image* image = task.image;
 
-                                // BGRA -> RGBA
-                                *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
+    task.nonzeroa = 0;
 
-                                if ( *(sPtr+3) > 0 )
-                                    nonzeroa = true;
+    HRESULT hr = _RunTasks( ( image->height + TGA_BAND_ROWS - 1 ) / TGA_BAND_ROWS, parallel, _DecodeTGA_Task, &task );
+    if ( FAILED(hr) )
+        return hr;
 
-                                sPtr += 4;
-                            }
+    // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
+    if ( image->format != DXGI_FORMAT_R8_UNORM && !task.nonzeroa )
+    {
+        hr = _SetAlphaChannelToOpaque( image );
+        if ( FAILED(hr) )
+            return hr;
+    }
 
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                }
-            }
+    return S_OK;
+}
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if ( !nonzeroa )
-            {
-                HRESULT hr = _SetAlphaChannelToOpaque( image );
-                if ( FAILED(hr) )
-                    return hr;
-            }
-        }
-        break;
+static bool _SetupTGADecode( _In_ LPCVOID pSource, _In_ const Image* image, _In_ DWORD convFlags, _Out_ TGADecodeTask& task )
+{
+    task.pSource = reinterpret_cast<const uint8_t*>( pSource );
+    task.image = image;
+    task.convFlags = convFlags;
 
-    //---------------------------------------------------------------------------------
+    switch( image->format )
+    {
+    case DXGI_FORMAT_R8_UNORM:          task.bpp = 1; task.dpp = 1; break;
+    case DXGI_FORMAT_B5G5R5A1_UNORM:    task.bpp = 2; task.dpp = 2; break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:    task.bpp = ( convFlags & CONV_FLAGS_EXPAND ) ? 3 : 4; task.dpp = 4; break;
     default:
-        return E_FAIL;
+        return false;
     }
 
-    return S_OK;
+    return true;
 }
 
 
 //-------------------------------------------------------------------------------------
-// Copies pixel data from a TGA into the target image
+// Uncompress pixel data from a TGA into the target image
 //-------------------------------------------------------------------------------------
-static HRESULT _CopyPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size, _In_ const Image* image, _In_ DWORD convFlags )
+static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size, _In_ const Image* image, _In_ DWORD convFlags, _In_ bool parallel )
 {
     assert( pSource && size > 0 );
 
     if ( !image || !image->pixels )
         return E_POINTER;
 
-    // Compute TGA image data pitch
-    size_t rowPitch;
-    if ( convFlags & CONV_FLAGS_EXPAND )
-    {
-        rowPitch = image->width * 3;
-    }
-    else
-    {
-        size_t slicePitch;
-        ComputePitch( image->format, image->width, image->height, rowPitch, slicePitch, CP_FLAGS_NONE );
-    }
-
-    const uint8_t* sPtr = reinterpret_cast<const uint8_t*>( pSource );
-    const uint8_t* endPtr = sPtr + size;
-
-    switch( image->format )
-    {
-    //--------------------------------------------------------------------------- 8-bit
-    case DXGI_FORMAT_R8_UNORM:
-        for( size_t y=0; y < image->height; ++y )
-        {
-            size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-            assert( offset < rowPitch);
-
-            uint8_t* dPtr = reinterpret_cast<uint8_t*>( image->pixels )
-                         + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) )
-                         + offset;
+    TGADecodeTask task;
+    if ( !_SetupTGADecode( pSource, image, convFlags, task ) )
+        return E_FAIL;
 
-            for( size_t x=0; x < image->width; ++x )
-            {
-                if ( sPtr >= endPtr )
-                    return E_FAIL;
+    // Find where each row starts, validating the packets on the way
+    auto sPtr = reinterpret_cast<const uint8_t*>( pSource );
+    size_t offset = 0;
 
-                *dPtr = *(sPtr++);
+    task.rowOffsets.resize( image->height );
 
-                if ( convFlags & CONV_FLAGS_INVERTX )
-                    --dPtr;
-                else
-                    ++dPtr;
-            }
-        }
-        break;
+    for( size_t y = 0; y < image->height; ++y )
+    {
+        task.rowOffsets[ y ] = offset;
 
-    //-------------------------------------------------------------------------- 16-bit
-    case DXGI_FORMAT_B5G5R5A1_UNORM:
+        for( size_t x = 0; x < image->width; )
         {
-            bool nonzeroa = false;
-            for( size_t y=0; y < image->height; ++y )
-            {
-                size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-                assert( offset*2 < rowPitch);
-
-                uint16_t* dPtr = reinterpret_cast<uint16_t*>( reinterpret_cast<uint8_t*>( image->pixels )
-                             + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) ) )
-                             + offset;
-
-                for( size_t x=0; x < image->width; ++x )
-                {
-                    if ( sPtr+1 >= endPtr )
-                        return E_FAIL;
+            if ( offset >= size )
+                return E_FAIL;
 
-                    uint16_t t =  *sPtr | (*(sPtr+1) << 8);
-                    sPtr += 2;
-                    *dPtr = t;
+            const uint8_t packet = sPtr[ offset++ ];
+            const size_t j = (packet & 0x7F) + 1;
 
-                    if ( t & 0x8000 )
-                        nonzeroa = true;
+            if ( x + j > image->width )
+                return E_FAIL;
 
-                    if ( convFlags & CONV_FLAGS_INVERTX )
-                        --dPtr;
-                    else
-                        ++dPtr;
-                }
-            }
+            const size_t bytes = ( packet & 0x80 ) ? task.bpp : j * task.bpp;
+            if ( bytes > size - offset )
+                return E_FAIL;
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if ( !nonzeroa )
-            {
-                HRESULT hr = _SetAlphaChannelToOpaque( image );
-                if ( FAILED(hr) )
-                    return hr;
-            }
+            offset += bytes;
+            x += j;
         }
-        break;
-
-    //----------------------------------------------------------------------- 24/32-bit
-    case DXGI_FORMAT_R8G8B8A8_UNORM:
-        {
-            bool nonzeroa = false;
-            for( size_t y=0; y < image->height; ++y )
-            {
-                size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-
-                uint32_t* dPtr = reinterpret_cast<uint32_t*>( reinterpret_cast<uint8_t*>( image->pixels )
-                              + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) ) )
-                              + offset;
-
-                for( size_t x=0; x < image->width; ++x )
-                {
-                    if ( convFlags & CONV_FLAGS_EXPAND )
-                    {
-                        assert( offset*3 < rowPitch);
-
-                        if ( sPtr+2 >= endPtr )
-                            return E_FAIL;
-
-                        // BGR -> RGBA
-                        *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
-                        sPtr += 3;
-
-                        nonzeroa = true;
-                    }
-                    else
-                    {
-                        assert( offset*4 < rowPitch);
-
-                        if ( sPtr+3 >= endPtr )
-                            return E_FAIL;
+    }
 
-                        // BGRA -> RGBA
-                        *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
+    return _DecodeTGARows( task, parallel );
+}
 
-                        if ( *(sPtr+3) > 0 )
-                            nonzeroa = true;
 
-                        sPtr += 4;
-                    }
+//-------------------------------------------------------------------------------------
+// Copies pixel data from a TGA into the target image
+//-------------------------------------------------------------------------------------
+static HRESULT _CopyPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size, _In_ const Image* image, _In_ DWORD convFlags, _In_ bool parallel )
+{
+    assert( pSource && size > 0 );
 
-                    if ( convFlags & CONV_FLAGS_INVERTX )
-                        --dPtr;
-                    else
-                        ++dPtr;
-                }
-            }
+    if ( !image || !image->pixels )
+        return E_POINTER;
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if ( !nonzeroa )
-            {
-                HRESULT hr = _SetAlphaChannelToOpaque( image );
-                if ( FAILED(hr) )
-                    return hr;
-            }
-        }
-        break;
+    TGADecodeTask task;
+    if ( !_SetupTGADecode( pSource, image, convFlags, task ) )
+        return E_FAIL;
 
-    //---------------------------------------------------------------------------------
-    default:
+    if ( size < image->width * image->height * task.bpp )
         return E_FAIL;
-    }
 
-    return S_OK;   
+    return _DecodeTGARows( task, parallel );
 }
 
 
@@ -791,6 +659,11 @@ static HRESULT _EncodeTGAHeader( _In_ const Image& image, _Out_ TGA_HEADER& head
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    if ( convFlags & CONV_FLAGS_RLE )
+    {
+        header.bImageType = ( header.bImageType == TGA_TRUECOLOR ) ? TGA_TRUECOLOR_RLE : TGA_BLACK_AND_WHITE_RLE;
+    }
+
     return S_OK;
 }
 
@@ -829,6 +702,101 @@ static void _Copy24bppScanline( _Out_writes_bytes_(outSize) LPVOID pDestination,
 }
 
 
+//-------------------------------------------------------------------------------------
+// Converts one image row to TGA pixel order
+//-------------------------------------------------------------------------------------
+static void _EncodeTGAScanline( _Out_writes_bytes_(rowPitch) uint8_t* pDestination, _In_ size_t rowPitch,
+                                _In_ const Image& image, _In_reads_bytes_(image.rowPitch) const uint8_t* pPixels, _In_ DWORD convFlags )
+{
+    if ( convFlags & CONV_FLAGS_888 )
+    {
+        _Copy24bppScanline( pDestination, rowPitch, pPixels, image.rowPitch );
+    }
+    else if ( convFlags & CONV_FLAGS_SWIZZLE )
+    {
+        assert( rowPitch >= image.width * 4 );
+        _SwapRedBlue32( pDestination, pPixels, image.width );
+    }
+    else
+    {
+        _CopyScanline( pDestination, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// Run-length encodes one row of TGA pixels
+//   Packets stay within the row, as TGA 2.0 asks. A run only interrupts a literal packet
+//   when it is long enough to save space (two pixels, or three for 8-bit data), so the
+//   output is never more than _MaxRLEScanline bytes
+//-------------------------------------------------------------------------------------
+inline size_t _MaxRLEScanline( _In_ size_t rowPitch, _In_ size_t width )
+{
+    return rowPitch + ( width / 128 ) + 1;
+}
+
+static inline bool _SamePixel( _In_reads_bytes_(bpp) const uint8_t* a, _In_reads_bytes_(bpp) const uint8_t* b, _In_ size_t bpp )
+{
+    switch( bpp )
+    {
+    case 1:     return a[0] == b[0];
+    case 2:     return a[0] == b[0] && a[1] == b[1];
+    case 3:     return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    default:    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+    }
+}
+
+static size_t _EncodeRLEScanline( _Out_writes_bytes_to_(_MaxRLEScanline(width*bpp, width), return) uint8_t* pDestination,
+                                  _In_reads_bytes_(width*bpp) const uint8_t* pSource, _In_ size_t width, _In_ size_t bpp )
+{
+    const size_t minRun = ( bpp > 1 ) ? 2 : 3;
+
+    uint8_t* dPtr = pDestination;
+
+    for( size_t x = 0; x < width; )
+    {
+        // Length of the run starting at x
+        size_t run = 1;
+        while( run < 128 && ( x + run ) < width && _SamePixel( pSource + x*bpp, pSource + (x + run)*bpp, bpp ) )
+            ++run;
+
+        if ( run >= minRun )
+        {
+            *(dPtr++) = static_cast<uint8_t>( 0x80 | ( run - 1 ) );
+            memcpy( dPtr, pSource + x*bpp, bpp );
+            dPtr += bpp;
+            x += run;
+            continue;
+        }
+
+        // Literal, up to the next run worth encoding
+        size_t count = run;
+        while( count < 128 && ( x + count ) < width )
+        {
+            const uint8_t* pixel = pSource + (x + count)*bpp;
+
+            size_t next = 1;
+            while( next < minRun && ( x + count + next ) < width && _SamePixel( pixel, pixel + next*bpp, bpp ) )
+                ++next;
+
+            if ( next >= minRun )
+                break;
+
+            count += next;
+        }
+
+        count = std::min<size_t>( count, 128 );
+
+        *(dPtr++) = static_cast<uint8_t>( count - 1 );
+        memcpy( dPtr, pSource + x*bpp, count*bpp );
+        dPtr += count*bpp;
+        x += count;
+    }
+
+    return static_cast<size_t>( dPtr - pDestination );
+}
+
+
 //=====================================================================================
 // Entry-points
 //=====================================================================================
@@ -909,7 +877,7 @@ HRESULT GetMetadataFromTGAFile( LPCWSTR szFile, TexMetadata& metadata )
 // Load a TGA file in memory
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata, ScratchImage& image )
+HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata, ScratchImage& image, DWORD flags )
 {
     if ( !pSource || size == 0 )
         return E_INVALIDARG;
@@ -938,11 +906,11 @@ HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata,
 
     if ( convFlags & CONV_FLAGS_RLE )
     {
-        hr = _UncompressPixels( pPixels, remaining, image.GetImage(0,0,0), convFlags );
+        hr = _UncompressPixels( pPixels, remaining, image.GetImage(0,0,0), convFlags, (flags & TGA_FLAGS_PARALLEL) != 0 );
     }
     else
     {
-        hr = _CopyPixels( pPixels, remaining, image.GetImage(0,0,0), convFlags );
+        hr = _CopyPixels( pPixels, remaining, image.GetImage(0,0,0), convFlags, (flags & TGA_FLAGS_PARALLEL) != 0 );
     }
 
     if ( FAILED(hr) )
@@ -962,7 +930,7 @@ HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata,
 // Load a TGA file from disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& image )
+HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& image, DWORD flags )
 {
     if ( !szFile )
         return E_INVALIDARG;
@@ -1186,11 +1154,11 @@ HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& im
 
         if ( convFlags & CONV_FLAGS_RLE )
         {
-            hr = _UncompressPixels( temp.get(), remaining, image.GetImage(0,0,0), convFlags );
+            hr = _UncompressPixels( temp.get(), remaining, image.GetImage(0,0,0), convFlags, (flags & TGA_FLAGS_PARALLEL) != 0 );
         }
         else
         {
-            hr = _CopyPixels( temp.get(), remaining, image.GetImage(0,0,0), convFlags );
+            hr = _CopyPixels( temp.get(), remaining, image.GetImage(0,0,0), convFlags, (flags & TGA_FLAGS_PARALLEL) != 0 );
         }
 
         if ( FAILED(hr) )
@@ -1211,13 +1179,13 @@ HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& im
 // Save a TGA file to memory
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
+HRESULT SaveToTGAMemory( const Image& image, Blob& blob, DWORD flags )
 {
     if ( !image.pixels )
         return E_POINTER;
 
     TGA_HEADER tga_header;
-    DWORD convFlags = 0;
+    DWORD convFlags = ( flags & TGA_FLAGS_RLE ) ? CONV_FLAGS_RLE : 0;
     HRESULT hr = _EncodeTGAHeader( image, tga_header, convFlags );
     if ( FAILED(hr) )
         return hr;
@@ -1236,6 +1204,17 @@ HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
         ComputePitch( image.format, image.width, image.height, rowPitch, slicePitch, CP_FLAGS_NONE );
     }
 
+    // RLE output is sized for the worst case and trimmed once the pixels are encoded
+    std::unique_ptr<uint8_t[]> temp;
+    if ( convFlags & CONV_FLAGS_RLE )
+    {
+        temp.reset( new (std::nothrow) uint8_t[ rowPitch ] );
+        if ( !temp )
+            return E_OUTOFMEMORY;
+
+        slicePitch = image.height * _MaxRLEScanline( rowPitch, image.width );
+    }
+
     hr = blob.Initialize( sizeof(TGA_HEADER) + slicePitch );
     if ( FAILED(hr) )
         return hr;
@@ -1252,23 +1231,27 @@ HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
     for( size_t y = 0; y < image.height; ++y )
     {
         // Copy pixels
-        if ( convFlags & CONV_FLAGS_888 )
-        {
-            _Copy24bppScanline( dPtr, rowPitch, pPixels, image.rowPitch );
-        }
-        else if ( convFlags & CONV_FLAGS_SWIZZLE )
+        if ( convFlags & CONV_FLAGS_RLE )
         {
-            _SwizzleScanline( dPtr, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
+            _EncodeTGAScanline( temp.get(), rowPitch, image, pPixels, convFlags );
+            dPtr += _EncodeRLEScanline( dPtr, temp.get(), image.width, rowPitch / image.width );
         }
         else
         {
-            _CopyScanline( dPtr, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
+            _EncodeTGAScanline( dPtr, rowPitch, image, pPixels, convFlags );
+            dPtr += rowPitch;
         }
 
-        dPtr += rowPitch;
         pPixels += image.rowPitch;
     }
 
+    if ( convFlags & CONV_FLAGS_RLE )
+    {
+        hr = blob.Trim( dPtr - reinterpret_cast<uint8_t*>( blob.GetBufferPointer() ) );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
     return S_OK;
 }
 
@@ -1277,7 +1260,7 @@ HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
 // Save a TGA file to disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
+HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile, DWORD flags )
 {
     if ( !szFile )
         return E_INVALIDARG;
@@ -1286,7 +1269,7 @@ HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
         return E_POINTER;
 
     TGA_HEADER tga_header;
-    DWORD convFlags = 0;
+    DWORD convFlags = ( flags & TGA_FLAGS_RLE ) ? CONV_FLAGS_RLE : 0;
     HRESULT hr = _EncodeTGAHeader( image, tga_header, convFlags );
     if ( FAILED(hr) )
         return hr;
@@ -1319,7 +1302,7 @@ HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
         // For small images, it is better to create an in-memory file and write it out
         Blob blob;
 
-        hr = SaveToTGAMemory( image, blob );
+        hr = SaveToTGAMemory( image, blob, flags );
         if ( FAILED(hr) )
             return hr;
 
@@ -1340,7 +1323,9 @@ HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
     else
     {
         // Otherwise, write the image one scanline at a time...
-        std::unique_ptr<uint8_t[]> temp( new (std::nothrow) uint8_t[ rowPitch ] );
+        const size_t outPitch = ( convFlags & CONV_FLAGS_RLE ) ? _MaxRLEScanline( rowPitch, image.width ) : 0;
+
+        std::unique_ptr<uint8_t[]> temp( new (std::nothrow) uint8_t[ rowPitch + outPitch ] );
         if ( !temp )
             return E_OUTOFMEMORY;
 
@@ -1360,27 +1345,24 @@ HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
         for( size_t y = 0; y < image.height; ++y )
         {
             // Copy pixels
-            if ( convFlags & CONV_FLAGS_888 )
-            {
-                _Copy24bppScanline( temp.get(), rowPitch, pPixels, image.rowPitch );
-            }
-            else if ( convFlags & CONV_FLAGS_SWIZZLE )
-            {
-                _SwizzleScanline( temp.get(), rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
-            }
-            else
-            {
-                _CopyScanline( temp.get(), rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
-            }
+            _EncodeTGAScanline( temp.get(), rowPitch, image, pPixels, convFlags );
 
             pPixels += image.rowPitch;
 
-            if ( !WriteFile( hFile.get(), temp.get(), static_cast<DWORD>( rowPitch ), &bytesWritten, 0 ) )
+            const uint8_t* pOut = temp.get();
+            size_t bytesToWrite = rowPitch;
+            if ( convFlags & CONV_FLAGS_RLE )
+            {
+                pOut = temp.get() + rowPitch;
+                bytesToWrite = _EncodeRLEScanline( temp.get() + rowPitch, temp.get(), image.width, rowPitch / image.width );
+            }
+
+            if ( !WriteFile( hFile.get(), pOut, static_cast<DWORD>( bytesToWrite ), &bytesWritten, 0 ) )
             {
                 return HRESULT_FROM_WIN32( GetLastError() );
             }
 
-            if ( bytesWritten != rowPitch )
+            if ( bytesWritten != bytesToWrite )
                 return E_FAIL;
         }
     }
@@ -15,6 +15,11 @@
 
 #include "directxtexp.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#pragma warning(disable : 4616 6993)
+#endif
+
 //-------------------------------------------------------------------------------------
 // WIC Pixel Format Translation Data
 //-------------------------------------------------------------------------------------
@@ -54,6 +59,8 @@ static WICTranslate g_WICFormats[] =
 
 static bool g_WIC2 = false;
 
+static volatile LONG g_MaxThreads = 0;
+
 namespace DirectX
 {
 
@@ -174,12 +181,15 @@ bool _IsWIC2()
     return g_WIC2;
 }
 
-IWICImagingFactory* _GetWIC()
-{
-    static IWICImagingFactory* s_Factory = nullptr;
+//-------------------------------------------------------------------------------------
+// The factory is created once, on whichever thread first asks for it. A failure (for
+// example COM not being initialized on that thread) leaves it to be retried next time
+//-------------------------------------------------------------------------------------
+static INIT_ONCE g_WICInitOnce = INIT_ONCE_STATIC_INIT;
 
-    if ( s_Factory )
-        return s_Factory;
+static BOOL CALLBACK _WICInit( PINIT_ONCE, PVOID, PVOID* ifactory )
+{
+    IWICImagingFactory* factory = nullptr;
 
 #if(_WIN32_WINNT >= _WIN32_WINNT_WIN8) || defined(_WIN7_PLATFORM_UPDATE)
     HRESULT hr = CoCreateInstance(
@@ -187,7 +197,7 @@ IWICImagingFactory* _GetWIC()
         nullptr,
         CLSCTX_INPROC_SERVER,
         __uuidof(IWICImagingFactory2),
-        (LPVOID*)&s_Factory
+        (LPVOID*)&factory
         );
 
     if ( SUCCEEDED(hr) )
@@ -202,14 +212,11 @@ IWICImagingFactory* _GetWIC()
             nullptr,
             CLSCTX_INPROC_SERVER,
             __uuidof(IWICImagingFactory),
-            (LPVOID*)&s_Factory
+            (LPVOID*)&factory
             );
 
         if ( FAILED(hr) )
-        {
-            s_Factory = nullptr;
-            return nullptr;
-        }
+            return FALSE;
     }
 #else
     HRESULT hr = CoCreateInstance(
@@ -217,17 +224,24 @@ IWICImagingFactory* _GetWIC()
         nullptr,
         CLSCTX_INPROC_SERVER,
         __uuidof(IWICImagingFactory),
-        (LPVOID*)&s_Factory
+        (LPVOID*)&factory
         );
 
     if ( FAILED(hr) )
-    {
-        s_Factory = nullptr;
-        return nullptr;
-    }
+        return FALSE;
 #endif
 
-    return s_Factory;
+    *ifactory = factory;
+    return TRUE;
+}
+
+IWICImagingFactory* _GetWIC()
+{
+    PVOID factory = nullptr;
+    if ( !InitOnceExecuteOnce( &g_WICInitOnce, _WICInit, nullptr, &factory ) )
+        return nullptr;
+
+    return reinterpret_cast<IWICImagingFactory*>( factory );
 }
 
 
@@ -995,6 +1009,542 @@ size_t TexMetadata::ComputeIndex( size_t mip, size_t item, size_t slice ) const
 }
 
 
+//=====================================================================================
+// Task scheduler
+//=====================================================================================
+
+_Use_decl_annotations_
+void SetMaxThreads( size_t count )
+{
+    InterlockedExchange( &g_MaxThreads, static_cast<LONG>( std::min<size_t>( count, LONG_MAX ) ) );
+}
+
+size_t GetMaxThreads()
+{
+    return static_cast<size_t>( g_MaxThreads );
+}
+
+_Use_decl_annotations_
+HRESULT _RunTasks( size_t nItems, bool parallel, TEXP_TASK pfTask, void* pContext )
+{
+    if ( !pfTask )
+        return E_POINTER;
+
+    if ( nItems > INT_MAX )
+        return E_INVALIDARG;
+
+#ifdef _OPENMP
+    if ( parallel && nItems > 1 )
+    {
+        int nthreads = omp_get_max_threads();
+
+        const LONG maxThreads = g_MaxThreads;
+        if ( maxThreads > 0 && maxThreads < nthreads )
+            nthreads = maxThreads;
+
+        if ( static_cast<size_t>( nthreads ) > nItems )
+            nthreads = static_cast<int>( nItems );
+
+        // Items vary a lot in cost (mips, partial blocks, early-outs in the encoders), so they are
+        // handed out dynamically rather than split evenly up front
+        volatile LONG result = S_OK;
+
+#pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+        for( int item = 0; item < static_cast<int>( nItems ); ++item )
+        {
+            if ( FAILED( result ) )
+                continue;
+
+            HRESULT hr = pfTask( static_cast<size_t>( item ), pContext );
+            if ( FAILED(hr) )
+                InterlockedCompareExchange( &result, hr, S_OK );
+        }
+
+        return static_cast<HRESULT>( result );
+    }
+#else
+    UNREFERENCED_PARAMETER(parallel);
+#endif
+
+    for( size_t item = 0; item < nItems; ++item )
+    {
+        HRESULT hr = pfTask( item, pContext );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
+    return S_OK;
+}
+
+
+//=====================================================================================
+// Memory allocation
+//=====================================================================================
+
+struct TexMemoryCounters
+{
+    volatile LONGLONG imageAllocations;
+    volatile LONGLONG imageBytes;
+    volatile LONGLONG largePageAllocations;
+    volatile LONGLONG largePageBytes;
+    volatile LONGLONG scratchRequests;
+    volatile LONGLONG scratchAllocationsAvoided;
+    volatile LONGLONG scratchBytesAvoided;
+};
+
+static TexMemoryCounters g_MemoryCounters = { 0 };
+
+static void* _DefaultImageAllocate( size_t size, void* )
+{
+    return _aligned_malloc( size, 16 );
+}
+
+static void _DefaultImageFree( void* p, size_t, void* )
+{
+    _aligned_free( p );
+}
+
+static const ImageAllocator g_DefaultImageAllocator = { _DefaultImageAllocate, _DefaultImageFree, nullptr };
+
+static SRWLOCK g_ImageAllocatorLock = SRWLOCK_INIT;
+static ImageAllocator g_ImageAllocator = g_DefaultImageAllocator;
+
+_Use_decl_annotations_
+HRESULT SetImageAllocator( const ImageAllocator* allocator )
+{
+    if ( allocator && ( !allocator->pfAllocate || !allocator->pfFree ) )
+        return E_INVALIDARG;
+
+    AcquireSRWLockExclusive( &g_ImageAllocatorLock );
+    g_ImageAllocator = ( allocator ) ? *allocator : g_DefaultImageAllocator;
+    ReleaseSRWLockExclusive( &g_ImageAllocatorLock );
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+void GetImageAllocator( ImageAllocator& allocator )
+{
+    AcquireSRWLockShared( &g_ImageAllocatorLock );
+    allocator = g_ImageAllocator;
+    ReleaseSRWLockShared( &g_ImageAllocatorLock );
+}
+
+_Use_decl_annotations_
+void* _AllocateImageMemory( size_t size, const ImageAllocator& allocator, ImageAllocator& used )
+{
+    if ( allocator.pfAllocate && allocator.pfFree )
+    {
+        used = allocator;
+    }
+    else
+    {
+        GetImageAllocator( used );
+    }
+
+    void* p = used.pfAllocate( size, used.pContext );
+    if ( !p )
+        return nullptr;
+
+    assert( !( reinterpret_cast<uintptr_t>( p ) & 0xF ) );
+
+    InterlockedIncrement64( &g_MemoryCounters.imageAllocations );
+    InterlockedExchangeAdd64( &g_MemoryCounters.imageBytes, static_cast<LONGLONG>( size ) );
+
+    return p;
+}
+
+_Use_decl_annotations_
+void _FreeImageMemory( void* p, size_t size, const ImageAllocator& allocator )
+{
+    if ( !p )
+        return;
+
+    assert( allocator.pfFree != 0 );
+    allocator.pfFree( p, size, allocator.pContext );
+}
+
+
+//-------------------------------------------------------------------------------------
+// Large page allocator
+//   Each buffer has a small header in front of it recording where it came from, since
+//   allocations fall back to the heap when they are small or no large pages are left
+//-------------------------------------------------------------------------------------
+#define LARGEPAGE_HEADER_SIZE 16
+
+enum LARGEPAGE_SOURCE
+{
+    LARGEPAGE_SOURCE_HEAP = 0x48454150,     // 'HEAP'
+    LARGEPAGE_SOURCE_VIRTUAL = 0x4C415247,  // 'LARG'
+};
+
+static void* _LargePageAllocate( size_t size, void* pContext )
+{
+    const size_t minimum = reinterpret_cast<size_t>( pContext );
+    assert( minimum > 0 && !( minimum & ( minimum - 1 ) ) );
+
+    if ( size > SIZE_MAX - LARGEPAGE_HEADER_SIZE - minimum )
+        return nullptr;
+
+    const size_t total = size + LARGEPAGE_HEADER_SIZE;
+
+    uint8_t* base = nullptr;
+    if ( size >= minimum )
+    {
+        const size_t rounded = ( total + minimum - 1 ) & ~( minimum - 1 );
+
+        base = reinterpret_cast<uint8_t*>( VirtualAlloc( nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE ) );
+        if ( base )
+        {
+            *reinterpret_cast<uint32_t*>( base ) = LARGEPAGE_SOURCE_VIRTUAL;
+
+            InterlockedIncrement64( &g_MemoryCounters.largePageAllocations );
+            InterlockedExchangeAdd64( &g_MemoryCounters.largePageBytes, static_cast<LONGLONG>( rounded ) );
+
+            return base + LARGEPAGE_HEADER_SIZE;
+        }
+    }
+
+    base = reinterpret_cast<uint8_t*>( _aligned_malloc( total, 16 ) );
+    if ( !base )
+        return nullptr;
+
+    *reinterpret_cast<uint32_t*>( base ) = LARGEPAGE_SOURCE_HEAP;
+
+    return base + LARGEPAGE_HEADER_SIZE;
+}
+
+static void _LargePageFree( void* p, size_t, void* )
+{
+    if ( !p )
+        return;
+
+    uint8_t* base = reinterpret_cast<uint8_t*>( p ) - LARGEPAGE_HEADER_SIZE;
+
+    if ( *reinterpret_cast<const uint32_t*>( base ) == LARGEPAGE_SOURCE_VIRTUAL )
+    {
+        VirtualFree( base, 0, MEM_RELEASE );
+    }
+    else
+    {
+        assert( *reinterpret_cast<const uint32_t*>( base ) == LARGEPAGE_SOURCE_HEAP );
+        _aligned_free( base );
+    }
+}
+
+_Use_decl_annotations_
+HRESULT GetLargePageAllocator( ImageAllocator& allocator )
+{
+    memset( &allocator, 0, sizeof(allocator) );
+
+    const size_t minimum = GetLargePageMinimum();
+    if ( !minimum )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    HANDLE hToken = nullptr;
+    if ( !OpenProcessToken( GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken ) )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    ScopedHandle token( safe_handle( hToken ) );
+
+    TOKEN_PRIVILEGES tp;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    if ( !LookupPrivilegeValueW( nullptr, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid ) )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    // Succeeds with ERROR_NOT_ALL_ASSIGNED if the account doesn't hold the privilege
+    if ( !AdjustTokenPrivileges( token.get(), FALSE, &tp, 0, nullptr, nullptr ) )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    DWORD err = GetLastError();
+    if ( err != ERROR_SUCCESS )
+        return HRESULT_FROM_WIN32( err );
+
+    allocator.pfAllocate = _LargePageAllocate;
+    allocator.pfFree = _LargePageFree;
+    allocator.pContext = reinterpret_cast<void*>( minimum );
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Scratch memory
+//   Each thread keeps up to SCRATCH_CACHE_BLOCKS freed buffers around (held in fiber
+//   local storage, so they are released when the thread exits). Capacities are rounded
+//   up so that a slightly larger request, such as the next image of a batch, still fits.
+//   Every cache is also on a process-wide list, so ReleaseScratchCache can empty them
+//   all, and the bytes held across threads are capped at SCRATCH_MAX_CACHED_TOTAL.
+//-------------------------------------------------------------------------------------
+#define SCRATCH_CACHE_BLOCKS 4
+#define SCRATCH_MAX_CACHED_SIZE ( 4 * 1024 * 1024 )
+#define SCRATCH_MAX_CACHED_TOTAL ( 64 * 1024 * 1024 )
+#define SCRATCH_GRANULARITY 4096
+
+struct ScratchHeader
+{
+    size_t capacity;
+    size_t reserved;    // keeps the buffer 16-byte aligned
+};
+
+struct ScratchCache
+{
+    ScratchHeader* blocks[ SCRATCH_CACHE_BLOCKS ];
+    SRWLOCK lock;       // uncontended except while ReleaseScratchCache runs
+    ScratchCache* pNext;
+    ScratchCache* pPrev;
+};
+
+static_assert( sizeof(ScratchHeader) % 16 == 0, "ScratchHeader must preserve 16-byte alignment" );
+
+static INIT_ONCE g_ScratchInitOnce = INIT_ONCE_STATIC_INIT;
+static DWORD g_ScratchFlsIndex = FLS_OUT_OF_INDEXES;
+
+static SRWLOCK g_ScratchListLock = SRWLOCK_INIT;
+static ScratchCache* g_ScratchList = nullptr;
+static volatile LONGLONG g_ScratchCachedBytes = 0;
+
+static void _ScratchCacheEmpty( _Inout_ ScratchCache* cache )
+{
+    for( size_t j = 0; j < SCRATCH_CACHE_BLOCKS; ++j )
+    {
+        if ( cache->blocks[ j ] )
+        {
+            InterlockedExchangeAdd64( &g_ScratchCachedBytes, -static_cast<LONGLONG>( cache->blocks[ j ]->capacity ) );
+            _aligned_free( cache->blocks[ j ] );
+            cache->blocks[ j ] = nullptr;
+        }
+    }
+}
+
+static VOID WINAPI _ScratchCacheRelease( PVOID pData )
+{
+    auto cache = reinterpret_cast<ScratchCache*>( pData );
+    if ( !cache )
+        return;
+
+    AcquireSRWLockExclusive( &g_ScratchListLock );
+
+    if ( cache->pPrev )
+        cache->pPrev->pNext = cache->pNext;
+    else
+        g_ScratchList = cache->pNext;
+
+    if ( cache->pNext )
+        cache->pNext->pPrev = cache->pPrev;
+
+    ReleaseSRWLockExclusive( &g_ScratchListLock );
+
+    _ScratchCacheEmpty( cache );
+
+    delete cache;
+}
+
+static BOOL CALLBACK _ScratchInit( PINIT_ONCE, PVOID, PVOID* )
+{
+    g_ScratchFlsIndex = FlsAlloc( _ScratchCacheRelease );
+    return TRUE;
+}
+
+static ScratchCache* _GetScratchCache( bool create )
+{
+    if ( !InitOnceExecuteOnce( &g_ScratchInitOnce, _ScratchInit, nullptr, nullptr ) )
+        return nullptr;
+
+    if ( g_ScratchFlsIndex == FLS_OUT_OF_INDEXES )
+        return nullptr;
+
+    auto cache = reinterpret_cast<ScratchCache*>( FlsGetValue( g_ScratchFlsIndex ) );
+    if ( !cache && create )
+    {
+        cache = new (std::nothrow) ScratchCache;
+        if ( cache )
+        {
+            memset( cache, 0, sizeof(ScratchCache) );
+            InitializeSRWLock( &cache->lock );
+
+            if ( !FlsSetValue( g_ScratchFlsIndex, cache ) )
+            {
+                delete cache;
+                return nullptr;
+            }
+
+            AcquireSRWLockExclusive( &g_ScratchListLock );
+
+            cache->pNext = g_ScratchList;
+            if ( g_ScratchList )
+                g_ScratchList->pPrev = cache;
+            g_ScratchList = cache;
+
+            ReleaseSRWLockExclusive( &g_ScratchListLock );
+        }
+    }
+
+    return cache;
+}
+
+_Use_decl_annotations_
+void* _AllocScratch( size_t size )
+{
+    InterlockedIncrement64( &g_MemoryCounters.scratchRequests );
+
+    ScratchCache* cache = _GetScratchCache( false );
+    if ( cache )
+    {
+        AcquireSRWLockExclusive( &cache->lock );
+
+        // Best fit among the cached blocks
+        size_t best = SCRATCH_CACHE_BLOCKS;
+        for( size_t j = 0; j < SCRATCH_CACHE_BLOCKS; ++j )
+        {
+            const ScratchHeader* block = cache->blocks[ j ];
+            if ( block && block->capacity >= size
+                 && ( best == SCRATCH_CACHE_BLOCKS || block->capacity < cache->blocks[ best ]->capacity ) )
+            {
+                best = j;
+            }
+        }
+
+        ScratchHeader* block = nullptr;
+        if ( best < SCRATCH_CACHE_BLOCKS )
+        {
+            block = cache->blocks[ best ];
+            cache->blocks[ best ] = nullptr;
+        }
+
+        ReleaseSRWLockExclusive( &cache->lock );
+
+        if ( block )
+        {
+            InterlockedExchangeAdd64( &g_ScratchCachedBytes, -static_cast<LONGLONG>( block->capacity ) );
+
+            InterlockedIncrement64( &g_MemoryCounters.scratchAllocationsAvoided );
+            InterlockedExchangeAdd64( &g_MemoryCounters.scratchBytesAvoided, static_cast<LONGLONG>( size ) );
+
+            return block + 1;
+        }
+    }
+
+    if ( size > SIZE_MAX - sizeof(ScratchHeader) - SCRATCH_GRANULARITY )
+        return nullptr;
+
+    const size_t capacity = ( size + SCRATCH_GRANULARITY - 1 ) & ~size_t( SCRATCH_GRANULARITY - 1 );
+
+    auto block = reinterpret_cast<ScratchHeader*>( _aligned_malloc( sizeof(ScratchHeader) + capacity, 16 ) );
+    if ( !block )
+        return nullptr;
+
+    block->capacity = capacity;
+    block->reserved = 0;
+
+    return block + 1;
+}
+
+_Use_decl_annotations_
+void _FreeScratch( void* p )
+{
+    if ( !p )
+        return;
+
+    ScratchHeader* block = reinterpret_cast<ScratchHeader*>( p ) - 1;
+
+    if ( block->capacity <= SCRATCH_MAX_CACHED_SIZE )
+    {
+        ScratchCache* cache = _GetScratchCache( true );
+        if ( cache )
+        {
+            AcquireSRWLockExclusive( &cache->lock );
+
+            // Use an empty slot, otherwise displace the smallest cached block if this one is bigger
+            size_t slot = SCRATCH_CACHE_BLOCKS;
+            for( size_t j = 0; j < SCRATCH_CACHE_BLOCKS; ++j )
+            {
+                if ( !cache->blocks[ j ] )
+                {
+                    slot = j;
+                    break;
+                }
+
+                if ( slot == SCRATCH_CACHE_BLOCKS || cache->blocks[ j ]->capacity < cache->blocks[ slot ]->capacity )
+                    slot = j;
+            }
+
+            assert( slot < SCRATCH_CACHE_BLOCKS );
+
+            ScratchHeader* displaced = cache->blocks[ slot ];
+            if ( !displaced || displaced->capacity < block->capacity )
+            {
+                // Only keep it if the process-wide total stays under the cap
+                const LONGLONG growth = static_cast<LONGLONG>( block->capacity ) - ( displaced ? static_cast<LONGLONG>( displaced->capacity ) : 0 );
+                if ( InterlockedExchangeAdd64( &g_ScratchCachedBytes, growth ) + growth <= SCRATCH_MAX_CACHED_TOTAL )
+                {
+                    cache->blocks[ slot ] = block;
+                    block = displaced;
+                }
+                else
+                {
+                    InterlockedExchangeAdd64( &g_ScratchCachedBytes, -growth );
+                }
+            }
+
+            ReleaseSRWLockExclusive( &cache->lock );
+        }
+    }
+
+    if ( block )
+        _aligned_free( block );
+}
+
+void ReleaseScratchCache()
+{
+    AcquireSRWLockExclusive( &g_ScratchListLock );
+
+    for( ScratchCache* cache = g_ScratchList; cache; cache = cache->pNext )
+    {
+        AcquireSRWLockExclusive( &cache->lock );
+        _ScratchCacheEmpty( cache );
+        ReleaseSRWLockExclusive( &cache->lock );
+    }
+
+    ReleaseSRWLockExclusive( &g_ScratchListLock );
+}
+
+
+//-------------------------------------------------------------------------------------
+// Statistics
+//-------------------------------------------------------------------------------------
+static inline uint64_t _ReadCounter( volatile LONGLONG* counter )
+{
+    return static_cast<uint64_t>( InterlockedCompareExchange64( counter, 0, 0 ) );
+}
+
+_Use_decl_annotations_
+void GetMemoryStats( TexMemoryStats& stats )
+{
+    stats.imageAllocations = _ReadCounter( &g_MemoryCounters.imageAllocations );
+    stats.imageBytes = _ReadCounter( &g_MemoryCounters.imageBytes );
+    stats.largePageAllocations = _ReadCounter( &g_MemoryCounters.largePageAllocations );
+    stats.largePageBytes = _ReadCounter( &g_MemoryCounters.largePageBytes );
+    stats.scratchRequests = _ReadCounter( &g_MemoryCounters.scratchRequests );
+    stats.scratchAllocationsAvoided = _ReadCounter( &g_MemoryCounters.scratchAllocationsAvoided );
+    stats.scratchBytesAvoided = _ReadCounter( &g_MemoryCounters.scratchBytesAvoided );
+    stats.scratchBytesCached = _ReadCounter( &g_ScratchCachedBytes );
+}
+
+void ResetMemoryStats()
+{
+    InterlockedExchange64( &g_MemoryCounters.imageAllocations, 0 );
+    InterlockedExchange64( &g_MemoryCounters.imageBytes, 0 );
+    InterlockedExchange64( &g_MemoryCounters.largePageAllocations, 0 );
+    InterlockedExchange64( &g_MemoryCounters.largePageBytes, 0 );
+    InterlockedExchange64( &g_MemoryCounters.scratchRequests, 0 );
+    InterlockedExchange64( &g_MemoryCounters.scratchAllocationsAvoided, 0 );
+    InterlockedExchange64( &g_MemoryCounters.scratchBytesAvoided, 0 );
+}
+
+
 //=====================================================================================
 // Blob - Bitmap image container
 //=====================================================================================
@@ -1045,4 +1595,21 @@ HRESULT Blob::Initialize( size_t size )
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT Blob::Trim( size_t size )
+{
+    if ( !size )
+        return E_INVALIDARG;
+
+    if ( !_buffer )
+        return E_UNEXPECTED;
+
+    if ( size > _size )
+        return E_INVALIDARG;
+
+    _size = size;
+
+    return S_OK;
+}
+
 }; // namespace
@@ -421,4 +421,98 @@ namespace TriangleFilter
 
 }; // namespace
 
+
+//-------------------------------------------------------------------------------------
+// Polyphase filtering helpers
+//-------------------------------------------------------------------------------------
+
+#define LANCZOS_RADIUS 3
+
+inline float _LanczosWeight( _In_ float x )
+{
+    x = fabsf( x );
+    if ( x < 1e-6f )
+        return 1.f;
+
+    if ( x >= float(LANCZOS_RADIUS) )
+        return 0.f;
+
+    float px = XM_PI * x;
+    return float(LANCZOS_RADIUS) * XMScalarSin( px ) * XMScalarSin( px / float(LANCZOS_RADIUS) ) / ( px * px );
+}
+
+// Number of taps per destination texel; when minifying, the kernel is stretched to cover the whole footprint
+inline size_t _PolyphaseTaps( _In_ size_t source, _In_ size_t dest )
+{
+    assert( source > 0 );
+    assert( dest > 0 );
+
+    float support = float(LANCZOS_RADIUS) * std::max<float>( 1.f, float(source) / float(dest) );
+    return size_t( support * 2.f ) + 2;
+}
+
+// Source texel for tap x. Unlike bounduvw, wrap and mirror repeat for any distance, since a minifying kernel
+// can reach more than a whole image past the edge of a small source
+inline size_t _PolyphaseIndex( _In_ ptrdiff_t x, _In_ size_t source, _In_ bool wrap, _In_ bool mirror )
+{
+    const ptrdiff_t n = ptrdiff_t( source );
+
+    if ( wrap )
+    {
+        return size_t( ( ( x % n ) + n ) % n );
+    }
+    else if ( mirror )
+    {
+        // Reflection repeats every 2n texels, with the edge texels doubled (-1 -> 0, n -> n-1)
+        ptrdiff_t m = ( ( x % ( 2 * n ) ) + 2 * n ) % ( 2 * n );
+        return size_t( ( m < n ) ? m : ( 2 * n - 1 - m ) );
+    }
+
+    return size_t( std::min<ptrdiff_t>( n - 1, std::max<ptrdiff_t>( 0, x ) ) );
+}
+
+// Builds the per-destination weight table: texel u reads source texels start[u] + t for t in [0,taps),
+// found at index[u*taps+t] after wrap/mirror/clamp and weighted by weight[u*taps+t] (normalized to 1)
+inline void _CreatePolyphaseFilter( _In_ size_t source, _In_ size_t dest, _In_ bool wrap, _In_ bool mirror, _In_ size_t taps,
+                                    _Out_writes_(dest) ptrdiff_t* start, _Out_writes_(dest*taps) size_t* index, _Out_writes_(dest*taps) float* weight )
+{
+    assert( source > 0 );
+    assert( dest > 0 );
+    assert( start != 0 && index != 0 && weight != 0 );
+
+    float scale = float(source) / float(dest);
+    float filterScale = std::max<float>( 1.f, scale );
+    float support = float(LANCZOS_RADIUS) * filterScale;
+
+    for( size_t u = 0; u < dest; ++u )
+    {
+        float center = ( float(u) + 0.5f ) * scale - 0.5f;
+        ptrdiff_t first = ptrdiff_t( floorf( center - support ) ) + 1;
+
+        start[ u ] = first;
+
+        size_t* pIndex = index + u * taps;
+        float* pWeight = weight + u * taps;
+
+        float total = 0.f;
+        for( size_t t = 0; t < taps; ++t )
+        {
+            ptrdiff_t x = first + ptrdiff_t(t);
+
+            float w = _LanczosWeight( ( float(x) - center ) / filterScale );
+            pWeight[ t ] = w;
+            total += w;
+
+            pIndex[ t ] = _PolyphaseIndex( x, source, wrap, mirror );
+        }
+
+        if ( fabsf( total ) > 1e-6f )
+        {
+            float norm = 1.f / total;
+            for( size_t t = 0; t < taps; ++t )
+                pWeight[ t ] *= norm;
+        }
+    }
+}
+
 }; // namespace
\ No newline at end of file
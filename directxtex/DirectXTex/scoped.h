@@ -22,9 +22,14 @@
 //---------------------------------------------------------------------------------
 struct aligned_deleter { void operator()(void* p) { _aligned_free(p); } };
 
-typedef std::unique_ptr<float, aligned_deleter> ScopedAlignedArrayFloat;
+// Temporary arrays come from DirectX::_AllocScratch, which recycles them through a per-thread cache
+namespace DirectX { void _FreeScratch( _In_opt_ void* p ); }
 
-typedef std::unique_ptr<DirectX::XMVECTOR, aligned_deleter> ScopedAlignedArrayXMVECTOR;
+struct scratch_deleter { void operator()(void* p) { DirectX::_FreeScratch(p); } };
+
+typedef std::unique_ptr<float, scratch_deleter> ScopedAlignedArrayFloat;
+
+typedef std::unique_ptr<DirectX::XMVECTOR, scratch_deleter> ScopedAlignedArrayXMVECTOR;
 
 //---------------------------------------------------------------------------------
 struct handle_closer { void operator()(HANDLE h) { assert(h != INVALID_HANDLE_VALUE); if (h) CloseHandle(h); } };
@@ -32,3 +37,8 @@ struct handle_closer { void operator()(HANDLE h) { assert(h != INVALID_HANDLE_VA
 typedef public std::unique_ptr<void, handle_closer> ScopedHandle;
 
 inline HANDLE safe_handle( HANDLE h ) { return (h == INVALID_HANDLE_VALUE) ? 0 : h; }
+
+//---------------------------------------------------------------------------------
+struct view_unmapper { void operator()(void* p) { if (p) UnmapViewOfFile(p); } };
+
+typedef std::unique_ptr<void, view_unmapper> ScopedMappedView;
@@ -9,6 +9,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdarg.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
 
 #include <dxgiformat.h>
 
@@ -32,6 +37,7 @@ enum OPTIONS    // Note: dwOptions below assumes 32 or less options.
     OPT_USE_DX10,
     OPT_NOLOGO,
     OPT_SEPALPHA,
+    OPT_JOBS,
     OPT_MAX
 };
 
@@ -50,6 +56,29 @@ struct SValue
     DWORD dwValue;
 };
 
+struct SAssembleItem
+{
+    SConversion*    pConv;
+    const Image*    pDest;
+    std::wstring    log;
+    bool            failed;
+
+    SAssembleItem() : pConv(nullptr), pDest(nullptr), failed(false) {}
+};
+
+struct SAssemble
+{
+    SAssembleItem*  pItems;
+    size_t          nItems;
+    volatile LONG   nextItem;
+    volatile LONG   abort;
+    size_t          width;
+    size_t          height;
+    DXGI_FORMAT     format;
+    DWORD           dwFilter;
+    DWORD           dwFilterOpts;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -68,6 +97,7 @@ SValue g_pOptions[] =
     { L"dx10",          OPT_USE_DX10  },
     { L"nologo",        OPT_NOLOGO    },
     { L"sepalpha",      OPT_SEPALPHA  },
+    { L"j",             OPT_JOBS      },
     { nullptr,          0             }
 };
 
@@ -195,54 +225,83 @@ const WCHAR* LookupByValue(DWORD pValue, const SValue *pArray)
     return L"";
 }
 
-void PrintFormat(DXGI_FORMAT Format)
+void LogPrintf( _Inout_opt_ std::wstring* pLog, _In_z_ LPCWSTR szFormat, ... )
+{
+    va_list args;
+
+    if ( !pLog )
+    {
+        va_start( args, szFormat );
+        vwprintf( szFormat, args );
+        va_end( args );
+        return;
+    }
+
+    va_start( args, szFormat );
+    int len = _vscwprintf( szFormat, args );
+    va_end( args );
+
+    if ( len <= 0 )
+        return;
+
+    size_t pos = pLog->size();
+    pLog->resize( pos + len + 1 );
+
+    va_start( args, szFormat );
+    vswprintf_s( &(*pLog)[ pos ], len + 1, szFormat, args );
+    va_end( args );
+
+    pLog->resize( pos + len );
+}
+
+void PrintFormat(DXGI_FORMAT Format, _Inout_opt_ std::wstring* pLog)
 {
     for(SValue *pFormat = g_pFormats; pFormat->pName; pFormat++)
     {
         if((DXGI_FORMAT) pFormat->dwValue == Format)
         {
-            wprintf( pFormat->pName );
+            LogPrintf( pLog, L"%s", pFormat->pName );
             break;
         }
     }
 }
 
-void PrintInfo( const TexMetadata& info )
+void PrintInfo( const TexMetadata& info, _Inout_opt_ std::wstring* pLog )
 {
-    wprintf( L" (%Iux%Iu", info.width, info.height);
+    LogPrintf( pLog, L" (%Iux%Iu", info.width, info.height);
 
     if ( TEX_DIMENSION_TEXTURE3D == info.dimension )
-        wprintf( L"x%Iu", info.depth);
+        LogPrintf( pLog, L"x%Iu", info.depth);
 
     if ( info.mipLevels > 1 )
-        wprintf( L",%Iu", info.mipLevels);
+        LogPrintf( pLog, L",%Iu", info.mipLevels);
 
-    wprintf( L" ");
-    PrintFormat( info.format );
+    LogPrintf( pLog, L" ");
+    PrintFormat( info.format, pLog );
 
     switch ( info.dimension )
     {
     case TEX_DIMENSION_TEXTURE1D:
-        wprintf( (info.arraySize > 1) ? L" 1DArray" : L" 1D" );
+        LogPrintf( pLog, (info.arraySize > 1) ? L" 1DArray" : L" 1D" );
         break;
 
     case TEX_DIMENSION_TEXTURE2D:
         if ( info.IsCubemap() )
         {
-            wprintf( (info.arraySize > 6) ? L" CubeArray" : L" Cube" );
+            LogPrintf( pLog, (info.arraySize > 6) ? L" CubeArray" : L" Cube" );
         }
         else
         {
-            wprintf( (info.arraySize > 1) ? L" 2DArray" : L" 2D" );
+            LogPrintf( pLog, (info.arraySize > 1) ? L" 2DArray" : L" 2D" );
         }
         break;
 
     case TEX_DIMENSION_TEXTURE3D:
-        wprintf( L" 3D");
+        LogPrintf( pLog, L" 3D");
         break;
     }
 
-    wprintf( L")");
+    LogPrintf( pLog, L")");
 }
 
 
@@ -293,6 +352,8 @@ void PrintUsage()
     wprintf( L"   -sepalpha           resize alpha channel separately from color channels\n");
     wprintf( L"   -dx10               Force use of 'DX10' extended header\n");
     wprintf( L"   -nologo             suppress copyright message\n");
+    wprintf( L"   -j <n>              load and process up to n images at once (defaults to\n"
+             L"                       the number of processors)\n");
 
     wprintf( L"\n");
     wprintf( L"   <format>: ");
@@ -304,6 +365,229 @@ void PrintUsage()
 }
 
 
+//--------------------------------------------------------------------------------------
+// Loads a source image (decompressing it if needed)
+//--------------------------------------------------------------------------------------
+bool LoadSourceImage( _In_ const SConversion* pConv, _In_ DWORD dwFilter, _Out_ TexMetadata& info,
+                      _Inout_ std::unique_ptr<ScratchImage>& image, _Inout_opt_ std::wstring* pLog )
+{
+    WCHAR ext[_MAX_EXT];
+    _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT );
+
+    LogPrintf( pLog, L"reading %s", pConv->szSrc );
+    if ( !pLog )
+        fflush(stdout);
+
+    HRESULT hr;
+    if ( _wcsicmp( ext, L".dds" ) == 0 )
+    {
+        hr = LoadFromDDSFile( pConv->szSrc, DDS_FLAGS_NONE, &info, *image );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return false;
+        }
+
+        if ( info.arraySize > 1
+             || info.depth > 1
+             || info.mipLevels > 1
+             || info.IsCubemap() )
+        {
+            LogPrintf( pLog, L"ERROR: Can't assemble complex surfaces\n" );
+            return false;
+        }
+    }
+    else if ( _wcsicmp( ext, L".tga" ) == 0 )
+    {
+        hr = LoadFromTGAFile( pConv->szSrc, &info, *image );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return false;
+        }
+    }
+    else
+    {
+        // WIC shares the same filter values for mode and dither
+        static_assert( WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match" );
+        static_assert( WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+
+        hr = LoadFromWICFile( pConv->szSrc, dwFilter, &info, *image );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return false;
+        }
+    }
+
+    PrintInfo( info, pLog );
+
+    // --- Decompress --------------------------------------------------------------
+    if ( IsCompressed( info.format ) )
+    {
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return false;
+        }
+
+        hr = Decompress( image->GetImages(), image->GetImageCount(), info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [decompress] (%x)\n", hr);
+            return false;
+        }
+
+        const TexMetadata& tinfo = timage->GetMetadata();
+
+        info.format = tinfo.format;
+
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
+
+        image.swap( timage );
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Resizes a loaded image and writes it into its slot in the result, converting the
+// format on the way
+//--------------------------------------------------------------------------------------
+bool PlaceImage( _Inout_ std::unique_ptr<ScratchImage>& image, _Inout_ TexMetadata& info, _In_ const SAssemble& assemble,
+                 _In_ const Image& dest, _Inout_opt_ std::wstring* pLog )
+{
+    HRESULT hr;
+
+    // --- Resize ------------------------------------------------------------------
+    if ( info.width != assemble.width || info.height != assemble.height )
+    {
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return false;
+        }
+
+        hr = Resize( image->GetImages(), image->GetImageCount(), image->GetMetadata(), assemble.width, assemble.height,
+                     assemble.dwFilter | assemble.dwFilterOpts, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [resize] (%x)\n", hr);
+            return false;
+        }
+
+        const TexMetadata& tinfo = timage->GetMetadata();
+
+        assert( tinfo.width == assemble.width && tinfo.height == assemble.height && tinfo.mipLevels == 1 );
+        info.width = tinfo.width;
+        info.height = tinfo.height;
+        info.mipLevels = 1;
+
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.format == tinfo.format );
+        assert( info.dimension == tinfo.dimension );
+
+        image.swap( timage );
+    }
+
+    // --- Convert -----------------------------------------------------------------
+    // CopyRectangle converts as it copies but can't dither, so only then is a separate Convert needed
+    if ( info.format != assemble.format && !IsCompressed( assemble.format )
+         && ( assemble.dwFilter & ( TEX_FILTER_DITHER | TEX_FILTER_DITHER_DIFFUSION ) ) )
+    {
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return false;
+        }
+
+        hr = Convert( image->GetImages(), image->GetImageCount(), image->GetMetadata(), assemble.format,
+                      assemble.dwFilter | assemble.dwFilterOpts, 0.5f, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [convert] (%x)\n", hr);
+            return false;
+        }
+
+        info.format = timage->GetMetadata().format;
+
+        image.swap( timage );
+    }
+
+    const Image* img = image->GetImage(0,0,0);
+    assert( img );
+
+    hr = CopyRectangle( *img, Rect( 0, 0, info.width, info.height ), dest, assemble.dwFilter | assemble.dwFilterOpts, 0, 0 );
+    if ( FAILED(hr) )
+    {
+        LogPrintf( pLog, L" FAILED [copy to result] (%x)\n", hr);
+        return false;
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Pulls images off the shared list until it runs out or another image fails
+//--------------------------------------------------------------------------------------
+DWORD WINAPI AssembleWorkerThread( LPVOID pParam )
+{
+    auto assemble = reinterpret_cast<SAssemble*>( pParam );
+
+    // Needed for WIC
+    HRESULT hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+
+    for(;;)
+    {
+        size_t index = static_cast<size_t>( InterlockedIncrement( &assemble->nextItem ) - 1 );
+        if ( assemble->abort || index >= assemble->nItems )
+            break;
+
+        SAssembleItem& item = assemble->pItems[ index ];
+
+        TexMetadata info;
+        std::unique_ptr<ScratchImage> image( new (std::nothrow) ScratchImage );
+        if ( !image )
+        {
+            LogPrintf( &item.log, L" ERROR: Memory allocation failed\n" );
+            item.failed = true;
+        }
+        else if ( !LoadSourceImage( item.pConv, assemble->dwFilter, info, image, &item.log )
+                  || !PlaceImage( image, info, *assemble, *item.pDest, &item.log ) )
+        {
+            item.failed = true;
+        }
+
+        if ( item.failed )
+            InterlockedExchange( &assemble->abort, TRUE );
+    }
+
+    if ( SUCCEEDED(hrCOM) )
+        CoUninitialize();
+
+    return 0;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Entry-point
 //--------------------------------------------------------------------------------------
@@ -322,6 +606,10 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     DWORD dwFilter = TEX_FILTER_DEFAULT;
     DWORD dwFilterOpts = 0;
 
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo( &sysInfo );
+    size_t jobs = std::min<size_t>( sysInfo.dwNumberOfProcessors, MAXIMUM_WAIT_OBJECTS - 1 );
+
     WCHAR szOutputFile[MAX_PATH] = { 0 };
 
     // Initialize COM (needed for WIC)
@@ -421,6 +709,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             case OPT_OUTPUTFILE:
                 wcscpy_s(szOutputFile, MAX_PATH, pValue);
                 break;
+
+            case OPT_JOBS:
+                // The worker threads are waited on together, which caps the count
+                if (swscanf_s(pValue, L"%Iu", &jobs) != 1 || jobs < 1 || jobs >= MAXIMUM_WAIT_OBJECTS)
+                {
+                    wprintf( L"Invalid value specified with -j (%s)\n", pValue);
+                    return 1;
+                }
+                break;
             }
         }
         else
@@ -478,18 +775,25 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         PrintLogo();
 
     // Convert images
-    std::vector<ScratchImage*> loadedImages; 
+    std::unique_ptr<SAssembleItem[]> items( new (std::nothrow) SAssembleItem[ images ] );
+    if ( !items )
+    {
+        wprintf( L"ERROR: Memory allocation failed\n" );
+        return 1;
+    }
+
+    {
+        size_t index = 0;
+        for( SConversion *pConv = pConversion; pConv; pConv = pConv->pNext )
+            items[ index++ ].pConv = pConv;
+    }
 
-    for( SConversion *pConv = pConversion; pConv; pConv = pConv->pNext )
     {
         WCHAR ext[_MAX_EXT];
         WCHAR fname[_MAX_FNAME];
-        _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
+        _wsplitpath_s( pConversion->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
 
-        // Load source image
-        if( pConv != pConversion )
-            wprintf( L"\n");
-        else if ( !*szOutputFile )
+        if ( !*szOutputFile )
         {
             if ( _wcsicmp( ext, L".dds" ) == 0 )
             {
@@ -499,246 +803,132 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
             _wmakepath_s( szOutputFile, nullptr, nullptr, fname, L".dds" );
         }
+    }
 
-        wprintf( L"reading %s", pConv->szSrc );
-        fflush(stdout);
-
-        TexMetadata info;
-        ScratchImage *image = new ScratchImage;
-
-        if ( !image )
-        {
-            wprintf( L" ERROR: Memory allocation failed\n" );
-            goto LError;
-        }
-
-        if ( _wcsicmp( ext, L".dds" ) == 0 )
-        {
-            hr = LoadFromDDSFile( pConv->szSrc, DDS_FLAGS_NONE, &info, *image );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                return 1;
-            }
-
-            if ( info.arraySize > 1
-                 || info.depth > 1
-                 || info.mipLevels > 1
-                 || info.IsCubemap() )
-            {
-                wprintf( L"ERROR: Can't assemble complex surfaces\n" );
-                return 1;
-            }
-        }
-        else if ( _wcsicmp( ext, L".tga" ) == 0 )
-        {
-            hr = LoadFromTGAFile( pConv->szSrc, &info, *image );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                return 1;
-            }
-        }
-        else
-        {
-            // WIC shares the same filter values for mode and dither
-            static_assert( WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match" );
-            static_assert( WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-
-            hr = LoadFromWICFile( pConv->szSrc, dwFilter, &info, *image );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                return 1;
-            }
-        }
-
-        PrintInfo( info );
+    SAssemble assemble;
+    assemble.pItems = items.get();
+    assemble.nItems = images;
+    assemble.nextItem = 1;
+    assemble.abort = FALSE;
+    assemble.dwFilter = dwFilter;
+    assemble.dwFilterOpts = dwFilterOpts;
 
-        // Convert texture
-        fflush(stdout);
+    {
+        ScratchImage result;
 
-        // --- Decompress --------------------------------------------------------------
-        if ( IsCompressed( info.format ) )
+        // The first image is done up front, as it picks the size and format when -w, -h, or -f are not given
         {
-            const Image* img = image->GetImage(0,0,0);
-            assert( img );
-            size_t nimg = image->GetImageCount();
-
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
+            TexMetadata info;
+            std::unique_ptr<ScratchImage> image( new (std::nothrow) ScratchImage );
+            if ( !image )
             {
                 wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
                 goto LError;
             }
 
-            hr = Decompress( img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [decompress] (%x)\n", hr);
-                delete timage;
-                delete image;
-                continue;
-            }
+            if ( !LoadSourceImage( items[0].pConv, dwFilter, info, image, nullptr ) )
+                goto LError;
 
-            const TexMetadata& tinfo = timage->GetMetadata();
+            fflush(stdout);
 
-            info.format = tinfo.format;
+            assemble.width = ( width ) ? width : info.width;
+            assemble.height = ( height ) ? height : info.height;
+            assemble.format = ( format != DXGI_FORMAT_UNKNOWN ) ? format : info.format;
 
-            assert( info.width == tinfo.width );
-            assert( info.height == tinfo.height );
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.dimension == tinfo.dimension );
+            // --- Create result -----------------------------------------------------------
+            switch( dwOptions & ( (1 << OPT_CUBE) | (1 << OPT_VOLUME) | (1 << OPT_ARRAY) | (1 << OPT_CUBEARRAY) ) )
+            {
+            case (1 << OPT_VOLUME):
+                hr = result.Initialize3D( assemble.format, assemble.width, assemble.height, images, 1 );
+                break;
 
-            delete image;
-            image = timage;
-        }
+            case (1 << OPT_ARRAY):
+                hr = ( assemble.height > 1 || !(dwOptions & (1 << OPT_USE_DX10)) )
+                     ? result.Initialize2D( assemble.format, assemble.width, assemble.height, images, 1 )
+                     : result.Initialize1D( assemble.format, assemble.width, images, 1 );
+                break;
 
-        // --- Resize ------------------------------------------------------------------
-        if ( !width )
-        {
-            width = info.width;
-        }
-        if ( !height )
-        {
-            height = info.height;
-        }
-        if ( info.width != width || info.height != height )
-        {
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
+            case (1 << OPT_CUBE):
+            case (1 << OPT_CUBEARRAY):
+                hr = result.InitializeCube( assemble.format, assemble.width, assemble.height, images / 6, 1 );
+                break;
             }
 
-            hr = Resize( image->GetImages(), image->GetImageCount(), image->GetMetadata(), width, height, dwFilter | dwFilterOpts, *timage );
-            if ( FAILED(hr) )
+            if ( FAILED(hr ) )
             {
-                wprintf( L" FAILED [resize] (%x)\n", hr);
-                delete timage;
-                delete image;
+                wprintf( L"\nFAILED building result image (%x)\n", hr);
                 goto LError;
             }
 
-            const TexMetadata& tinfo = timage->GetMetadata();
-
-            assert( tinfo.width == width && tinfo.height == height && tinfo.mipLevels == 1 );
-            info.width = tinfo.width;
-            info.height = tinfo.height;
-            info.mipLevels = 1;
-
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.format == tinfo.format );
-            assert( info.dimension == tinfo.dimension );
+            // Every image is written straight into its own slice of the result
+            const bool volume = ( dwOptions & (1 << OPT_VOLUME) ) != 0;
+            for( size_t index = 0; index < images; ++index )
+            {
+                items[ index ].pDest = ( volume ) ? result.GetImage( 0, 0, index ) : result.GetImage( 0, index, 0 );
+                if ( !items[ index ].pDest )
+                {
+                    wprintf( L"\nFAILED building result image (%x)\n", E_POINTER );
+                    goto LError;
+                }
+            }
 
-            delete image;
-            image = timage;
+            if ( !PlaceImage( image, info, assemble, *items[0].pDest, nullptr ) )
+                goto LError;
         }
 
-        // --- Convert -----------------------------------------------------------------
-        if ( format == DXGI_FORMAT_UNKNOWN )
+        // The rest are loaded and processed in parallel, with the main thread as one of the workers
         {
-            format = info.format;
-        }
-        else if ( info.format != format && !IsCompressed( format ) )
-        {
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
+            HANDLE hThreads[ MAXIMUM_WAIT_OBJECTS ];
+            DWORD nThreads = 0;
 
-            hr = Convert( image->GetImages(), image->GetImageCount(), image->GetMetadata(), format, dwFilter | dwFilterOpts, 0.5f, *timage );
-            if ( FAILED(hr) )
+            const size_t nworkers = std::min<size_t>( jobs, images - 1 );
+            for( size_t j = 1; j < nworkers; ++j )
             {
-                wprintf( L" FAILED [convert] (%x)\n", hr);
-                delete timage;
-                delete image;
-                goto LError;
+                hThreads[ nThreads ] = CreateThread( nullptr, 0, AssembleWorkerThread, &assemble, 0, nullptr );
+                if ( hThreads[ nThreads ] )
+                    ++nThreads;
             }
 
-            const TexMetadata& tinfo = timage->GetMetadata();
+            AssembleWorkerThread( &assemble );
 
-            assert( tinfo.format == format );
-            info.format = tinfo.format;
-
-            assert( info.width == tinfo.width );
-            assert( info.height == tinfo.height );
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.dimension == tinfo.dimension );
+            if ( nThreads > 0 )
+            {
+                WaitForMultipleObjects( nThreads, hThreads, TRUE, INFINITE );
 
-            delete image;
-            image = timage;
+                for( DWORD j = 0; j < nThreads; ++j )
+                    CloseHandle( hThreads[ j ] );
+            }
         }
 
-        loadedImages.push_back( image );
-    }
-
-    // --- Create result ---------------------------------------------------------------
-    {
-        std::vector<Image> imageArray;
-        imageArray.reserve( images );
-
-        for( auto it = loadedImages.cbegin(); it != loadedImages.cend(); ++it )
+        bool failed = false;
+        for( size_t index = 1; index < images && !failed; ++index )
         {
-            const Image* img = (*it)->GetImage(0,0,0);
-            assert( img != 0 );
-            imageArray.push_back( *img );
-        }
-
-        ScratchImage result;
-        switch( dwOptions & ( (1 << OPT_CUBE) | (1 << OPT_VOLUME) | (1 << OPT_ARRAY) | (1 << OPT_CUBEARRAY) ) )
-        {
-        case (1 << OPT_VOLUME):
-            hr = result.Initialize3DFromImages( &imageArray[0], imageArray.size() );
-            break;
-
-        case (1 << OPT_ARRAY):
-            hr = result.InitializeArrayFromImages( &imageArray[0], imageArray.size(), (dwOptions & (1 << OPT_USE_DX10)) != 0 );
-            break;
+            const SAssembleItem& item = items[ index ];
+            if ( item.log.empty() )
+            {
+                // Never picked up once another image had failed
+                continue;
+            }
 
-        case (1 << OPT_CUBE):
-        case (1 << OPT_CUBEARRAY):
-            hr = result.InitializeCubeFromImages( &imageArray[0], imageArray.size() );
-            break;
+            wprintf( L"\n%s", item.log.c_str() );
+            failed = item.failed;
         }
+        fflush(stdout);
 
-        if ( FAILED(hr ) )
-        {
-            wprintf( L"FAILED building result image (%x)\n", hr);
+        if ( failed )
             goto LError;
-        }
-
 
         // Write texture
         wprintf( L"\nWriting %s ", szOutputFile);
-        PrintInfo( result.GetMetadata() );
+        PrintInfo( result.GetMetadata(), nullptr );
         wprintf( L"\n" );
         fflush(stdout);
 
-        hr = SaveToDDSFile( result.GetImages(), result.GetImageCount(), result.GetMetadata(),
-                            (dwOptions & (1 << OPT_USE_DX10) ) ? (DDS_FLAGS_FORCE_DX10_EXT|DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE, 
-                            szOutputFile );
+        DWORD ddsFlags = DDS_FLAGS_PARALLEL;
+        if ( dwOptions & (1 << OPT_USE_DX10) )
+            ddsFlags |= DDS_FLAGS_FORCE_DX10_EXT|DDS_FLAGS_FORCE_DX10_EXT_MISC2;
+
+        hr = SaveToDDSFile( result.GetImages(), result.GetImageCount(), result.GetMetadata(), ddsFlags, szOutputFile );
         if(FAILED(hr))
         {
             wprintf( L"\nFAILED (%x)\n", hr);
@@ -10,7 +10,10 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include <stdarg.h>
+
 #include <memory>
+#include <string>
 
 #include <dxgiformat.h>
 
@@ -49,6 +52,8 @@ enum OPTIONS    // Note: dwOptions below assumes 32 or less options.
     OPT_FEATURE_LEVEL,
     OPT_FIT_POWEROF2,
     OPT_ALPHA_WEIGHT,
+    OPT_BC_QUICK,
+    OPT_JOBS,
     OPT_MAX
 };
 
@@ -62,6 +67,43 @@ struct SConversion
     SConversion *pNext;
 };
 
+struct SConvertOptions
+{
+    size_t width;
+    size_t height;
+    size_t mipLevels;
+    DXGI_FORMAT format;
+    DWORD dwFilter;
+    DWORD dwSRGB;
+    DWORD dwFilterOpts;
+    DWORD FileType;
+    DWORD maxSize;
+    float alphaWeight;
+    DWORD dwCompress;
+    DWORD dwOptions;
+
+    WCHAR szPrefix[MAX_PATH];
+    WCHAR szSuffix[MAX_PATH];
+};
+
+// State shared by every file being converted, including the batch mode workers
+struct SConvertShared
+{
+    CRITICAL_SECTION gpuLock;   // guards creation and use of pDevice
+    ID3D11Device* pDevice;
+    bool gpuTried;
+
+    volatile LONG nonpow2warn;
+    volatile LONG non4bc;
+};
+
+enum CONVERT_RESULT
+{
+    CONVERT_OK = 0,
+    CONVERT_SKIPPED,            // this file failed, carry on with the next one
+    CONVERT_FATAL,              // stop processing altogether
+};
+
 struct SValue
 {
     LPCWSTR pName;
@@ -103,6 +145,8 @@ SValue g_pOptions[] =
     { L"fl",            OPT_FEATURE_LEVEL },
     { L"pow2",          OPT_FIT_POWEROF2 },
     { L"aw",            OPT_ALPHA_WEIGHT },
+    { L"bcquick",       OPT_BC_QUICK  },
+    { L"j",             OPT_JOBS      },
     { nullptr,          0             }
 };
 
@@ -331,13 +375,43 @@ const WCHAR* LookupByValue(DWORD pValue, const SValue *pArray)
     return L"";
 }
 
-void PrintFormat(DXGI_FORMAT Format)
+void LogPrintf( _Inout_opt_ std::wstring* pLog, _In_z_ LPCWSTR szFormat, ... )
+{
+    va_list args;
+
+    if ( !pLog )
+    {
+        va_start( args, szFormat );
+        vwprintf( szFormat, args );
+        va_end( args );
+        return;
+    }
+
+    va_start( args, szFormat );
+    int len = _vscwprintf( szFormat, args );
+    va_end( args );
+
+    if ( len <= 0 )
+        return;
+
+    size_t pos = pLog->size();
+    pLog->resize( pos + len + 1 );
+
+    va_start( args, szFormat );
+    vswprintf_s( &(*pLog)[ pos ], len + 1, szFormat, args );
+    va_end( args );
+
+    pLog->resize( pos + len );
+}
+
+
+void PrintFormat(DXGI_FORMAT Format, _Inout_opt_ std::wstring* pLog)
 {
     for(SValue *pFormat = g_pFormats; pFormat->pName; pFormat++)
     {
         if((DXGI_FORMAT) pFormat->dwValue == Format)
         {
-            wprintf( pFormat->pName );
+            LogPrintf( pLog, L"%s", pFormat->pName );
             return;
         }
     }
@@ -346,50 +420,50 @@ void PrintFormat(DXGI_FORMAT Format)
     {
         if((DXGI_FORMAT) pFormat->dwValue == Format)
         {
-            wprintf( pFormat->pName );
+            LogPrintf( pLog, L"%s", pFormat->pName );
             return;
         }
     }
 
-    wprintf( L"*UNKNOWN*" );
+    LogPrintf( pLog, L"*UNKNOWN*" );
 }
 
-void PrintInfo( const TexMetadata& info )
+void PrintInfo( const TexMetadata& info, _Inout_opt_ std::wstring* pLog )
 {
-    wprintf( L" (%Iux%Iu", info.width, info.height);
+    LogPrintf( pLog, L" (%Iux%Iu", info.width, info.height);
 
     if ( TEX_DIMENSION_TEXTURE3D == info.dimension )
-        wprintf( L"x%Iu", info.depth);
+        LogPrintf( pLog, L"x%Iu", info.depth);
 
     if ( info.mipLevels > 1 )
-        wprintf( L",%Iu", info.mipLevels);
+        LogPrintf( pLog, L",%Iu", info.mipLevels);
 
-    wprintf( L" ");
-    PrintFormat( info.format );
+    LogPrintf( pLog, L" ");
+    PrintFormat( info.format, pLog );
 
     switch ( info.dimension )
     {
     case TEX_DIMENSION_TEXTURE1D:
-        wprintf( (info.arraySize > 1) ? L" 1DArray" : L" 1D" );
+        LogPrintf( pLog, (info.arraySize > 1) ? L" 1DArray" : L" 1D" );
         break;
 
     case TEX_DIMENSION_TEXTURE2D:
         if ( info.IsCubemap() )
         {
-            wprintf( (info.arraySize > 6) ? L" CubeArray" : L" Cube" );
+            LogPrintf( pLog, (info.arraySize > 6) ? L" CubeArray" : L" Cube" );
         }
         else
         {
-            wprintf( (info.arraySize > 1) ? L" 2DArray" : L" 2D" );
+            LogPrintf( pLog, (info.arraySize > 1) ? L" 2DArray" : L" 2D" );
         }
         break;
 
     case TEX_DIMENSION_TEXTURE3D:
-        wprintf( L" 3D");
+        LogPrintf( pLog, L" 3D");
         break;
     }
 
-    wprintf( L")");
+    LogPrintf( pLog, L")");
 }
 
 
@@ -447,6 +521,8 @@ void PrintUsage()
     wprintf( L"   -pow2               resize to fit a power-of-2, respecting aspect ratio\n" );
     wprintf( L"   -aw                 BC7 GPU compressor weighting for alpha error metric\n"
              L"                       (defaults to 1.0)\n" );
+    wprintf( L"   -bcquick <n>        BC6H/BC7 CPU compressor speed level from 0 (exhaustive,\n"
+             L"                       the default) to 3 (fastest, lowest quality)\n" );
     wprintf( L"   -fl <feature-level> Set maximum feature level target (defaults to 11.0)\n");
     wprintf( L"\n                       (DDS input only)\n");
     wprintf( L"   -t{u|f}             TYPELESS format is treated as UNORM or FLOAT\n");
@@ -456,9 +532,11 @@ void PrintUsage()
     wprintf( L"   -dx10               Force use of 'DX10' extended header\n");
     wprintf( L"\n   -nologo             suppress copyright message\n");
 #ifdef _OPENMP
-    wprintf( L"   -singleproc         Do not use multi-threaded compression\n");
+    wprintf( L"   -singleproc         Do not use multi-threaded processing\n");
 #endif
     wprintf( L"   -nogpu              Do not use DirectCompute-based codecs\n");
+    wprintf( L"   -j <n>              batch mode: convert up to n files at once, with a\n"
+             L"                       prefetching reader and progress reporting\n");
 
     wprintf( L"\n");
     wprintf( L"   <format>: ");
@@ -479,7 +557,7 @@ void PrintUsage()
 }
 
 _Success_(return != false)
-bool CreateDevice( _Outptr_ ID3D11Device** pDevice )
+bool CreateDevice( _Outptr_ ID3D11Device** pDevice, _Inout_opt_ std::wstring* pLog )
 {
     if ( !pDevice )
         return false;
@@ -549,7 +627,7 @@ bool CreateDevice( _Outptr_ ID3D11Device** pDevice )
                 hr = pAdapter->GetDesc( &desc );
                 if ( SUCCEEDED(hr) )
                 {
-                    wprintf( L"\n[Using DirectCompute on \"%s\"]\n", desc.Description );
+                    LogPrintf( pLog, L"\n[Using DirectCompute on \"%s\"]\n", desc.Description );
                 }
                 pAdapter->Release();
             }
@@ -605,414 +683,544 @@ void FitPowerOf2( size_t origx, size_t origy, size_t& targetx, size_t& targety,
 
 
 //--------------------------------------------------------------------------------------
-// Entry-point
+// Converts a single file. The source comes from pSource when provided (batch mode prefetch)
+// and is loaded from pConv->szSrc otherwise; likewise the result is encoded into pOutput
+// or written to pConv->szDest. Messages go to pLog, or straight to stdout when it is null.
 //--------------------------------------------------------------------------------------
-#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
-
-int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+CONVERT_RESULT ConvertFile( _Inout_ SConversion* pConv, _In_ const SConvertOptions& opts, _Inout_ SConvertShared& shared,
+                            _In_reads_bytes_opt_(sourceSize) const uint8_t* pSource, _In_ size_t sourceSize,
+                            _Out_opt_ Blob* pOutput, _Inout_opt_ std::wstring* pLog )
 {
-    // Parameters and defaults
+    const size_t width = opts.width;
+    const size_t height = opts.height;
+    const size_t mipLevels = opts.mipLevels;
+    const DXGI_FORMAT format = opts.format;
+    const DWORD dwFilter = opts.dwFilter;
+    const DWORD dwSRGB = opts.dwSRGB;
+    const DWORD dwFilterOpts = opts.dwFilterOpts;
+    const DWORD FileType = opts.FileType;
+    const DWORD maxSize = opts.maxSize;
+    const float alphaWeight = opts.alphaWeight;
+    const DWORD dwCompress = opts.dwCompress;
+    const DWORD dwOptions = opts.dwOptions;
+    LPCWSTR szPrefix = opts.szPrefix;
+    LPCWSTR szSuffix = opts.szSuffix;
+
     HRESULT hr;
-    INT nReturn;
+    ID3D11Device* pDevice = nullptr;
 
-    size_t width = 0;
-    size_t height = 0; 
-    size_t mipLevels = 0;
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    DWORD dwFilter = TEX_FILTER_DEFAULT;
-    DWORD dwSRGB = 0;
-    DWORD dwFilterOpts = 0;
-    DWORD FileType = CODEC_DDS;
-    DWORD maxSize = 16384;
-    float alphaWeight = 1.f;
+    // Load source image
+    LogPrintf( pLog, L"reading %s", pConv->szSrc );
+    if ( !pLog )
+        fflush(stdout);
 
-    WCHAR szPrefix   [MAX_PATH];
-    WCHAR szSuffix   [MAX_PATH];
-    WCHAR szOutputDir[MAX_PATH];
+    WCHAR ext[_MAX_EXT];
+    WCHAR fname[_MAX_FNAME];
+    _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
 
-    szPrefix[0]    = 0;
-    szSuffix[0]    = 0;
-    szOutputDir[0] = 0;
+    TexMetadata info;
+    std::unique_ptr<ScratchImage> image( new (std::nothrow) ScratchImage );
 
-    // Initialize COM (needed for WIC)
-    if( FAILED( hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED) ) )
+    if ( !image )
     {
-        wprintf( L"Failed to initialize COM (%08X)\n", hr);
-        return 1;
+        LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+        return CONVERT_FATAL;
     }
 
-    // Process command line
-    DWORD dwOptions = 0;
-    SConversion *pConversion = nullptr;
-    SConversion **ppConversion = &pConversion;
+    if ( _wcsicmp( ext, L".dds" ) == 0 )
+    {
+        DWORD ddsFlags = DDS_FLAGS_NONE;
+        if ( dwOptions & (1 << OPT_DDS_DWORD_ALIGN) )
+            ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
+        if ( dwOptions & (1 << OPT_EXPAND_LUMINANCE) )
+            ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+
+        hr = ( pSource ) ? LoadFromDDSMemory( pSource, sourceSize, ddsFlags, &info, *image )
+                         : LoadFromDDSFile( pConv->szSrc, ddsFlags, &info, *image );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return CONVERT_SKIPPED;
+        }
 
-    for(int iArg = 1; iArg < argc; iArg++)
+        if ( IsTypeless( info.format ) )
+        {
+            if ( dwOptions & (1 << OPT_TYPELESS_UNORM) )
+            {
+                info.format = MakeTypelessUNORM( info.format );
+            }
+            else if ( dwOptions & (1 << OPT_TYPELESS_FLOAT) )
+            {
+                info.format = MakeTypelessFLOAT( info.format );
+            }
+
+            if ( IsTypeless( info.format ) )
+            {
+                LogPrintf( pLog, L" FAILED due to Typeless format %d\n", info.format );
+                return CONVERT_SKIPPED;
+            }
+
+            image->OverrideFormat( info.format );
+        }
+    }
+    else if ( _wcsicmp( ext, L".tga" ) == 0 )
     {
-        PWSTR pArg = argv[iArg];
+        const DWORD tgaFlags = ( dwFilterOpts & TEX_FILTER_PARALLEL ) ? TGA_FLAGS_PARALLEL : TGA_FLAGS_NONE;
 
-        if(('-' == pArg[0]) || ('/' == pArg[0]))
+        hr = ( pSource ) ? LoadFromTGAMemory( pSource, sourceSize, &info, *image, tgaFlags )
+                         : LoadFromTGAFile( pConv->szSrc, &info, *image, tgaFlags );
+        if ( FAILED(hr) )
         {
-            pArg++;
-            PWSTR pValue;
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return CONVERT_SKIPPED;
+        }
+    }
+    else
+    {
+        // WIC shares the same filter values for mode and dither
+        static_assert( WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match" );
+        static_assert( WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+
+        hr = ( pSource ) ? LoadFromWICMemory( pSource, sourceSize, dwFilter, &info, *image )
+                         : LoadFromWICFile( pConv->szSrc, dwFilter, &info, *image );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return CONVERT_SKIPPED;
+        }
+    }
 
-            for(pValue = pArg; *pValue && (':' != *pValue); pValue++);
+    PrintInfo( info, pLog );
 
-            if(*pValue)
-                *pValue++ = 0;
+    size_t tMips = ( !mipLevels && info.mipLevels > 1 ) ? info.mipLevels : mipLevels;
 
-            DWORD dwOption = LookupByName(pArg, g_pOptions);
+    bool sizewarn = false;
 
-            if(!dwOption || (dwOptions & (1 << dwOption)))
-            {
-                PrintUsage();
-                return 1;
-            }
+    size_t twidth = ( !width ) ? info.width : width;
+    if ( twidth > maxSize )
+    {
+        if ( !width )
+            twidth = maxSize;
+        else
+            sizewarn = true;
+    }
 
-            dwOptions |= 1 << dwOption;
+    size_t theight = ( !height ) ? info.height : height;
+    if ( theight > maxSize )
+    {
+        if ( !height )
+            theight = maxSize;
+        else
+            sizewarn = true;
+    }
 
-            if( (OPT_NOLOGO != dwOption) && (OPT_TYPELESS_UNORM != dwOption) && (OPT_TYPELESS_FLOAT != dwOption)
-                && (OPT_SEPALPHA != dwOption) && (OPT_PREMUL_ALPHA != dwOption) && (OPT_EXPAND_LUMINANCE != dwOption)
-                && (OPT_TA_WRAP != dwOption) && (OPT_TA_MIRROR != dwOption)
-                && (OPT_FORCE_SINGLEPROC != dwOption) && (OPT_NOGPU != dwOption) && (OPT_FIT_POWEROF2 != dwOption)
-                && (OPT_SRGB != dwOption) && (OPT_SRGBI != dwOption) && (OPT_SRGBO != dwOption)
-                && (OPT_HFLIP != dwOption) && (OPT_VFLIP != dwOption)
-                && (OPT_DDS_DWORD_ALIGN != dwOption) && (OPT_USE_DX10 != dwOption) )
-            {
-                if(!*pValue)
-                {
-                    if((iArg + 1 >= argc))
-                    {
-                        PrintUsage();
-                        return 1;
-                    }
+    if ( sizewarn )
+    {
+        LogPrintf( pLog, L"\nWARNING: Target size exceeds maximum size for feature level (%u)\n", maxSize );
+    }
 
-                    iArg++;
-                    pValue = argv[iArg];
-                }
-            }
+    if (dwOptions & (1 << OPT_FIT_POWEROF2))
+    {
+        FitPowerOf2( info.width, info.height, twidth, theight, maxSize );
+    }
 
-            switch(dwOption)
-            {
-            case OPT_WIDTH:
-                if (swscanf_s(pValue, L"%Iu", &width) != 1)
-                {
-                    wprintf( L"Invalid value specified with -w (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    // Convert texture
+    LogPrintf( pLog, L" as");
+    if ( !pLog )
+        fflush(stdout);
 
-            case OPT_HEIGHT:
-                if (swscanf_s(pValue, L"%Iu", &height) != 1)
-                {
-                    wprintf( L"Invalid value specified with -h (%s)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    // --- Planar ------------------------------------------------------------------
+    if ( IsPlanar( info.format ) )
+    {
+        auto img = image->GetImage(0,0,0);
+        assert( img );
+        size_t nimg = image->GetImageCount();
 
-            case OPT_MIPLEVELS:
-                if (swscanf_s(pValue, L"%Iu", &mipLevels) != 1)
-                {
-                    wprintf( L"Invalid value specified with -m (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
+        }
 
-            case OPT_FORMAT:
-                format = (DXGI_FORMAT) LookupByName(pValue, g_pFormats);
-                if ( !format )
-                {
-                    wprintf( L"Invalid value specified with -f (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        hr = ConvertToSinglePlane( img, nimg, info, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [converttosingeplane] (%x)\n", hr);
+            return CONVERT_SKIPPED;
+        }
 
-            case OPT_FILTER:
-                dwFilter = LookupByName(pValue, g_pFilters);
-                if ( !dwFilter )
-                {
-                    wprintf( L"Invalid value specified with -if (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        auto& tinfo = timage->GetMetadata();
 
-            case OPT_SRGBI:
-                dwSRGB |= TEX_FILTER_SRGB_IN;
-                break;
+        info.format = tinfo.format;
 
-            case OPT_SRGBO:
-                dwSRGB |= TEX_FILTER_SRGB_OUT;
-                break;
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
 
-            case OPT_SRGB:
-                dwSRGB |= TEX_FILTER_SRGB;
-                break;
+        image.swap( timage );
+    }
 
-            case OPT_SEPALPHA:
-                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
-                break;
+    DXGI_FORMAT tformat = ( format == DXGI_FORMAT_UNKNOWN ) ? info.format : format;
 
-            case OPT_PREFIX:
-                wcscpy_s(szPrefix, MAX_PATH, pValue);
-                break;
+    // --- Decompress --------------------------------------------------------------
+    std::unique_ptr<ScratchImage> cimage;
+    if ( IsCompressed( info.format ) )
+    {
+        auto img = image->GetImage(0,0,0);
+        assert( img );
+        size_t nimg = image->GetImageCount();
 
-            case OPT_SUFFIX:
-                wcscpy_s(szSuffix, MAX_PATH, pValue);
-                break;
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
+        }
 
-            case OPT_OUTPUTDIR:
-                wcscpy_s(szOutputDir, MAX_PATH, pValue);
-                break;
+        hr = Decompress( img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [decompress] (%x)\n", hr);
+            return CONVERT_SKIPPED;
+        }
 
-            case OPT_FILETYPE:
-                FileType = LookupByName(pValue, g_pSaveFileTypes);
-                if ( !FileType )
-                {
-                    wprintf( L"Invalid value specified with -ft (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        auto& tinfo = timage->GetMetadata();
 
-            case OPT_TA_WRAP:
-                if ( dwFilterOpts & TEX_FILTER_MIRROR )
-                {
-                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_WRAP;
-                break;
+        info.format = tinfo.format;
 
-            case OPT_TA_MIRROR:
-                if ( dwFilterOpts & TEX_FILTER_WRAP )
-                {
-                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_MIRROR;
-                break;
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
 
-            case OPT_FEATURE_LEVEL:
-                maxSize = LookupByName( pValue, g_pFeatureLevels );
-                if ( !maxSize )
-                {
-                    wprintf( L"Invalid value specified with -fl (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        if ( FileType == CODEC_DDS )
+        {
+            // Keep the original compressed image in case we can reuse it
+            cimage.reset( image.release() );
+            image.reset( timage.release() );
+        }
+        else
+        {
+            image.swap( timage );
+        }
+    }
 
-            case OPT_ALPHA_WEIGHT:
-                if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
-                {
-                    wprintf( L"Invalid value specified with -aw (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if ( alphaWeight < 0.f )
-                {
-                    wprintf( L"-aw (%s) parameter must be positive\n", pValue);
-                    wprintf( L"\n");
-                    return 1;
-                }
-                break;
-            }
+    // --- Flip/Rotate -------------------------------------------------------------
+    if ( dwOptions & ( (1 << OPT_HFLIP) | (1 << OPT_VFLIP) ) )
+    {
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
         }
-        else
-        {         
-            SConversion *pConv = new SConversion;
-            if ( !pConv )
-                return 1;
 
-            wcscpy_s(pConv->szSrc, MAX_PATH, pArg);
+        DWORD dwFlags = 0;
 
-            pConv->szDest[0] = 0;
-            pConv->pNext = nullptr;
+        if ( dwOptions & (1 << OPT_HFLIP) )
+            dwFlags |= TEX_FR_FLIP_HORIZONTAL;
 
-            *ppConversion = pConv;
-            ppConversion = &pConv->pNext;
-        }
-    }
+        if ( dwOptions & (1 << OPT_VFLIP) )
+            dwFlags |= TEX_FR_FLIP_VERTICAL;
 
-    if(!pConversion)
-    {
-        PrintUsage();
-        return 0;
-    }
+        assert( dwFlags != 0 );
 
-    if(~dwOptions & (1 << OPT_NOLOGO))
-        PrintLogo();
+        hr = FlipRotate( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFlags, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [fliprotate] (%x)\n", hr);
+            return CONVERT_FATAL;
+        }
 
-    // Work out out filename prefix and suffix
-    if(szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
-        wcscat_s( szOutputDir, MAX_PATH, L"\\" );
+        auto& tinfo = timage->GetMetadata();
 
-    if(szPrefix[0])
-        wcscat_s(szOutputDir, MAX_PATH, szPrefix);
+        assert( tinfo.width == twidth && tinfo.height == theight );
 
-    wcscpy_s(szPrefix, MAX_PATH, szOutputDir);
+        info.width = tinfo.width;
+        info.height = tinfo.height;
 
-    const WCHAR* fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.format == tinfo.format );
+        assert( info.dimension == tinfo.dimension );
 
-    if (fileTypeName)
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".");
-        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
-    }
-    else
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".unknown");
+        image.swap( timage );
+        cimage.reset();
     }
 
-    if (FileType != CODEC_DDS)
+    // --- Resize ------------------------------------------------------------------
+    if ( info.width != twidth || info.height != theight )
     {
-        mipLevels = 1;
-    }
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
+        }
 
-    // Convert images
-    bool nonpow2warn = false;
-    bool non4bc = false;
-    SConversion *pConv;
-    ID3D11Device* pDevice = nullptr;
+        hr = Resize( image->GetImages(), image->GetImageCount(), image->GetMetadata(), twidth, theight, dwFilter | dwFilterOpts, *timage );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [resize] (%x)\n", hr);
+            return CONVERT_FATAL;
+        }
 
-    for(pConv = pConversion; pConv; pConv = pConv->pNext)
-    {
-        // Load source image
-        if(pConv != pConversion)
-            wprintf( L"\n");
+        auto& tinfo = timage->GetMetadata();
 
-        wprintf( L"reading %s", pConv->szSrc );
-        fflush(stdout);
+        assert( tinfo.width == twidth && tinfo.height == theight && tinfo.mipLevels == 1 );
+        info.width = tinfo.width;
+        info.height = tinfo.height;
+        info.mipLevels = 1;
 
-        WCHAR ext[_MAX_EXT];
-        WCHAR fname[_MAX_FNAME];
-        _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.format == tinfo.format );
+        assert( info.dimension == tinfo.dimension );
 
-        TexMetadata info;
-        std::unique_ptr<ScratchImage> image( new (std::nothrow) ScratchImage );
+        image.swap( timage );
+        cimage.reset();
+    }
 
-        if ( !image )
+    // --- Convert -----------------------------------------------------------------
+    bool pmfused = false;
+    if ( info.format != tformat && !IsCompressed( tformat ) )
+    {
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
         {
-            wprintf( L" ERROR: Memory allocation failed\n" );
-            goto LError;
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
         }
 
-        if ( _wcsicmp( ext, L".dds" ) == 0 )
+        // When no mips will be generated afterwards, premultiplied alpha is applied in the same pass as the conversion
+        // (not with -srgbi/-srgbo, which are left to the separate step exactly as before)
+        pmfused = ( dwOptions & (1 << OPT_PREMUL_ALPHA) )
+                  && !dwSRGB
+                  && HasAlpha( tformat )
+                  && tformat != DXGI_FORMAT_A8_UNORM
+                  && !info.IsPMAlpha()
+                  && ( ( tMips && ( tMips == 1 || info.mipLevels == tMips ) ) || ( info.width <= 1 && info.height <= 1 && info.depth <= 1 ) );
+
+        DWORD dwConvert = dwFilter | dwFilterOpts | dwSRGB;
+        if ( pmfused )
+            dwConvert |= TEX_FILTER_PREMULTIPLY_ALPHA;
+
+        hr = Convert( image->GetImages(), image->GetImageCount(), image->GetMetadata(), tformat, dwConvert, 0.5f, *timage );
+        if ( FAILED(hr) )
         {
-            DWORD ddsFlags = DDS_FLAGS_NONE;
-            if ( dwOptions & (1 << OPT_DDS_DWORD_ALIGN) )
-                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
-            if ( dwOptions & (1 << OPT_EXPAND_LUMINANCE) )
-                ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+            LogPrintf( pLog, L" FAILED [convert] (%x)\n", hr);
+            return CONVERT_FATAL;
+        }
 
-            hr = LoadFromDDSFile( pConv->szSrc, ddsFlags, &info, *image );
-            if ( FAILED(hr) )
+        auto& tinfo = timage->GetMetadata();
+
+        assert( tinfo.format == tformat );
+        info.format = tinfo.format;
+        info.miscFlags2 = tinfo.miscFlags2;
+
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
+
+        image.swap( timage );
+        cimage.reset();
+    }
+
+    // --- Generate mips -----------------------------------------------------------
+    if ( !ispow2(info.width) || !ispow2(info.height) || !ispow2(info.depth) )
+    {
+        if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
+        {
+            if ( !tMips )
             {
-                wprintf( L" FAILED (%x)\n", hr);
-                continue;
+                tMips = 1;
             }
-
-            if ( IsTypeless( info.format ) )
+            else
             {
-                if ( dwOptions & (1 << OPT_TYPELESS_UNORM) )
-                {
-                    info.format = MakeTypelessUNORM( info.format );
-                }
-                else if ( dwOptions & (1 << OPT_TYPELESS_FLOAT) )
-                {
-                    info.format = MakeTypelessFLOAT( info.format );
-                }
+                LogPrintf( pLog, L" ERROR: Cannot generate mips for non-power-of-2 volume textures\n" );
+                return CONVERT_FATAL;
+            }
+        }
+        else if ( !tMips || info.mipLevels != 1 )
+        {
+            InterlockedExchange( &shared.nonpow2warn, TRUE );
+        }
+    }
+
+    if ( (!tMips || info.mipLevels != tMips) && ( info.mipLevels != 1 ) )
+    {
+        // Mips generation only works on a single base image, so strip off existing mip levels
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
+        {
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
+        }
+
+        TexMetadata mdata = info;
+        mdata.mipLevels = 1;
+        hr = timage->Initialize( mdata );
+        if ( FAILED(hr) )
+        {
+            LogPrintf( pLog, L" FAILED [copy to single level] (%x)\n", hr);
+            return CONVERT_FATAL;
+        }
 
-                if ( IsTypeless( info.format ) )
+        if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
+        {
+            for( size_t d = 0; d < info.depth; ++d )
+            {
+                hr = CopyRectangle( *image->GetImage( 0, 0, d ), Rect( 0, 0, info.width, info.height ),
+                                    *timage->GetImage( 0, 0, d ), TEX_FILTER_DEFAULT, 0, 0 );
+                if ( FAILED(hr) )
                 {
-                    wprintf( L" FAILED due to Typeless format %d\n", info.format );
-                    continue;
+                    LogPrintf( pLog, L" FAILED [copy to single level] (%x)\n", hr);
+                    return CONVERT_FATAL;
                 }
-
-                image->OverrideFormat( info.format );
             }
         }
-        else if ( _wcsicmp( ext, L".tga" ) == 0 )
+        else
         {
-            hr = LoadFromTGAFile( pConv->szSrc, &info, *image );
-            if ( FAILED(hr) )
+            for( size_t i = 0; i < info.arraySize; ++i )
             {
-                wprintf( L" FAILED (%x)\n", hr);
-                continue;
+                hr = CopyRectangle( *image->GetImage( 0, i, 0 ), Rect( 0, 0, info.width, info.height ),
+                                    *timage->GetImage( 0, i, 0 ), TEX_FILTER_DEFAULT, 0, 0 );
+                if ( FAILED(hr) )
+                {
+                    LogPrintf( pLog, L" FAILED [copy to single level] (%x)\n", hr);
+                    return CONVERT_FATAL;
+                }
             }
         }
-        else
+
+        image.swap( timage );
+        info.mipLevels = image->GetMetadata().mipLevels;
+
+        if ( cimage && ( tMips == 1 ) )
         {
-            // WIC shares the same filter values for mode and dither
-            static_assert( WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match" );
-            static_assert( WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-
-            hr = LoadFromWICFile( pConv->szSrc, dwFilter, &info, *image );
+            // Special case for trimming mips off compressed images and keeping the original compressed highest level mip
+            mdata = cimage->GetMetadata();
+            mdata.mipLevels = 1;
+            hr = timage->Initialize( mdata );
             if ( FAILED(hr) )
             {
-                wprintf( L" FAILED (%x)\n", hr);
-                continue;
+                LogPrintf( pLog, L" FAILED [copy compressed to single level] (%x)\n", hr);
+                return CONVERT_FATAL;
             }
-        }
 
-        PrintInfo( info );
+            if ( mdata.dimension == TEX_DIMENSION_TEXTURE3D )
+            {
+                for( size_t d = 0; d < mdata.depth; ++d )
+                {
+                    auto simg = cimage->GetImage( 0, 0, d );
+                    auto dimg = timage->GetImage( 0, 0, d );
 
-        size_t tMips = ( !mipLevels && info.mipLevels > 1 ) ? info.mipLevels : mipLevels;
+                    memcpy_s( dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch );
+                }
+            }
+            else
+            {
+                for( size_t i = 0; i < mdata.arraySize; ++i )
+                {
+                    auto simg = cimage->GetImage( 0, i, 0 );
+                    auto dimg = timage->GetImage( 0, i, 0 );
 
-        bool sizewarn = false;
+                    memcpy_s( dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch );
+                }
+            }
 
-        size_t twidth = ( !width ) ? info.width : width;
-        if ( twidth > maxSize )
+            cimage.swap( timage );
+        }
+        else
         {
-            if ( !width )
-                twidth = maxSize;
-            else
-                sizewarn = true;
+            cimage.reset();
         }
+    }
 
-        size_t theight = ( !height ) ? info.height : height;
-        if ( theight > maxSize )
+    bool fusemips = ( !tMips || info.mipLevels != tMips ) && ( info.width > 1 || info.height > 1 || info.depth > 1 )
+                    && IsCompressed( tformat ) && (FileType == CODEC_DDS)
+                    && info.dimension != TEX_DIMENSION_TEXTURE3D
+                    && !( dwOptions & (1 << OPT_PREMUL_ALPHA) );
+    if ( fusemips )
+    {
+        // Mips are generated a level at a time while compressing below, rather than as a full uncompressed chain
+        cimage.reset();
+    }
+    else if ( ( !tMips || info.mipLevels != tMips ) && ( info.width > 1 || info.height > 1 || info.depth > 1 ) )
+    {
+        std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
+        if ( !timage )
         {
-            if ( !height )
-                theight = maxSize;
-            else
-                sizewarn = true;
+            LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+            return CONVERT_FATAL;
         }
 
-        if ( sizewarn )
+        if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
         {
-            wprintf( L"\nWARNING: Target size exceeds maximum size for feature level (%u)\n", maxSize );
+            hr = GenerateMipMaps3D( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
         }
-
-        if (dwOptions & (1 << OPT_FIT_POWEROF2))
+        else
+        {
+            hr = GenerateMipMaps( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
+        }
+        if ( FAILED(hr) )
         {
-            FitPowerOf2( info.width, info.height, twidth, theight, maxSize );
+            LogPrintf( pLog, L" FAILED [mipmaps] (%x)\n", hr);
+            return CONVERT_FATAL;
         }
 
-        // Convert texture
-        wprintf( L" as");
-        fflush(stdout);
+        auto& tinfo = timage->GetMetadata();
+        info.mipLevels = tinfo.mipLevels;
+
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
+
+
+        image.swap( timage );
+        cimage.reset();
+    }
 
-        // --- Planar ------------------------------------------------------------------
-        if ( IsPlanar( info.format ) )
+    // --- Premultiplied alpha (if requested) --------------------------------------
+    if ( ( dwOptions & (1 << OPT_PREMUL_ALPHA) )
+         && !pmfused
+         && HasAlpha( info.format )
+         && info.format != DXGI_FORMAT_A8_UNORM )
+    {
+        if ( info.IsPMAlpha() )
+        {
+            LogPrintf( pLog, L"WARNING: Image is already using premultiplied alpha\n" );
+        }
+        else
         {
             auto img = image->GetImage(0,0,0);
             assert( img );
@@ -1021,21 +1229,20 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
             if ( !timage )
             {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
+                LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+                return CONVERT_FATAL;
             }
 
-            hr = ConvertToSinglePlane( img, nimg, info, *timage );
+            hr = PremultiplyAlpha( img, nimg, info, dwSRGB, *timage );
             if ( FAILED(hr) )
             {
-                wprintf( L" FAILED [converttosingeplane] (%x)\n", hr);
-                continue;
+                LogPrintf( pLog, L" FAILED [premultiply alpha] (%x)\n", hr);
+                return CONVERT_SKIPPED;
             }
 
             auto& tinfo = timage->GetMetadata();
-
-            info.format = tinfo.format;
-
+            info.miscFlags2 = tinfo.miscFlags2;
+ 
             assert( info.width == tinfo.width );
             assert( info.height == tinfo.height );
             assert( info.depth == tinfo.depth );
@@ -1046,36 +1253,26 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             assert( info.dimension == tinfo.dimension );
 
             image.swap( timage );
+            cimage.reset();
         }
+    }
 
-        DXGI_FORMAT tformat = ( format == DXGI_FORMAT_UNKNOWN ) ? info.format : format;
-
-        // --- Decompress --------------------------------------------------------------
-        std::unique_ptr<ScratchImage> cimage;
-        if ( IsCompressed( info.format ) )
+    // --- Compress ----------------------------------------------------------------
+    if ( IsCompressed( tformat ) && (FileType == CODEC_DDS) )
+    {
+        if ( cimage && ( cimage->GetMetadata().format == tformat ) )
         {
-            auto img = image->GetImage(0,0,0);
-            assert( img );
-            size_t nimg = image->GetImageCount();
+            // We never changed the image and it was already compressed in our desired format, use original data
+            image.reset( cimage.release() );
 
-            std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
-            }
+            auto& tinfo = image->GetMetadata();
 
-            hr = Decompress( img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [decompress] (%x)\n", hr);
-                continue;
+            if ( (tinfo.width % 4) != 0 || (tinfo.height % 4) != 0 )
+            { 
+                InterlockedExchange( &shared.non4bc, TRUE );
             }
 
-            auto& tinfo = timage->GetMetadata();
-
             info.format = tinfo.format;
-
             assert( info.width == tinfo.width );
             assert( info.height == tinfo.height );
             assert( info.depth == tinfo.depth );
@@ -1084,122 +1281,113 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             assert( info.miscFlags == tinfo.miscFlags );
             assert( info.miscFlags2 == tinfo.miscFlags2 );
             assert( info.dimension == tinfo.dimension );
-
-            if ( FileType == CODEC_DDS )
-            {
-                // Keep the original compressed image in case we can reuse it
-                cimage.reset( image.release() );
-                image.reset( timage.release() );
-            }
-            else
-            {
-                image.swap( timage );
-            }
         }
-
-        // --- Flip/Rotate -------------------------------------------------------------
-        if ( dwOptions & ( (1 << OPT_HFLIP) | (1 << OPT_VFLIP) ) )
+        else
         {
+            cimage.reset();
+
+            auto img = image->GetImage(0,0,0);
+            assert( img );
+            size_t nimg = image->GetImageCount();
+
             std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
             if ( !timage )
             {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
+                LogPrintf( pLog, L" ERROR: Memory allocation failed\n" );
+                return CONVERT_FATAL;
             }
 
-            DWORD dwFlags = 0;
-
-            if ( dwOptions & (1 << OPT_HFLIP) )
-                dwFlags |= TEX_FR_FLIP_HORIZONTAL;
-
-            if ( dwOptions & (1 << OPT_VFLIP) )
-                dwFlags |= TEX_FR_FLIP_VERTICAL;
-
-            assert( dwFlags != 0 );
-
-            hr = FlipRotate( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFlags, *timage );
-            if ( FAILED(hr) )
+            bool bc6hbc7=false;
+            switch( tformat )
             {
-                wprintf( L" FAILED [fliprotate] (%x)\n", hr);
-                goto LError;
-            }
-
-            auto& tinfo = timage->GetMetadata();
+            case DXGI_FORMAT_BC6H_TYPELESS:
+            case DXGI_FORMAT_BC6H_UF16:
+            case DXGI_FORMAT_BC6H_SF16:
+            case DXGI_FORMAT_BC7_TYPELESS:
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB:
+                bc6hbc7=true;
 
-            assert( tinfo.width == twidth && tinfo.height == theight );
+                {
+                    EnterCriticalSection( &shared.gpuLock );
 
-            info.width = tinfo.width;
-            info.height = tinfo.height;
+                    if ( !shared.gpuTried )
+                    {
+                        shared.gpuTried = true;
 
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.format == tinfo.format );
-            assert( info.dimension == tinfo.dimension );
+                        if ( !(dwOptions & (1 << OPT_NOGPU) ) )
+                        {
+                            if ( !CreateDevice( &shared.pDevice, pLog ) )
+                                LogPrintf( pLog, L"\nWARNING: DirectCompute is not available, using BC6H / BC7 CPU codec\n" );
+                        }
+                        else
+                        {
+                            LogPrintf( pLog, L"\nWARNING: using BC6H / BC7 CPU codec\n" );
+                        }
+                    }
 
-            image.swap( timage );
-            cimage.reset();
-        }
+                    pDevice = shared.pDevice;
 
-        // --- Resize ------------------------------------------------------------------
-        if ( info.width != twidth || info.height != theight )
-        {
-            std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
+                    LeaveCriticalSection( &shared.gpuLock );
+                }
+                break;
             }
 
-            hr = Resize( image->GetImages(), image->GetImageCount(), image->GetMetadata(), twidth, theight, dwFilter | dwFilterOpts, *timage );
-            if ( FAILED(hr) )
+            DWORD cflags = TEX_COMPRESS_DEFAULT;
+#ifdef _OPENMP
+            if ( bc6hbc7 && !(dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
             {
-                wprintf( L" FAILED [resize] (%x)\n", hr);
-                goto LError;
+                cflags |= TEX_COMPRESS_PARALLEL;
             }
+#endif
 
-            auto& tinfo = timage->GetMetadata();
-
-            assert( tinfo.width == twidth && tinfo.height == theight && tinfo.mipLevels == 1 );
-            info.width = tinfo.width;
-            info.height = tinfo.height;
-            info.mipLevels = 1;
+            if ( (img->width % 4) != 0 || (img->height % 4) != 0 )
+            { 
+                InterlockedExchange( &shared.non4bc, TRUE );
+            }
 
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.format == tinfo.format );
-            assert( info.dimension == tinfo.dimension );
+            if ( fusemips && bc6hbc7 && pDevice )
+            {
+                // DirectCompute works on the whole chain, so generate it up front
+                hr = GenerateMipMaps( img, nimg, info, dwFilter | dwFilterOpts, tMips, *timage );
+                if ( FAILED(hr) )
+                {
+                    LogPrintf( pLog, L" FAILED [mipmaps] (%x)\n", hr);
+                    return CONVERT_FATAL;
+                }
 
-            image.swap( timage );
-            cimage.reset();
-        }
+                image.swap( timage );
+                img = image->GetImage(0,0,0);
+                nimg = image->GetImageCount();
+                info.mipLevels = image->GetMetadata().mipLevels;
+                fusemips = false;
+            }
 
-        // --- Convert -----------------------------------------------------------------
-        if ( info.format != tformat && !IsCompressed( tformat ) )
-        {
-            std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-            if ( !timage )
+            if ( bc6hbc7 && pDevice )
             {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
+                // The device's immediate context is shared by all the batch workers
+                EnterCriticalSection( &shared.gpuLock );
+                hr = Compress( pDevice, img, nimg, info, tformat, dwSRGB, alphaWeight, *timage );
+                LeaveCriticalSection( &shared.gpuLock );
+            }
+            else if ( fusemips )
+            {
+                hr = GenerateMipMapsAndCompress( img, nimg, info, dwFilter | dwFilterOpts, tMips, tformat, cflags | dwSRGB | dwCompress, 0.5f, *timage );
+            }
+            else
+            {
+                hr = Compress( img, nimg, info, tformat, cflags | dwSRGB | dwCompress, 0.5f, *timage );
             }
-
-            hr = Convert( image->GetImages(), image->GetImageCount(), image->GetMetadata(), tformat, dwFilter | dwFilterOpts | dwSRGB, 0.5f, *timage );
             if ( FAILED(hr) )
             {
-                wprintf( L" FAILED [convert] (%x)\n", hr);
-                goto LError;
+                LogPrintf( pLog, L" FAILED [compress] (%x)\n", hr);
+                return CONVERT_SKIPPED;
             }
 
             auto& tinfo = timage->GetMetadata();
 
-            assert( tinfo.format == tformat );
             info.format = tinfo.format;
-
+            info.mipLevels = tinfo.mipLevels;
             assert( info.width == tinfo.width );
             assert( info.height == tinfo.height );
             assert( info.depth == tinfo.depth );
@@ -1210,413 +1398,872 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             assert( info.dimension == tinfo.dimension );
 
             image.swap( timage );
-            cimage.reset();
         }
+    }
+    else
+    {
+        cimage.reset();
+    }
 
-        // --- Generate mips -----------------------------------------------------------
-        if ( !ispow2(info.width) || !ispow2(info.height) || !ispow2(info.depth) )
+    // --- Set alpha mode ----------------------------------------------------------
+    if ( HasAlpha( info.format )
+         && info.format != DXGI_FORMAT_A8_UNORM )
+    {
+        ImageStatistics stats;
+        hr = ComputeImageStatistics( image->GetImages(), image->GetImageCount(),
+                                     CSTATS_OPAQUE_ONLY | ( ( dwFilterOpts & TEX_FILTER_PARALLEL ) ? CSTATS_PARALLEL : 0 ), stats );
+        if ( SUCCEEDED(hr) && stats.opaque )
         {
-            if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
-            {
-                if ( !tMips )
-                {
-                    tMips = 1;
-                }
-                else
-                {
-                    wprintf( L" ERROR: Cannot generate mips for non-power-of-2 volume textures\n" );
-                    goto LError;
-                }
-            }
-            else if ( !tMips || info.mipLevels != 1 )
-            {
-                nonpow2warn = true;
-            }
+            info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+        }
+        else if ( info.IsPMAlpha() )
+        {
+            // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
+        }
+        else if ( dwOptions & (1 << OPT_SEPALPHA) )
+        {
+            info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
+        }
+        else
+        {
+            info.SetAlphaMode(TEX_ALPHA_MODE_STRAIGHT);
+        }
+    }
+    else
+    {
+        info.miscFlags2 &= ~TEX_MISC2_ALPHA_MODE_MASK;
+    }
+
+    // --- Save result -------------------------------------------------------------
+    {
+        auto img = image->GetImage(0,0,0);
+        assert( img );
+        size_t nimg = image->GetImageCount();
+
+        PrintInfo( info, pLog );
+        LogPrintf( pLog, L"\n");
+
+        // Figure out dest filename
+        WCHAR *pchSlash, *pchDot;
+
+        wcscpy_s(pConv->szDest, MAX_PATH, szPrefix);
+
+        pchSlash = wcsrchr(pConv->szSrc, L'\\');
+        if(pchSlash != 0)
+            wcscat_s(pConv->szDest, MAX_PATH, pchSlash + 1);
+        else
+            wcscat_s(pConv->szDest, MAX_PATH, pConv->szSrc);
+
+        pchSlash = wcsrchr(pConv->szDest, '\\');
+        pchDot = wcsrchr(pConv->szDest, '.');
+
+        if(pchDot > pchSlash)
+            *pchDot = 0;
+
+        wcscat_s(pConv->szDest, MAX_PATH, szSuffix);
+
+        // Write texture
+        LogPrintf( pLog, L"writing %s", pConv->szDest);
+        if ( !pLog )
+            fflush(stdout);
+
+        DWORD ddsFlags = (dwOptions & (1 << OPT_USE_DX10) ) ? (DDS_FLAGS_FORCE_DX10_EXT|DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE;
+        if ( dwFilterOpts & TEX_FILTER_PARALLEL )
+            ddsFlags |= DDS_FLAGS_PARALLEL;
+
+        switch( FileType )
+        {
+        case CODEC_DDS:
+            hr = ( pOutput ) ? SaveToDDSMemory( img, nimg, info, ddsFlags, *pOutput )
+                             : SaveToDDSFile( img, nimg, info, ddsFlags, pConv->szDest );
+            break;
+
+        case CODEC_TGA:
+            hr = ( pOutput ) ? SaveToTGAMemory( img[0], *pOutput )
+                             : SaveToTGAFile( img[0], pConv->szDest );
+            break;
+
+        default:
+            hr = ( pOutput ) ? SaveToWICMemory( img, nimg, WIC_FLAGS_ALL_FRAMES, GetWICCodec( static_cast<WICCodecs>(FileType) ), *pOutput )
+                             : SaveToWICFile( img, nimg, WIC_FLAGS_ALL_FRAMES, GetWICCodec( static_cast<WICCodecs>(FileType) ), pConv->szDest );
+            break;
         }
 
-        if ( (!tMips || info.mipLevels != tMips) && ( info.mipLevels != 1 ) )
+        if(FAILED(hr))
         {
-            // Mips generation only works on a single base image, so strip off existing mip levels
-            std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
-            }
+            LogPrintf( pLog, L" FAILED (%x)\n", hr);
+            return CONVERT_SKIPPED;
+        }
 
-            TexMetadata mdata = info;
-            mdata.mipLevels = 1;
-            hr = timage->Initialize( mdata );
-            if ( FAILED(hr) )
+        // With pOutput the caller finishes the line once the blob is on disk
+        if ( !pOutput )
+            LogPrintf( pLog, L"\n");
+    }
+
+    return CONVERT_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Batch mode (-j)
+//   A reader thread prefetches source files into memory, a pool of workers runs
+//   ConvertFile on them, and the main thread writes the results out in input order along
+//   with each file's messages. At most BATCH_WINDOW_PER_JOB files per worker are in flight
+//   between the reader and the writer, which bounds the memory held by the pipeline.
+//--------------------------------------------------------------------------------------
+#define BATCH_WINDOW_PER_JOB 2
+
+enum BATCH_STATE
+{
+    BATCH_PENDING = 0,
+    BATCH_READ,
+    BATCH_WORKING,
+    BATCH_DONE,
+};
+
+struct SBatchItem
+{
+    SConversion* pConv;
+    BATCH_STATE state;
+
+    std::unique_ptr<uint8_t[]> source;
+    size_t sourceSize;
+    HRESULT hrRead;
+
+    CONVERT_RESULT result;
+    Blob output;
+    std::wstring log;
+
+    SBatchItem() : pConv(nullptr), state(BATCH_PENDING), sourceSize(0), hrRead(S_OK), result(CONVERT_OK) {}
+};
+
+struct SBatch
+{
+    const SConvertOptions* pOpts;
+    SConvertShared* pShared;
+
+    SBatchItem* pItems;
+    size_t nItems;
+    size_t window;
+
+    // Guarded by cs
+    size_t nextRead;
+    size_t nextWork;
+    size_t nextWrite;
+    bool abort;
+
+    CRITICAL_SECTION cs;
+    CONDITION_VARIABLE cv;
+};
+
+HRESULT ReadSourceFile( _In_z_ LPCWSTR szFile, _Inout_ std::unique_ptr<uint8_t[]>& data, _Out_ size_t& size )
+{
+    size = 0;
+
+    HANDLE hFile = CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( hFile == INVALID_HANDLE_VALUE )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    HRESULT hr = S_OK;
+
+    LARGE_INTEGER fileSize = {0};
+    if ( !GetFileSizeEx( hFile, &fileSize ) )
+    {
+        hr = HRESULT_FROM_WIN32( GetLastError() );
+    }
+    else if ( fileSize.HighPart > 0 )
+    {
+        // The loaders can't handle files this large either
+        hr = HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+    else
+    {
+        data.reset( new (std::nothrow) uint8_t[ fileSize.LowPart ? fileSize.LowPart : 1 ] );
+        if ( !data )
+        {
+            hr = E_OUTOFMEMORY;
+        }
+        else
+        {
+            DWORD bytesRead = 0;
+            if ( !ReadFile( hFile, data.get(), fileSize.LowPart, &bytesRead, nullptr ) )
             {
-                wprintf( L" FAILED [copy to single level] (%x)\n", hr);
-                goto LError;
+                hr = HRESULT_FROM_WIN32( GetLastError() );
             }
-
-            if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
+            else if ( bytesRead != fileSize.LowPart )
             {
-                for( size_t d = 0; d < info.depth; ++d )
-                {
-                    hr = CopyRectangle( *image->GetImage( 0, 0, d ), Rect( 0, 0, info.width, info.height ),
-                                        *timage->GetImage( 0, 0, d ), TEX_FILTER_DEFAULT, 0, 0 );
-                    if ( FAILED(hr) )
-                    {
-                        wprintf( L" FAILED [copy to single level] (%x)\n", hr);
-                        goto LError;
-                    }
-                }
+                hr = E_FAIL;
             }
             else
             {
-                for( size_t i = 0; i < info.arraySize; ++i )
-                {
-                    hr = CopyRectangle( *image->GetImage( 0, i, 0 ), Rect( 0, 0, info.width, info.height ),
-                                        *timage->GetImage( 0, i, 0 ), TEX_FILTER_DEFAULT, 0, 0 );
-                    if ( FAILED(hr) )
-                    {
-                        wprintf( L" FAILED [copy to single level] (%x)\n", hr);
-                        goto LError;
-                    }
-                }
+                size = bytesRead;
             }
+        }
+    }
 
-            image.swap( timage );
-            info.mipLevels = image->GetMetadata().mipLevels;
+    CloseHandle( hFile );
 
-            if ( cimage && ( tMips == 1 ) )
-            {
-                // Special case for trimming mips off compressed images and keeping the original compressed highest level mip
-                mdata = cimage->GetMetadata();
-                mdata.mipLevels = 1;
-                hr = timage->Initialize( mdata );
-                if ( FAILED(hr) )
-                {
-                    wprintf( L" FAILED [copy compressed to single level] (%x)\n", hr);
-                    goto LError;
-                }
+    if ( FAILED(hr) )
+        data.reset();
 
-                if ( mdata.dimension == TEX_DIMENSION_TEXTURE3D )
-                {
-                    for( size_t d = 0; d < mdata.depth; ++d )
-                    {
-                        auto simg = cimage->GetImage( 0, 0, d );
-                        auto dimg = timage->GetImage( 0, 0, d );
+    return hr;
+}
 
-                        memcpy_s( dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch );
-                    }
-                }
-                else
-                {
-                    for( size_t i = 0; i < mdata.arraySize; ++i )
-                    {
-                        auto simg = cimage->GetImage( 0, i, 0 );
-                        auto dimg = timage->GetImage( 0, i, 0 );
+HRESULT WriteDestFile( _In_z_ LPCWSTR szFile, _In_ const Blob& blob )
+{
+    if ( blob.GetBufferSize() > 0xFFFFFFFF )
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
 
-                        memcpy_s( dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch );
-                    }
-                }
+    HANDLE hFile = CreateFileW( szFile, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr );
+    if ( hFile == INVALID_HANDLE_VALUE )
+        return HRESULT_FROM_WIN32( GetLastError() );
 
-                cimage.swap( timage );
-            }
-            else
-            {
-                cimage.reset();
-            }
+    HRESULT hr = S_OK;
+
+    DWORD bytesWritten = 0;
+    if ( !WriteFile( hFile, blob.GetBufferPointer(), static_cast<DWORD>( blob.GetBufferSize() ), &bytesWritten, nullptr ) )
+    {
+        hr = HRESULT_FROM_WIN32( GetLastError() );
+    }
+    else if ( bytesWritten != blob.GetBufferSize() )
+    {
+        hr = E_FAIL;
+    }
+
+    CloseHandle( hFile );
+
+    if ( FAILED(hr) )
+        DeleteFileW( szFile );
+
+    return hr;
+}
+
+DWORD WINAPI BatchReaderThread( LPVOID pParam )
+{
+    auto batch = reinterpret_cast<SBatch*>( pParam );
+
+    for(;;)
+    {
+        EnterCriticalSection( &batch->cs );
+
+        while ( !batch->abort && batch->nextRead < batch->nItems
+                && ( batch->nextRead - batch->nextWrite ) >= batch->window )
+        {
+            SleepConditionVariableCS( &batch->cv, &batch->cs, INFINITE );
         }
 
-        if ( ( !tMips || info.mipLevels != tMips ) && ( info.width > 1 || info.height > 1 || info.depth > 1 ) )
+        if ( batch->abort || batch->nextRead >= batch->nItems )
         {
-            std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                goto LError;
-            }
+            LeaveCriticalSection( &batch->cs );
+            break;
+        }
+
+        SBatchItem& item = batch->pItems[ batch->nextRead ];
+
+        LeaveCriticalSection( &batch->cs );
+
+        item.hrRead = ReadSourceFile( item.pConv->szSrc, item.source, item.sourceSize );
+
+        EnterCriticalSection( &batch->cs );
+        item.state = BATCH_READ;
+        ++batch->nextRead;
+        LeaveCriticalSection( &batch->cs );
+
+        WakeAllConditionVariable( &batch->cv );
+    }
+
+    return 0;
+}
+
+DWORD WINAPI BatchWorkerThread( LPVOID pParam )
+{
+    auto batch = reinterpret_cast<SBatch*>( pParam );
+
+    // Needed for WIC
+    HRESULT hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+
+    for(;;)
+    {
+        EnterCriticalSection( &batch->cs );
+
+        // Files are picked up in input order as the reader delivers them
+        while ( !batch->abort && batch->nextWork < batch->nItems
+                && batch->pItems[ batch->nextWork ].state != BATCH_READ )
+        {
+            SleepConditionVariableCS( &batch->cv, &batch->cs, INFINITE );
+        }
+
+        if ( batch->abort || batch->nextWork >= batch->nItems )
+        {
+            LeaveCriticalSection( &batch->cs );
+            break;
+        }
+
+        SBatchItem& item = batch->pItems[ batch->nextWork++ ];
+        item.state = BATCH_WORKING;
+
+        LeaveCriticalSection( &batch->cs );
+
+        if ( FAILED( item.hrRead ) )
+        {
+            LogPrintf( &item.log, L"reading %s FAILED (%x)\n", item.pConv->szSrc, item.hrRead );
+            item.result = CONVERT_SKIPPED;
+        }
+        else
+        {
+            item.result = ConvertFile( item.pConv, *batch->pOpts, *batch->pShared,
+                                       item.source.get(), item.sourceSize, &item.output, &item.log );
+        }
+
+        item.source.reset();
+
+        EnterCriticalSection( &batch->cs );
+        item.state = BATCH_DONE;
+        LeaveCriticalSection( &batch->cs );
+
+        WakeAllConditionVariable( &batch->cv );
+    }
+
+    if ( SUCCEEDED(hrCOM) )
+        CoUninitialize();
+
+    return 0;
+}
+
+bool RunBatch( _In_ SConversion* pConversion, _In_ const SConvertOptions& opts, _Inout_ SConvertShared& shared, _In_ size_t jobs )
+{
+    assert( jobs > 1 && jobs < MAXIMUM_WAIT_OBJECTS );
+
+    size_t nItems = 0;
+    for( SConversion* pConv = pConversion; pConv; pConv = pConv->pNext )
+        ++nItems;
+
+    std::unique_ptr<SBatchItem[]> items( new (std::nothrow) SBatchItem[ nItems ] );
+    if ( !items )
+    {
+        wprintf( L"ERROR: Memory allocation failed\n" );
+        return false;
+    }
+
+    {
+        size_t index = 0;
+        for( SConversion* pConv = pConversion; pConv; pConv = pConv->pNext )
+            items[ index++ ].pConv = pConv;
+    }
+
+    SBatch batch;
+    batch.pOpts = &opts;
+    batch.pShared = &shared;
+    batch.pItems = items.get();
+    batch.nItems = nItems;
+    batch.window = jobs * BATCH_WINDOW_PER_JOB;
+    batch.nextRead = batch.nextWork = batch.nextWrite = 0;
+    batch.abort = false;
+    InitializeCriticalSection( &batch.cs );
+    InitializeConditionVariable( &batch.cv );
+
+    HANDLE hThreads[ MAXIMUM_WAIT_OBJECTS ];
+    DWORD nThreads = 0;
+
+    hThreads[ nThreads ] = CreateThread( nullptr, 0, BatchReaderThread, &batch, 0, nullptr );
+    if ( hThreads[ nThreads ] )
+        ++nThreads;
+
+    for( size_t j = 0; j < jobs && nThreads == j + 1; ++j )
+    {
+        hThreads[ nThreads ] = CreateThread( nullptr, 0, BatchWorkerThread, &batch, 0, nullptr );
+        if ( hThreads[ nThreads ] )
+            ++nThreads;
+    }
+
+    bool fatal = false;
 
-            if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
+    if ( nThreads < 2 )
+    {
+        // Without a reader and at least one worker nothing would ever complete
+        wprintf( L"ERROR: Failed to create batch threads (%x)\n", HRESULT_FROM_WIN32( GetLastError() ) );
+        fatal = true;
+    }
+
+    LARGE_INTEGER qpcFreq, qpcStart, qpcNow;
+    QueryPerformanceFrequency( &qpcFreq );
+    QueryPerformanceCounter( &qpcStart );
+
+    size_t nConverted = 0;
+    ULONGLONG bytesRead = 0;
+    ULONGLONG bytesWritten = 0;
+    double elapsed = 0;
+
+    // The main thread is the writer stage
+    for( size_t i = 0; i < nItems && !fatal; ++i )
+    {
+        SBatchItem& item = items[ i ];
+
+        EnterCriticalSection( &batch.cs );
+        while ( item.state != BATCH_DONE )
+        {
+            SleepConditionVariableCS( &batch.cv, &batch.cs, INFINITE );
+        }
+        LeaveCriticalSection( &batch.cs );
+
+        if ( i > 0 )
+            wprintf( L"\n");
+
+        wprintf( L"%s", item.log.c_str() );
+
+        bytesRead += item.sourceSize;
+
+        if ( item.result == CONVERT_OK )
+        {
+            HRESULT hr = WriteDestFile( item.pConv->szDest, item.output );
+            if ( FAILED(hr) )
             {
-                hr = GenerateMipMaps3D( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
+                wprintf( L" FAILED (%x)\n", hr);
             }
             else
             {
-                hr = GenerateMipMaps( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
-            }
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [mipmaps] (%x)\n", hr);
-                goto LError;
+                wprintf( L"\n");
+                ++nConverted;
+                bytesWritten += item.output.GetBufferSize();
             }
+        }
+        else if ( item.result == CONVERT_FATAL )
+        {
+            fatal = true;
+        }
 
-            auto& tinfo = timage->GetMetadata();
-            info.mipLevels = tinfo.mipLevels;
+        item.output.Release();
+        item.log.clear();
 
-            assert( info.width == tinfo.width );
-            assert( info.height == tinfo.height );
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.dimension == tinfo.dimension );
+        QueryPerformanceCounter( &qpcNow );
+        elapsed = double( qpcNow.QuadPart - qpcStart.QuadPart ) / double( qpcFreq.QuadPart );
+
+        if ( elapsed > 0 )
+        {
+            wprintf( L"[%Iu/%Iu] %.1f files/sec, %.1f MB/sec read\n", i + 1, nItems,
+                     double( i + 1 ) / elapsed, double( bytesRead ) / ( 1024.0 * 1024.0 * elapsed ) );
+        }
+        else
+        {
+            wprintf( L"[%Iu/%Iu]\n", i + 1, nItems );
+        }
+        fflush(stdout);
+
+        EnterCriticalSection( &batch.cs );
+        ++batch.nextWrite;
+        if ( fatal )
+            batch.abort = true;
+        LeaveCriticalSection( &batch.cs );
+
+        WakeAllConditionVariable( &batch.cv );
+    }
+
+    if ( fatal )
+    {
+        EnterCriticalSection( &batch.cs );
+        batch.abort = true;
+        LeaveCriticalSection( &batch.cs );
+
+        WakeAllConditionVariable( &batch.cv );
+    }
 
+    if ( nThreads > 0 )
+    {
+        WaitForMultipleObjects( nThreads, hThreads, TRUE, INFINITE );
+
+        for( DWORD j = 0; j < nThreads; ++j )
+            CloseHandle( hThreads[ j ] );
+    }
+
+    DeleteCriticalSection( &batch.cs );
+
+    if ( !fatal )
+    {
+        wprintf( L"\n%Iu of %Iu files converted in %.2f seconds", nConverted, nItems, elapsed );
+        if ( elapsed > 0 )
+        {
+            wprintf( L" (%.1f files/sec, %.1f MB/sec read, %.1f MB/sec written)", double( nItems ) / elapsed,
+                     double( bytesRead ) / ( 1024.0 * 1024.0 * elapsed ), double( bytesWritten ) / ( 1024.0 * 1024.0 * elapsed ) );
+        }
+        wprintf( L"\n");
+    }
+
+    return !fatal;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // Parameters and defaults
+    HRESULT hr;
+    INT nReturn;
+
+    size_t width = 0;
+    size_t height = 0; 
+    size_t mipLevels = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    DWORD dwFilter = TEX_FILTER_DEFAULT;
+    DWORD dwSRGB = 0;
+    DWORD dwFilterOpts = 0;
+    DWORD FileType = CODEC_DDS;
+    DWORD maxSize = 16384;
+    float alphaWeight = 1.f;
+    DWORD dwCompress = TEX_COMPRESS_DEFAULT;
+    size_t jobs = 1;
+
+    WCHAR szPrefix   [MAX_PATH];
+    WCHAR szSuffix   [MAX_PATH];
+    WCHAR szOutputDir[MAX_PATH];
+
+    szPrefix[0]    = 0;
+    szSuffix[0]    = 0;
+    szOutputDir[0] = 0;
+
+    // Initialize COM (needed for WIC)
+    if( FAILED( hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED) ) )
+    {
+        wprintf( L"Failed to initialize COM (%08X)\n", hr);
+        return 1;
+    }
+
+    // Process command line
+    DWORD dwOptions = 0;
+    SConversion *pConversion = nullptr;
+    SConversion **ppConversion = &pConversion;
+
+    for(int iArg = 1; iArg < argc; iArg++)
+    {
+        PWSTR pArg = argv[iArg];
+
+        if(('-' == pArg[0]) || ('/' == pArg[0]))
+        {
+            pArg++;
+            PWSTR pValue;
+
+            for(pValue = pArg; *pValue && (':' != *pValue); pValue++);
+
+            if(*pValue)
+                *pValue++ = 0;
+
+            DWORD dwOption = LookupByName(pArg, g_pOptions);
+
+            if(!dwOption || (dwOptions & (1 << dwOption)))
+            {
+                PrintUsage();
+                return 1;
+            }
 
-            image.swap( timage );
-            cimage.reset();
-        }
+            dwOptions |= 1 << dwOption;
 
-        // --- Premultiplied alpha (if requested) --------------------------------------
-        if ( ( dwOptions & (1 << OPT_PREMUL_ALPHA) )
-             && HasAlpha( info.format )
-             && info.format != DXGI_FORMAT_A8_UNORM )
-        {
-            if ( info.IsPMAlpha() )
+            if( (OPT_NOLOGO != dwOption) && (OPT_TYPELESS_UNORM != dwOption) && (OPT_TYPELESS_FLOAT != dwOption)
+                && (OPT_SEPALPHA != dwOption) && (OPT_PREMUL_ALPHA != dwOption) && (OPT_EXPAND_LUMINANCE != dwOption)
+                && (OPT_TA_WRAP != dwOption) && (OPT_TA_MIRROR != dwOption)
+                && (OPT_FORCE_SINGLEPROC != dwOption) && (OPT_NOGPU != dwOption) && (OPT_FIT_POWEROF2 != dwOption)
+                && (OPT_SRGB != dwOption) && (OPT_SRGBI != dwOption) && (OPT_SRGBO != dwOption)
+                && (OPT_HFLIP != dwOption) && (OPT_VFLIP != dwOption)
+                && (OPT_DDS_DWORD_ALIGN != dwOption) && (OPT_USE_DX10 != dwOption) )
             {
-                printf("WARNING: Image is already using premultiplied alpha\n");
+                if(!*pValue)
+                {
+                    if((iArg + 1 >= argc))
+                    {
+                        PrintUsage();
+                        return 1;
+                    }
+
+                    iArg++;
+                    pValue = argv[iArg];
+                }
             }
-            else
+
+            switch(dwOption)
             {
-                auto img = image->GetImage(0,0,0);
-                assert( img );
-                size_t nimg = image->GetImageCount();
+            case OPT_WIDTH:
+                if (swscanf_s(pValue, L"%Iu", &width) != 1)
+                {
+                    wprintf( L"Invalid value specified with -w (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
 
-                std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-                if ( !timage )
+            case OPT_HEIGHT:
+                if (swscanf_s(pValue, L"%Iu", &height) != 1)
                 {
-                    wprintf( L" ERROR: Memory allocation failed\n" );
-                    goto LError;
+                    wprintf( L"Invalid value specified with -h (%s)\n", pValue);
+                    printf("\n");
+                    PrintUsage();
+                    return 1;
                 }
+                break;
 
-                hr = PremultiplyAlpha( img, nimg, info, dwSRGB, *timage );
-                if ( FAILED(hr) )
+            case OPT_MIPLEVELS:
+                if (swscanf_s(pValue, L"%Iu", &mipLevels) != 1)
                 {
-                    wprintf( L" FAILED [premultiply alpha] (%x)\n", hr);
-                    continue;
+                    wprintf( L"Invalid value specified with -m (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
                 }
+                break;
 
-                auto& tinfo = timage->GetMetadata();
-                info.miscFlags2 = tinfo.miscFlags2;
- 
-                assert( info.width == tinfo.width );
-                assert( info.height == tinfo.height );
-                assert( info.depth == tinfo.depth );
-                assert( info.arraySize == tinfo.arraySize );
-                assert( info.mipLevels == tinfo.mipLevels );
-                assert( info.miscFlags == tinfo.miscFlags );
-                assert( info.miscFlags2 == tinfo.miscFlags2 );
-                assert( info.dimension == tinfo.dimension );
+            case OPT_FORMAT:
+                format = (DXGI_FORMAT) LookupByName(pValue, g_pFormats);
+                if ( !format )
+                {
+                    wprintf( L"Invalid value specified with -f (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
 
-                image.swap( timage );
-                cimage.reset();
-            }
-        }
+            case OPT_FILTER:
+                dwFilter = LookupByName(pValue, g_pFilters);
+                if ( !dwFilter )
+                {
+                    wprintf( L"Invalid value specified with -if (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
 
-        // --- Compress ----------------------------------------------------------------
-        if ( IsCompressed( tformat ) && (FileType == CODEC_DDS) )
-        {
-            if ( cimage && ( cimage->GetMetadata().format == tformat ) )
-            {
-                // We never changed the image and it was already compressed in our desired format, use original data
-                image.reset( cimage.release() );
+            case OPT_SRGBI:
+                dwSRGB |= TEX_FILTER_SRGB_IN;
+                break;
 
-                auto& tinfo = image->GetMetadata();
+            case OPT_SRGBO:
+                dwSRGB |= TEX_FILTER_SRGB_OUT;
+                break;
 
-                if ( (tinfo.width % 4) != 0 || (tinfo.height % 4) != 0 )
-                { 
-                    non4bc = true;
-                }
+            case OPT_SRGB:
+                dwSRGB |= TEX_FILTER_SRGB;
+                break;
 
-                info.format = tinfo.format;
-                assert( info.width == tinfo.width );
-                assert( info.height == tinfo.height );
-                assert( info.depth == tinfo.depth );
-                assert( info.arraySize == tinfo.arraySize );
-                assert( info.mipLevels == tinfo.mipLevels );
-                assert( info.miscFlags == tinfo.miscFlags );
-                assert( info.miscFlags2 == tinfo.miscFlags2 );
-                assert( info.dimension == tinfo.dimension );
-            }
-            else
-            {
-                cimage.reset();
+            case OPT_SEPALPHA:
+                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
+                break;
+
+            case OPT_PREFIX:
+                wcscpy_s(szPrefix, MAX_PATH, pValue);
+                break;
+
+            case OPT_SUFFIX:
+                wcscpy_s(szSuffix, MAX_PATH, pValue);
+                break;
 
-                auto img = image->GetImage(0,0,0);
-                assert( img );
-                size_t nimg = image->GetImageCount();
+            case OPT_OUTPUTDIR:
+                wcscpy_s(szOutputDir, MAX_PATH, pValue);
+                break;
 
-                std::unique_ptr<ScratchImage> timage( new (std::nothrow) ScratchImage );
-                if ( !timage )
+            case OPT_FILETYPE:
+                FileType = LookupByName(pValue, g_pSaveFileTypes);
+                if ( !FileType )
                 {
-                    wprintf( L" ERROR: Memory allocation failed\n" );
-                    goto LError;
+                    wprintf( L"Invalid value specified with -ft (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
                 }
+                break;
 
-                bool bc6hbc7=false;
-                switch( tformat )
+            case OPT_TA_WRAP:
+                if ( dwFilterOpts & TEX_FILTER_MIRROR )
                 {
-                case DXGI_FORMAT_BC6H_TYPELESS:
-                case DXGI_FORMAT_BC6H_UF16:
-                case DXGI_FORMAT_BC6H_SF16:
-                case DXGI_FORMAT_BC7_TYPELESS:
-                case DXGI_FORMAT_BC7_UNORM:
-                case DXGI_FORMAT_BC7_UNORM_SRGB:
-                    bc6hbc7=true;
-
-                    {
-                        static bool s_tryonce = false;
-
-                        if ( !s_tryonce )
-                        {
-                            s_tryonce = true;
-
-                            if ( !(dwOptions & (1 << OPT_NOGPU) ) )
-                            {
-                                if ( !CreateDevice( &pDevice ) )
-                                    wprintf( L"\nWARNING: DirectCompute is not available, using BC6H / BC7 CPU codec\n" );
-                            }
-                            else
-                            {
-                                wprintf( L"\nWARNING: using BC6H / BC7 CPU codec\n" );
-                            }
-                        }
-                    }
-                    break;
+                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
                 }
+                dwFilterOpts |= TEX_FILTER_WRAP;
+                break;
 
-                DWORD cflags = TEX_COMPRESS_DEFAULT;
-#ifdef _OPENMP
-                if ( bc6hbc7 && !(dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
+            case OPT_TA_MIRROR:
+                if ( dwFilterOpts & TEX_FILTER_WRAP )
                 {
-                    cflags |= TEX_COMPRESS_PARALLEL;
+                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
                 }
-#endif
+                dwFilterOpts |= TEX_FILTER_MIRROR;
+                break;
 
-                if ( (img->width % 4) != 0 || (img->height % 4) != 0 )
-                { 
-                    non4bc = true;
+            case OPT_FEATURE_LEVEL:
+                maxSize = LookupByName( pValue, g_pFeatureLevels );
+                if ( !maxSize )
+                {
+                    wprintf( L"Invalid value specified with -fl (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
                 }
+                break;
 
-                if ( bc6hbc7 && pDevice )
+            case OPT_ALPHA_WEIGHT:
+                if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
                 {
-                    hr = Compress( pDevice, img, nimg, info, tformat, dwSRGB, alphaWeight, *timage );
+                    wprintf( L"Invalid value specified with -aw (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
                 }
-                else
+                else if ( alphaWeight < 0.f )
                 {
-                    hr = Compress( img, nimg, info, tformat, cflags | dwSRGB, 0.5f, *timage );
+                    wprintf( L"-aw (%s) parameter must be positive\n", pValue);
+                    wprintf( L"\n");
+                    return 1;
                 }
-                if ( FAILED(hr) )
+                break;
+
+            case OPT_BC_QUICK:
                 {
-                    wprintf( L" FAILED [compress] (%x)\n", hr);
-                    continue;
+                    // BC6H has a single fast tier, used for any non-zero level
+                    static const DWORD s_bcQuick[] = { TEX_COMPRESS_DEFAULT,
+                                                       TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC6H_QUICK,
+                                                       TEX_COMPRESS_BC7_QUICKER | TEX_COMPRESS_BC6H_QUICK,
+                                                       TEX_COMPRESS_BC7_QUICKEST | TEX_COMPRESS_BC6H_QUICK };
+
+                    size_t level = 0;
+                    if (swscanf_s(pValue, L"%Iu", &level) != 1 || level >= _countof(s_bcQuick))
+                    {
+                        wprintf( L"Invalid value specified with -bcquick (%s)\n", pValue);
+                        wprintf( L"\n");
+                        PrintUsage();
+                        return 1;
+                    }
+                    dwCompress = s_bcQuick[ level ];
                 }
+                break;
 
-                auto& tinfo = timage->GetMetadata();
-
-                info.format = tinfo.format;
-                assert( info.width == tinfo.width );
-                assert( info.height == tinfo.height );
-                assert( info.depth == tinfo.depth );
-                assert( info.arraySize == tinfo.arraySize );
-                assert( info.mipLevels == tinfo.mipLevels );
-                assert( info.miscFlags == tinfo.miscFlags );
-                assert( info.miscFlags2 == tinfo.miscFlags2 );
-                assert( info.dimension == tinfo.dimension );
-
-                image.swap( timage );
+            case OPT_JOBS:
+                // The batch threads are waited on together, which caps the count
+                if (swscanf_s(pValue, L"%Iu", &jobs) != 1 || jobs < 1 || jobs >= MAXIMUM_WAIT_OBJECTS)
+                {
+                    wprintf( L"Invalid value specified with -j (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
             }
         }
         else
-        {
-            cimage.reset();
-        }
+        {         
+            SConversion *pConv = new SConversion;
+            if ( !pConv )
+                return 1;
 
-        // --- Set alpha mode ----------------------------------------------------------
-        if ( HasAlpha( info.format )
-             && info.format != DXGI_FORMAT_A8_UNORM )
-        {
-            if ( image->IsAlphaAllOpaque() )
-            {
-                info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
-            }
-            else if ( info.IsPMAlpha() )
-            {
-                // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
-            }
-            else if ( dwOptions & (1 << OPT_SEPALPHA) )
-            {
-                info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
-            }
-            else
-            {
-                info.SetAlphaMode(TEX_ALPHA_MODE_STRAIGHT);
-            }
-        }
-        else
-        {
-            info.miscFlags2 &= ~TEX_MISC2_ALPHA_MODE_MASK;
+            wcscpy_s(pConv->szSrc, MAX_PATH, pArg);
+
+            pConv->szDest[0] = 0;
+            pConv->pNext = nullptr;
+
+            *ppConversion = pConv;
+            ppConversion = &pConv->pNext;
         }
+    }
 
-        // --- Save result -------------------------------------------------------------
-        {
-            auto img = image->GetImage(0,0,0);
-            assert( img );
-            size_t nimg = image->GetImageCount();
+    if(!pConversion)
+    {
+        PrintUsage();
+        return 0;
+    }
 
-            PrintInfo( info );
-            wprintf( L"\n");
+    if(~dwOptions & (1 << OPT_NOLOGO))
+        PrintLogo();
 
-            // Figure out dest filename
-            WCHAR *pchSlash, *pchDot;
+#ifdef _OPENMP
+    // Resize, Convert and GenerateMipMaps spread array items and volume slices across cores
+    if(~dwOptions & (1 << OPT_FORCE_SINGLEPROC))
+        dwFilterOpts |= TEX_FILTER_PARALLEL;
+#endif
 
-            wcscpy_s(pConv->szDest, MAX_PATH, szPrefix);
+    // Work out out filename prefix and suffix
+    if(szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
+        wcscat_s( szOutputDir, MAX_PATH, L"\\" );
 
-            pchSlash = wcsrchr(pConv->szSrc, L'\\');
-            if(pchSlash != 0)
-                wcscat_s(pConv->szDest, MAX_PATH, pchSlash + 1);
-            else
-                wcscat_s(pConv->szDest, MAX_PATH, pConv->szSrc);
+    if(szPrefix[0])
+        wcscat_s(szOutputDir, MAX_PATH, szPrefix);
+
+    wcscpy_s(szPrefix, MAX_PATH, szOutputDir);
 
-            pchSlash = wcsrchr(pConv->szDest, '\\');
-            pchDot = wcsrchr(pConv->szDest, '.');
+    const WCHAR* fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
 
-            if(pchDot > pchSlash)
-                *pchDot = 0;
+    if (fileTypeName)
+    {
+        wcscat_s(szSuffix, MAX_PATH, L".");
+        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
+    }
+    else
+    {
+        wcscat_s(szSuffix, MAX_PATH, L".unknown");
+    }
 
-            wcscat_s(pConv->szDest, MAX_PATH, szSuffix);
+    if (FileType != CODEC_DDS)
+    {
+        mipLevels = 1;
+    }
 
-            // Write texture
-            wprintf( L"writing %s", pConv->szDest);
-            fflush(stdout);
+    SConvertOptions opts;
+    opts.width = width;
+    opts.height = height;
+    opts.mipLevels = mipLevels;
+    opts.format = format;
+    opts.dwFilter = dwFilter;
+    opts.dwSRGB = dwSRGB;
+    opts.dwFilterOpts = dwFilterOpts;
+    opts.FileType = FileType;
+    opts.maxSize = maxSize;
+    opts.alphaWeight = alphaWeight;
+    opts.dwCompress = dwCompress;
+    opts.dwOptions = dwOptions;
+    wcscpy_s( opts.szPrefix, MAX_PATH, szPrefix );
+    wcscpy_s( opts.szSuffix, MAX_PATH, szSuffix );
+
+    SConvertShared shared;
+    InitializeCriticalSection( &shared.gpuLock );
+    shared.pDevice = nullptr;
+    shared.gpuTried = false;
+    shared.nonpow2warn = FALSE;
+    shared.non4bc = FALSE;
 
-            switch( FileType )
-            {
-            case CODEC_DDS:
-                hr = SaveToDDSFile( img, nimg, info,
-                                    (dwOptions & (1 << OPT_USE_DX10) ) ? (DDS_FLAGS_FORCE_DX10_EXT|DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE, 
-                                    pConv->szDest );
-                break;
+    // Convert images
+    SConversion *pConv;
 
-            case CODEC_TGA:
-                hr = SaveToTGAFile( img[0], pConv->szDest );
-                break;
+    if ( jobs > 1 && pConversion->pNext )
+    {
+#ifdef _OPENMP
+        // Split the cores between the batch workers rather than have each one spin up a full set of OpenMP threads
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo( &sysInfo );
+        SetMaxThreads( std::max<size_t>( 1, sysInfo.dwNumberOfProcessors / jobs ) );
+#endif
 
-            default:
-                hr = SaveToWICFile( img, nimg, WIC_FLAGS_ALL_FRAMES, GetWICCodec( static_cast<WICCodecs>(FileType) ), pConv->szDest );
-                break;
-            }
+        if ( !RunBatch( pConversion, opts, shared, jobs ) )
+            goto LError;
+    }
+    else
+    {
+        for(pConv = pConversion; pConv; pConv = pConv->pNext)
+        {
+            if(pConv != pConversion)
+                wprintf( L"\n");
 
-            if(FAILED(hr))
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                continue;
-            }
-            wprintf( L"\n");
+            if ( ConvertFile( pConv, opts, shared, nullptr, 0, nullptr, nullptr ) == CONVERT_FATAL )
+                goto LError;
         }
     }
 
-    if ( nonpow2warn )
+    if ( shared.nonpow2warn )
         wprintf( L"\n WARNING: Not all feature levels support non-power-of-2 textures with mipmaps\n" );
 
-    if ( non4bc )
+    if ( shared.non4bc )
         wprintf( L"\n WARNING: Direct3D requires BC image to be multiple of 4 in width & height\n" );
 
     nReturn = 0;
@@ -1635,10 +2282,12 @@ LDone:
         delete pConv;
     }
 
-    if ( pDevice )
+    if ( shared.pDevice )
     {
-        pDevice->Release();
+        shared.pDevice->Release();
     }
 
+    DeleteCriticalSection( &shared.gpuLock );
+
     return nReturn;
 }